@@ -1,10 +1,44 @@
 #include "vk_core.hpp"
 #include "vk_pipeline.hpp"
+#include "vk_config.hpp"
+#include "vk_profiler.hpp"
+#include "vk_hot_reload.hpp"
+#include "vk_memory.hpp"
+#include "vk_reflect.hpp"
+#include "vk_variant.hpp"
+#include "vk_draw.hpp"
+#include "vk_buffer.hpp"
+#include "vk_handle.hpp"
+#include "vk_attachment.hpp"
+#include "vk_tonemap.hpp"
+#include "vk_compute.hpp"
+#include "vk_primitives.hpp"
+#include "vk_particles.hpp"
+#include "vk_texture.hpp"
+#include "vk_ktx.hpp"
+#include "vk_query.hpp"
+#include "vk_readback.hpp"
+#include "vk_video.hpp"
+#include "vk_input.hpp"
 #include "my_util.hpp"
 
 #include <iostream>		// reporting errors
 #include <stdexcept>	// reporting errors: std::runtime_error()
 #include <cstdlib>		// miscellaneous utilities (EXIT_SUCCESS, EXIT_FAILURE)
+#include <memory>
+#include <cmath>		// sqrt(), ceil()
+#include <filesystem>
+#include <future>
+#include <sstream>
+#include <iomanip>
+#include <functional>
+#include <numeric>		// inclusive_scan(), exclusive_scan()
+#include <algorithm>	// sort()
+#include <random>
+#include <cstring>		// memcpy()
+#include <thread>
+#include <atomic>
+#include <exception>	// exception_ptr
 
 
 using namespace my_util; // my_util.hpp
@@ -13,156 +47,2008 @@ using namespace my_util; // my_util.hpp
 /* -------------------- -------------------- */
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
+
+const std::string PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+const std::string DEVICE_PROBE_CACHE_FILE = "device_probe.cache";
+
+// Fraction of the budget of a device local heap above which memory pressure is logged
+const double MEMORY_PRESSURE_THRESHOLD = 0.9;
 /* -------------------- -------------------- */
 
 
-/*
-This class stores the Vulkan objects as private members
-and interacts with them through functions.
-*/
-class HelloTriangle {
+/*
+This class stores the Vulkan objects as private members
+and interacts with them through functions.
+*/
+class HelloTriangle {
+
+public:
+
+	explicit HelloTriangle(const vk_config::Config& config)
+		: config(config), render_path(config.render_path) {
+	}
+
+
+	void run() {
+
+		// If at any time during execution an error occurs,
+		// we'll throw a std::runtime_error exception
+		// which will propagate back to the main function and catched
+		// by the general std::exception.
+
+		prefetch_startup_files();
+
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "init_window");
+			init_window();
+		}
+
+		init_vulkan();
+
+		if (config.benchmark_frames > 0) {
+			run_benchmark();
+		}
+		else if (config.benchmark_variants > 0) {
+			run_variant_benchmark();
+		}
+		else if (config.benchmark_draws > 0) {
+			run_per_draw_benchmark();
+		}
+		else if (config.benchmark_msaa > 0) {
+			run_msaa_benchmark();
+		}
+		else if (config.benchmark_depth_prepass > 0) {
+			run_depth_prepass_benchmark();
+		}
+		else if (config.benchmark_hdr > 0) {
+			run_hdr_benchmark();
+		}
+		else if (config.benchmark_textures > 0) {
+			run_texture_benchmark();
+		}
+		else if (config.benchmark_capture > 0) {
+			run_capture_benchmark();
+		}
+		else if (config.benchmark_render_thread > 0) {
+			run_render_thread_benchmark();
+		}
+		else {
+			main_loop();
+		}
+
+		cleanup();
+	}
+
+
+private:
+
+	vk_config::Config config;
+	vk_config::RenderPath render_path; // the render path in use, may differ from the requested one
+
+	GLFWwindow* window;
+
+	VkInstance instance;
+	VkSurfaceKHR surface;
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE; // implicitly destroyed in vkDestroyInstance()
+	vk_device::DeviceProbe device_probe; // capabilities of physical_device
+	VkDevice device;
+
+	// All queues are implicitly destoyed in vkDestroyDevice()
+	VkQueue queue_graphics;
+	VkQueue queue_present;
+	uint32_t timestamp_valid_bits = 0; // of the graphics queue family, read by create_timestamp_query_pool()
+
+	// Destroys the objects released by the handles below once the frames that may use them
+	// have completed, so replacing them never waits for the device to be idle
+	vk_handle::DeletionQueue deletion_queue;
+
+	vk_handle::Handle<VkSwapchainKHR> swapchain;
+	std::vector<VkImage> swapchain_images; // implicitly destroyed in vkDestroySwapchainKHR()
+	VkFormat swapchain_image_format;
+	VkExtent2D swapchain_extent;
+	// Of the window, for the swapchain: only read from GLFW on the main thread (read_framebuffer_extent()),
+	// the render thread gets it from the Resize events
+	VkExtent2D framebuffer_extent = { 0, 0 };
+	bool swapchain_out_of_date = false; // recreated by the next draw_frame(), for framebuffer_extent
+	VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT; // of the color target, clamped to what the GPU supports
+	VkFormat depth_format = VK_FORMAT_UNDEFINED;
+	bool depth_prepass = false; // the render pass, the pipelines and the attachments depend on it
+	VkFormat hdr_format = VK_FORMAT_UNDEFINED; // of the offscreen color target, UNDEFINED renders straight to the swapchain
+	bool storage_swapchain = false; // swapchain images written by the tone mapping pass
+	bool readback_swapchain = false; // swapchain images copied to host memory (vk_readback)
+	std::vector<vk_handle::Handle<VkImageView>> swapchain_image_views;
+	std::vector<vk_handle::Handle<VkFramebuffer>> swapchain_framebuffers;
+	std::vector<vk_attachment::Attachment> framebuffer_attachments; // shared by the framebuffers (render pass path)
+
+	vk_handle::Handle<VkPipelineCache> pipeline_cache;
+	std::unique_ptr<vk_reflect::LayoutCache> layout_cache; // owns every pipeline and descriptor set layout
+	std::unique_ptr<vk_variant::VariantCache> variant_cache; // pipelines of the benchmarked shader variants
+	vk_handle::Handle<VkPipeline> pipeline;
+	VkPipelineLayout pipeline_layout;
+	vk_handle::Handle<VkPipeline> depth_prepass_pipeline; // only depth writes
+	VkPipelineLayout depth_prepass_pipeline_layout;        // the layout of the variant, same as pipeline_layout
+	vk_handle::Handle<VkRenderPass> render_pass; // not created with dynamic rendering
+	std::unique_ptr<vk_tonemap::ToneMapPass> tone_map; // only created with storage_swapchain
+	bool particles_enabled = false; // the particle pipeline is built with the render path objects
+	vk_handle::Handle<VkPipeline> particle_pipeline;
+	VkPipelineLayout particle_pipeline_layout;
+	std::unique_ptr<vk_particles::ParticleSystem> particle_system;
+	std::unique_ptr<vk_texture::SamplerCache> sampler_cache; // samplers of every texture, one per sampler state
+	std::vector<vk_texture::Texture> textures; // loaded from config.textures
+
+	vk_handle::Handle<VkCommandPool> command_pool;
+	VkCommandBuffer command_buffer; // implicitly freed with the command pool
+
+	vk_handle::Handle<VkSemaphore> semaphore_image_available;
+	vk_handle::Handle<VkSemaphore> semaphore_render_finished;
+	vk_handle::Handle<VkFence> fence_in_flight;
+
+	// Passes and resources of the frame, declared again every frame (dynamic rendering path)
+	std::unique_ptr<vk_graph::RenderGraph> render_graph;
+	vk_profiler::FrameCounters barrier_counters; // of the render graph, each frame
+
+	std::unique_ptr<vk_hot_reload::ShaderHotReload> shader_hot_reload;
+
+	// Budget and usage of every memory heap, sampled each frame
+	std::unique_ptr<vk_memory::MemoryTelemetry> memory_telemetry;
+	uint64_t frame_count = 0;
+
+	// Statistics and occlusion queries of every pass, with --pass-queries
+	std::unique_ptr<vk_query::QueryManager> pass_queries;
+
+	// Every frame written to config.capture, with --capture. The readback consumes into the sink:
+	// declared after it, destroyed before it.
+	std::unique_ptr<vk_video::VideoSink> video_sink;
+	std::unique_ptr<vk_readback::ReadbackService> frame_readback; // main loop only
+
+	// Startup phases until the first frame, on every thread
+	vk_profiler::TraceRecorder startup_trace;
+	std::vector<std::future<MappedFile>> prefetched_files;
+	bool first_frame_presented = false;
+	/* -------------------- -------------------- */
+
+
+	// Own an object created from the device, released through the deletion queue
+	template <typename T>
+	vk_handle::Handle<T> own(T handle) {
+
+		return vk_handle::Handle<T>(handle, device, &deletion_queue);
+	}
+
+
+	// Start reading the files the pipeline needs while the window and the device
+	// are created: create_pipeline() then maps them from the OS file cache
+	void prefetch_startup_files() {
+
+		for (const std::string& file_path : { std::string("shaders/vert.spv"), std::string("shaders/frag.spv"), PIPELINE_CACHE_FILE }) {
+			if (std::filesystem::exists(file_path)) {
+				prefetched_files.push_back(map_file_async(file_path));
+			}
+		}
+	}
+
+
+	// Initialize a GLFW window
+	void init_window() {
+
+		glfwInit();    // Initialize GLFW library
+
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Do not create an OpenGL context -> GLFW_NO_API
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);	  // The swapchain is recreated for the new framebuffer size
+
+		// The capture benchmark streams full HD frames
+		if (config.benchmark_capture > 0) {
+			window = glfwCreateWindow(1920, 1080, "Vulkan tutorial", nullptr, nullptr);
+		}
+		else {
+			window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan tutorial", nullptr, nullptr);
+		}
+	}
+
+
+	// Initialize the Vulkan objects.
+	// The pipeline is compiled on another thread while the swapchain
+	// and the per-frame objects are created on this one.
+	void init_vulkan() {
+
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_vk_instance");
+			vk_core::create_vk_instance(instance);
+		}
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_vk_surface");
+			vk_core::create_vk_surface(surface, instance, window);
+		}
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "select_physical_device");
+			vk_core::select_physical_device(physical_device, device_probe,
+				                            instance, surface,
+				                            config.device, DEVICE_PROBE_CACHE_FILE);
+		}
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_logical_device");
+			vk_core::create_logical_device(device, physical_device, device_probe,
+				                           instance, surface,
+				                           queue_graphics, queue_present);
+		}
+
+		memory_telemetry = std::make_unique<vk_memory::MemoryTelemetry>(
+			physical_device, device_probe.memory_budget_extension, MEMORY_PRESSURE_THRESHOLD);
+
+		render_graph = std::make_unique<vk_graph::RenderGraph>(physical_device, device, &deletion_queue);
+
+		if (config.pass_queries > 0) {
+			pass_queries = std::make_unique<vk_query::QueryManager>(
+				physical_device, device, device_probe, &deletion_queue);
+		}
+
+		// Enabled by create_logical_device() with dynamic rendering, on Vulkan 1.3 devices only.
+		// The render graph and the barrier trackers record vkCmdPipelineBarrier2(): without it
+		// only the render pass path is left, without the features that go through them.
+		bool synchronization2 = device_probe.dynamic_rendering;
+
+		if (render_path == vk_config::RenderPath::DynamicRendering && !synchronization2) {
+
+			LOG_MESSAGE("Dynamic rendering not supported, falling back to the render pass path.", Color::Red, Color::Black, 0);
+			render_path = vk_config::RenderPath::RenderPass;
+		}
+
+		msaa_samples = vk_attachment::clamp_sample_count(config.msaa_samples, physical_device);
+		if (msaa_samples != config.msaa_samples) {
+			LOG_MESSAGE(std::to_string(config.msaa_samples) + "x MSAA not supported, using " +
+				        std::to_string(msaa_samples) + "x.", Color::Red, Color::Black, 0);
+		}
+		LOG_MESSAGE("MSAA: " + std::to_string(msaa_samples) + "x", Color::Bright_White, Color::Black, 0);
+
+		depth_format = vk_attachment::find_depth_format(physical_device);
+
+		// The variants are drawn without a depth only pipeline, and the uniform buffer
+		// vertex shader of the per-draw benchmark has no pre-pass counterpart
+		depth_prepass = config.depth_prepass;
+		if (depth_prepass && (config.benchmark_variants > 0 || config.benchmark_draws > 0)) {
+			LOG_MESSAGE("Depth pre-pass disabled for this benchmark.", Color::Red, Color::Black, 0);
+			depth_prepass = false;
+		}
+		LOG_MESSAGE(std::string("Depth pre-pass: ") + (depth_prepass ? "on" : "off"), Color::Bright_White, Color::Black, 0);
+
+		// The HDR target is tone mapped by a compute pass that writes the swapchain images.
+		// The storage swapchain (UNORM) is only selected when a target is actually tone mapped:
+		// nothing else sRGB encodes the colors. The HDR benchmark renders to every supported format,
+		// and only runs without the benchmarks before it in run().
+		bool hdr_benchmark = config.benchmark_hdr > 0 && config.benchmark_frames == 0 && config.benchmark_variants == 0 &&
+			                 config.benchmark_draws == 0 && config.benchmark_msaa == 0 && config.benchmark_depth_prepass == 0;
+
+		VkFormat requested_hdr_format = vk_tonemap::to_vk_format(config.hdr_format);
+		if (requested_hdr_format != VK_FORMAT_UNDEFINED && !vk_tonemap::check_hdr_format_support(requested_hdr_format, physical_device)) {
+			LOG_MESSAGE(vk_config::to_string(config.hdr_format) + " color targets not supported, HDR disabled.", Color::Red, Color::Black, 0);
+			requested_hdr_format = VK_FORMAT_UNDEFINED;
+		}
+
+		if (requested_hdr_format != VK_FORMAT_UNDEFINED || hdr_benchmark) {
+
+			if (!std::filesystem::exists(vk_tonemap::TONE_MAP_SHADER_FILE)) {
+				LOG_MESSAGE(vk_tonemap::TONE_MAP_SHADER_FILE + " not found, run shaders/compile_shaders.bat first. HDR disabled.", Color::Red, Color::Black, 0);
+			}
+			else if (!synchronization2) {
+				LOG_MESSAGE("The tone mapping pass needs synchronization2, HDR disabled.", Color::Red, Color::Black, 0);
+			}
+			else if (!vk_core::check_storage_swapchain_support(surface, physical_device, device_probe)) {
+				LOG_MESSAGE("Compute shaders can not write the swapchain images, HDR disabled.", Color::Red, Color::Black, 0);
+			}
+			else {
+				storage_swapchain = true;
+			}
+		}
+
+		if (config.benchmark_capture > 0 || !config.capture.empty()) {
+
+			readback_swapchain = synchronization2 && vk_core::check_readback_swapchain_support(surface, physical_device);
+			if (!readback_swapchain) {
+				LOG_MESSAGE("The swapchain images can not be copied from (or no synchronization2), capture disabled.", Color::Red, Color::Black, 0);
+			}
+		}
+
+		hdr_format = storage_swapchain ? requested_hdr_format : VK_FORMAT_UNDEFINED;
+		LOG_MESSAGE("HDR target: " + (hdr_format != VK_FORMAT_UNDEFINED ? vk_config::to_string(config.hdr_format) : std::string("off")),
+			        Color::Bright_White, Color::Black, 0);
+
+		// The pipeline only depends on the swapchain format, not on the swapchain itself:
+		// choose it the same way create_swapchain() does, before the swapchain exists
+		std::vector<VkSurfaceFormatKHR> surface_formats = vk_core::query_swapchain_support(surface, physical_device).formats;
+		swapchain_image_format = storage_swapchain ?
+			vk_core::choose_storage_surface_format(surface_formats, physical_device).value().format :
+			vk_core::choose_swapchain_surface_format(surface_formats).format;
+
+		if (config.particle_count > 0) {
+
+			particles_enabled = synchronization2 && vk_particles::check_particle_support(physical_device);
+			if (!particles_enabled) {
+				LOG_MESSAGE("Particles disabled.", Color::Red, Color::Black, 0);
+			}
+		}
+
+		// Only touches the pipeline objects, this thread only touches the swapchain and per-frame objects
+		std::future<void> pipeline_ready = std::async(std::launch::async, [this] {
+
+			vk_profiler::ScopedTrace trace(startup_trace, "pipeline objects (parallel)");
+			create_pipeline_objects();
+		});
+
+		VkFormat created_format; // same as swapchain_image_format, read by the pipeline thread meanwhile
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_swapchain");
+
+			read_framebuffer_extent();
+
+			VkSwapchainKHR new_swapchain;
+			vk_core::create_swapchain(new_swapchain, swapchain_images,
+				                      created_format, swapchain_extent,
+				                      surface, framebuffer_extent, physical_device, device,
+				                      storage_swapchain, readback_swapchain);
+			swapchain = own(new_swapchain);
+		}
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_image_views");
+
+			std::vector<VkImageView> new_image_views;
+			vk_core::create_image_views(new_image_views,
+				                        swapchain_images, created_format,
+				                        device);
+			swapchain_image_views = vk_handle::to_handles(new_image_views, device, &deletion_queue);
+		}
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "command pool, buffer and sync objects");
+
+			VkCommandPool new_command_pool;
+			vk_pipeline::create_command_pool(new_command_pool, physical_device, device, surface);
+			command_pool = own(new_command_pool);
+
+			vk_pipeline::create_command_buffer(command_buffer, command_pool, device);
+
+			VkSemaphore new_semaphore_image_available, new_semaphore_render_finished;
+			VkFence new_fence_in_flight;
+			vk_pipeline::create_sync_objects(new_semaphore_image_available, new_semaphore_render_finished,
+				                             new_fence_in_flight, device);
+			semaphore_image_available = own(new_semaphore_image_available);
+			semaphore_render_finished = own(new_semaphore_render_finished);
+			fence_in_flight = own(new_fence_in_flight);
+		}
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "wait for pipeline");
+			pipeline_ready.get(); // rethrows the errors of the pipeline thread
+		}
+		prefetched_files.clear();
+
+		// Simulated on the graphics queue, in the command buffer of the frames
+		if (particles_enabled) {
+			vk_profiler::ScopedTrace trace(startup_trace, "create particle system");
+
+			particle_system = std::make_unique<vk_particles::ParticleSystem>(
+				physical_device, device,
+				vk_core::check_queue_families(physical_device, surface).graphics_family.value(), queue_graphics,
+				pipeline_cache, *layout_cache, config.particle_count);
+		}
+
+		sampler_cache = std::make_unique<vk_texture::SamplerCache>(device_probe, device);
+
+		if (!config.textures.empty()) {
+			vk_profiler::ScopedTrace trace(startup_trace, "load_textures");
+			load_textures();
+		}
+
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_framebuffers");
+			create_render_path_framebuffers();
+		}
+
+		if (readback_swapchain && !config.capture.empty()) {
+			create_video_capture();
+		}
+
+		LOG_MESSAGE("Framebuffer attachments:", Color::Yellow, Color::Black, 0);
+		vk_attachment::report_attachments(framebuffer_attachments, physical_device, device);
+
+		if (config.hot_reload && config.benchmark_frames == 0 && config.benchmark_variants == 0 &&
+			config.benchmark_draws == 0 && config.benchmark_msaa == 0 && config.benchmark_depth_prepass == 0 &&
+			config.benchmark_hdr == 0 && config.benchmark_textures == 0 && config.benchmark_capture == 0 &&
+			config.benchmark_render_thread == 0) {
+			start_shader_hot_reload();
+		}
+	}
+
+
+	// Pipeline cache, layout and variant caches, render pass and pipeline
+	void create_pipeline_objects() {
+
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_pipeline_cache");
+
+			VkPipelineCache new_pipeline_cache;
+			vk_pipeline::create_pipeline_cache(new_pipeline_cache, PIPELINE_CACHE_FILE, physical_device, device);
+			pipeline_cache = own(new_pipeline_cache);
+		}
+
+		layout_cache = std::make_unique<vk_reflect::LayoutCache>(device);
+
+		// Variants are built on the main thread, for the current render path
+		variant_cache = std::make_unique<vk_variant::VariantCache>(device,
+			[this](const vk_variant::ShaderVariant& variant, VkPipeline& new_pipeline, VkPipelineLayout& new_pipeline_layout) {
+
+				vk_pipeline::create_pipeline(new_pipeline, new_pipeline_layout,
+					                         render_pass, color_format(), depth_format, msaa_samples,
+					                         scene_depth_mode(), render_path, variant, pipeline_cache,
+					                         *layout_cache, device);
+			},
+			&deletion_queue);
+
+		if (storage_swapchain) {
+			vk_profiler::ScopedTrace trace(startup_trace, "create tone map pass");
+			tone_map = std::make_unique<vk_tonemap::ToneMapPass>(device, pipeline_cache, *layout_cache, &deletion_queue);
+		}
+
+		{
+			vk_profiler::ScopedTrace trace(startup_trace, "create_pipeline");
+			create_render_path_pipeline();
+		}
+	}
+
+
+	// Rebuild the graphics and compute pipelines in the background when their shaders change
+	void start_shader_hot_reload() {
+
+		shader_hot_reload = std::make_unique<vk_hot_reload::ShaderHotReload>(device, "shaders");
+
+		// The builder runs on the hot reload thread: capture copies, not members
+		VkRenderPass current_render_pass = render_pass;
+		VkFormat current_format = color_format();
+		VkFormat current_depth_format = depth_format;
+		VkSampleCountFlagBits current_samples = msaa_samples;
+		vk_pipeline::DepthMode current_depth_mode = scene_depth_mode();
+		vk_config::RenderPath current_render_path = render_path;
+		VkPipelineCache current_pipeline_cache = pipeline_cache; // internally synchronized
+		vk_reflect::LayoutCache* current_layout_cache = layout_cache.get(); // thread safe
+		vk_variant::ShaderVariant current_variant = shader_variant();
+		VkDevice current_device = device;
+
+		shader_hot_reload->add_pipeline(pipeline, pipeline_layout, { "vert.spv", "frag.spv" },
+			[=](VkPipeline& new_pipeline, VkPipelineLayout& new_pipeline_layout) {
+
+				vk_pipeline::create_pipeline(new_pipeline, new_pipeline_layout,
+					                         current_render_pass, current_format, current_depth_format, current_samples,
+					                         current_depth_mode, current_render_path, current_variant,
+					                         current_pipeline_cache, *current_layout_cache,
+					                         current_device);
+			});
+
+		if (depth_prepass) {
+
+			// Rebuilt with the scene pipeline, so both compute the same depth
+			// (its layout is reflected from both shaders too)
+			shader_hot_reload->add_pipeline(depth_prepass_pipeline, depth_prepass_pipeline_layout, { "vert.spv", "frag.spv" },
+				[=](VkPipeline& new_pipeline, VkPipelineLayout& new_pipeline_layout) {
+
+					vk_pipeline::create_pipeline(new_pipeline, new_pipeline_layout,
+						                         current_render_pass, current_format, current_depth_format, current_samples,
+						                         vk_pipeline::DepthMode::DepthOnly, current_render_path, current_variant,
+						                         current_pipeline_cache, *current_layout_cache,
+						                         current_device);
+				});
+		}
+
+		// The compute pipelines keep their descriptor sets: only rebuilt with the same interface
+		if (tone_map) {
+			tone_map->watch(*shader_hot_reload, pipeline_cache, *layout_cache);
+		}
+		if (particle_system) {
+			particle_system->watch(*shader_hot_reload);
+		}
+
+		shader_hot_reload->start();
+	}
+
+
+	// Shaders of the main pipeline, specialized for the configured shading model
+	vk_variant::ShaderVariant shader_variant() const {
+
+		vk_variant::ShaderVariant variant;
+		variant.frag_specialization.set(vk_variant::SHADING_MODEL, config.shading_model);
+
+		return variant;
+	}
+
+
+	// Format the scene is rendered in: of the HDR target, or of the swapchain without one
+	VkFormat color_format() const {
+
+		return hdr_format != VK_FORMAT_UNDEFINED ? hdr_format : swapchain_image_format;
+	}
+
+
+	// Depth test of the scene pipeline: after the pre-pass the depth is already final
+	vk_pipeline::DepthMode scene_depth_mode() const {
+
+		return depth_prepass ? vk_pipeline::DepthMode::EqualTest : vk_pipeline::DepthMode::TestAndWrite;
+	}
+
+
+	// Create the render pass, pipeline and framebuffers for the current render path.
+	// Dynamic rendering only needs the pipeline.
+	void create_render_path_objects() {
+
+		create_render_path_pipeline();
+		create_render_path_framebuffers();
+	}
+
+
+	// The render pass and the pipeline only depend on the swapchain format
+	void create_render_path_pipeline() {
+
+		if (render_path == vk_config::RenderPath::RenderPass) {
+			VkRenderPass new_render_pass;
+			vk_pipeline::create_renderpass(new_render_pass, device, color_format(), depth_format,
+				                           msaa_samples, depth_prepass, hdr_format != VK_FORMAT_UNDEFINED);
+			render_pass = own(new_render_pass);
+		}
+
+		VkPipeline new_pipeline;
+		vk_pipeline::create_pipeline(new_pipeline, pipeline_layout,
+			                         render_pass, color_format(), depth_format, msaa_samples,
+			                         scene_depth_mode(), render_path, shader_variant(),
+			                         pipeline_cache, *layout_cache, device);
+		pipeline = own(new_pipeline);
+
+		if (depth_prepass) {
+			VkPipeline new_depth_prepass_pipeline;
+			vk_pipeline::create_pipeline(new_depth_prepass_pipeline, depth_prepass_pipeline_layout,
+				                         render_pass, color_format(), depth_format, msaa_samples,
+				                         vk_pipeline::DepthMode::DepthOnly, render_path, shader_variant(),
+				                         pipeline_cache, *layout_cache, device);
+			depth_prepass_pipeline = own(new_depth_prepass_pipeline);
+		}
+
+		// Drawn in the color pass, after the pre-pass if there is one
+		if (particles_enabled) {
+
+			vk_variant::ShaderVariant particle_variant;
+			particle_variant.vert_file = vk_particles::VERT_SHADER_FILE;
+			particle_variant.frag_file = vk_particles::FRAG_SHADER_FILE;
+
+			VkPipeline new_particle_pipeline;
+			vk_pipeline::create_pipeline(new_particle_pipeline, particle_pipeline_layout,
+				                         render_pass, color_format(), depth_format, msaa_samples,
+				                         depth_prepass ? vk_pipeline::DepthMode::TranslucentAfterPrepass : vk_pipeline::DepthMode::Translucent,
+				                         render_path, particle_variant,
+				                         pipeline_cache, *layout_cache, device);
+			particle_pipeline = own(new_particle_pipeline);
+		}
+	}
+
+
+	// Attachments of the render pass besides the swapchain image, sized like it,
+	// in the order of vk_pipeline::create_renderpass()
+	std::vector<vk_attachment::AttachmentDesc> framebuffer_attachment_descs() const {
+
+		std::vector<vk_attachment::AttachmentDesc> descs;
+
+		if (msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+
+			// Resolved into the color target at the end of the subpass
+			vk_attachment::AttachmentDesc multisampled_color;
+			multisampled_color.name = "msaa color";
+			multisampled_color.format = color_format();
+			multisampled_color.extent = swapchain_extent;
+			multisampled_color.samples = msaa_samples;
+			multisampled_color.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			multisampled_color.transient = true;
+
+			descs.push_back(multisampled_color);
+		}
+
+		// Replaces the swapchain image in the framebuffers. It is read by the tone mapping pass
+		// after the render pass, so it is stored: not a transient attachment.
+		if (hdr_format != VK_FORMAT_UNDEFINED) {
+
+			vk_attachment::AttachmentDesc hdr_color;
+			hdr_color.name = "hdr color";
+			hdr_color.format = hdr_format;
+			hdr_color.extent = swapchain_extent;
+			hdr_color.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			hdr_color.transient = false;
+
+			descs.push_back(hdr_color);
+		}
+
+		// As many samples as the color target
+		vk_attachment::AttachmentDesc depth;
+		depth.name = "depth";
+		depth.format = depth_format;
+		depth.extent = swapchain_extent;
+		depth.samples = msaa_samples;
+		depth.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		depth.aspect = vk_attachment::depth_aspect(depth_format);
+		depth.transient = true;
+
+		descs.push_back(depth);
+
+		return descs;
+	}
+
+
+	// The swapchain image is the resolve attachment with MSAA, the color attachment otherwise.
+	// The HDR target takes its place when there is one.
+	uint32_t swapchain_attachment_index() const {
+
+		if (hdr_format != VK_FORMAT_UNDEFINED) {
+			return vk_pipeline::NO_SWAPCHAIN_ATTACHMENT;
+		}
+
+		return msaa_samples != VK_SAMPLE_COUNT_1_BIT ? 1 : 0;
+	}
+
+
+	// The HDR target of the frame, nothing if the scene is rendered straight to the swapchain
+	vk_pipeline::HdrTarget hdr_target() const {
+
+		vk_pipeline::HdrTarget target;
+		if (hdr_format == VK_FORMAT_UNDEFINED) {
+			return target;
+		}
+
+		target.tone_map = tone_map.get();
+		target.format = hdr_format;
+
+		// After the multisampled color, see framebuffer_attachment_descs()
+		if (render_path == vk_config::RenderPath::RenderPass) {
+			const vk_attachment::Attachment& hdr_color = framebuffer_attachments[msaa_samples != VK_SAMPLE_COUNT_1_BIT ? 1 : 0];
+			target.image = hdr_color.image;
+			target.image_view = hdr_color.image_view;
+		}
+
+		return target;
+	}
+
+
+	// The framebuffers and their attachments depend on the swapchain images
+	void create_render_path_framebuffers() {
+
+		if (render_path == vk_config::RenderPath::RenderPass) {
+
+			framebuffer_attachments.clear();
+			for (const auto& desc : framebuffer_attachment_descs()) {
+				framebuffer_attachments.push_back(
+					vk_attachment::create_attachment(desc, physical_device, device, &deletion_queue));
+			}
+
+			std::vector<VkFramebuffer> new_framebuffers;
+			vk_pipeline::create_framebuffers(new_framebuffers,
+				                             vk_handle::to_raw(swapchain_image_views),
+				                             framebuffer_attachments, swapchain_attachment_index(),
+				                             swapchain_extent,
+				                             device, render_pass);
+			swapchain_framebuffers = vk_handle::to_handles(new_framebuffers, device, &deletion_queue);
+		}
+	}
+
+
+	// Released objects are destroyed once the frame in flight has completed
+	void destroy_render_path_objects() {
+
+		swapchain_framebuffers.clear();
+		framebuffer_attachments.clear();
+
+		pipeline.reset();
+		depth_prepass_pipeline.reset();
+		particle_pipeline.reset();
+		variant_cache->clear();
+
+		render_pass.reset();
+	}
+
+
+	// Write the frames to config.capture: converted and written by the threads of the sink and of the
+	// readback. The frames of the capture benchmark go through its own readback service.
+	void create_video_capture() {
+
+		if (!vk_video::check_yuv_source_format(swapchain_image_format)) {
+			LOG_MESSAGE("The swapchain format can not be converted to YUV, capture disabled.", Color::Red, Color::Black, 0);
+			return;
+		}
+
+		video_sink = std::make_unique<vk_video::VideoSink>(config.capture, swapchain_extent, config.capture_frame_rate);
+
+		if (config.benchmark_capture == 0) {
+
+			vk_video::VideoSink* sink = video_sink.get();
+			frame_readback = std::make_unique<vk_readback::ReadbackService>(
+				physical_device, device, &deletion_queue,
+				[sink](const vk_readback::Frame& frame) { sink->write_frame(frame); });
+		}
+	}
+
+
+	// Main thread only: GLFW may not be called from the render thread
+	void read_framebuffer_extent() {
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+
+		framebuffer_extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+	}
+
+
+	// Rebuild the swapchain and everything that depends on its images, for framebuffer_extent.
+	// The dynamic rendering path has no framebuffers to rebuild.
+	// The frame in flight may still use the old objects: they are released
+	// to the deletion queue instead of waiting for the device to be idle.
+	void recreate_swapchain() {
+
+		// The fences of the deletion queue only cover the command buffers: a presentation of an old
+		// image may still be pending after the frame fence has signaled. Wait for the present queue
+		// (not the whole device) before the old swapchain and its image views are retired.
+		vkQueueWaitIdle(queue_present);
+
+		swapchain_framebuffers.clear();
+		framebuffer_attachments.clear();
+		swapchain_image_views.clear();
+
+		// The old swapchain is retired by the new one, and destroyed later
+		VkSwapchainKHR new_swapchain;
+		vk_core::create_swapchain(new_swapchain, swapchain_images,
+			                      swapchain_image_format, swapchain_extent,
+			                      surface, framebuffer_extent, physical_device, device,
+			                      storage_swapchain, readback_swapchain, swapchain);
+		swapchain.replace(new_swapchain);
+
+		std::vector<VkImageView> new_image_views;
+		vk_core::create_image_views(new_image_views,
+			                        swapchain_images, swapchain_image_format,
+			                        device);
+		swapchain_image_views = vk_handle::to_handles(new_image_views, device, &deletion_queue);
+
+		create_render_path_framebuffers();
+	}
+
+
+	// Render the same frames with every supported render path and compare
+	// the per-frame cost and the cost of a swapchain recreation.
+	void run_benchmark() {
+
+		LOG_MESSAGE("Running benchmark...", Color::Yellow, Color::Black, 0);
+
+		std::vector<vk_config::RenderPath> render_paths = { vk_config::RenderPath::RenderPass };
+		if (device_probe.dynamic_rendering) {
+			render_paths.push_back(vk_config::RenderPath::DynamicRendering);
+		}
+
+		std::vector<vk_profiler::TimingStats> frame_stats(render_paths.size());
+		std::vector<vk_profiler::TimingStats> recreation_stats(render_paths.size());
+
+		for (size_t p = 0; p < render_paths.size(); p++) {
+
+			destroy_render_path_objects();
+
+			render_path = render_paths[p];
+			create_render_path_objects();
+
+			for (uint32_t i = 0; i < config.benchmark_frames && !glfwWindowShouldClose(window); i++) {
+
+				glfwPollEvents();
+
+				vk_profiler::ScopedTimer timer(frame_stats[p]);
+				draw_frame();
+			}
+
+			read_framebuffer_extent();
+
+			for (uint32_t i = 0; i < config.benchmark_recreations; i++) {
+
+				vk_profiler::ScopedTimer timer(recreation_stats[p]);
+				recreate_swapchain();
+			}
+		}
+
+		LOG_MESSAGE("Benchmark results:", Color::Yellow, Color::Black, 0);
+		for (size_t p = 0; p < render_paths.size(); p++) {
+			frame_stats[p].report(vk_config::to_string(render_paths[p]) + " | frame");
+			recreation_stats[p].report(vk_config::to_string(render_paths[p]) + " | swapchain recreation");
+		}
+
+		// Read back once the last frame has completed
+		if (particle_system) {
+			vkWaitForFences(device, 1, fence_in_flight.ptr(), VK_TRUE, UINT64_MAX);
+			LOG_MESSAGE("Particles alive in the last frame: " + std::to_string(particle_system->alive_count()) + " of " +
+				        std::to_string(particle_system->capacity()), Color::Bright_Green, Color::Black, 4);
+		}
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+	}
+
+
+	// Compare the GPU cost of the fragment shader specialized for a shading model
+	// with the uber shader variant, that reads the shading model at runtime.
+	// benchmark_overdraw triangles are stacked back to front so that
+	// the fragment shader dominates the GPU time.
+	void run_variant_benchmark() {
+
+		LOG_MESSAGE("Running shader variant benchmark...", Color::Yellow, Color::Black, 0);
+
+		const uint32_t NOISE_OCTAVES = 8;
+
+		// Shaders compiled before the constants existed can not be specialized
+		MappedFile frag_shader = map_file("shaders/frag.spv");
+		vk_reflect::ShaderReflection frag_reflection = vk_reflect::reflect_shader(frag_shader.words(), frag_shader.size() / sizeof(uint32_t));
+
+		if (frag_reflection.specialization_constants.empty() || frag_reflection.push_constant_ranges.empty()) {
+			LOG_MESSAGE("shaders/frag.spv has no specialization constants, run shaders/compile_shaders.bat first.", Color::Red, Color::Black, 0);
+			return;
+		}
+
+		vk_handle::Handle<VkQueryPool> timestamp_query_pool = create_timestamp_query_pool();
+
+		struct BenchmarkedVariant {
+			std::string name;
+			vk_variant::ShaderVariant variant;
+			vk_draw::PerDraw per_draw; // material and octaves read by the uber shader
+		};
+
+		std::vector<BenchmarkedVariant> benchmarked_variants;
+		for (uint32_t shading_model : { vk_variant::SHADING_GRADIENT, vk_variant::SHADING_NOISE }) {
+
+			std::string model_name = shading_model == vk_variant::SHADING_NOISE ? "noise" : "gradient";
+
+			vk_draw::PerDraw per_draw;
+			per_draw.material_id = shading_model;
+			per_draw.noise_octaves = NOISE_OCTAVES;
+
+			BenchmarkedVariant specialized{ model_name + " | specialized", {}, per_draw };
+			specialized.variant.frag_specialization
+				.set(vk_variant::SHADING_MODEL, shading_model)
+				.set(vk_variant::NOISE_OCTAVES, NOISE_OCTAVES);
+
+			BenchmarkedVariant uber{ model_name + " | uber shader", {}, per_draw };
+			uber.variant.frag_specialization.set(vk_variant::UBER_SHADER, true);
+
+			benchmarked_variants.push_back(specialized);
+			benchmarked_variants.push_back(uber);
+		}
+
+		std::vector<vk_profiler::TimingStats> gpu_stats(benchmarked_variants.size());
+		std::vector<vk_profiler::TimingStats> frame_stats(benchmarked_variants.size());
+
+		for (size_t v = 0; v < benchmarked_variants.size(); v++) {
+
+			vk_pipeline::DrawSettings draw_settings;
+			VkPipeline variant_pipeline = variant_cache->get_pipeline(benchmarked_variants[v].variant, draw_settings.pipeline_layout);
+
+			draw_settings.push_constant_stages = layout_cache->push_constant_stages(draw_settings.pipeline_layout);
+			draw_settings.draws = vk_draw::overdraw_layers(config.benchmark_overdraw, benchmarked_variants[v].per_draw);
+			draw_settings.timestamp_query_pool = timestamp_query_pool;
+
+			// The first frame pays for the first use of the pipeline
+			draw_frame(variant_pipeline, draw_settings);
+
+			for (uint32_t i = 0; i < config.benchmark_variants && !glfwWindowShouldClose(window); i++) {
+
+				glfwPollEvents();
+				{
+					vk_profiler::ScopedTimer timer(frame_stats[v]);
+					draw_frame(variant_pipeline, draw_settings);
+				}
+
+				if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+					gpu_stats[v].add_sample(read_gpu_time(timestamp_query_pool));
+				}
+			}
+		}
+
+		LOG_MESSAGE("Benchmark results (" + std::to_string(config.benchmark_overdraw) + " draws per frame):", Color::Yellow, Color::Black, 0);
+		for (size_t v = 0; v < benchmarked_variants.size(); v++) {
+			if (gpu_stats[v].count() > 0) {
+				gpu_stats[v].report(benchmarked_variants[v].name + " | GPU");
+			}
+			frame_stats[v].report(benchmarked_variants[v].name + " | frame");
+		}
+		LOG_MESSAGE("Shader variants: " + std::to_string(variant_cache->size()) +
+			        ", cache hits: " + std::to_string(variant_cache->hit_count()) +
+			        ", misses: " + std::to_string(variant_cache->miss_count()), Color::Bright_Green, Color::Black, 4);
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+	}
+
+
+	// Compare the frame cost of rendering the same frames at 1x, 2x, 4x and 8x MSAA.
+	// benchmark_overdraw triangles are stacked back to front so that the samples are written many times.
+	// The GPU time covers the whole rendering, the resolve at the end of the pass included.
+	void run_msaa_benchmark() {
+
+		LOG_MESSAGE("Running MSAA benchmark...", Color::Yellow, Color::Black, 0);
+
+		vk_handle::Handle<VkQueryPool> timestamp_query_pool = create_timestamp_query_pool();
+
+		std::vector<VkSampleCountFlagBits> sample_counts;
+		for (VkSampleCountFlagBits samples : { VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT }) {
+
+			if (vk_attachment::clamp_sample_count(samples, physical_device) == samples) {
+				sample_counts.push_back(samples);
+			}
+			else {
+				LOG_MESSAGE(std::to_string(samples) + "x MSAA not supported, skipped.", Color::Red, Color::Black, 4);
+			}
+		}
+
+		std::vector<vk_profiler::TimingStats> gpu_stats(sample_counts.size());
+		std::vector<vk_profiler::TimingStats> frame_stats(sample_counts.size());
+
+		for (size_t s = 0; s < sample_counts.size(); s++) {
+
+			// The render pass, the pipeline and the attachments depend on the sample count
+			destroy_render_path_objects();
+
+			msaa_samples = sample_counts[s];
+			create_render_path_objects();
+
+			vk_draw::PerDraw per_draw;
+			per_draw.material_id = config.shading_model;
+
+			vk_pipeline::DrawSettings draw_settings;
+			draw_settings.pipeline_layout = pipeline_layout;
+			draw_settings.push_constant_stages = layout_cache->push_constant_stages(pipeline_layout);
+			draw_settings.draws = vk_draw::overdraw_layers(config.benchmark_overdraw, per_draw);
+			draw_settings.timestamp_query_pool = timestamp_query_pool;
+
+			// The first frame pays for the first use of the pipeline and of the multisampled image
+			draw_frame(pipeline, draw_settings);
+
+			for (uint32_t i = 0; i < config.benchmark_msaa && !glfwWindowShouldClose(window); i++) {
+
+				glfwPollEvents();
+				{
+					vk_profiler::ScopedTimer timer(frame_stats[s]);
+					draw_frame(pipeline, draw_settings);
+				}
+
+				if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+					gpu_stats[s].add_sample(read_gpu_time(timestamp_query_pool));
+				}
+			}
+		}
+
+		LOG_MESSAGE("Benchmark results (" + std::to_string(config.benchmark_overdraw) + " draws per frame, " +
+			        vk_config::to_string(render_path) + "):", Color::Yellow, Color::Black, 0);
+		for (size_t s = 0; s < sample_counts.size(); s++) {
+
+			std::string name = std::to_string(sample_counts[s]) + "x MSAA";
+			if (gpu_stats[s].count() > 0) {
+				gpu_stats[s].report(name + " | GPU");
+			}
+			frame_stats[s].report(name + " | frame");
+		}
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+	}
+
+
+	// Two timestamp queries, written around the rendering when given in the DrawSettings.
+	// A null handle if the GPU does not support timestamps.
+	vk_handle::Handle<VkQueryPool> create_timestamp_query_pool() {
+
+		uint32_t queue_families_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, queue_families.data());
+
+		timestamp_valid_bits = queue_families[vk_core::check_queue_families(physical_device, surface).graphics_family.value()].timestampValidBits;
+
+		if (!device_probe.timestamps || timestamp_valid_bits == 0) {
+			LOG_MESSAGE("Timestamps not supported, only the frame time is measured.", Color::Red, Color::Black, 4);
+			return {};
+		}
+
+		VkQueryPoolCreateInfo query_pool_info{};
+		query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		query_pool_info.queryCount = 2;
+
+		VkQueryPool new_query_pool;
+		if (vkCreateQueryPool(device, &query_pool_info, nullptr, &new_query_pool) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to create Vulkan Query pool! \033[0m \n");
+		}
+
+		return own(new_query_pool);
+	}
+
+
+	// GPU time of the rendering of the frame just submitted in milliseconds, waits for it
+	double read_gpu_time(VkQueryPool timestamp_query_pool) {
+
+		uint64_t timestamps[2] = {};
+		vkGetQueryPoolResults(device, timestamp_query_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+			                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+		return vk_query::timestamp_interval_ms(timestamps[0], timestamps[1], timestamp_valid_bits,
+			                                   device_probe.timestamp_period);
+	}
+
+
+	// One pipeline statistics query counting the fragment shader invocations of the rendering,
+	// when given in the DrawSettings. A null handle if the GPU does not support it.
+	vk_handle::Handle<VkQueryPool> create_statistics_query_pool() {
+
+		if (!device_probe.pipeline_statistics) {
+			LOG_MESSAGE("Pipeline statistics queries not supported, fragment shader invocations are not counted.", Color::Red, Color::Black, 4);
+			return {};
+		}
+
+		VkQueryPoolCreateInfo query_pool_info{};
+		query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		query_pool_info.queryCount = 1;
+		query_pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		VkQueryPool new_query_pool;
+		if (vkCreateQueryPool(device, &query_pool_info, nullptr, &new_query_pool) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to create Vulkan Query pool! \033[0m \n");
+		}
+
+		return own(new_query_pool);
+	}
+
+
+	// Fragment shader invocations of the frame just submitted, waits for it
+	uint64_t read_fragment_invocations(VkQueryPool statistics_query_pool) {
+
+		uint64_t invocations = 0;
+		vkGetQueryPoolResults(device, statistics_query_pool, 0, 1, sizeof(invocations), &invocations, sizeof(uint64_t),
+			                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+		return invocations;
+	}
+
+
+	// Render the same frames of benchmark_overdraw full screen triangles, stacked from back to front
+	// (the worst case for a LESS depth test: every layer passes), without and with the depth pre-pass.
+	// Reports the GPU time of the rendering, the frame time and the fragment shader invocations.
+	void run_depth_prepass_benchmark() {
+
+		LOG_MESSAGE("Running depth pre-pass benchmark...", Color::Yellow, Color::Black, 0);
+
+		vk_handle::Handle<VkQueryPool> timestamp_query_pool = create_timestamp_query_pool();
+		vk_handle::Handle<VkQueryPool> statistics_query_pool = create_statistics_query_pool();
+
+		vk_draw::PerDraw per_draw;
+		per_draw.material_id = config.shading_model;
+		std::vector<vk_draw::PerDraw> layers = vk_draw::overdraw_layers(config.benchmark_overdraw, per_draw);
+
+		const bool prepass_modes[] = { false, true };
+
+		vk_profiler::TimingStats gpu_stats[2];
+		vk_profiler::TimingStats frame_stats[2];
+		uint64_t fragment_invocations[2] = {};
+		uint32_t counted_frames[2] = {};
+
+		for (size_t m = 0; m < 2; m++) {
+
+			// The render pass, the pipelines and the attachments depend on the pre-pass
+			destroy_render_path_objects();
+
+			depth_prepass = prepass_modes[m];
+			create_render_path_objects();
+
+			vk_pipeline::DrawSettings draw_settings;
+			draw_settings.pipeline_layout = pipeline_layout;
+			draw_settings.push_constant_stages = layout_cache->push_constant_stages(pipeline_layout);
+			draw_settings.draws = layers;
+			draw_settings.timestamp_query_pool = timestamp_query_pool;
+			draw_settings.statistics_query_pool = statistics_query_pool;
+
+			// The first frame pays for the first use of the pipelines and of the depth buffer
+			draw_frame(pipeline, draw_settings);
+
+			for (uint32_t i = 0; i < config.benchmark_depth_prepass && !glfwWindowShouldClose(window); i++) {
+
+				glfwPollEvents();
+				{
+					vk_profiler::ScopedTimer timer(frame_stats[m]);
+					draw_frame(pipeline, draw_settings);
+				}
+
+				if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+					gpu_stats[m].add_sample(read_gpu_time(timestamp_query_pool));
+				}
+				if (statistics_query_pool.get() != VK_NULL_HANDLE) {
+					fragment_invocations[m] += read_fragment_invocations(statistics_query_pool);
+					counted_frames[m]++;
+				}
+			}
+		}
+
+		const double pixel_count = static_cast<double>(swapchain_extent.width) * swapchain_extent.height;
+
+		LOG_MESSAGE("Benchmark results (" + std::to_string(config.benchmark_overdraw) + " layers per frame, " +
+			        vk_config::to_string(render_path) + ", " + std::to_string(msaa_samples) + "x MSAA):", Color::Yellow, Color::Black, 0);
+		for (size_t m = 0; m < 2; m++) {
+
+			std::string name = prepass_modes[m] ? "depth pre-pass" : "no pre-pass";
+			if (gpu_stats[m].count() > 0) {
+				gpu_stats[m].report(name + " | GPU");
+			}
+			frame_stats[m].report(name + " | frame");
+
+			if (counted_frames[m] > 0) {
+
+				double invocations_per_frame = static_cast<double>(fragment_invocations[m]) / counted_frames[m];
+
+				std::ostringstream invocations_log;
+				invocations_log << std::fixed << std::setprecision(2)
+					<< name << " | fragment shader invocations per frame: " << static_cast<uint64_t>(invocations_per_frame)
+					<< ", per pixel: " << invocations_per_frame / pixel_count;
+
+				LOG_MESSAGE(invocations_log.str(), Color::Bright_Green, Color::Black, 4);
+			}
+		}
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+	}
+
+
+	// Render the same frames of benchmark_overdraw stacked triangles straight to the swapchain image,
+	// then to each HDR target format followed by the tone mapping pass.
+	// The swapchain has the storage (UNORM) format in every case: without HDR the colors are not sRGB encoded.
+	// Reports the GPU time of the rendering (tone mapping included), the frame time
+	// and an estimate of the color traffic of each format.
+	void run_hdr_benchmark() {
+
+		LOG_MESSAGE("Running HDR benchmark...", Color::Yellow, Color::Black, 0);
+
+		if (!storage_swapchain) {
+			LOG_MESSAGE("HDR disabled, nothing to compare.", Color::Red, Color::Black, 0);
+			return;
+		}
+
+		vk_handle::Handle<VkQueryPool> timestamp_query_pool = create_timestamp_query_pool();
+
+		std::vector<vk_config::HdrFormat> hdr_formats = { vk_config::HdrFormat::Off };
+		for (vk_config::HdrFormat format : { vk_config::HdrFormat::B10G11R11, vk_config::HdrFormat::R16G16B16A16 }) {
+
+			if (vk_tonemap::check_hdr_format_support(vk_tonemap::to_vk_format(format), physical_device)) {
+				hdr_formats.push_back(format);
+			}
+			else {
+				LOG_MESSAGE(vk_config::to_string(format) + " color targets not supported, skipped.", Color::Red, Color::Black, 4);
+			}
+		}
+
+		vk_draw::PerDraw per_draw;
+		per_draw.material_id = config.shading_model;
+		std::vector<vk_draw::PerDraw> layers = vk_draw::overdraw_layers(config.benchmark_overdraw, per_draw);
+
+		std::vector<vk_profiler::TimingStats> gpu_stats(hdr_formats.size());
+		std::vector<vk_profiler::TimingStats> frame_stats(hdr_formats.size());
+
+		for (size_t f = 0; f < hdr_formats.size(); f++) {
+
+			// The render pass, the pipelines and the attachments depend on the color format
+			destroy_render_path_objects();
+
+			hdr_format = vk_tonemap::to_vk_format(hdr_formats[f]);
+			create_render_path_objects();
+
+			vk_pipeline::DrawSettings draw_settings;
+			draw_settings.pipeline_layout = pipeline_layout;
+			draw_settings.push_constant_stages = layout_cache->push_constant_stages(pipeline_layout);
+			draw_settings.draws = layers;
+			draw_settings.timestamp_query_pool = timestamp_query_pool;
+
+			// The first frame pays for the first use of the pipelines and of the HDR target
+			draw_frame(pipeline, draw_settings);
+
+			for (uint32_t i = 0; i < config.benchmark_hdr && !glfwWindowShouldClose(window); i++) {
+
+				glfwPollEvents();
+				{
+					vk_profiler::ScopedTimer timer(frame_stats[f]);
+					draw_frame(pipeline, draw_settings);
+				}
+
+				if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+					gpu_stats[f].add_sample(read_gpu_time(timestamp_query_pool));
+				}
+			}
+		}
+
+		const double pixel_count = static_cast<double>(swapchain_extent.width) * swapchain_extent.height;
+		const uint32_t swapchain_texel_size = vk_tonemap::texel_size(swapchain_image_format);
+
+		LOG_MESSAGE("Benchmark results (" + std::to_string(config.benchmark_overdraw) + " layers per frame, " +
+			        vk_config::to_string(render_path) + "):", Color::Yellow, Color::Black, 0);
+		for (size_t f = 0; f < hdr_formats.size(); f++) {
+
+			std::string name = "HDR " + vk_config::to_string(hdr_formats[f]);
+			if (gpu_stats[f].count() > 0) {
+				gpu_stats[f].report(name + " | GPU");
+			}
+			frame_stats[f].report(name + " | frame");
+
+			// Lower bound of the color traffic per frame, once the tiles or the caches absorb the overdraw:
+			// the target is stored, then read by the tone mapping pass which writes the swapchain image
+			uint64_t bytes_per_pixel = swapchain_texel_size;
+			if (hdr_formats[f] != vk_config::HdrFormat::Off) {
+				bytes_per_pixel += 2 * vk_tonemap::texel_size(vk_tonemap::to_vk_format(hdr_formats[f]));
+			}
+
+			std::ostringstream traffic_log;
+			traffic_log << std::fixed << std::setprecision(2)
+				<< name << " | color traffic per frame: " << bytes_per_pixel * pixel_count / 1024.0 / 1024.0
+				<< " MiB (" << bytes_per_pixel << " bytes per pixel)";
+
+			LOG_MESSAGE(traffic_log.str(), Color::Bright_Green, Color::Black, 4);
+		}
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+	}
+
+
+	// Load the KTX2 file config.textures, or every .ktx2 file of that directory, in one upload batch.
+	// Logs the load time, the memory and the compression of each texture, and the GPU time of the batch.
+	void load_textures() {
+
+		std::vector<std::string> files;
+
+		if (std::filesystem::is_directory(config.textures)) {
+			for (const auto& entry : std::filesystem::directory_iterator(config.textures)) {
+				if (entry.is_regular_file() && entry.path().extension() == ".ktx2") {
+					files.push_back(entry.path().string());
+				}
+			}
+			std::sort(files.begin(), files.end());
+		}
+		else {
+			files.push_back(config.textures);
+		}
+
+		LOG_MESSAGE("Loading " + std::to_string(files.size()) + " texture(s) from " + config.textures + "...", Color::Yellow, Color::Black, 0);
+
+		vk_texture::TextureUploader uploader(
+			physical_device, device_probe, device,
+			vk_core::check_queue_families(physical_device, surface).graphics_family.value(), queue_graphics,
+			&deletion_queue);
+
+		VkDeviceSize memory_bytes = 0;
+		VkDeviceSize rgba8_bytes = 0;
+
+		for (const std::string& file : files) {
+
+			vk_ktx::LoadReport report;
+			textures.push_back(vk_ktx::load_ktx2(file, uploader, physical_device, device_probe, &report));
+			report.report();
+
+			memory_bytes += report.memory_bytes;
+			rgba8_bytes += report.rgba8_bytes;
+		}
+
+		double gpu_time = uploader.submit();
+
+		std::ostringstream total_log;
+		total_log << std::fixed << std::setprecision(2)
+			<< "Textures | " << memory_bytes / 1024.0 / 1024.0 << " MiB, "
+			<< rgba8_bytes / 1024.0 / 1024.0 << " MiB in RGBA8, upload " << gpu_time << " ms (GPU), "
+			<< uploader.barrier_stats().image_barrier_count << " barrier(s) in "
+			<< uploader.barrier_stats().flush_count << " batch(es)";
+
+		LOG_MESSAGE(total_log.str(), Color::Bright_Green, Color::Black, 4);
+	}
+
+
+	// Upload benchmark_textures RGBA8 textures of each size from 256x256 to 4096x4096 through the staging path,
+	// without then with their mip chain generated on the GPU, one submission per texture.
+	// Reports the megapixels per second of level 0 for the CPU (staging copy, recording, submit and wait)
+	// and the GPU (timestamps), then requests the samplers of a few materials from the sampler cache.
+	void run_texture_benchmark() {
+
+		LOG_MESSAGE("Running texture benchmark...", Color::Yellow, Color::Black, 0);
+
+		const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+		if (!vk_texture::check_mip_generation_support(format, physical_device)) {
+			LOG_MESSAGE("No linear blits of RGBA8 sRGB images, the textures get a single level.", Color::Red, Color::Black, 4);
+		}
+
+		// Nothing else uses the textures: destroyed as soon as they are released, not at the end of the run
+		vk_texture::TextureUploader uploader(
+			physical_device, device_probe, device,
+			vk_core::check_queue_families(physical_device, surface).graphics_family.value(), queue_graphics,
+			nullptr);
+
+		struct TextureRun {
+			std::string name;
+			double megapixels = 0.0; // of level 0
+			vk_profiler::TimingStats cpu_stats;
+			vk_profiler::TimingStats gpu_stats;
+			VkDeviceSize memory = 0;
+		};
+
+		std::vector<TextureRun> runs;
+
+		for (uint32_t size = 256; size <= 4096 && !glfwWindowShouldClose(window); size *= 2) {
+
+			VkExtent2D extent = { size, size };
+
+			// A color gradient with a checkerboard, so that the mips are not uniform
+			std::vector<uint32_t> pixels(static_cast<size_t>(size) * size);
+			for (uint32_t y = 0; y < size; y++) {
+				for (uint32_t x = 0; x < size; x++) {
+					uint32_t checker = ((x / 8 + y / 8) % 2) * 64;
+					uint32_t r = (x * 255 / size) ^ checker;
+					uint32_t g = (y * 255 / size) ^ checker;
+					pixels[static_cast<size_t>(y) * size + x] = r | (g << 8) | (128u << 16) | (255u << 24);
+				}
+			}
+			VkDeviceSize pixels_size = pixels.size() * sizeof(uint32_t);
+
+			for (bool mipmaps : { false, true }) {
+
+				TextureRun run;
+				run.name = std::to_string(size) + "x" + std::to_string(size) + (mipmaps ? " + mips" : "");
+				run.megapixels = static_cast<double>(size) * size / 1e6;
+
+				// The first upload pays for the first allocations of the size
+				vk_texture::Texture warm_up = uploader.create_texture(run.name, pixels.data(), pixels_size, extent, format, mipmaps);
+				uploader.submit();
+
+				for (uint32_t i = 0; i < config.benchmark_textures; i++) {
+
+					glfwPollEvents();
+
+					vk_texture::Texture texture;
+					double gpu_time = 0.0;
+					{
+						vk_profiler::ScopedTimer timer(run.cpu_stats);
+						texture = uploader.create_texture(run.name, pixels.data(), pixels_size, extent, format, mipmaps);
+						gpu_time = uploader.submit();
+					}
+
+					if (gpu_time > 0.0) {
+						run.gpu_stats.add_sample(gpu_time);
+					}
+					run.memory = texture.size;
+				}
+
+				runs.push_back(std::move(run));
+			}
+		}
+
+		LOG_MESSAGE("Benchmark results (" + std::to_string(config.benchmark_textures) + " textures per size):", Color::Yellow, Color::Black, 0);
+		for (const TextureRun& run : runs) {
+
+			run.cpu_stats.report(run.name + " | CPU");
+			if (run.gpu_stats.count() > 0) {
+				run.gpu_stats.report(run.name + " | GPU");
+			}
+
+			std::ostringstream throughput_log;
+			throughput_log << std::fixed << std::setprecision(2)
+				<< run.name << " | " << run.megapixels / run.cpu_stats.average() * 1e3 << " MP/s (CPU)";
+			if (run.gpu_stats.count() > 0) {
+				throughput_log << ", " << run.megapixels / run.gpu_stats.average() * 1e3 << " MP/s (GPU)";
+			}
+			throughput_log << ", " << run.memory / 1024.0 / 1024.0 << " MiB per texture";
+
+			LOG_MESSAGE(throughput_log.str(), Color::Bright_Green, Color::Black, 4);
+		}
+
+		// Materials asking for the same state share a sampler
+		uint64_t misses_before = sampler_cache->miss_count();
+		for (uint32_t material = 0; material < 64; material++) {
+
+			vk_texture::SamplerDesc desc;
+			desc.max_anisotropy = (material % 2 == 0) ? 16.0f : 1.0f;
+			desc.address_mode_u = (material % 4 < 2) ? VK_SAMPLER_ADDRESS_MODE_REPEAT : VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			desc.address_mode_v = desc.address_mode_u;
+
+			sampler_cache->get(desc);
+		}
+
+		LOG_MESSAGE("Sampler cache | 64 materials, " + std::to_string(sampler_cache->miss_count() - misses_before) +
+			        " new samplers, " + std::to_string(sampler_cache->size()) + " in total", Color::Bright_Green, Color::Black, 4);
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+	}
+
+
+	// Render benchmark_capture frames without then with the readback of every frame (vk_readback)
+	// into host memory, consumed by a copy into a frame buffer that stands for an encoder or a socket.
+	// Reports the frame time of both runs, the frames skipped by the service, its throughput and latency.
+	void run_capture_benchmark() {
+
+		LOG_MESSAGE("Running capture benchmark (" + std::to_string(swapchain_extent.width) + "x" +
+			        std::to_string(swapchain_extent.height) + ")...", Color::Yellow, Color::Black, 0);
+
+		if (!readback_swapchain) {
+			LOG_MESSAGE("Capture disabled, nothing to compare.", Color::Red, Color::Black, 0);
+			return;
+		}
+
+		// Into the --capture file, else copied into a frame buffer
+		vk_video::VideoSink* sink = video_sink.get();
+		std::vector<uint8_t> consumed_frame; // only touched by the consumer thread
+		vk_readback::ReadbackService readback(physical_device, device, &deletion_queue,
+			[sink, &consumed_frame](const vk_readback::Frame& frame) {
+				if (sink != nullptr) {
+					sink->write_frame(frame);
+					return;
+				}
+				size_t size = static_cast<size_t>(frame.row_pitch) * frame.extent.height;
+				consumed_frame.resize(size);
+				std::memcpy(consumed_frame.data(), frame.pixels, size);
+			});
+
+		vk_pipeline::DrawSettings draw_settings;
+		draw_settings.pipeline_layout = pipeline_layout;
+		draw_settings.push_constant_stages = layout_cache->push_constant_stages(pipeline_layout);
+		draw_settings.draws[0].material_id = config.shading_model;
 
-public:
+		const char* run_names[] = { "no capture", "capture" };
+		vk_profiler::TimingStats frame_stats[2];
 
-	void run() {
+		for (int run = 0; run < 2; run++) {
 
-		// If at any time during execution an error occurs,
-		// we'll throw a std::runtime_error exception
-		// which will propagate back to the main function and catched
-		// by the general std::exception.
+			draw_settings.readback = run == 1 ? &readback : nullptr;
 
-		init_window();
+			// The first frame pays for the first use of the pipeline (and of the readback buffers)
+			draw_frame(pipeline, draw_settings);
 
-		init_vulkan();
+			for (uint32_t i = 0; i < config.benchmark_capture && !glfwWindowShouldClose(window); i++) {
 
-		main_loop();
+				glfwPollEvents();
 
-		cleanup();
+				vk_profiler::ScopedTimer timer(frame_stats[run]);
+				draw_frame(pipeline, draw_settings);
+			}
+		}
+
+		// The copies of the last frame
+		vkWaitForFences(device, 1, fence_in_flight.ptr(), VK_TRUE, UINT64_MAX);
+		readback.frames_completed();
+		readback.drain();
+
+		LOG_MESSAGE("Benchmark results (" + vk_config::to_string(render_path) + "):", Color::Yellow, Color::Black, 0);
+		for (int run = 0; run < 2; run++) {
+			frame_stats[run].report(std::string("Capture | ") + run_names[run] + " | frame");
+		}
+
+		if (frame_stats[0].count() > 0 && frame_stats[1].count() > 0) {
+
+			std::ostringstream overhead_log;
+			overhead_log << std::fixed << std::setprecision(2)
+				<< "Capture | " << frame_stats[1].average() / frame_stats[0].average()
+				<< "x the frame time without capture";
+
+			LOG_MESSAGE(overhead_log.str(), Color::Bright_Green, Color::Black, 4);
+		}
+
+		readback.report("Capture | readback");
+
+		if (sink != nullptr) {
+			sink->flush();
+			sink->report("Capture | " + config.capture);
+		}
+
+		run_yuv_conversion_benchmark();
+
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
 	}
 
 
-private:
+	// Convert a frame of the size of the swapchain to YUV 4:2:0 with the SIMD then the scalar loop,
+	// benchmark_capture times each, and check that they give the same bytes
+	void run_yuv_conversion_benchmark() {
 
-	GLFWwindow* window;
+		const uint32_t row_pitch = swapchain_extent.width * 4;
 
-	VkInstance instance;
-	VkSurfaceKHR surface;
+		// A gradient: every block has some chroma
+		std::vector<uint8_t> pixels(static_cast<size_t>(row_pitch) * swapchain_extent.height);
+		for (size_t i = 0; i < pixels.size(); i++) {
+			pixels[i] = static_cast<uint8_t>(i * 7 + i / row_pitch);
+		}
 
-	VkPhysicalDevice physical_device = VK_NULL_HANDLE; // implicitly destroyed in vkDestroyInstance()
-	VkDevice device;
+		std::vector<uint8_t> simd_yuv(vk_video::yuv420_frame_size(swapchain_extent));
+		std::vector<uint8_t> scalar_yuv(simd_yuv.size());
+
+		vk_profiler::TimingStats simd_stats;
+		vk_profiler::TimingStats scalar_stats;
+
+		for (uint32_t i = 0; i < config.benchmark_capture; i++) {
+			{
+				vk_profiler::ScopedTimer timer(simd_stats);
+				vk_video::convert_to_yuv420(pixels.data(), row_pitch, swapchain_extent, false, simd_yuv.data());
+			}
+			{
+				vk_profiler::ScopedTimer timer(scalar_stats);
+				vk_video::convert_to_yuv420_scalar(pixels.data(), row_pitch, swapchain_extent, false, scalar_yuv.data());
+			}
+		}
 
-	// All queues are implicitly destoyed in vkDestroyDevice()
-	VkQueue queue_graphics;
-	VkQueue queue_present;
+		simd_stats.report("YUV 4:2:0 | SIMD");
+		scalar_stats.report("YUV 4:2:0 | scalar");
 
-	VkSwapchainKHR swapchain;
-	std::vector<VkImage> swapchain_images; // implicitly destroyed in vkDestroySwapchainKHR()
-	VkFormat swapchain_image_format;
-	VkExtent2D swapchain_extent;
-	std::vector<VkImageView> swapchain_image_views;
-	std::vector<VkFramebuffer> swapchain_framebuffers;
+		std::ostringstream conversion_log;
+		conversion_log << std::fixed << std::setprecision(2)
+			<< "YUV 4:2:0 | SIMD " << scalar_stats.average() / simd_stats.average() << "x faster, "
+			<< (simd_yuv == scalar_yuv ? "same output" : "OUTPUTS DIFFER");
 
-	VkPipeline pipeline;
-	VkPipelineLayout pipeline_layout;
-	VkRenderPass render_pass;
+		LOG_MESSAGE(conversion_log.str(), simd_yuv == scalar_yuv ? Color::Bright_Green : Color::Red, Color::Black, 4);
+	}
 
-	VkCommandPool command_pool;
-	VkCommandBuffer command_buffer;
 
-	VkSemaphore semaphore_image_available;
-	VkSemaphore semaphore_render_finished;
-	VkFence fence_in_flight;
-	/* -------------------- -------------------- */
+	// Render benchmark_render_thread frames with the events and the frames alternating on the main thread,
+	// then with the frames on a render thread (run_render_thread()), first with nothing else to do, then
+	// with an event handler that stalls the main thread for 4 ms every 8 event polls.
+	// Reports the frame time of each case: its standard deviation and 99th percentile show the jitter.
+	void run_render_thread_benchmark() {
 
+		LOG_MESSAGE("Running render thread benchmark...", Color::Yellow, Color::Black, 0);
 
-	// Initialize a GLFW window
-	void init_window() {
+		const uint32_t stall_every = 8;
+		const std::chrono::milliseconds event_stall(4);
 
-		glfwInit();    // Initialize GLFW library
+		const char* mode_names[] = { "main thread", "render thread" };
+		vk_profiler::TimingStats frame_stats[2][2]; // [stalls][mode]
 
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // Do not create an OpenGL context -> GLFW_NO_API
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);	  // For now, disable window resizing
+		for (int stalls = 0; stalls < 2 && !glfwWindowShouldClose(window); stalls++) {
+
+			// The first frame pays for the first use of the pipeline
+			draw_frame();
+
+			for (uint32_t i = 0; i < config.benchmark_render_thread && !glfwWindowShouldClose(window); i++) {
+
+				vk_profiler::ScopedTimer timer(frame_stats[stalls][0]);
+
+				glfwPollEvents();
+				if (stalls == 1 && (i + 1) % stall_every == 0) {
+					std::this_thread::sleep_for(event_stall);
+				}
+
+				draw_frame();
+			}
+
+			run_render_thread(config.benchmark_render_thread, &frame_stats[stalls][1],
+				              stalls == 1 ? stall_every : 0, event_stall);
+		}
+
+		LOG_MESSAGE("Benchmark results (" + vk_config::to_string(render_path) + "):", Color::Yellow, Color::Black, 0);
+		for (int stalls = 0; stalls < 2; stalls++) {
 
-		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan tutorial", nullptr, nullptr);
+			std::string events = stalls == 1 ? "slow events" : "idle events";
+
+			for (int mode = 0; mode < 2; mode++) {
+				frame_stats[stalls][mode].report(events + " | " + mode_names[mode] + " | frame");
+			}
+
+			if (frame_stats[stalls][0].count() > 0 && frame_stats[stalls][1].count() > 0) {
+
+				std::ostringstream variance_log;
+				variance_log << std::fixed << std::setprecision(2)
+					<< events << " | frame time standard deviation: " << frame_stats[stalls][0].standard_deviation()
+					<< " ms on the main thread, " << frame_stats[stalls][1].standard_deviation() << " ms on the render thread";
+
+				LOG_MESSAGE(variance_log.str(), Color::Bright_Green, Color::Black, 4);
+			}
+		}
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
 	}
 
 
-	// Initialize the Vulkan objects
-	void init_vulkan() {
+	// Compare the two ways of giving small per-draw data to the shaders:
+	// push constants recorded with each draw, and a dynamic uniform buffer written
+	// every frame and bound with a different offset for each draw.
+	void run_per_draw_benchmark() {
 
-		vk_core::create_vk_instance(instance);
+		LOG_MESSAGE("Running per-draw data benchmark...", Color::Yellow, Color::Black, 0);
 
-		vk_core::create_vk_surface(surface, instance, window);
+		// The fragment shader of the uniform buffer path has no push constant block: nothing is pushed on it
+		const std::string UBO_VERT_FILE = "shaders/per_draw_ubo_vert.spv";
+		const std::string UBO_FRAG_FILE = "shaders/per_draw_ubo_frag.spv";
 
-		vk_core::select_physical_device(physical_device, instance, surface);
+		// Shaders compiled before the per-draw data existed can not be compared
+		for (const std::string& file : { UBO_VERT_FILE, UBO_FRAG_FILE }) {
+			if (!std::filesystem::exists(file)) {
+				LOG_MESSAGE(file + " not found, run shaders/compile_shaders.bat first.", Color::Red, Color::Black, 0);
+				return;
+			}
+		}
 
-		vk_core::create_logical_device(device, physical_device,
-			                           instance, surface,
-			                           queue_graphics, queue_present);
+		// Small triangles on a grid: the cost is in the draws, not in the fragments
+		const uint32_t draw_count = config.benchmark_draws_per_frame;
+		const uint32_t grid_size = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(draw_count))));
 
-		vk_core::create_swapchain(swapchain, swapchain_images,
-			                      swapchain_image_format, swapchain_extent,
-			                      surface, window, physical_device, device);
+		std::vector<vk_draw::PerDraw> draws(draw_count);
+		for (uint32_t i = 0; i < draw_count; i++) {
 
-		vk_core::create_image_views(swapchain_image_views,
-			                        swapchain_images, swapchain_image_format,
-			                        device);
+			float x = -1.0f + (2.0f * (i % grid_size) + 1.0f) / grid_size;
+			float y = -1.0f + (2.0f * (i / grid_size) + 1.0f) / grid_size;
+			float scale = 1.0f / grid_size;
+
+			draws[i].transform = glm::mat4(
+				scale, 0.0f, 0.0f, 0.0f,
+				0.0f, scale, 0.0f, 0.0f,
+				0.0f, 0.0f, 1.0f, 0.0f,
+				x, y, 0.0f, 1.0f); // column major: translation in the last column
+			draws[i].object_index = i;
+		}
+
+		// Dynamic uniform buffer: one entry per draw, at the alignment the device requires
+		VkPhysicalDeviceProperties device_properties;
+		vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+		VkDeviceSize stride = vk_buffer::align_size(sizeof(vk_draw::PerDraw), device_properties.limits.minUniformBufferOffsetAlignment);
+
+		VkBuffer new_buffer;
+		VkDeviceMemory new_buffer_memory;
+		vk_buffer::create_buffer(new_buffer, new_buffer_memory,
+			                     stride * draw_count, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			                     physical_device, device);
+
+		// Released in this order: the buffer, then its memory (freeing it also unmaps it)
+		vk_handle::Handle<VkDeviceMemory> per_draw_buffer_memory = own(new_buffer_memory);
+		vk_handle::Handle<VkBuffer> per_draw_buffer = own(new_buffer);
+
+		void* mapped_per_draw_buffer = nullptr;
+		vkMapMemory(device, per_draw_buffer_memory, 0, VK_WHOLE_SIZE, 0, &mapped_per_draw_buffer);
+
+		// Both paths use the same specialization of shader.frag (the uniform buffer path without its push block)
+		vk_variant::ShaderVariant push_variant = shader_variant();
+		vk_variant::ShaderVariant ubo_variant = shader_variant();
+		ubo_variant.vert_file = UBO_VERT_FILE;
+		ubo_variant.frag_file = UBO_FRAG_FILE;
+
+		vk_pipeline::DrawSettings push_settings;
+		VkPipeline push_pipeline = variant_cache->get_pipeline(push_variant, push_settings.pipeline_layout);
+		push_settings.push_constant_stages = layout_cache->push_constant_stages(push_settings.pipeline_layout);
+		push_settings.draws = draws;
+
+		vk_pipeline::DrawSettings ubo_settings;
+		VkPipeline ubo_pipeline = variant_cache->get_pipeline(ubo_variant, ubo_settings.pipeline_layout);
+		ubo_settings.draws = draws;
+		ubo_settings.per_draw_stride = stride;
+
+		// A single set with the whole buffer, the dynamic offset selects the draw
+		VkDescriptorPoolSize pool_size{};
+		pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		pool_size.descriptorCount = 1;
+
+		VkDescriptorPoolCreateInfo descriptor_pool_info{};
+		descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptor_pool_info.maxSets = 1;
+		descriptor_pool_info.poolSizeCount = 1;
+		descriptor_pool_info.pPoolSizes = &pool_size;
+
+		VkDescriptorPool new_descriptor_pool;
+		if (vkCreateDescriptorPool(device, &descriptor_pool_info, nullptr, &new_descriptor_pool) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to create Vulkan Descriptor pool! \033[0m \n");
+		}
+		vk_handle::Handle<VkDescriptorPool> descriptor_pool = own(new_descriptor_pool);
+
+		std::vector<VkDescriptorSetLayout> set_layouts = layout_cache->descriptor_set_layouts(ubo_settings.pipeline_layout);
+		if (set_layouts.empty()) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error(UBO_VERT_FILE + " declares no per-draw uniform buffer! \033[0m \n");
+		}
+
+		VkDescriptorSetAllocateInfo descriptor_set_info{};
+		descriptor_set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descriptor_set_info.descriptorPool = descriptor_pool;
+		descriptor_set_info.descriptorSetCount = 1;
+		descriptor_set_info.pSetLayouts = &set_layouts[0];
+
+		if (vkAllocateDescriptorSets(device, &descriptor_set_info, &ubo_settings.per_draw_descriptor_set) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to allocate Vulkan Descriptor set! \033[0m \n");
+		}
+
+		VkDescriptorBufferInfo buffer_info{};
+		buffer_info.buffer = per_draw_buffer;
+		buffer_info.offset = 0;
+		buffer_info.range = sizeof(vk_draw::PerDraw);
+
+		VkWriteDescriptorSet descriptor_write{};
+		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_write.dstSet = ubo_settings.per_draw_descriptor_set;
+		descriptor_write.dstBinding = 0;
+		descriptor_write.descriptorCount = 1;
+		descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptor_write.pBufferInfo = &buffer_info;
 
-		vk_pipeline::create_renderpass(render_pass, device, swapchain_image_format);
+		vkUpdateDescriptorSets(device, 1, &descriptor_write, 0, nullptr);
 
-		vk_pipeline::create_pipeline(pipeline, pipeline_layout, render_pass, device);
+		vk_profiler::TimingStats push_stats, ubo_stats;
 
-		vk_pipeline::create_framebuffers(swapchain_framebuffers,
-			                             swapchain_image_views,
-			                             swapchain_extent,
-			                             device, render_pass);
+		for (bool use_ubo : { false, true }) {
 
-		vk_pipeline::create_command_pool(command_pool, physical_device, device, surface);
+			VkPipeline frame_pipeline = use_ubo ? ubo_pipeline : push_pipeline;
+			const vk_pipeline::DrawSettings& draw_settings = use_ubo ? ubo_settings : push_settings;
+			vk_profiler::TimingStats& stats = use_ubo ? ubo_stats : push_stats;
 
-		vk_pipeline::create_command_buffer(command_buffer, command_pool, device);
+			for (uint32_t i = 0; i < config.benchmark_draws && !glfwWindowShouldClose(window); i++) {
 
-		vk_pipeline::create_sync_objects(semaphore_image_available, semaphore_render_finished,
-			                             fence_in_flight, device);
+				glfwPollEvents();
+
+				vk_profiler::ScopedTimer timer(stats);
+
+				// The previous frame must be done reading the buffer before it is written again
+				vkWaitForFences(device, 1, fence_in_flight.ptr(), VK_TRUE, UINT64_MAX);
+				if (use_ubo) {
+					vk_draw::write_per_draw(mapped_per_draw_buffer, stride, draws);
+				}
+
+				draw_frame(frame_pipeline, draw_settings);
+			}
+		}
+
+		LOG_MESSAGE("Benchmark results (" + std::to_string(draw_count) + " draws per frame):", Color::Yellow, Color::Black, 0);
+		push_stats.report("push constants | frame");
+		ubo_stats.report("dynamic uniform buffer | frame");
+
+		for (const auto* stats : { &push_stats, &ubo_stats }) {
+			if (stats->count() > 0 && stats->average() > 0.0) {
+				double draws_per_second = draw_count / (stats->average() / 1000.0);
+				LOG_MESSAGE(std::string(stats == &push_stats ? "push constants" : "dynamic uniform buffer") +
+					        " | draws per second: " + std::to_string(static_cast<uint64_t>(draws_per_second)),
+					        Color::Bright_Green, Color::Black, 4);
+			}
+		}
+		LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
 	}
 
 
 	// Iterates render operations until the window is closed
 	void main_loop() {
 
+		if (config.render_thread) {
+			run_render_thread(UINT64_MAX, nullptr, 0, std::chrono::milliseconds(0));
+			return;
+		}
+
 		// Keep running until an error occurs or the window is closed
 		while(!glfwWindowShouldClose(window)) {
 
 			glfwPollEvents();
+			read_framebuffer_extent();
+
+			// Minimized: no size, nothing to draw until it is restored
+			if (framebuffer_extent.width == 0 || framebuffer_extent.height == 0) {
+				glfwWaitEvents();
+				continue;
+			}
 
 			draw_frame();
 		}
 
-		// All the operations in draw_frame() are asynchronous.
-		// When we exit the loop in main_loop(), some operations may still be going on.
-		// Cleaning up resources while that is happening should be avoided.
-		// The solution is wait for the logical device to finish operations.
-		vkDeviceWaitIdle(device);
+		// All the operations in draw_frame() are asynchronous:
+		// cleanup() waits for the last frame before destroying anything.
+	}
+
+
+	// Render on a render thread (render_loop()) while this thread, the only one allowed to process the
+	// window events, waits for them and forwards them, until the window is closed or the render thread
+	// has rendered max_frames frames. An error of the render thread is thrown again here.
+	// With stall_every > 0 this thread also stalls for event_stall every stall_every polls, like a slow
+	// event handler would (render thread benchmark).
+	void run_render_thread(uint64_t max_frames, vk_profiler::TimingStats* frame_stats,
+		                   uint32_t stall_every, std::chrono::milliseconds event_stall) {
+
+		vk_input::EventForwarder forwarder(window);
+		vk_profiler::TimingStats event_latency; // render thread only, until it is joined
+
+		std::atomic<bool> render_done{ false };
+		std::exception_ptr render_error;
+
+		std::thread render_thread([&] {
+
+			try {
+				render_loop(forwarder, max_frames, frame_stats, event_latency);
+			}
+			catch (...) {
+				render_error = std::current_exception();
+			}
+
+			render_done = true;
+			glfwPostEmptyEvent(); // wake this thread up
+		});
+
+		uint64_t poll_count = 0;
+		while (!render_done && !glfwWindowShouldClose(window)) {
+
+			if (stall_every == 0) {
+				glfwWaitEvents();
+			}
+			else {
+				glfwWaitEventsTimeout(0.001);
+				if (++poll_count % stall_every == 0) {
+					std::this_thread::sleep_for(event_stall);
+				}
+			}
+		}
+
+		// Only a running render thread empties the queue
+		while (!render_done && !forwarder.try_post_close()) {
+			std::this_thread::yield();
+		}
+		render_thread.join();
+
+		if (render_error) {
+			std::rethrow_exception(render_error);
+		}
+
+		if (event_latency.count() > 0) {
+			event_latency.report("Render thread | event latency");
+		}
+		if (forwarder.dropped_events() > 0) {
+			LOG_MESSAGE("Render thread | " + std::to_string(forwarder.dropped_events()) + " event(s) dropped, the queue was full",
+				        Color::Red, Color::Black, 4);
+		}
+	}
+
+
+	// Render thread: drain the window events and take the window state, then render a frame, until
+	// the Close event or max_frames frames. Only touches GLFW through the forwarder: a new framebuffer
+	// size comes with the window state, the swapchain is recreated for it by the next frame.
+	void render_loop(vk_input::EventForwarder& forwarder, uint64_t max_frames,
+		             vk_profiler::TimingStats* frame_stats, vk_profiler::TimingStats& event_latency) {
+
+		vk_input::SpscQueue<vk_input::WindowEvent>& events = forwarder.events();
+		vk_input::WindowState window_state;
+
+		for (uint64_t frame = 0; frame < max_frames; ) {
+
+			auto frame_start = std::chrono::steady_clock::now();
+
+			if (forwarder.take_window_state(window_state)) {
+
+				VkExtent2D new_extent = { window_state.width, window_state.height };
+				if (new_extent.width != framebuffer_extent.width || new_extent.height != framebuffer_extent.height) {
+					framebuffer_extent = new_extent;
+					swapchain_out_of_date = true;
+				}
+			}
+
+			vk_input::WindowEvent event;
+			while (events.try_pop(event)) {
+
+				event_latency.add_sample(std::chrono::duration<double, std::milli>(frame_start - event.posted).count());
+
+				// The scene does not react to the input yet
+				if (event.type == vk_input::WindowEvent::Type::Close) {
+					return;
+				}
+			}
+
+			// Nothing is visible (a minimized window has no size): wait for the window to be restored
+			if (window_state.minimized || framebuffer_extent.width == 0 || framebuffer_extent.height == 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+
+			draw_frame();
+			frame++;
+
+			if (frame_stats != nullptr) {
+				frame_stats->add_sample(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+			}
+		}
 	}
 
 
-	// Render a single frame of a scene
+	// Render a single frame of a scene with the main pipeline
 	void draw_frame() {
 
-		// Wait for the previous frame to finish
-		vkWaitForFences(device, 1, &fence_in_flight, VK_TRUE, UINT64_MAX);
-		vkResetFences(device, 1, &fence_in_flight);
+		vk_pipeline::DrawSettings draw_settings;
+		draw_settings.pipeline_layout = pipeline_layout;
+		draw_settings.push_constant_stages = layout_cache->push_constant_stages(pipeline_layout);
+		draw_settings.draws[0].material_id = config.shading_model;
+		draw_settings.pass_queries = pass_queries.get();
+		draw_settings.readback = frame_readback.get();
+
+		if (particle_system) {
+			draw_settings.particles = particle_system.get();
+			draw_settings.particle_pipeline = particle_pipeline;
+			draw_settings.particle_pipeline_layout = particle_pipeline_layout;
+		}
+
+		draw_frame(pipeline, draw_settings);
+	}
+
+
+	void draw_frame(VkPipeline frame_pipeline, const vk_pipeline::DrawSettings& draw_settings) {
+
+		// Wait for the previous frame to finish.
+		// The fence is reset once an image is acquired: a skipped frame leaves it signaled.
+		vkWaitForFences(device, 1, fence_in_flight.ptr(), VK_TRUE, UINT64_MAX);
+
+		// The swapchain no longer matches the surface (acquire or present said so, or the window was resized).
+		// A minimized window has no size: no frame until it is restored.
+		if (swapchain_out_of_date) {
+			if (framebuffer_extent.width == 0 || framebuffer_extent.height == 0) {
+				return;
+			}
+			recreate_swapchain();
+			swapchain_out_of_date = false;
+		}
+
+		// Every submitted frame has completed: destroy what they were the last to use
+		deletion_queue.collect(deletion_queue.frame_index());
+
+		// The previous frame is done: pipelines replaced by the hot reload are no longer in use.
+		// A swapped pipeline is picked up by the next call of draw_frame().
+		if (shader_hot_reload) {
+			shader_hot_reload->apply_pending();
+		}
+
+		memory_telemetry->sample();
+		frame_count++;
+		if (config.memory_report > 0 && frame_count % config.memory_report == 0) {
+			memory_telemetry->report();
+			if (render_path == vk_config::RenderPath::DynamicRendering) {
+				render_graph->report(); // of the previous frame
+				barrier_counters.report("frame barriers");
+			}
+		}
+
+		// The frames the GPU has finished, without waiting for the others
+		if (pass_queries) {
+			pass_queries->collect();
+			if (frame_count % config.pass_queries == 0) {
+				pass_queries->report();
+			}
+		}
+
+		// The copies of the previous frame have completed: hand them to the consumer thread
+		if (draw_settings.readback != nullptr) {
+			draw_settings.readback->frames_completed();
+		}
 
 		uint32_t image_index = 0;
 		// Acquire an image from the swapchain
-		vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
-			                  semaphore_image_available, VK_NULL_HANDLE, &image_index);
+		VkResult acquire_result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+			                                            semaphore_image_available, VK_NULL_HANDLE, &image_index);
+
+		// Nothing acquired, the semaphore will not be signaled: skip the frame, recreate for the next one
+		if (acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
+			swapchain_out_of_date = true;
+			return;
+		}
+		if (acquire_result != VK_SUCCESS && acquire_result != VK_SUBOPTIMAL_KHR) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to acquire a Swapchain image! \033[0m \n");
+		}
+
+		// Suboptimal: the image is acquired and still presentable, recreate after this frame
+		if (acquire_result == VK_SUBOPTIMAL_KHR) {
+			swapchain_out_of_date = true;
+		}
+
+		vkResetFences(device, 1, fence_in_flight.ptr());
 
 
 		// Record command buffer which draws the scene onto that image
 		vkResetCommandBuffer(command_buffer, /*VkCommandBufferResetFlagBits*/ 0);
+		VkFramebuffer framebuffer = render_path == vk_config::RenderPath::RenderPass ?
+			                        swapchain_framebuffers[image_index].get() : VK_NULL_HANDLE;
+
 		vk_pipeline::record_command_buffer(command_buffer, image_index,
-			                               pipeline, render_pass,
-			                               swapchain_framebuffers, swapchain_extent);
+			                               frame_pipeline, depth_prepass ? depth_prepass_pipeline.get() : VK_NULL_HANDLE,
+			                               render_pass, framebuffer,
+			                               swapchain_images[image_index], swapchain_image_views[image_index],
+			                               swapchain_image_format, depth_format,
+			                               swapchain_extent, msaa_samples, hdr_target(), render_path,
+			                               draw_settings, *render_graph);
+
+		if (render_path == vk_config::RenderPath::DynamicRendering) {
+			const vk_graph::GraphStats& graph_stats = render_graph->stats();
+			barrier_counters.add("image barriers", graph_stats.image_barrier_count);
+			barrier_counters.add("buffer barriers", graph_stats.buffer_barrier_count);
+			barrier_counters.add("barrier batches", graph_stats.barrier_batch_count);
+			barrier_counters.add("redundant barriers dropped", graph_stats.redundant_barrier_count);
+			barrier_counters.add("barriers merged", graph_stats.merged_barrier_count);
+		}
+		barrier_counters.end_frame();
 
 
 		// Submit the command buffer
@@ -188,6 +2074,9 @@ private:
 			throw std::runtime_error("Failed to submit draw Command Buffer! \033[0m \n");
 		}
 
+		// Objects released from now on may be used by the next frame only
+		deletion_queue.end_frame();
+
 
 		// Present the swapchain image
 		VkPresentInfoKHR present_info{};
@@ -200,42 +2089,133 @@ private:
 		present_info.pSwapchains = swapchains;
 		present_info.pImageIndices = &image_index;
 
-		vkQueuePresentKHR(queue_present, &present_info);
+		VkResult present_result = vkQueuePresentKHR(queue_present, &present_info);
+
+		if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR) {
+			swapchain_out_of_date = true;
+		}
+		else if (present_result != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to present a Swapchain image! \033[0m \n");
+		}
+
+		if (!first_frame_presented) {
+			first_frame_presented = true;
+			finish_startup_trace();
+		}
+	}
+
+
+	// Report the time to first frame, and every startup phase if a trace file was requested
+	void finish_startup_trace() {
+
+		startup_trace.add_marker("first frame presented");
+		memory_telemetry->record_counters(startup_trace);
+		if (render_path == vk_config::RenderPath::DynamicRendering) {
+			render_graph->record_counters(startup_trace);
+			barrier_counters.record_counters(startup_trace, "frame barriers");
+		}
+
+		LOG_MESSAGE("Time to first frame: " + std::to_string(startup_trace.elapsed()) + " ms", Color::Bright_Green, Color::Black, 0);
+
+		if (!config.startup_trace.empty()) {
+			startup_trace.report();
+			startup_trace.write_chrome_trace(config.startup_trace);
+		}
 	}
 
 
 	// Deallocate resources in opposite order of creation
 	void cleanup() {
 
+		// Stop compiling before the device goes away
+		shader_hot_reload.reset();
+
+		memory_telemetry->report();
+		memory_telemetry.reset();
+
+		if (render_path == vk_config::RenderPath::DynamicRendering) {
+			render_graph->report();
+			barrier_counters.report("frame barriers");
+		}
+		render_graph.reset(); // releases its transient images to the deletion queue
+
+		// The last frame is the only one in flight. Presenting is not covered by its fence,
+		// so also wait for the present queue to be done with the render finished semaphore.
+		vkWaitForFences(device, 1, fence_in_flight.ptr(), VK_TRUE, UINT64_MAX);
+		vkQueueWaitIdle(queue_present);
+
+		if (pass_queries) {
+			pass_queries->collect(); // the last frame
+			pass_queries->report();
+			pass_queries.reset();
+		}
+
+		// The copies of the last frame, then the frames still converted or written
+		if (frame_readback) {
+			frame_readback->frames_completed();
+			frame_readback->drain();
+			frame_readback->report("Capture | readback");
+			frame_readback.reset();
+		}
+		if (video_sink) {
+			video_sink->flush();
+			video_sink->report("Capture | " + config.capture);
+			video_sink.reset();
+		}
+
+		// The handles release their objects to the deletion queue, flushed below
 		LOG_MESSAGE("Destroying Vulkan Semaphore(s) and Fence(s)...", Color::Bright_Blue, Color::Black, 0);
-		vkDestroySemaphore(device, semaphore_image_available, nullptr);
-		vkDestroySemaphore(device, semaphore_render_finished, nullptr);
-		vkDestroyFence(device, fence_in_flight, nullptr);
+		semaphore_image_available.reset();
+		semaphore_render_finished.reset();
+		fence_in_flight.reset();
 
 		LOG_MESSAGE("Destroying Vulkan Command Pool...", Color::Bright_Blue, Color::Black, 0);
-		vkDestroyCommandPool(device, command_pool, nullptr);
+		command_pool.reset();
 
 		LOG_MESSAGE("Destroying Vulkan Swapchain Framebuffers...", Color::Bright_Blue, Color::Black, 0);
-		for (auto framebuffer : swapchain_framebuffers) {
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
-		}
+		swapchain_framebuffers.clear();
+		framebuffer_attachments.clear();
+
+		LOG_MESSAGE("Destroying " + std::to_string(textures.size()) + " texture(s)...", Color::Bright_Blue, Color::Black, 0);
+		textures.clear();
+
+		LOG_MESSAGE("Destroying particle system...", Color::Bright_Blue, Color::Black, 0);
+		particle_system.reset();
 
 		LOG_MESSAGE("Destroying Vulkan Pipeline...", Color::Bright_Blue, Color::Black, 0);
-		vkDestroyPipeline(device, pipeline, nullptr);
+		pipeline.reset();
+		depth_prepass_pipeline.reset();
+		particle_pipeline.reset();
+
+		LOG_MESSAGE("Destroying shader variant Pipelines...", Color::Bright_Blue, Color::Black, 4);
+		variant_cache.reset();
+
+		LOG_MESSAGE("Destroying tone mapping Pipeline...", Color::Bright_Blue, Color::Black, 4);
+		tone_map.reset();
 
-		LOG_MESSAGE("Destroying Vulkan Pipeline Layout...", Color::Bright_Blue, Color::Black, 4);
-		vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+		LOG_MESSAGE("Destroying Vulkan Pipeline cache...", Color::Bright_Blue, Color::Black, 0);
+		vk_pipeline::save_pipeline_cache(pipeline_cache, PIPELINE_CACHE_FILE, device);
+		pipeline_cache.reset();
 
 		LOG_MESSAGE("Destroying Vulkan Render pass...", Color::Bright_Blue, Color::Black, 0);
-		vkDestroyRenderPass(device, render_pass, nullptr);
+		render_pass.reset();
 
 		LOG_MESSAGE("Destroying Vulkan Image Views...", Color::Bright_Blue, Color::Black, 0);
-		for (auto imgv : swapchain_image_views) {
-			vkDestroyImageView(device, imgv, nullptr);
-		}
+		swapchain_image_views.clear();
 
 		LOG_MESSAGE("Destroying Vulkan Swapchain...", Color::Bright_Blue, Color::Black, 0);
-		vkDestroySwapchainKHR(device, swapchain, nullptr);
+		swapchain.reset();
+
+		LOG_MESSAGE("Destroying " + std::to_string(deletion_queue.size()) + " released Vulkan objects...", Color::Bright_Blue, Color::Black, 0);
+		deletion_queue.flush();
+
+		// After the pipelines that use them
+		LOG_MESSAGE("Destroying Vulkan Pipeline and Descriptor set Layouts...", Color::Bright_Blue, Color::Black, 4);
+		layout_cache.reset();
+
+		LOG_MESSAGE("Destroying " + std::to_string(sampler_cache->size()) + " Vulkan Sampler(s)...", Color::Bright_Blue, Color::Black, 0);
+		sampler_cache.reset();
 
 		LOG_MESSAGE("Destroying Vulkan Logical Device...", Color::Bright_Blue, Color::Black, 0);
 		LOG_MESSAGE("Destroying Queues...", Color::Bright_Blue, Color::Black, 4);
@@ -255,12 +2235,387 @@ private:
 };
 
 
-int main() {
+// Sum of the file contents, so that every loader really reads every byte
+static uint64_t checksum(const char* data, size_t size) {
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < size; i++) {
+		sum += static_cast<unsigned char>(data[i]);
+	}
+
+	return sum;
+}
+
+
+// Compare the std::ifstream loader with the memory mapped loaders on a (large) file
+void run_file_loader_benchmark(const std::string& file_path, uint32_t iterations) {
+
+	LOG_MESSAGE("Running file loader benchmark on " + file_path + "...", Color::Yellow, Color::Black, 0);
+
+	vk_profiler::TimingStats read_stats, map_stats, map_async_stats;
+	uint64_t read_sum = 0, map_sum = 0, map_async_sum = 0;
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		{
+			vk_profiler::ScopedTimer timer(read_stats);
+			std::vector<char> file = read_file(file_path);
+			read_sum = checksum(file.data(), file.size());
+		}
+		{
+			vk_profiler::ScopedTimer timer(map_stats);
+			MappedFile file = map_file(file_path);
+			map_sum = checksum(file.data(), file.size());
+		}
+		{
+			vk_profiler::ScopedTimer timer(map_async_stats);
+			MappedFile file = map_file_async(file_path).get();
+			map_async_sum = checksum(file.data(), file.size());
+		}
+	}
+
+	if (read_sum != map_sum || read_sum != map_async_sum) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("File loaders returned different data! \033[0m \n");
+	}
+
+	LOG_MESSAGE("Benchmark results (load + read every byte):", Color::Yellow, Color::Black, 0);
+	read_stats.report("read_file");
+	map_stats.report("map_file");
+	map_async_stats.report("map_file_async");
+}
+
+
+// Push constants of saxpy.comp
+struct SaxpyConstants {
+	uint32_t count;
+	float a;
+};
+
+
+// Throughput of the headless compute path: y = a * x + y on growing arrays,
+// from the launch overhead of small batches to the memory bandwidth of large ones
+void run_compute_benchmark(const vk_config::Config& config) {
+
+	LOG_MESSAGE("Running compute benchmark...", Color::Yellow, Color::Black, 0);
+
+	const std::string saxpy_file = "shaders/saxpy_comp.spv";
+	if (!std::filesystem::exists(saxpy_file)) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(saxpy_file + " not found, run shaders/compile_shaders.bat first! \033[0m \n");
+	}
+
+	// Destroyed in reverse order: the context and the layouts before the device
+	vk_compute::HeadlessDevice headless(config.device, DEVICE_PROBE_CACHE_FILE);
+	vk_reflect::LayoutCache layout_cache(headless.device);
+	vk_compute::ComputeContext context(headless.physical_device, headless.device,
+		                               headless.queue_family, headless.queue,
+		                               VK_NULL_HANDLE, layout_cache);
+
+	vk_compute::Kernel saxpy = context.create_kernel(saxpy_file);
+
+	LOG_MESSAGE("Benchmark results (" + headless.device_probe.name + ", " +
+		        std::to_string(config.benchmark_compute) + " runs per size):", Color::Yellow, Color::Black, 0);
+
+	for (uint64_t count = 1000; count <= config.benchmark_compute_max_elements; count *= 10) {
+
+		VkDeviceSize size = count * sizeof(float);
+
+		// Halves and 2.0: every result is exact, on the CPU and on the GPU
+		std::vector<float> x(count), y(count);
+		for (uint64_t i = 0; i < count; i++) {
+			x[i] = static_cast<float>(i % 1024) * 0.5f;
+			y[i] = 1.0f;
+		}
+
+		vk_compute::Buffer x_buffer = context.create_buffer(size);
+		vk_compute::Buffer y_buffer = context.create_buffer(size);
+		context.upload(x_buffer, x.data(), size);
+		context.upload(y_buffer, y.data(), size);
+
+		SaxpyConstants constants{ static_cast<uint32_t>(count), 2.0f };
+		uint32_t groups = context.group_count(count, saxpy);
+
+		context.dispatch(saxpy, { &x_buffer, &y_buffer }, &constants, sizeof(constants), groups);
+
+		std::vector<float> result(count);
+		context.download(y_buffer, result.data(), size);
+
+		for (uint64_t i = 0; i < count; i++) {
+			if (result[i] != constants.a * x[i] + y[i]) {
+				std::cout << "\033[31;40m";
+				throw std::runtime_error("saxpy mismatch at element " + std::to_string(i) + "! \033[0m \n");
+			}
+		}
+
+		vk_profiler::TimingStats gpu_stats, submit_stats, cpu_stats;
+
+		for (uint32_t i = 0; i < config.benchmark_compute; i++) {
+
+			context.dispatch(saxpy, { &x_buffer, &y_buffer }, &constants, sizeof(constants), groups);
+
+			vk_profiler::ScopedTimer timer(submit_stats);
+			double gpu_time = context.submit();
+			if (gpu_time > 0.0) {
+				gpu_stats.add_sample(gpu_time);
+			}
+		}
+
+		for (uint32_t i = 0; i < config.benchmark_compute; i++) {
+
+			vk_profiler::ScopedTimer timer(cpu_stats);
+			for (uint64_t e = 0; e < count; e++) {
+				y[e] = constants.a * x[e] + y[e];
+			}
+		}
+
+		std::string name = "saxpy " + std::to_string(count);
+		if (gpu_stats.count() > 0) {
+			gpu_stats.report(name + " | GPU");
+		}
+		submit_stats.report(name + " | submit + wait");
+		cpu_stats.report(name + " | CPU");
+
+		// Two reads and one write per element
+		double gpu_ms = gpu_stats.count() > 0 ? gpu_stats.average() : submit_stats.average();
+		double bytes = 3.0 * static_cast<double>(size);
+
+		std::ostringstream throughput_log;
+		throughput_log << std::fixed << std::setprecision(2)
+			<< name << " | " << count / gpu_ms / 1e6 << " G elements/s, " << bytes / gpu_ms / 1e6 << " GB/s (GPU), "
+			<< count / cpu_stats.average() / 1e6 << " G elements/s (CPU)";
 
-	HelloTriangle application;
+		LOG_MESSAGE(throughput_log.str(), Color::Bright_Green, Color::Black, 4);
+	}
+	LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+}
+
+
+// Throughput of the parallel primitives (vk_primitives) on growing arrays of uints,
+// next to their std:: counterparts on the CPU. Every GPU result is checked against the CPU one.
+void run_primitives_benchmark(const vk_config::Config& config) {
+
+	LOG_MESSAGE("Running parallel primitives benchmark...", Color::Yellow, Color::Black, 0);
+
+	for (const std::string& file : { vk_primitives::REDUCE_SHADER_FILE, vk_primitives::SCAN_SHADER_FILE,
+		                             vk_primitives::COMPACT_SHADER_FILE, vk_primitives::RADIX_HISTOGRAM_SHADER_FILE,
+		                             vk_primitives::RADIX_SCATTER_SHADER_FILE }) {
+
+		if (!std::filesystem::exists(file)) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error(file + " not found, run shaders/compile_shaders.bat first! \033[0m \n");
+		}
+	}
+
+	vk_compute::HeadlessDevice headless(config.device, DEVICE_PROBE_CACHE_FILE);
+
+	if (!vk_primitives::check_subgroup_support(headless.physical_device)) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(headless.device_probe.name + " lacks the subgroup operations of the primitives! \033[0m \n");
+	}
+
+	vk_reflect::LayoutCache layout_cache(headless.device);
+	vk_compute::ComputeContext context(headless.physical_device, headless.device,
+		                               headless.queue_family, headless.queue,
+		                               VK_NULL_HANDLE, layout_cache);
+	vk_primitives::Primitives primitives(context);
+
+	const uint32_t runs = config.benchmark_primitives;
+
+	LOG_MESSAGE("Benchmark results (" + headless.device_probe.name + ", " +
+		        std::to_string(runs) + " runs per size):", Color::Yellow, Color::Black, 0);
+
+	std::mt19937 random(42);
+
+	// 64 bit steps: count * 10 must not wrap past a maximum of 10^9 or more
+	for (uint64_t step = 1000; step <= config.benchmark_compute_max_elements; step *= 10) {
+
+		const uint32_t count = static_cast<uint32_t>(step); // <= benchmark_compute_max_elements
+		const VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(uint32_t);
+
+		std::vector<uint32_t> data(count), flags(count), keys(count), indices(count);
+		std::vector<uint64_t> wide_keys(count);
+		for (uint32_t i = 0; i < count; i++) {
+			data[i] = random() & 0xFF;
+			flags[i] = random() & 1;
+			keys[i] = static_cast<uint32_t>(random());
+			wide_keys[i] = (static_cast<uint64_t>(random()) << 32) | random();
+			indices[i] = i;
+		}
+
+		vk_compute::Buffer data_buffer = context.create_buffer(size);
+		vk_compute::Buffer flags_buffer = context.create_buffer(size);
+		vk_compute::Buffer result_buffer = context.create_buffer(size);
+		vk_compute::Buffer count_buffer = context.create_buffer(sizeof(uint32_t));
+		vk_compute::Buffer keys_buffer = context.create_buffer(size * 2);
+		vk_compute::Buffer values_buffer = context.create_buffer(size);
+
+		context.upload(data_buffer, data.data(), size);
+		context.upload(flags_buffer, flags.data(), size);
+
+		std::vector<uint32_t> expected, result(count);
+
+		// The CPU runs first and leaves its result in expected. The first GPU run is checked,
+		// and allocates the scratch buffers; prepare() runs before each GPU run, outside the timings.
+		auto benchmark = [&](const std::string& name, std::function<void()> cpu_run,
+			                 std::function<void()> prepare, std::function<void()> record,
+			                 std::function<bool()> check) {
+
+			vk_profiler::TimingStats cpu_stats, gpu_stats, submit_stats;
+
+			for (uint32_t i = 0; i < runs; i++) {
+				vk_profiler::ScopedTimer timer(cpu_stats);
+				cpu_run();
+			}
+
+			prepare();
+			record();
+			context.submit();
+
+			if (!check()) {
+				std::cout << "\033[31;40m";
+				throw std::runtime_error(name + " of " + std::to_string(count) + " elements differs from the CPU! \033[0m \n");
+			}
+
+			for (uint32_t i = 0; i < runs; i++) {
+
+				prepare();
+				record();
+
+				vk_profiler::ScopedTimer timer(submit_stats);
+				double gpu_time = context.submit();
+				if (gpu_time > 0.0) {
+					gpu_stats.add_sample(gpu_time);
+				}
+			}
+
+			std::string label = name + " " + std::to_string(count);
+			if (gpu_stats.count() > 0) {
+				gpu_stats.report(label + " | GPU");
+			}
+			submit_stats.report(label + " | submit + wait");
+			cpu_stats.report(label + " | CPU");
+
+			double gpu_ms = gpu_stats.count() > 0 ? gpu_stats.average() : submit_stats.average();
+
+			std::ostringstream throughput_log;
+			throughput_log << std::fixed << std::setprecision(2)
+				<< label << " | " << count / gpu_ms / 1e3 << " M elements/s (GPU), "
+				<< count / cpu_stats.average() / 1e3 << " M elements/s (CPU), x"
+				<< cpu_stats.average() / gpu_ms;
+
+			LOG_MESSAGE(throughput_log.str(), Color::Bright_Green, Color::Black, 4);
+		};
+
+		auto nothing = [] {};
+		auto result_matches = [&] {
+			context.download(result_buffer, result.data(), size);
+			return result == expected;
+		};
+
+		benchmark("inclusive scan",
+			[&] { expected.resize(count); std::inclusive_scan(data.begin(), data.end(), expected.begin()); },
+			nothing,
+			[&] { primitives.inclusive_scan(data_buffer, result_buffer, count); },
+			result_matches);
+
+		benchmark("exclusive scan",
+			[&] { expected.resize(count); std::exclusive_scan(data.begin(), data.end(), expected.begin(), 0u); },
+			nothing,
+			[&] { primitives.exclusive_scan(data_buffer, result_buffer, count); },
+			result_matches);
+
+		benchmark("reduce",
+			[&] { expected.assign(1, std::accumulate(data.begin(), data.end(), 0u)); },
+			nothing,
+			[&] { primitives.reduce(data_buffer, count_buffer, count); },
+			[&] {
+				uint32_t sum = 0;
+				context.download(count_buffer, &sum, sizeof(sum));
+				return sum == expected[0];
+			});
+
+		benchmark("compact",
+			[&] {
+				expected.clear();
+				for (uint32_t i = 0; i < count; i++) {
+					if (flags[i] != 0) {
+						expected.push_back(data[i]);
+					}
+				}
+			},
+			nothing,
+			[&] { primitives.compact(data_buffer, flags_buffer, result_buffer, count_buffer, count); },
+			[&] {
+				uint32_t kept = 0;
+				context.download(count_buffer, &kept, sizeof(kept));
+				if (kept != expected.size()) {
+					return false;
+				}
+				context.download(result_buffer, result.data(), kept * sizeof(uint32_t));
+				return std::equal(expected.begin(), expected.end(), result.begin());
+			});
+
+		// Sorted indices: the radix sort is stable, std::sort of (key, index) pairs gives the same order
+		auto sort_benchmark = [&](const std::string& name, auto& sort_keys, uint32_t key_bits) {
+
+			using Key = typename std::remove_reference_t<decltype(sort_keys)>::value_type;
+			std::vector<std::pair<Key, uint32_t>> pairs;
+			const VkDeviceSize keys_size = static_cast<VkDeviceSize>(count) * sizeof(Key);
+
+			benchmark(name,
+				[&] {
+					pairs.resize(count);
+					for (uint32_t i = 0; i < count; i++) {
+						pairs[i] = { sort_keys[i], i };
+					}
+					std::sort(pairs.begin(), pairs.end());
+
+					expected.resize(count);
+					for (uint32_t i = 0; i < count; i++) {
+						expected[i] = pairs[i].second;
+					}
+				},
+				[&] {
+					context.upload(keys_buffer, sort_keys.data(), keys_size);
+					context.upload(values_buffer, indices.data(), size);
+				},
+				[&] { primitives.sort_pairs(keys_buffer, values_buffer, count, key_bits); },
+				[&] {
+					context.download(values_buffer, result.data(), size);
+					return result == expected;
+				});
+		};
+
+		sort_benchmark("radix sort 32 bit", keys, 32);
+		sort_benchmark("radix sort 64 bit", wide_keys, 64);
+	}
+	LOG_MESSAGE("", Color::Yellow, Color::Black, 0);
+}
+
+
+int main(int argc, char* argv[]) {
 
 	try {
 
+		vk_config::Config config = vk_config::parse_config(argc, argv);
+
+		if (!config.benchmark_file.empty()) {
+			run_file_loader_benchmark(config.benchmark_file, config.benchmark_file_iterations);
+			return EXIT_SUCCESS;
+		}
+
+		if (config.benchmark_compute > 0) {
+			run_compute_benchmark(config);
+			return EXIT_SUCCESS;
+		}
+
+		if (config.benchmark_primitives > 0) {
+			run_primitives_benchmark(config);
+			return EXIT_SUCCESS;
+		}
+
+		HelloTriangle application(config);
+
 		application.run();
 	}
 	catch (const std::exception& ex) {
@@ -3,6 +3,22 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <cstdlib>	// getenv(), _dupenv_s()
+#include <stdexcept>
+#include <utility>	// exchange()
+#include <sstream>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 namespace my_util {
@@ -55,14 +71,22 @@ void LOG_MESSAGE(std::string message, Color text, Color background, uint16_t ind
 		case Color::Bright_White: { colors += "107m"; break; }
 	}
 
+	// Build the whole line first: messages logged by several threads
+	// (parallel initialization, shader hot reload) must not interleave
+	std::ostringstream line;
+
 	if (indentation_width > 0) {
-		std::cout << colors << std::setfill(' ') << std::setw(indentation_width) << ' ' << message << "\033[0m \n";
+		line << colors << std::setfill(' ') << std::setw(indentation_width) << ' ' << message << "\033[0m \n";
 	}
 	else {
 		// else do not indent text
-		std::cout << colors << message << "\033[0m \n";
+		line << colors << message << "\033[0m \n";
 	}
 
+	static std::mutex log_mutex;
+	std::lock_guard<std::mutex> lock(log_mutex);
+	std::cout << line.str();
+
 }
 
 
@@ -90,4 +114,180 @@ std::vector<char> read_file(const std::string& file_path) {
 }
 
 
+MappedFile::MappedFile(const std::string& file_path)
+	: file_path(file_path) {
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to open file: " + file_path + " \033[0m \n");
+	}
+
+	LARGE_INTEGER file_size{};
+	GetFileSizeEx(file, &file_size);
+	view_size = static_cast<size_t>(file_size.QuadPart);
+
+	// An empty file cannot be mapped, it simply has no data
+	if (view_size > 0) {
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr) {
+			view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping); // the view keeps the mapping alive
+		}
+	}
+
+	CloseHandle(file);
+#else
+	int file = ::open(file_path.c_str(), O_RDONLY);
+
+	if (file < 0) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to open file: " + file_path + " \033[0m \n");
+	}
+
+	struct stat file_stat{};
+	fstat(file, &file_stat);
+	view_size = static_cast<size_t>(file_stat.st_size);
+
+	// An empty file cannot be mapped, it simply has no data
+	if (view_size > 0) {
+
+		void* mapping = mmap(nullptr, view_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (mapping != MAP_FAILED) {
+			view = static_cast<const char*>(mapping);
+		}
+	}
+
+	::close(file); // the mapping keeps the file alive
+#endif
+
+	if (view_size > 0 && view == nullptr) {
+		view_size = 0;
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to map file: " + file_path + " \033[0m \n");
+	}
+}
+
+
+MappedFile::~MappedFile() {
+
+	unmap();
+}
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: view(std::exchange(other.view, nullptr)),
+	  view_size(std::exchange(other.view_size, 0)),
+	  file_path(std::move(other.file_path)) {
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+
+	if (this != &other) {
+		unmap();
+		view = std::exchange(other.view, nullptr);
+		view_size = std::exchange(other.view_size, 0);
+		file_path = std::move(other.file_path);
+	}
+
+	return *this;
+}
+
+
+const uint32_t* MappedFile::words() const {
+
+	if (view_size % sizeof(uint32_t) != 0) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("File size is not a multiple of 4 bytes: " + file_path + " \033[0m \n");
+	}
+
+	// The view is page aligned, so this cast is always correctly aligned
+	return reinterpret_cast<const uint32_t*>(view);
+}
+
+
+void MappedFile::prefetch() const {
+
+	if (view == nullptr) {
+		return;
+	}
+
+#ifndef _WIN32
+	madvise(const_cast<char*>(view), view_size, MADV_WILLNEED);
+#endif
+
+	// Touch one byte per page so the OS reads the whole file now
+	const size_t page_size = 4096;
+	volatile char sink = 0;
+	for (size_t offset = 0; offset < view_size; offset += page_size) {
+		sink = sink + view[offset];
+	}
+}
+
+
+void MappedFile::unmap() {
+
+	if (view != nullptr) {
+	#ifdef _WIN32
+		UnmapViewOfFile(view);
+	#else
+		munmap(const_cast<char*>(view), view_size);
+	#endif
+	}
+
+	view = nullptr;
+	view_size = 0;
+}
+
+
+MappedFile map_file(const std::string& file_path) {
+
+	return MappedFile(file_path);
+}
+
+
+std::future<MappedFile> map_file_async(const std::string& file_path) {
+
+	return std::async(std::launch::async, [file_path]() {
+
+		MappedFile file(file_path);
+		file.prefetch();
+
+		return file;
+	});
+}
+
+
+std::optional<std::string> get_env(const std::string& name) {
+
+#ifdef _MSC_VER
+	// getenv() is flagged as unsafe by the SDL checks, use the MSVC variant
+	char* value = nullptr;
+	size_t value_size = 0;
+
+	if (_dupenv_s(&value, &value_size, name.c_str()) != 0 || value == nullptr) {
+		return std::nullopt;
+	}
+
+	std::string result = value;
+	free(value);
+
+	return result;
+#else
+	const char* value = std::getenv(name.c_str());
+
+	if (value == nullptr) {
+		return std::nullopt;
+	}
+
+	return std::string(value);
+#endif
+}
+
+
 } // namespace my_util
\ No newline at end of file
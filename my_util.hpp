@@ -2,6 +2,9 @@
 
 #include <string>
 #include <vector>
+#include <optional>
+#include <cstdint>
+#include <future>
 
 
 namespace my_util {
@@ -17,7 +20,63 @@ enum Color {
 void LOG_MESSAGE(std::string message, Color text, Color background, uint16_t indentation_width);
 
 
+// Read a whole file into memory with std::ifstream.
+// The buffer has no alignment guarantee, prefer map_file() for SPIR-V and binary data.
 std::vector<char> read_file(const std::string& file_path);
 
 
+/*
+Read-only memory mapping of a whole file.
+The contents are not copied: pages are loaded by the OS when they are first read.
+The mapping starts at a page boundary, so data() can be read as uint32_t words
+(SPIR-V, pipeline cache headers) without alignment issues.
+The file is unmapped when the object is destroyed.
+*/
+class MappedFile {
+
+public:
+
+	MappedFile() = default;
+	explicit MappedFile(const std::string& file_path);
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const char* data() const { return view; }
+	size_t size() const { return view_size; }
+	bool empty() const { return view_size == 0; }
+	const std::string& path() const { return file_path; }
+
+	// The file as 32-bit words, the size must be a multiple of 4
+	const uint32_t* words() const;
+
+	// Read every page once so later accesses do not fault
+	void prefetch() const;
+
+private:
+
+	const char* view = nullptr;
+	size_t view_size = 0;
+	std::string file_path;
+
+	void unmap();
+};
+
+
+// Map a file in memory, throws if it cannot be opened
+MappedFile map_file(const std::string& file_path);
+
+
+// Map and prefetch a file on another thread
+std::future<MappedFile> map_file_async(const std::string& file_path);
+
+
+// Value of an environment variable, if it is set
+std::optional<std::string> get_env(const std::string& name);
+
+
 } // namespace my_util
\ No newline at end of file
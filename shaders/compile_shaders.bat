@@ -1,3 +1,33 @@
-C:/VulkanSDK/1.3.296.0/Bin/glslc.exe shader.vert -o vert.spv
-C:/VulkanSDK/1.3.296.0/Bin/glslc.exe shader.frag -o frag.spv
-pause
\ No newline at end of file
+@echo off
+rem Compile every shader to SPIR-V next to it. The SPIR-V is not tracked: the build runs this
+rem before compiling the program ("nopause"). Run it by hand after editing a shader outside of it.
+
+cd /d "%~dp0"
+
+set GLSLC=C:/VulkanSDK/1.3.296.0/Bin/glslc.exe
+if defined VULKAN_SDK set GLSLC=%VULKAN_SDK%/Bin/glslc.exe
+
+"%GLSLC%" shader.vert -o vert.spv || goto failed
+"%GLSLC%" shader.frag -o frag.spv || goto failed
+"%GLSLC%" per_draw_ubo.vert -o per_draw_ubo_vert.spv || goto failed
+"%GLSLC%" -DPER_DRAW_UBO shader.frag -o per_draw_ubo_frag.spv || goto failed
+"%GLSLC%" tonemap.comp -o tonemap_comp.spv || goto failed
+"%GLSLC%" saxpy.comp -o saxpy_comp.spv || goto failed
+"%GLSLC%" --target-env=vulkan1.1 reduce.comp -o reduce_comp.spv || goto failed
+"%GLSLC%" --target-env=vulkan1.1 scan.comp -o scan_comp.spv || goto failed
+"%GLSLC%" --target-env=vulkan1.1 compact.comp -o compact_comp.spv || goto failed
+"%GLSLC%" --target-env=vulkan1.1 radix_histogram.comp -o radix_histogram_comp.spv || goto failed
+"%GLSLC%" --target-env=vulkan1.1 radix_scatter.comp -o radix_scatter_comp.spv || goto failed
+"%GLSLC%" particles_simulate.comp -o particles_simulate_comp.spv || goto failed
+"%GLSLC%" particles_emit.comp -o particles_emit_comp.spv || goto failed
+"%GLSLC%" particles_depth_keys.comp -o particles_depth_keys_comp.spv || goto failed
+"%GLSLC%" particles.vert -o particles_vert.spv || goto failed
+"%GLSLC%" particles.frag -o particles_frag.spv || goto failed
+
+if not "%1"=="nopause" pause
+exit /b 0
+
+:failed
+echo Shader compilation failed.
+if not "%1"=="nopause" pause
+exit /b 1
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 460
+
+// Round, soft particles: the alpha fades from the center of the billboard to its edge.
+
+layout(location = 0) in vec2 frag_corner;
+layout(location = 1) in vec4 frag_color;
+
+layout(location = 0) out vec4 output_color;
+
+
+void main() {
+
+    float falloff = 1.0 - dot(frag_corner, frag_corner);
+    if (falloff <= 0.0) {
+        discard;
+    }
+
+    output_color = vec4(frag_color.rgb, frag_color.a * falloff);
+}
\ No newline at end of file
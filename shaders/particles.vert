@@ -0,0 +1,54 @@
+#version 460
+
+// Particle billboards: one instance per alive particle (indirect draw), six vertices each.
+// The instances read the particles in the order of the depth sort, from back to front,
+// so that alpha blending composes them correctly.
+
+layout(location = 0) out vec2 frag_corner;
+layout(location = 1) out vec4 frag_color;
+
+// vk_particles::Particle
+struct Particle {
+    vec4 position_life;
+    vec4 velocity_lifetime;
+};
+
+layout(set = 0, binding = 0) readonly buffer Particles {
+    Particle particles[];
+};
+
+// Slots sorted from back to front
+layout(set = 0, binding = 1) readonly buffer DrawOrder {
+    uint draw_order[];
+};
+
+// vk_particles::ParticleSystem::Camera
+layout(push_constant) uniform Camera {
+    mat4 view_projection;
+    vec2 billboard_size; // half size in clip space, scaled by the depth like the position
+} camera;
+
+// Two triangles facing the camera, in the corners of the quad
+vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+const vec3 YOUNG_COLOR = vec3(1.0, 0.85, 0.4);
+const vec3 OLD_COLOR = vec3(0.9, 0.25, 0.1);
+
+
+void main() {
+
+    Particle particle = particles[draw_order[gl_InstanceIndex]];
+    vec2 corner = corners[gl_VertexIndex];
+
+    // The offset is added before the perspective divide: the billboards shrink with the distance
+    gl_Position = camera.view_projection * vec4(particle.position_life.xyz, 1.0);
+    gl_Position.xy += corner * camera.billboard_size;
+
+    float age = 1.0 - particle.position_life.w / particle.velocity_lifetime.w;
+
+    frag_corner = corner;
+    frag_color = vec4(mix(YOUNG_COLOR, OLD_COLOR, age), 0.6 * (1.0 - age));
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 460
+
+// frag_colors is the output vector that
+// will be colored in shader.frag
+layout(location = 0) out vec3 frag_colors;
+
+// Same per-draw data as shader.vert, read from a uniform buffer
+// at a dynamic offset instead of push constants (vk_draw::write_per_draw).
+// Only used to compare both paths (--benchmark-draws).
+// The "_dynamic" suffix makes the reflection use UNIFORM_BUFFER_DYNAMIC.
+layout(set = 0, binding = 0) uniform PerDraw {
+    mat4 transform;
+    uint object_index;
+    uint material_id;
+    uint noise_octaves;
+} per_draw_dynamic;
+
+// The vector that stores the vertex positions (x,y)
+// that forms the triangle.
+vec2 positions[3] = vec2[](
+    vec2(0.0, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+// The vector that stores the vertex colors (RGB).
+vec3 colors[3] = vec3[](
+    vec3(1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0)
+);
+
+// Main function is invoked for every vertex.
+// gl_VertexIndex contains the index of the current vertex (index of the vector positions).
+// gl_Position is the output vector.
+void main() {
+
+    // gl_Position is the positions (x,y) with the (z,w) coordinates added,
+    // placed by the transform of the draw.
+    gl_Position = per_draw_dynamic.transform * vec4(positions[gl_VertexIndex], 0.0, 1.0);
+
+    // colors every index of frag_colors which is passed to
+    // shader.frag
+    frag_colors = colors[gl_VertexIndex];
+}
\ No newline at end of file
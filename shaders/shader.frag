@@ -13,6 +13,58 @@ layout(location = 0) in vec3 frag_colors;
 // specifically to the framebuffer of index 0.
 layout(location = 0) out vec4 output_color;
 
+// Specialization constants are fixed when the pipeline is created
+// (vk_variant::Specialization), the driver then compiles the variant
+// with the branches and the loop bounds already resolved.
+layout(constant_id = 0) const uint SHADING_MODEL = 0; // 0: gradient, 1: gradient * procedural noise
+layout(constant_id = 1) const uint NOISE_OCTAVES = 4;
+layout(constant_id = 2) const bool UBER_SHADER = false; // read the values below at runtime instead
+
+// Per-draw data pushed with every draw (vk_draw::PerDraw), same block as in shader.vert.
+// The uber shader reads its shading model (material_id) and octaves from it.
+// Compiled with PER_DRAW_UBO for the per_draw_ubo.vert pipeline of --benchmark-draws,
+// which pushes nothing: no push constants, always the specialized values.
+#ifndef PER_DRAW_UBO
+layout(push_constant) uniform PerDraw {
+    mat4 transform;
+    uint object_index;
+    uint material_id;
+    uint noise_octaves;
+} per_draw;
+#endif
+
+
+// Value noise: random values on the integer grid, smoothly interpolated
+float hash(vec2 p) {
+
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float value_noise(vec2 p) {
+
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+    vec2 u = f * f * (3.0 - 2.0 * f);
+
+    return mix(mix(hash(i), hash(i + vec2(1.0, 0.0)), u.x),
+               mix(hash(i + vec2(0.0, 1.0)), hash(i + vec2(1.0, 1.0)), u.x), u.y);
+}
+
+// Sum of octaves of noise, each with double the frequency and half the amplitude
+float fractal_noise(vec2 p, uint octaves) {
+
+    float value = 0.0;
+    float amplitude = 0.5;
+
+    for (uint i = 0; i < octaves; i++) {
+        value += amplitude * value_noise(p);
+        p *= 2.0;
+        amplitude *= 0.5;
+    }
+
+    return value;
+}
+
 
 // Main function is invoked for every fragment.
 void main() {
@@ -21,6 +73,20 @@ void main() {
     // (each pixel of the triangle) to be red -> (1,0,0,1) in RGBA.
     // output_color = vec4(1.0, 0.0, 0.0, 1.0);
 
-    // gradient triangle
-    output_color = vec4(frag_colors, 1.0);
+#ifdef PER_DRAW_UBO
+    uint shading_model = SHADING_MODEL;
+    uint noise_octaves = NOISE_OCTAVES;
+#else
+    uint shading_model = UBER_SHADER ? per_draw.material_id : SHADING_MODEL;
+    uint noise_octaves = UBER_SHADER ? per_draw.noise_octaves : NOISE_OCTAVES;
+#endif
+
+    if (shading_model == 1) {
+        // noisy gradient triangle
+        output_color = vec4(frag_colors * fractal_noise(gl_FragCoord.xy * 0.05, noise_octaves), 1.0);
+    }
+    else {
+        // gradient triangle
+        output_color = vec4(frag_colors, 1.0);
+    }
 }
\ No newline at end of file
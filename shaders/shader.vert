@@ -4,6 +4,15 @@
 // will be colored in shader.frag
 layout(location = 0) out vec3 frag_colors;
 
+// Per-draw data pushed with every draw (vk_draw::PerDraw),
+// the same block is declared in shader.frag
+layout(push_constant) uniform PerDraw {
+    mat4 transform;
+    uint object_index;
+    uint material_id;
+    uint noise_octaves;
+} per_draw;
+
 // The vector that stores the vertex positions (x,y)
 // that forms the triangle.
 vec2 positions[3] = vec2[](
@@ -19,13 +28,18 @@ vec3 colors[3] = vec3[](
     vec3(0.0, 0.0, 1.0)
 );
 
+// The depth pre-pass and the color pass run this shader in two pipelines:
+// the EQUAL depth test needs both to compute exactly the same position.
+invariant gl_Position;
+
 // Main function is invoked for every vertex.
 // gl_VertexIndex contains the index of the current vertex (index of the vector positions).
 // gl_Position is the output vector.
 void main() {
 
-    // gl_Position is the positions (x,y) with the (z,w) coordinates added.
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    // gl_Position is the positions (x,y) with the (z,w) coordinates added,
+    // placed by the transform of the draw.
+    gl_Position = per_draw.transform * vec4(positions[gl_VertexIndex], 0.0, 1.0);
 
     // colors every index of frag_colors which is passed to
     // shader.frag
@@ -0,0 +1,212 @@
+#include "vk_attachment.hpp"
+#include "vk_buffer.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <sstream>
+#include <iomanip>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_attachment {
+
+
+// The only usages allowed together with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+static const VkImageUsageFlags ATTACHMENT_USAGES =
+	VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+
+static double to_mib(VkDeviceSize bytes) {
+
+	return static_cast<double>(bytes) / 1024.0 / 1024.0;
+}
+
+
+bool supports_lazy_allocation(VkPhysicalDevice physical_device) {
+
+	return vk_buffer::has_memory_type(UINT32_MAX, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, physical_device);
+}
+
+
+VkImageUsageFlags transient_usage(VkImageUsageFlags usage) {
+
+	if (usage == 0 || (usage & ~ATTACHMENT_USAGES) != 0) {
+		return usage;
+	}
+
+	return usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+}
+
+
+VkMemoryPropertyFlags memory_properties(uint32_t type_bits, VkPhysicalDevice physical_device) {
+
+	if (vk_buffer::has_memory_type(type_bits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, physical_device)) {
+		return VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+
+	return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+
+VkSampleCountFlagBits clamp_sample_count(uint32_t requested_samples, VkPhysicalDevice physical_device) {
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	// The depth attachment has as many samples as the color one
+	VkSampleCountFlags supported = device_properties.limits.framebufferColorSampleCounts &
+		                           device_properties.limits.framebufferDepthSampleCounts;
+
+	// 1 sample is always supported
+	uint32_t samples = VK_SAMPLE_COUNT_64_BIT;
+	while (samples > VK_SAMPLE_COUNT_1_BIT && (samples > requested_samples || (supported & samples) == 0)) {
+		samples >>= 1;
+	}
+
+	return static_cast<VkSampleCountFlagBits>(samples);
+}
+
+
+VkFormat find_depth_format(VkPhysicalDevice physical_device) {
+
+	for (VkFormat format : { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }) {
+
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+
+		if (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+			return format;
+		}
+	}
+
+	std::cout << "\033[31;40m";
+	throw std::runtime_error("Failed to find a supported depth format! \033[0m \n");
+}
+
+
+VkImageAspectFlags depth_aspect(VkFormat depth_format) {
+
+	if (depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth_format == VK_FORMAT_D24_UNORM_S8_UINT ||
+		depth_format == VK_FORMAT_D16_UNORM_S8_UINT) {
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+
+VkAttachmentStoreOp store_op(const AttachmentDesc& desc) {
+
+	return desc.transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+}
+
+
+Attachment create_attachment(const AttachmentDesc& desc,
+	                         VkPhysicalDevice physical_device, VkDevice device,
+	                         vk_handle::DeletionQueue* deletion_queue) {
+
+	Attachment attachment;
+	attachment.desc = desc;
+
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.format = desc.format;
+	image_info.extent = { desc.extent.width, desc.extent.height, 1 };
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = 1;
+	image_info.samples = desc.samples;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.usage = desc.transient ? transient_usage(desc.usage) : desc.usage;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkImage image;
+	if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create attachment image " + desc.name + "! \033[0m \n");
+	}
+	attachment.image = vk_handle::Handle<VkImage>(image, device, deletion_queue);
+
+	// Only transient attachment images list the lazily allocated memory types
+	VkMemoryRequirements memory_requirements;
+	vkGetImageMemoryRequirements(device, image, &memory_requirements);
+
+	VkMemoryPropertyFlags properties = memory_properties(memory_requirements.memoryTypeBits, physical_device);
+
+	VkDeviceMemory memory = vk_buffer::allocate_memory(memory_requirements, properties, physical_device, device);
+	attachment.memory = vk_handle::Handle<VkDeviceMemory>(memory, device, deletion_queue);
+	attachment.size = memory_requirements.size;
+	attachment.lazily_allocated = (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+
+	vkBindImageMemory(device, image, memory, 0);
+
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = desc.format;
+	view_info.subresourceRange.aspectMask = desc.aspect;
+	view_info.subresourceRange.baseMipLevel = 0;
+	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = 1;
+
+	VkImageView image_view;
+	if (vkCreateImageView(device, &view_info, nullptr, &image_view) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create attachment image view " + desc.name + "! \033[0m \n");
+	}
+	attachment.image_view = vk_handle::Handle<VkImageView>(image_view, device, deletion_queue);
+
+	return attachment;
+}
+
+
+void report_attachments(const std::vector<Attachment>& attachments,
+	                    VkPhysicalDevice physical_device, VkDevice device) {
+
+	LOG_MESSAGE(std::string("Lazily allocated memory: ") +
+		        (supports_lazy_allocation(physical_device) ? "available" : "not available, transient attachments use device local memory"),
+		        Color::Bright_White, Color::Black, 4);
+
+	VkDeviceSize total_bytes = 0;
+	VkDeviceSize saved_bytes = 0;
+
+	for (const Attachment& attachment : attachments) {
+
+		// What the driver actually backed the lazily allocated memory with so far
+		VkDeviceSize committed_bytes = attachment.size;
+		if (attachment.lazily_allocated) {
+			vkGetDeviceMemoryCommitment(device, attachment.memory, &committed_bytes);
+		}
+
+		total_bytes += attachment.size;
+		saved_bytes += attachment.size - committed_bytes;
+
+		std::ostringstream attachment_log;
+		attachment_log << std::fixed << std::setprecision(2)
+			<< attachment.desc.name << ": " << to_mib(attachment.size) << " MiB"
+			<< (attachment.desc.transient ? ", transient" : "")
+			<< (attachment.lazily_allocated ? ", lazily allocated (" + std::to_string(committed_bytes) + " bytes committed)" : "");
+
+		LOG_MESSAGE(attachment_log.str(), Color::Bright_White, Color::Black, 8);
+	}
+
+	if (attachments.empty()) {
+		return;
+	}
+
+	std::ostringstream total_log;
+	total_log << std::fixed << std::setprecision(2)
+		<< "Attachments: " << to_mib(total_bytes) << " MiB, "
+		<< to_mib(saved_bytes) << " MiB saved by lazy allocation";
+
+	LOG_MESSAGE(total_log.str(), Color::Bright_Green, Color::Black, 4);
+}
+
+
+} // namespace vk_attachment
\ No newline at end of file
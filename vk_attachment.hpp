@@ -0,0 +1,94 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_handle.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace vk_attachment {
+
+
+// An image rendered to alongside the swapchain image (e.g. depth, multisampled color)
+struct AttachmentDesc {
+
+	std::string name;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+	// The contents are only needed inside the render pass: depth, or multisampled color
+	// resolved at the end of the subpass. They are never written back to memory.
+	bool transient = true;
+};
+
+
+struct Attachment {
+
+	AttachmentDesc desc;
+
+	vk_handle::Handle<VkImage> image;
+	vk_handle::Handle<VkDeviceMemory> memory;
+	vk_handle::Handle<VkImageView> image_view;
+
+	VkDeviceSize size = 0;         // of the memory allocation
+	bool lazily_allocated = false; // only backed by memory if the GPU ever needs to spill the tile
+};
+
+
+// True if the device has a lazily allocated memory type (tile based GPUs).
+// Desktop GPUs have none: transient attachments then use device local memory.
+bool supports_lazy_allocation(VkPhysicalDevice physical_device);
+
+
+// Usage with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT added if the image can have it:
+// only attachment usages are allowed together with it
+VkImageUsageFlags transient_usage(VkImageUsageFlags usage);
+
+
+// Memory properties for an image of the given memoryTypeBits:
+// lazily allocated if it allows it (only transient attachments do), device local otherwise
+VkMemoryPropertyFlags memory_properties(uint32_t type_bits, VkPhysicalDevice physical_device);
+
+
+// Highest sample count the device supports for color and depth attachments
+// (framebufferColorSampleCounts, framebufferDepthSampleCounts) that is not above the requested one
+VkSampleCountFlagBits clamp_sample_count(uint32_t requested_samples, VkPhysicalDevice physical_device);
+
+
+// First depth format the device can use as an optimal tiling depth attachment,
+// depth only formats first (a stencil aspect makes every barrier cover it too)
+VkFormat find_depth_format(VkPhysicalDevice physical_device);
+
+
+// Aspects of the depth attachment views and barriers: depth, plus stencil if the format has it
+VkImageAspectFlags depth_aspect(VkFormat depth_format);
+
+
+// DONT_CARE for transient attachments: the tile is never written back to memory
+VkAttachmentStoreOp store_op(const AttachmentDesc& desc);
+
+
+/*
+Create an attachment image, its memory and its view.
+Transient attachments get VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT and are bound to
+lazily allocated memory when the device has it: on tilers they then live in tile memory
+only, and take neither memory nor bandwidth. The objects are released through the
+deletion queue with the attachment.
+*/
+Attachment create_attachment(
+	const AttachmentDesc& desc,
+	VkPhysicalDevice physical_device, VkDevice device,
+	vk_handle::DeletionQueue* deletion_queue);
+
+
+// Log the attachments, and the memory the lazily allocated ones do not commit
+void report_attachments(
+	const std::vector<Attachment>& attachments,
+	VkPhysicalDevice physical_device, VkDevice device);
+
+
+} // namespace vk_attachment
\ No newline at end of file
@@ -0,0 +1,490 @@
+#include "vk_barrier.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <algorithm>	// sort(), min()
+#include <tuple>		// tie(), make_tuple()
+#include <cstdint>	// uintptr_t
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_barrier {
+
+
+static const VkAccessFlags2 WRITE_ACCESSES =
+	VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT |
+	VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+// End of a buffer range that goes to the end of the buffer
+static const VkDeviceSize WHOLE_BUFFER_END = UINT64_MAX;
+
+
+bool is_write(VkAccessFlags2 access) {
+
+	return (access & WRITE_ACCESSES) != 0;
+}
+
+
+bool is_read(VkAccessFlags2 access) {
+
+	return (access & ~WRITE_ACCESSES) != 0;
+}
+
+
+static void throw_untracked(const std::string& kind) {
+
+	std::cout << "\033[31;40m";
+	throw std::runtime_error("The " + kind + " is not tracked by the barrier state tracker! \033[0m \n");
+}
+
+
+void StateTracker::add_image(VkImage image, VkImageAspectFlags aspect,
+	                         uint32_t mip_levels, uint32_t array_layers,
+	                         const Access& initial) {
+
+	State state;
+	state.layout = initial.layout;
+	state.write_stage = initial.stage;
+	state.write_access = initial.access;
+
+	ImageState image_state;
+	image_state.aspect = aspect;
+	image_state.mip_levels = mip_levels;
+	image_state.array_layers = array_layers;
+	image_state.subresources.assign(static_cast<size_t>(mip_levels) * array_layers, state);
+
+	images[image] = std::move(image_state);
+}
+
+
+void StateTracker::add_buffer(VkBuffer buffer, VkDeviceSize size, const Access& initial) {
+
+	BufferRange range;
+	range.offset = 0;
+	range.end = (size == VK_WHOLE_SIZE) ? WHOLE_BUFFER_END : size;
+	range.state.write_stage = initial.stage;
+	range.state.write_access = initial.access;
+
+	buffers[buffer] = { range };
+}
+
+
+// Every stage that used the resource since its last write, and that write
+static void add_last_uses(Access& last_uses, VkPipelineStageFlags2 write_stage, VkAccessFlags2 write_access,
+	                      VkPipelineStageFlags2 read_stages) {
+
+	last_uses.stage |= write_stage | read_stages;
+	last_uses.access |= write_access;
+}
+
+
+Access StateTracker::remove_image(VkImage image) {
+
+	auto it = images.find(image);
+	if (it == images.end()) {
+		throw_untracked("image");
+	}
+
+	Access last_uses;
+	last_uses.layout = it->second.subresources[0].layout;
+
+	for (const State& state : it->second.subresources) {
+		add_last_uses(last_uses, state.write_stage, state.write_access, state.read_stages);
+	}
+
+	images.erase(it);
+	return last_uses;
+}
+
+
+Access StateTracker::remove_buffer(VkBuffer buffer) {
+
+	auto it = buffers.find(buffer);
+	if (it == buffers.end()) {
+		throw_untracked("buffer");
+	}
+
+	Access last_uses;
+	for (const BufferRange& range : it->second) {
+		add_last_uses(last_uses, range.state.write_stage, range.state.write_access, range.state.read_stages);
+	}
+
+	buffers.erase(it);
+	return last_uses;
+}
+
+
+bool StateTracker::tracks_image(VkImage image) const {
+
+	return images.count(image) > 0;
+}
+
+
+bool StateTracker::transition(State& state, const Access& access, bool is_image,
+	                          VkPipelineStageFlags2& src_stage, VkAccessFlags2& src_access, VkImageLayout& old_layout) {
+
+	bool write = is_write(access.access);
+	bool layout_change = is_image && access.layout != state.layout;
+	bool visible = state.write_stage == VK_PIPELINE_STAGE_2_NONE ||
+		           (state.visible_stages & access.stage) == access.stage;
+
+	// Read after read in the same layout, or a read that already sees the last write
+	if (!write && !layout_change && visible) {
+		state.read_stages |= access.stage;
+		return false;
+	}
+
+	// Read after write: wait for the write. Write after read (or a layout change): also for the reads.
+	src_stage = state.write_stage;
+	if (write || layout_change) {
+		src_stage |= state.read_stages;
+	}
+	src_access = state.write_access;
+	old_layout = state.layout;
+
+	if (write || layout_change) {
+		// A layout transition is a write that completes before the destination stages
+		state.write_stage = access.stage;
+		state.write_access = write ? access.access : VK_ACCESS_2_NONE;
+		state.read_stages = (!write && is_read(access.access)) ? access.stage : VK_PIPELINE_STAGE_2_NONE;
+		state.visible_stages = write ? VK_PIPELINE_STAGE_2_NONE : access.stage;
+	}
+	else {
+		state.read_stages |= access.stage;
+		state.visible_stages |= access.stage;
+	}
+
+	if (is_image) {
+		state.layout = access.layout;
+	}
+
+	// First use of a resource nothing used before (e.g. a new buffer): nothing to wait for
+	return layout_change || src_stage != VK_PIPELINE_STAGE_2_NONE;
+}
+
+
+void StateTracker::merge_pending(State& state, const Access& access, bool is_image,
+	                             VkPipelineStageFlags2& dst_stage, VkAccessFlags2& dst_access, VkImageLayout new_layout) {
+
+	if (is_image && access.layout != new_layout) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("An image subresource is used in two layouts before the same barrier flush! \033[0m \n");
+	}
+
+	dst_stage |= access.stage;
+	dst_access |= access.access;
+
+	// The uses run together after the flush: the next use waits for all of them
+	if (is_write(access.access)) {
+		state.write_stage |= access.stage;
+		state.write_access |= access.access;
+		state.visible_stages = VK_PIPELINE_STAGE_2_NONE;
+	}
+	if (is_read(access.access)) {
+		state.read_stages |= access.stage;
+	}
+}
+
+
+void StateTracker::use_image(VkImage image, const Access& access,
+	                         uint32_t base_level, uint32_t level_count,
+	                         uint32_t base_layer, uint32_t layer_count) {
+
+	auto it = images.find(image);
+	if (it == images.end()) {
+		throw_untracked("image");
+	}
+
+	ImageState& image_state = it->second;
+	uint32_t end_level = (level_count == VK_REMAINING_MIP_LEVELS) ? image_state.mip_levels :
+		                 std::min(base_level + level_count, image_state.mip_levels);
+	uint32_t end_layer = (layer_count == VK_REMAINING_ARRAY_LAYERS) ? image_state.array_layers :
+		                 std::min(base_layer + layer_count, image_state.array_layers);
+
+	barrier_stats.request_count++;
+	bool needed = false;
+
+	for (uint32_t level = base_level; level < end_level; level++) {
+		for (uint32_t layer = base_layer; layer < end_layer; layer++) {
+
+			State& state = image_state.subresources[static_cast<size_t>(level) * image_state.array_layers + layer];
+
+			if (state.pending >= 0) {
+				VkImageMemoryBarrier2& pending = pending_image_barriers[state.pending];
+				merge_pending(state, access, true, pending.dstStageMask, pending.dstAccessMask, pending.newLayout);
+				needed = true;
+				continue;
+			}
+
+			VkImageMemoryBarrier2 barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+
+			if (!transition(state, access, true, barrier.srcStageMask, barrier.srcAccessMask, barrier.oldLayout)) {
+				continue;
+			}
+
+			barrier.dstStageMask = access.stage;
+			barrier.dstAccessMask = access.access;
+			barrier.newLayout = access.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image;
+			barrier.subresourceRange.aspectMask = image_state.aspect;
+			barrier.subresourceRange.baseMipLevel = level;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = layer;
+			barrier.subresourceRange.layerCount = 1;
+
+			state.pending = static_cast<int32_t>(pending_image_barriers.size());
+			pending_image_barriers.push_back(barrier);
+			needed = true;
+		}
+	}
+
+	if (!needed) {
+		barrier_stats.redundant_count++;
+	}
+}
+
+
+void StateTracker::use_buffer(VkBuffer buffer, const Access& access, VkDeviceSize offset, VkDeviceSize size) {
+
+	auto it = buffers.find(buffer);
+	if (it == buffers.end()) {
+		throw_untracked("buffer");
+	}
+
+	std::vector<BufferRange>& ranges = it->second;
+	VkDeviceSize end = (size == VK_WHOLE_SIZE) ? WHOLE_BUFFER_END : offset + size;
+
+	// Split the ranges at the bounds of the access, so that it covers whole ranges
+	for (VkDeviceSize bound : { offset, end }) {
+		for (size_t r = 0; r < ranges.size(); r++) {
+			if (ranges[r].offset < bound && bound < ranges[r].end) {
+				BufferRange upper = ranges[r];
+				upper.offset = bound;
+				ranges[r].end = bound;
+				ranges.insert(ranges.begin() + r + 1, upper);
+				break;
+			}
+		}
+	}
+
+	barrier_stats.request_count++;
+	bool needed = false;
+
+	for (BufferRange& range : ranges) {
+
+		if (range.offset < offset || range.offset >= end) {
+			continue;
+		}
+
+		State& state = range.state;
+
+		if (state.pending >= 0) {
+			VkBufferMemoryBarrier2& pending = pending_buffer_barriers[state.pending];
+			merge_pending(state, access, false, pending.dstStageMask, pending.dstAccessMask, VK_IMAGE_LAYOUT_UNDEFINED);
+			needed = true;
+			continue;
+		}
+
+		VkBufferMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+
+		VkImageLayout unused_layout;
+		if (!transition(state, access, false, barrier.srcStageMask, barrier.srcAccessMask, unused_layout)) {
+			continue;
+		}
+
+		barrier.dstStageMask = access.stage;
+		barrier.dstAccessMask = access.access;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = range.offset;
+		barrier.size = (range.end == WHOLE_BUFFER_END) ? VK_WHOLE_SIZE : range.end - range.offset;
+
+		state.pending = static_cast<int32_t>(pending_buffer_barriers.size());
+		pending_buffer_barriers.push_back(barrier);
+		needed = true;
+	}
+
+	if (!needed) {
+		barrier_stats.redundant_count++;
+	}
+}
+
+
+void StateTracker::coalesce() {
+
+	// The queued barriers are about to be recorded: the next uses start new ones
+	for (const VkImageMemoryBarrier2& barrier : pending_image_barriers) {
+		auto it = images.find(barrier.image);
+		if (it != images.end()) {
+			size_t index = static_cast<size_t>(barrier.subresourceRange.baseMipLevel) * it->second.array_layers +
+				           barrier.subresourceRange.baseArrayLayer;
+			it->second.subresources[index].pending = -1;
+		}
+	}
+	for (const VkBufferMemoryBarrier2& barrier : pending_buffer_barriers) {
+		auto it = buffers.find(barrier.buffer);
+		if (it != buffers.end()) {
+			for (BufferRange& range : it->second) {
+				range.state.pending = -1;
+			}
+		}
+	}
+
+	size_t queued = pending_image_barriers.size() + pending_buffer_barriers.size();
+
+	// Same image and same synchronization, differing only by the subresources
+	auto same_sync = [](const VkImageMemoryBarrier2& a, const VkImageMemoryBarrier2& b) {
+		return a.image == b.image && a.oldLayout == b.oldLayout && a.newLayout == b.newLayout &&
+			   a.srcStageMask == b.srcStageMask && a.srcAccessMask == b.srcAccessMask &&
+			   a.dstStageMask == b.dstStageMask && a.dstAccessMask == b.dstAccessMask;
+	};
+	auto sync_key = [](const VkImageMemoryBarrier2& b) {
+		return std::make_tuple(reinterpret_cast<uintptr_t>(b.image), b.oldLayout, b.newLayout,
+			                   b.srcStageMask, b.srcAccessMask, b.dstStageMask, b.dstAccessMask);
+	};
+
+	// Neighbouring levels of a layer, then neighbouring layers of the same levels
+	for (bool levels : { true, false }) {
+
+		std::sort(pending_image_barriers.begin(), pending_image_barriers.end(),
+			[&](const VkImageMemoryBarrier2& a, const VkImageMemoryBarrier2& b) {
+				const VkImageSubresourceRange& ra = a.subresourceRange;
+				const VkImageSubresourceRange& rb = b.subresourceRange;
+				if (sync_key(a) != sync_key(b)) {
+					return sync_key(a) < sync_key(b);
+				}
+				return levels ? std::tie(ra.baseArrayLayer, ra.layerCount, ra.baseMipLevel) <
+					            std::tie(rb.baseArrayLayer, rb.layerCount, rb.baseMipLevel)
+					          : std::tie(ra.baseMipLevel, ra.levelCount, ra.baseArrayLayer) <
+					            std::tie(rb.baseMipLevel, rb.levelCount, rb.baseArrayLayer);
+			});
+
+		std::vector<VkImageMemoryBarrier2> merged;
+		for (const VkImageMemoryBarrier2& barrier : pending_image_barriers) {
+
+			if (!merged.empty() && same_sync(merged.back(), barrier)) {
+
+				VkImageSubresourceRange& last = merged.back().subresourceRange;
+				const VkImageSubresourceRange& next = barrier.subresourceRange;
+
+				if (levels && last.baseArrayLayer == next.baseArrayLayer && last.layerCount == next.layerCount &&
+					last.baseMipLevel + last.levelCount == next.baseMipLevel) {
+					last.levelCount += next.levelCount;
+					continue;
+				}
+				if (!levels && last.baseMipLevel == next.baseMipLevel && last.levelCount == next.levelCount &&
+					last.baseArrayLayer + last.layerCount == next.baseArrayLayer) {
+					last.layerCount += next.layerCount;
+					continue;
+				}
+			}
+
+			merged.push_back(barrier);
+		}
+		pending_image_barriers = std::move(merged);
+	}
+
+	// Neighbouring ranges of a buffer
+	std::sort(pending_buffer_barriers.begin(), pending_buffer_barriers.end(),
+		[](const VkBufferMemoryBarrier2& a, const VkBufferMemoryBarrier2& b) {
+			return std::make_tuple(reinterpret_cast<uintptr_t>(a.buffer), a.srcStageMask, a.srcAccessMask,
+				                   a.dstStageMask, a.dstAccessMask, a.offset) <
+				   std::make_tuple(reinterpret_cast<uintptr_t>(b.buffer), b.srcStageMask, b.srcAccessMask,
+					               b.dstStageMask, b.dstAccessMask, b.offset);
+		});
+
+	std::vector<VkBufferMemoryBarrier2> merged_buffers;
+	for (const VkBufferMemoryBarrier2& barrier : pending_buffer_barriers) {
+
+		if (!merged_buffers.empty()) {
+
+			VkBufferMemoryBarrier2& last = merged_buffers.back();
+
+			if (last.buffer == barrier.buffer && last.size != VK_WHOLE_SIZE && last.offset + last.size == barrier.offset &&
+				last.srcStageMask == barrier.srcStageMask && last.srcAccessMask == barrier.srcAccessMask &&
+				last.dstStageMask == barrier.dstStageMask && last.dstAccessMask == barrier.dstAccessMask) {
+				last.size = (barrier.size == VK_WHOLE_SIZE) ? VK_WHOLE_SIZE : last.size + barrier.size;
+				continue;
+			}
+		}
+
+		merged_buffers.push_back(barrier);
+	}
+	pending_buffer_barriers = std::move(merged_buffers);
+
+	barrier_stats.merged_count += static_cast<uint32_t>(queued - pending_image_barriers.size() - pending_buffer_barriers.size());
+}
+
+
+void StateTracker::flush(VkCommandBuffer command_buffer) {
+
+	std::vector<VkImageMemoryBarrier2> image_barriers;
+	std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+	take(image_barriers, buffer_barriers);
+
+	if (image_barriers.empty() && buffer_barriers.empty()) {
+		return;
+	}
+
+	VkDependencyInfo dependency_info{};
+	dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+	dependency_info.pImageMemoryBarriers = image_barriers.data();
+	dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+	dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+
+	vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+
+void StateTracker::take(std::vector<VkImageMemoryBarrier2>& image_barriers,
+	                    std::vector<VkBufferMemoryBarrier2>& buffer_barriers) {
+
+	if (pending_image_barriers.empty() && pending_buffer_barriers.empty()) {
+		return;
+	}
+
+	coalesce();
+
+	barrier_stats.flush_count++;
+	barrier_stats.image_barrier_count += static_cast<uint32_t>(pending_image_barriers.size());
+	barrier_stats.buffer_barrier_count += static_cast<uint32_t>(pending_buffer_barriers.size());
+
+	image_barriers.insert(image_barriers.end(), pending_image_barriers.begin(), pending_image_barriers.end());
+	buffer_barriers.insert(buffer_barriers.end(), pending_buffer_barriers.begin(), pending_buffer_barriers.end());
+
+	pending_image_barriers.clear();
+	pending_buffer_barriers.clear();
+}
+
+
+VkImageLayout StateTracker::layout(VkImage image, uint32_t level, uint32_t layer) const {
+
+	auto it = images.find(image);
+	if (it == images.end()) {
+		throw_untracked("image");
+	}
+
+	return it->second.subresources.at(static_cast<size_t>(level) * it->second.array_layers + layer).layout;
+}
+
+
+void StateTracker::clear() {
+
+	images.clear();
+	buffers.clear();
+	pending_image_barriers.clear();
+	pending_buffer_barriers.clear();
+}
+
+
+} // namespace vk_barrier
\ No newline at end of file
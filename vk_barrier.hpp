@@ -0,0 +1,190 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <vector>
+#include <unordered_map>
+
+
+namespace vk_barrier {
+
+
+// How a command uses a resource: the stages and accesses to synchronize with,
+// and for images the layout the command needs
+struct Access {
+
+	VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// A swapchain image right after vkAcquireNextImageKHR(): the acquire semaphore is waited on at
+// the color attachment output stage, and the previous contents are not needed
+const Access SWAPCHAIN_ACQUIRED = { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED };
+
+// Ready for vkQueuePresentKHR(), which is synchronized by the render finished semaphore
+const Access PRESENT = { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+
+const Access COLOR_ATTACHMENT_WRITE = { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+// The depth layouts cover the stencil aspect too, so they work with every depth format
+// without separateDepthStencilLayouts
+const Access DEPTH_ATTACHMENT_WRITE = {
+	VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+	VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+// Depth test without depth writes, e.g. the EQUAL test after a depth pre-pass
+const Access DEPTH_ATTACHMENT_READ = {
+	VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+	VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+	VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+const Access FRAGMENT_SAMPLED_READ = { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+const Access COMPUTE_SAMPLED_READ = { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+const Access COMPUTE_STORAGE_READ = { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const Access COMPUTE_STORAGE_WRITE = { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const Access TRANSFER_READ = { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+const Access TRANSFER_WRITE = { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+
+
+// True if the accesses include a write
+bool is_write(VkAccessFlags2 access);
+
+// True if the accesses include a read
+bool is_read(VkAccessFlags2 access);
+
+
+// What the barriers of a tracker cost, since its creation or reset_stats()
+struct BarrierStats {
+
+	uint32_t request_count = 0;        // use_image() and use_buffer() calls
+	uint32_t redundant_count = 0;      // requests that needed no barrier
+	uint32_t flush_count = 0;          // vkCmdPipelineBarrier2() calls (or take() with barriers)
+	uint32_t image_barrier_count = 0;  // recorded, after merging
+	uint32_t buffer_barrier_count = 0;
+	uint32_t merged_count = 0;         // barriers of subresources or ranges merged into a neighbour
+};
+
+
+/*
+State of the images and buffers a command buffer uses: the layout of each image subresource
+(mip level and array layer) and, for each subresource or buffer range, the last write and the
+stages that read it since. Commands declare their accesses with use_image() and use_buffer()
+before they are recorded; the barriers they need are queued, and flush() records all of them
+in a single vkCmdPipelineBarrier2():
+- an access that needs nothing is dropped: a read of a subresource in the right layout that already
+  sees the last write (read after read, or another read of the stages a barrier already waited for),
+- subresources used twice before the same flush are used by the same commands: their barriers
+  are merged (they must then ask for the same layout),
+- barriers of neighbouring levels, layers or buffer ranges with the same stages, accesses and
+  layouts are merged into one at the flush.
+A tracker follows one command buffer, or the queue order of the command buffers it records,
+from the states given to add_image() and add_buffer(). Not thread safe.
+*/
+class StateTracker {
+
+public:
+
+	StateTracker() = default;
+
+	StateTracker(const StateTracker&) = delete;
+	StateTracker& operator=(const StateTracker&) = delete;
+
+	// Track an image whose subresources are all in the initial state:
+	// its layout, and the last write (stage and access) the first use must wait for
+	void add_image(
+		VkImage image, VkImageAspectFlags aspect,
+		uint32_t mip_levels, uint32_t array_layers,
+		const Access& initial);
+
+	// Track a buffer of size bytes (VK_WHOLE_SIZE if unknown)
+	void add_buffer(VkBuffer buffer, VkDeviceSize size, const Access& initial);
+
+	// Stop tracking a resource. Returns every stage that used it since its last write
+	// (and that write): what must be waited for before its memory is reused.
+	// The layout is that of its first subresource.
+	Access remove_image(VkImage image);
+	Access remove_buffer(VkBuffer buffer);
+
+	bool tracks_image(VkImage image) const;
+
+	// The commands recorded after the next flush use the subresources with access.
+	// Ranges are clamped to the image (VK_REMAINING_MIP_LEVELS, VK_REMAINING_ARRAY_LAYERS work).
+	void use_image(
+		VkImage image, const Access& access,
+		uint32_t base_level = 0, uint32_t level_count = VK_REMAINING_MIP_LEVELS,
+		uint32_t base_layer = 0, uint32_t layer_count = VK_REMAINING_ARRAY_LAYERS);
+
+	void use_buffer(
+		VkBuffer buffer, const Access& access,
+		VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+	// Record the queued barriers in a single vkCmdPipelineBarrier2(), nothing if none is queued
+	void flush(VkCommandBuffer command_buffer);
+
+	// Take the queued barriers instead of recording them, e.g. to record them later
+	// (a flush point computed ahead of recording). Appended to the vectors.
+	void take(
+		std::vector<VkImageMemoryBarrier2>& image_barriers,
+		std::vector<VkBufferMemoryBarrier2>& buffer_barriers);
+
+	// Current layout of a subresource, counting the queued barriers
+	VkImageLayout layout(VkImage image, uint32_t level = 0, uint32_t layer = 0) const;
+
+	// Forget every resource and queued barrier (the stats are kept)
+	void clear();
+
+	const BarrierStats& stats() const { return barrier_stats; }
+	void reset_stats() { barrier_stats = BarrierStats{}; }
+
+private:
+
+	// What must be waited on before the next use of a subresource or range
+	struct State {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 write_stage = VK_PIPELINE_STAGE_2_NONE;    // last write or layout transition
+		VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+		VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;    // reads since then
+		VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE; // stages that already see the last write
+		int32_t pending = -1; // queued barrier, until the flush
+	};
+
+	struct ImageState {
+		VkImageAspectFlags aspect;
+		uint32_t mip_levels;
+		uint32_t array_layers;
+		std::vector<State> subresources; // level * array_layers + layer
+	};
+
+	// [offset, end) of a buffer, the ranges of a buffer cover it in order
+	struct BufferRange {
+		VkDeviceSize offset;
+		VkDeviceSize end; // UINT64_MAX: to the end of the buffer
+		State state;
+	};
+
+	std::unordered_map<VkImage, ImageState> images;
+	std::unordered_map<VkBuffer, std::vector<BufferRange>> buffers;
+
+	// One per subresource or range until the flush
+	std::vector<VkImageMemoryBarrier2> pending_image_barriers;
+	std::vector<VkBufferMemoryBarrier2> pending_buffer_barriers;
+
+	BarrierStats barrier_stats;
+
+	// Update the state for an access, and fill barrier (stages, accesses and layouts) if one is needed.
+	// Returns false if the access needs no barrier.
+	static bool transition(State& state, const Access& access, bool is_image,
+		                   VkPipelineStageFlags2& src_stage, VkAccessFlags2& src_access, VkImageLayout& old_layout);
+
+	// Merge an access into the queued barrier of a subresource used twice before the same flush
+	static void merge_pending(State& state, const Access& access, bool is_image,
+		                      VkPipelineStageFlags2& dst_stage, VkAccessFlags2& dst_access, VkImageLayout new_layout);
+
+	// Merge the pending barriers of neighbouring subresources and ranges, and clear the pending marks
+	void coalesce();
+};
+
+
+} // namespace vk_barrier
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "vk_buffer.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <map>
+#include <mutex>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_buffer {
+
+
+// Live allocations, for the memory telemetry (allocations may come from any thread)
+struct Allocation {
+	uint32_t heap_index;
+	VkDeviceSize size;
+};
+
+static std::mutex allocations_mutex;
+static std::map<VkDeviceMemory, Allocation> allocations;
+
+
+uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties,
+	                      VkPhysicalDevice physical_device) {
+
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+		if ((type_bits & (1u << i)) &&
+			(memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	std::cout << "\033[31;40m";
+	throw std::runtime_error("Failed to find a suitable memory type! \033[0m \n");
+}
+
+
+bool has_memory_type(uint32_t type_bits, VkMemoryPropertyFlags properties,
+	                 VkPhysicalDevice physical_device) {
+
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+		if ((type_bits & (1u << i)) &&
+			(memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void create_buffer(VkBuffer& buffer, VkDeviceMemory& buffer_memory,
+	               VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+	               VkPhysicalDevice physical_device, VkDevice device) {
+
+	VkBufferCreateInfo buffer_info{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = size;
+	buffer_info.usage = usage;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &buffer_info, nullptr, &buffer) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Buffer! \033[0m \n");
+	}
+
+	VkMemoryRequirements memory_requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &memory_requirements);
+
+	try {
+		buffer_memory = allocate_memory(memory_requirements, properties, physical_device, device);
+	}
+	catch (const std::exception&) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		throw;
+	}
+
+	vkBindBufferMemory(device, buffer, buffer_memory, 0);
+}
+
+
+void destroy_buffer(VkBuffer buffer, VkDeviceMemory buffer_memory, VkDevice device) {
+
+	vkDestroyBuffer(device, buffer, nullptr);
+	free_memory(buffer_memory, device);
+}
+
+
+VkDeviceMemory allocate_memory(const VkMemoryRequirements& memory_requirements, VkMemoryPropertyFlags properties,
+	                           VkPhysicalDevice physical_device, VkDevice device) {
+
+	VkMemoryAllocateInfo allocate_info{};
+	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocate_info.allocationSize = memory_requirements.size;
+	allocate_info.memoryTypeIndex = find_memory_type(memory_requirements.memoryTypeBits, properties, physical_device);
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(device, &allocate_info, nullptr, &memory) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to allocate Vulkan memory! \033[0m \n");
+	}
+
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	std::lock_guard<std::mutex> lock(allocations_mutex);
+	allocations[memory] = { memory_properties.memoryTypes[allocate_info.memoryTypeIndex].heapIndex, allocate_info.allocationSize };
+
+	return memory;
+}
+
+
+void free_memory(VkDeviceMemory memory, VkDevice device) {
+
+	vkFreeMemory(device, memory, nullptr);
+
+	std::lock_guard<std::mutex> lock(allocations_mutex);
+	allocations.erase(memory);
+}
+
+
+AllocationStats get_allocation_stats() {
+
+	std::lock_guard<std::mutex> lock(allocations_mutex);
+
+	AllocationStats stats;
+	stats.heap_bytes.resize(VK_MAX_MEMORY_HEAPS, 0);
+	stats.allocation_count = static_cast<uint32_t>(allocations.size());
+
+	for (const auto& [memory, allocation] : allocations) {
+		stats.heap_bytes[allocation.heap_index] += allocation.size;
+	}
+
+	return stats;
+}
+
+
+VkDeviceSize align_size(VkDeviceSize size, VkDeviceSize alignment) {
+
+	if (alignment == 0) {
+		return size;
+	}
+
+	return (size + alignment - 1) & ~(alignment - 1);
+}
+
+
+} // namespace vk_buffer
\ No newline at end of file
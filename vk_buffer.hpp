@@ -0,0 +1,60 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <vector>
+
+
+namespace vk_buffer {
+
+
+// Index of a memory type allowed by type_bits (VkMemoryRequirements::memoryTypeBits)
+// that has all the given properties
+uint32_t find_memory_type(
+	uint32_t type_bits, VkMemoryPropertyFlags properties,
+	VkPhysicalDevice physical_device);
+
+
+// True if find_memory_type() would find a memory type
+bool has_memory_type(
+	uint32_t type_bits, VkMemoryPropertyFlags properties,
+	VkPhysicalDevice physical_device);
+
+
+// Allocate device memory for the requirements of a resource.
+// Every allocation made here is counted in get_allocation_stats().
+VkDeviceMemory allocate_memory(
+	const VkMemoryRequirements& memory_requirements, VkMemoryPropertyFlags properties,
+	VkPhysicalDevice physical_device, VkDevice device);
+
+
+// Free memory from allocate_memory()
+void free_memory(VkDeviceMemory memory, VkDevice device);
+
+
+// Create a buffer with its own dedicated memory allocation
+void create_buffer(
+	VkBuffer& buffer, VkDeviceMemory& buffer_memory,
+	VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+	VkPhysicalDevice physical_device, VkDevice device);
+
+
+// Destroy a buffer from create_buffer() and free its memory
+void destroy_buffer(VkBuffer buffer, VkDeviceMemory buffer_memory, VkDevice device);
+
+
+// Memory currently allocated through allocate_memory()
+struct AllocationStats {
+
+	std::vector<VkDeviceSize> heap_bytes; // indexed by memory heap
+	uint32_t allocation_count = 0;
+};
+
+AllocationStats get_allocation_stats();
+
+
+// Round size up to a multiple of alignment (a power of two, e.g. minUniformBufferOffsetAlignment)
+VkDeviceSize align_size(VkDeviceSize size, VkDeviceSize alignment);
+
+
+} // namespace vk_buffer
\ No newline at end of file
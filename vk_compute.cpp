@@ -0,0 +1,600 @@
+#include "vk_compute.hpp"
+#include "vk_core.hpp"
+#include "vk_pipeline.hpp"
+#include "vk_buffer.hpp"
+#include "vk_query.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <cstring>		// memcpy()
+#include <algorithm>	// sort(), min()
+#include <array>
+#include <filesystem>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_compute {
+
+
+// Descriptor sets of a pool, and storage buffers they can hold
+static const uint32_t DESCRIPTOR_POOL_SETS = 256;
+static const uint32_t DESCRIPTOR_POOL_BUFFERS = 1024;
+
+// Every stage a command of the batch may read or write a buffer from
+static const VkPipelineStageFlags2 COMPUTE_STAGES = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+	                                                VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT;
+
+
+// A single global memory barrier: buffers only, so there is nothing to transition
+static void record_memory_barrier(VkCommandBuffer command_buffer,
+	                              VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access,
+	                              VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access) {
+
+	VkMemoryBarrier2 memory_barrier{};
+	memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	memory_barrier.srcStageMask = src_stages;
+	memory_barrier.srcAccessMask = src_access;
+	memory_barrier.dstStageMask = dst_stages;
+	memory_barrier.dstAccessMask = dst_access;
+
+	VkDependencyInfo dependency_info{};
+	dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency_info.memoryBarrierCount = 1;
+	dependency_info.pMemoryBarriers = &memory_barrier;
+
+	vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+
+HeadlessDevice::HeadlessDevice(const std::string& device_override, const std::string& probe_cache_file) {
+
+	vk_core::create_vk_instance(instance, true);
+
+	try {
+		vk_core::select_physical_device(physical_device, device_probe,
+			                            instance, VK_NULL_HANDLE,
+			                            device_override, probe_cache_file);
+
+		vk_core::create_compute_device(device, physical_device, device_probe, queue_family, queue);
+	}
+	catch (const std::exception&) {
+		vkDestroyInstance(instance, nullptr);
+		throw;
+	}
+}
+
+
+HeadlessDevice::~HeadlessDevice() {
+
+	if (device != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(device);
+		vkDestroyDevice(device, nullptr);
+	}
+
+	vkDestroyInstance(instance, nullptr);
+}
+
+
+ComputeContext::ComputeContext(VkPhysicalDevice physical_device, VkDevice device,
+	                           uint32_t queue_family, VkQueue queue,
+	                           VkPipelineCache pipeline_cache, vk_reflect::LayoutCache& layout_cache)
+	: physical_device(physical_device), device(device), queue(queue),
+	  pipeline_cache(pipeline_cache), layout_cache(layout_cache) {
+
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	// Reading back from uncached memory (e.g. resizable BAR on discrete GPUs) is very slow:
+	// only map the buffers when the device memory is cached for the host too
+	host_visible_buffers = vk_buffer::has_memory_type(UINT32_MAX,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, physical_device);
+
+	VkCommandPoolCreateInfo command_pool_info{};
+	command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	command_pool_info.queueFamilyIndex = queue_family;
+
+	VkCommandPool new_command_pool;
+	if (vkCreateCommandPool(device, &command_pool_info, nullptr, &new_command_pool) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Command pool! \033[0m \n");
+	}
+	command_pool = vk_handle::Handle<VkCommandPool>(new_command_pool, device, nullptr);
+
+	vk_pipeline::create_command_buffer(batch_command_buffer, command_pool, device);
+	command_buffer = batch_command_buffer;
+
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence new_fence;
+	if (vkCreateFence(device, &fence_info, nullptr, &new_fence) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Fence! \033[0m \n");
+	}
+	fence = vk_handle::Handle<VkFence>(new_fence, device, nullptr);
+
+	// Timestamps before and after the batch
+	uint32_t queue_families_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, queue_families.data());
+
+	timestamp_valid_bits = queue_families[queue_family].timestampValidBits;
+
+	if (timestamp_valid_bits > 0) {
+
+		VkQueryPoolCreateInfo query_pool_info{};
+		query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		query_pool_info.queryCount = 2;
+
+		VkQueryPool new_query_pool;
+		if (vkCreateQueryPool(device, &query_pool_info, nullptr, &new_query_pool) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to create Vulkan Query pool! \033[0m \n");
+		}
+		timestamp_query_pool = vk_handle::Handle<VkQueryPool>(new_query_pool, device, nullptr);
+	}
+	else {
+		LOG_MESSAGE("No timestamps on the compute queue, GPU times are not measured.", Color::Red, Color::Black, 4);
+	}
+
+	add_descriptor_pool();
+}
+
+
+ComputeContext::~ComputeContext() {
+
+	// Commands recorded but never submitted are dropped with the command pool
+	if (recording && !external) {
+		vkEndCommandBuffer(batch_command_buffer);
+	}
+}
+
+
+Kernel ComputeContext::create_kernel(const std::string& shader_file, const vk_variant::Specialization& specialization) {
+
+	Kernel kernel;
+	kernel.name = shader_file;
+	kernel.specialization = specialization;
+
+	vk_reflect::ShaderReflection reflection;
+
+	VkPipeline new_pipeline;
+	vk_pipeline::create_compute_pipeline(new_pipeline, kernel.pipeline_layout, reflection,
+		                                 shader_file, specialization,
+		                                 pipeline_cache, layout_cache, device);
+	kernel.pipeline = vk_handle::Handle<VkPipeline>(new_pipeline, device, nullptr);
+
+	for (const auto& binding : reflection.descriptor_bindings) {
+
+		if (binding.set != 0) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error(shader_file + ": kernels only use descriptor set 0 \033[0m \n");
+		}
+		if (binding.type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER && binding.type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error(shader_file + ": kernels only bind storage and uniform buffers \033[0m \n");
+		}
+
+		kernel.bindings.push_back(binding);
+	}
+
+	std::sort(kernel.bindings.begin(), kernel.bindings.end(),
+		      [](const vk_reflect::DescriptorBinding& a, const vk_reflect::DescriptorBinding& b) { return a.binding < b.binding; });
+
+	std::vector<VkDescriptorSetLayout> set_layouts = layout_cache.descriptor_set_layouts(kernel.pipeline_layout);
+	if (!set_layouts.empty()) {
+		kernel.set_layout = set_layouts[0];
+	}
+
+	for (const auto& range : reflection.push_constant_ranges) {
+		kernel.push_constant_size = std::max(kernel.push_constant_size, range.offset + range.size);
+	}
+
+	for (int i = 0; i < 3; i++) {
+		kernel.local_size[i] = reflection.local_size[i];
+	}
+
+	return kernel;
+}
+
+
+void ComputeContext::watch_kernel(vk_hot_reload::ShaderHotReload& hot_reload, Kernel& kernel) {
+
+	// The builder runs on the hot reload thread: capture copies, not members
+	std::string shader_file = kernel.name;
+	vk_variant::Specialization specialization = kernel.specialization;
+	VkPipelineLayout expected_pipeline_layout = kernel.pipeline_layout;
+	std::array<uint32_t, 3> expected_local_size = { kernel.local_size[0], kernel.local_size[1], kernel.local_size[2] };
+	VkPipelineCache current_pipeline_cache = pipeline_cache; // internally synchronized
+	vk_reflect::LayoutCache* current_layout_cache = &layout_cache; // thread safe
+	VkDevice current_device = device;
+
+	hot_reload.add_pipeline(kernel.pipeline, kernel.pipeline_layout,
+		{ std::filesystem::path(shader_file).filename().string() },
+		[=](VkPipeline& new_pipeline, VkPipelineLayout& new_pipeline_layout) {
+
+			vk_pipeline::rebuild_compute_pipeline(new_pipeline, new_pipeline_layout, shader_file, specialization,
+				                                  expected_pipeline_layout, expected_local_size.data(),
+				                                  current_pipeline_cache, *current_layout_cache, current_device);
+		});
+}
+
+
+Buffer ComputeContext::create_buffer(VkDeviceSize size, VkBufferUsageFlags extra_usage) {
+
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extra_usage;
+
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	if (host_visible_buffers) {
+		properties |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+
+	VkBuffer new_buffer;
+	VkDeviceMemory new_memory;
+	vk_buffer::create_buffer(new_buffer, new_memory, size, usage, properties, physical_device, device);
+
+	Buffer buffer;
+	buffer.memory = vk_handle::Handle<VkDeviceMemory>(new_memory, device, nullptr);
+	buffer.buffer = vk_handle::Handle<VkBuffer>(new_buffer, device, nullptr);
+	buffer.size = size;
+
+	if (host_visible_buffers && vkMapMemory(device, new_memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to map Vulkan Buffer memory! \033[0m \n");
+	}
+
+	return buffer;
+}
+
+
+Buffer ComputeContext::create_staging_buffer(VkDeviceSize size) {
+
+	VkBuffer new_buffer;
+	VkDeviceMemory new_memory;
+	vk_buffer::create_buffer(new_buffer, new_memory, size,
+		                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                     physical_device, device);
+
+	Buffer buffer;
+	buffer.memory = vk_handle::Handle<VkDeviceMemory>(new_memory, device, nullptr);
+	buffer.buffer = vk_handle::Handle<VkBuffer>(new_buffer, device, nullptr);
+	buffer.size = size;
+
+	if (vkMapMemory(device, new_memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to map Vulkan staging Buffer memory! \033[0m \n");
+	}
+
+	return buffer;
+}
+
+
+void ComputeContext::upload(Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset) {
+
+	// The kernels recorded so far may still read or write the buffer
+	submit();
+
+	if (buffer.mapped != nullptr) {
+		std::memcpy(static_cast<char*>(buffer.mapped) + offset, data, size);
+		return;
+	}
+
+	Buffer staging = create_staging_buffer(size);
+	std::memcpy(staging.mapped, data, size);
+
+	copy(staging, buffer, size, 0, offset);
+	submit();
+}
+
+
+void ComputeContext::download(const Buffer& buffer, void* data, VkDeviceSize size, VkDeviceSize offset) {
+
+	submit();
+
+	if (buffer.mapped != nullptr) {
+		std::memcpy(data, static_cast<const char*>(buffer.mapped) + offset, size);
+		return;
+	}
+
+	Buffer staging = create_staging_buffer(size);
+
+	copy(buffer, staging, size, offset, 0);
+	submit();
+
+	std::memcpy(data, staging.mapped, size);
+}
+
+
+void ComputeContext::begin_command() {
+
+	if (!recording) {
+
+		VkCommandBufferBeginInfo begin_info{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to begin recording Command buffer! \033[0m \n");
+		}
+
+		if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+			vkCmdResetQueryPool(command_buffer, timestamp_query_pool, 0, 2);
+			vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_query_pool, 0);
+		}
+
+		// The buffers may have been written by an external recording, submitted by its owner
+		record_memory_barrier(command_buffer,
+			                  VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+			                  COMPUTE_STAGES, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+
+		recording = true;
+		return;
+	}
+
+	// Each command reads what the previous ones wrote
+	record_memory_barrier(command_buffer,
+		                  COMPUTE_STAGES, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		                  COMPUTE_STAGES, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+		                                  VK_ACCESS_2_UNIFORM_READ_BIT |
+		                                  VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+}
+
+
+void ComputeContext::dispatch(const Kernel& kernel, const std::vector<const Buffer*>& buffers,
+	                          const void* push_constants, uint32_t push_constants_size,
+	                          uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) {
+
+	if (buffers.size() != kernel.bindings.size()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(kernel.name + " binds " + std::to_string(kernel.bindings.size()) + " buffers, " +
+			                     std::to_string(buffers.size()) + " given! \033[0m \n");
+	}
+	if (push_constants_size != kernel.push_constant_size) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(kernel.name + " takes " + std::to_string(kernel.push_constant_size) +
+			                     " bytes of push constants, " + std::to_string(push_constants_size) + " given! \033[0m \n");
+	}
+
+	begin_command();
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline);
+
+	if (!buffers.empty()) {
+
+		VkDescriptorSet descriptor_set = allocate_descriptor_set(kernel.set_layout);
+
+		std::vector<VkDescriptorBufferInfo> buffer_infos(buffers.size());
+		std::vector<VkWriteDescriptorSet> descriptor_writes(buffers.size());
+
+		for (size_t i = 0; i < buffers.size(); i++) {
+
+			buffer_infos[i].buffer = buffers[i]->buffer;
+			buffer_infos[i].offset = 0;
+			buffer_infos[i].range = VK_WHOLE_SIZE;
+
+			descriptor_writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptor_writes[i].dstSet = descriptor_set;
+			descriptor_writes[i].dstBinding = kernel.bindings[i].binding;
+			descriptor_writes[i].descriptorCount = 1;
+			descriptor_writes[i].descriptorType = kernel.bindings[i].type;
+			descriptor_writes[i].pBufferInfo = &buffer_infos[i];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel.pipeline_layout,
+			                    0, 1, &descriptor_set, 0, nullptr);
+	}
+
+	if (push_constants_size > 0) {
+		vkCmdPushConstants(command_buffer, kernel.pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+			               0, push_constants_size, push_constants);
+	}
+
+	vkCmdDispatch(command_buffer, group_count_x, group_count_y, group_count_z);
+	command_count++;
+}
+
+
+void ComputeContext::fill(Buffer& buffer, uint32_t value, VkDeviceSize size, VkDeviceSize offset) {
+
+	begin_command();
+
+	vkCmdFillBuffer(command_buffer, buffer.buffer, offset, size, value);
+	command_count++;
+}
+
+
+void ComputeContext::copy(const Buffer& source, Buffer& destination, VkDeviceSize size,
+	                      VkDeviceSize source_offset, VkDeviceSize destination_offset) {
+
+	begin_command();
+
+	VkBufferCopy region{};
+	region.srcOffset = source_offset;
+	region.dstOffset = destination_offset;
+	region.size = size;
+
+	vkCmdCopyBuffer(command_buffer, source.buffer, destination.buffer, 1, &region);
+	command_count++;
+}
+
+
+double ComputeContext::submit() {
+
+	if (external) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Can not submit a compute batch while recording into an external Command buffer! \033[0m \n");
+	}
+
+	if (!recording) {
+		return 0.0;
+	}
+
+	if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_query_pool, 1);
+	}
+
+	// Results of the batch visible to the host (mapped buffers)
+	record_memory_barrier(command_buffer,
+		                  COMPUTE_STAGES, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		                  VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+
+	recording = false;
+	command_count = 0;
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to record Command buffer! \033[0m \n");
+	}
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	if (vkQueueSubmit(queue, 1, &submit_info, fence) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to submit compute Command buffer! \033[0m \n");
+	}
+
+	vkWaitForFences(device, 1, fence.ptr(), VK_TRUE, UINT64_MAX);
+	vkResetFences(device, 1, fence.ptr());
+	vkResetCommandBuffer(command_buffer, 0);
+
+	// The descriptor sets of the batch are no longer used
+	reset_descriptor_pools();
+
+	if (timestamp_query_pool.get() == VK_NULL_HANDLE) {
+		return 0.0;
+	}
+
+	uint64_t timestamps[2] = {};
+	vkGetQueryPoolResults(device, timestamp_query_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+		                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	return vk_query::timestamp_interval_ms(timestamps[0], timestamps[1], timestamp_valid_bits,
+		                                   device_properties.limits.timestampPeriod);
+}
+
+
+void ComputeContext::begin_external(VkCommandBuffer external_command_buffer) {
+
+	// The batch may use the buffers the external commands write
+	submit();
+
+	// The previous external recording has completed
+	reset_descriptor_pools();
+
+	command_buffer = external_command_buffer;
+	external = true;
+	recording = true;
+	command_count = 0;
+
+	// Earlier commands of any stage (e.g. the draws of the previous frame) may still read
+	// or write the buffers: the first command waits for all of them
+	record_memory_barrier(command_buffer,
+		                  VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT,
+		                  COMPUTE_STAGES, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
+}
+
+
+void ComputeContext::end_external(VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access) {
+
+	if (!external) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("end_external() without begin_external()! \033[0m \n");
+	}
+
+	record_memory_barrier(command_buffer,
+		                  COMPUTE_STAGES, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		                  dst_stages, dst_access);
+
+	command_buffer = batch_command_buffer;
+	external = false;
+	recording = false;
+	command_count = 0;
+}
+
+
+uint32_t ComputeContext::group_count(uint64_t element_count, const Kernel& kernel) const {
+
+	uint64_t groups = (element_count + kernel.local_size[0] - 1) / kernel.local_size[0];
+
+	return static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(groups, 1),
+		                                            device_properties.limits.maxComputeWorkGroupCount[0]));
+}
+
+
+void ComputeContext::reset_descriptor_pools() {
+
+	for (const auto& descriptor_pool : descriptor_pools) {
+		vkResetDescriptorPool(device, descriptor_pool, 0);
+	}
+	current_descriptor_pool = 0;
+}
+
+
+VkDescriptorSet ComputeContext::allocate_descriptor_set(VkDescriptorSetLayout set_layout) {
+
+	VkDescriptorSetAllocateInfo descriptor_set_info{};
+	descriptor_set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptor_set_info.descriptorSetCount = 1;
+	descriptor_set_info.pSetLayouts = &set_layout;
+
+	VkDescriptorSet descriptor_set;
+
+	// Try the current pool, then a new one
+	for (int attempt = 0; attempt < 2; attempt++) {
+
+		descriptor_set_info.descriptorPool = descriptor_pools[current_descriptor_pool];
+
+		if (vkAllocateDescriptorSets(device, &descriptor_set_info, &descriptor_set) == VK_SUCCESS) {
+			return descriptor_set;
+		}
+
+		current_descriptor_pool++;
+		if (current_descriptor_pool == descriptor_pools.size()) {
+			add_descriptor_pool();
+		}
+	}
+
+	std::cout << "\033[31;40m";
+	throw std::runtime_error("Failed to allocate Vulkan Descriptor set! \033[0m \n");
+}
+
+
+void ComputeContext::add_descriptor_pool() {
+
+	VkDescriptorPoolSize pool_sizes[2] = {};
+	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_sizes[0].descriptorCount = DESCRIPTOR_POOL_BUFFERS;
+	pool_sizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	pool_sizes[1].descriptorCount = DESCRIPTOR_POOL_SETS;
+
+	VkDescriptorPoolCreateInfo descriptor_pool_info{};
+	descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptor_pool_info.maxSets = DESCRIPTOR_POOL_SETS;
+	descriptor_pool_info.poolSizeCount = 2;
+	descriptor_pool_info.pPoolSizes = pool_sizes;
+
+	VkDescriptorPool new_descriptor_pool;
+	if (vkCreateDescriptorPool(device, &descriptor_pool_info, nullptr, &new_descriptor_pool) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Descriptor pool! \033[0m \n");
+	}
+
+	descriptor_pools.emplace_back(new_descriptor_pool, device, nullptr);
+}
+
+
+} // namespace vk_compute
\ No newline at end of file
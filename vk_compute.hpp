@@ -0,0 +1,189 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_device.hpp"
+#include "vk_reflect.hpp"
+#include "vk_variant.hpp"
+#include "vk_handle.hpp"
+#include "vk_hot_reload.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace vk_compute {
+
+
+/*
+Vulkan objects of a compute only run: instance, device and one compute queue,
+created with the vk_core functions but without a window, a surface or a swapchain.
+Destroyed with the object, so everything created from the device must be destroyed first.
+*/
+class HeadlessDevice {
+
+public:
+
+	// device_override and probe_cache_file as for vk_core::select_physical_device()
+	HeadlessDevice(const std::string& device_override, const std::string& probe_cache_file);
+	~HeadlessDevice();
+
+	HeadlessDevice(const HeadlessDevice&) = delete;
+	HeadlessDevice& operator=(const HeadlessDevice&) = delete;
+
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	vk_device::DeviceProbe device_probe;
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t queue_family = 0;
+	VkQueue queue = VK_NULL_HANDLE;
+};
+
+
+// Storage buffer used by the kernels
+struct Buffer {
+
+	vk_handle::Handle<VkDeviceMemory> memory;
+	vk_handle::Handle<VkBuffer> buffer;
+	VkDeviceSize size = 0;
+
+	// Host visible memory stays mapped: upload() and download() copy directly,
+	// otherwise they go through a staging buffer
+	void* mapped = nullptr;
+};
+
+
+// Compute pipeline and the interface of its shader
+struct Kernel {
+
+	std::string name; // SPIR-V file
+	vk_variant::Specialization specialization;
+
+	vk_handle::Handle<VkPipeline> pipeline;
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;    // owned by the layout cache
+	VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;    // set 0, owned by the layout cache
+
+	std::vector<vk_reflect::DescriptorBinding> bindings;  // of set 0, sorted by binding
+	uint32_t push_constant_size = 0;
+	uint32_t local_size[3] = { 1, 1, 1 };
+};
+
+
+/*
+Runs compute kernels on a queue, with or without a window.
+Commands (dispatches, copies, fills) are recorded in a batch, in order: each one waits
+for the writes of the previous ones (a global memory barrier between them).
+submit() runs the batch and waits for it, so the batch is the unit of GPU work:
+record many commands before submitting to keep the GPU busy.
+Between begin_external() and end_external() the commands are recorded into a command buffer
+of the caller instead (e.g. the one of a frame), which submits it.
+Descriptor sets are allocated per dispatch and recycled after each submit
+and at each begin_external().
+Not thread safe.
+*/
+class ComputeContext {
+
+public:
+
+	ComputeContext(
+		VkPhysicalDevice physical_device, VkDevice device,
+		uint32_t queue_family, VkQueue queue,
+		VkPipelineCache pipeline_cache, vk_reflect::LayoutCache& layout_cache);
+	~ComputeContext();
+
+	ComputeContext(const ComputeContext&) = delete;
+	ComputeContext& operator=(const ComputeContext&) = delete;
+
+	// Create the pipeline of a compute shader (SPIR-V file)
+	Kernel create_kernel(
+		const std::string& shader_file,
+		const vk_variant::Specialization& specialization = vk_variant::Specialization{});
+
+	// Rebuild the pipeline of kernel when the shader hot reload recompiles its shader,
+	// as long as its interface is unchanged. kernel must outlive hot_reload.
+	void watch_kernel(vk_hot_reload::ShaderHotReload& hot_reload, Kernel& kernel);
+
+	// Storage buffer, also usable as a copy source and destination.
+	// Device local, and host visible when the device has cached host visible device memory
+	// (integrated and CPU devices).
+	Buffer create_buffer(VkDeviceSize size, VkBufferUsageFlags extra_usage = 0);
+
+	// Copy host data into a buffer, or a buffer into host memory.
+	// The recorded batch is submitted first, the copy is complete when they return.
+	void upload(Buffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+	void download(const Buffer& buffer, void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+
+	// Record a dispatch of group_count workgroups. buffers are bound to the bindings of set 0,
+	// in binding order; push_constants must be the size of the push constant block of the shader.
+	void dispatch(
+		const Kernel& kernel, const std::vector<const Buffer*>& buffers,
+		const void* push_constants, uint32_t push_constants_size,
+		uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1);
+
+	// Record a fill of size bytes (a multiple of 4, or VK_WHOLE_SIZE) with a 32 bit value
+	void fill(Buffer& buffer, uint32_t value, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+	// Record a buffer to buffer copy
+	void copy(const Buffer& source, Buffer& destination, VkDeviceSize size,
+		      VkDeviceSize source_offset = 0, VkDeviceSize destination_offset = 0);
+
+	// Submit the recorded commands and wait for them.
+	// Returns the GPU time of the batch in milliseconds (timestamp queries), 0 without timestamps.
+	// Throws between begin_external() and end_external().
+	double submit();
+
+	// Record the next commands into command_buffer, already begun, after the batch is submitted.
+	// The descriptor sets of the previous external recording are recycled: the command buffer
+	// it was recorded into must have completed. The first command waits for every earlier command.
+	void begin_external(VkCommandBuffer command_buffer);
+
+	// Make the writes of the external commands visible to the commands recorded after them
+	// in the command buffer, e.g. indirect draws and vertex shader reads, then go back to the batch
+	void end_external(VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access);
+
+	// Workgroups to cover element_count invocations along x, clamped to maxComputeWorkGroupCount[0]:
+	// kernels loop over the elements with a grid stride, so large counts still fit
+	uint32_t group_count(uint64_t element_count, const Kernel& kernel) const;
+
+	// Commands recorded since the last submit()
+	uint32_t recorded_commands() const { return command_count; }
+
+	VkDevice get_device() const { return device; }
+	const VkPhysicalDeviceProperties& properties() const { return device_properties; }
+
+private:
+
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	VkQueue queue;
+	VkPipelineCache pipeline_cache;
+	vk_reflect::LayoutCache& layout_cache;
+
+	VkPhysicalDeviceProperties device_properties;
+	bool host_visible_buffers = false; // create_buffer() maps the buffers
+
+	vk_handle::Handle<VkCommandPool> command_pool;
+	VkCommandBuffer batch_command_buffer = VK_NULL_HANDLE; // freed with the pool
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;       // being recorded: the batch or the external one
+	vk_handle::Handle<VkFence> fence;
+	vk_handle::Handle<VkQueryPool> timestamp_query_pool; // null without timestamps
+	uint32_t timestamp_valid_bits = 0;                   // of the queue family
+
+	// Pools are added when the current one is full and reset after each submit
+	std::vector<vk_handle::Handle<VkDescriptorPool>> descriptor_pools;
+	size_t current_descriptor_pool = 0;
+
+	bool recording = false;
+	bool external = false;
+	uint32_t command_count = 0;
+
+	void begin_command();
+	void reset_descriptor_pools();
+	VkDescriptorSet allocate_descriptor_set(VkDescriptorSetLayout set_layout);
+	void add_descriptor_pool();
+
+	// One shot host visible buffer for upload() and download() without mapped memory
+	Buffer create_staging_buffer(VkDeviceSize size);
+};
+
+
+} // namespace vk_compute
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "vk_config.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <optional>
+#include <algorithm>	// transform()
+#include <cctype>		// toupper(), isdigit()
+#include <limits>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_config {
+
+
+// Look for "--name=value" in the command line first,
+// then for the LV_NAME environment variable
+static std::optional<std::string> find_option(int argc, char* argv[], const std::string& name) {
+
+	const std::string prefix = "--" + name + "=";
+
+	for (int i = 1; i < argc; i++) {
+
+		std::string arg = argv[i];
+		if (arg.rfind(prefix, 0) == 0) {
+			return arg.substr(prefix.size());
+		}
+	}
+
+	// --render-path -> LV_RENDER_PATH
+	std::string env_name = "LV_" + name;
+	std::transform(env_name.begin(), env_name.end(), env_name.begin(),
+		[](unsigned char c) { return c == '-' ? '_' : static_cast<char>(std::toupper(c)); });
+
+	return get_env(env_name);
+}
+
+
+static uint32_t parse_uint(const std::string& name, const std::string& value) {
+
+	// stoull() accepts a sign (and wraps "-1") and leading spaces: only digits are valid
+	bool valid = !value.empty() && std::isdigit(static_cast<unsigned char>(value[0]));
+
+	unsigned long long number = 0;
+	if (valid) {
+		try {
+			size_t end = 0;
+			number = std::stoull(value, &end);
+			valid = end == value.size() && number <= std::numeric_limits<uint32_t>::max();
+		}
+		catch (const std::exception&) {
+			valid = false;
+		}
+	}
+
+	if (!valid) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Invalid value for option " + name + ": " + value + " \033[0m \n");
+	}
+
+	return static_cast<uint32_t>(number);
+}
+
+
+static bool parse_bool(const std::string& name, const std::string& value) {
+
+	if (value == "1" || value == "true" || value == "on") {
+		return true;
+	}
+	if (value == "0" || value == "false" || value == "off") {
+		return false;
+	}
+
+	std::cout << "\033[31;40m";
+	throw std::runtime_error("Invalid value for option " + name + ": " + value + " \033[0m \n");
+}
+
+
+Config parse_config(int argc, char* argv[]) {
+
+	Config config;
+
+	if (auto value = find_option(argc, argv, "render-path")) {
+
+		if (*value == "renderpass") {
+			config.render_path = RenderPath::RenderPass;
+		}
+		else if (*value == "dynamic") {
+			config.render_path = RenderPath::DynamicRendering;
+		}
+		else {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Unknown render path: " + *value + " (expected renderpass or dynamic) \033[0m \n");
+		}
+	}
+
+	if (auto value = find_option(argc, argv, "device")) {
+		config.device = *value;
+	}
+
+	if (auto value = find_option(argc, argv, "shading")) {
+
+		if (*value == "gradient") {
+			config.shading_model = 0;
+		}
+		else if (*value == "noise") {
+			config.shading_model = 1;
+		}
+		else {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Unknown shading model: " + *value + " (expected gradient or noise) \033[0m \n");
+		}
+	}
+
+	if (auto value = find_option(argc, argv, "msaa")) {
+
+		config.msaa_samples = parse_uint("msaa", *value);
+
+		// A sample count is a power of two
+		if (config.msaa_samples == 0 || config.msaa_samples > 64 || (config.msaa_samples & (config.msaa_samples - 1)) != 0) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Invalid MSAA sample count: " + *value + " (expected 1, 2, 4, 8, 16, 32 or 64) \033[0m \n");
+		}
+	}
+
+	if (auto value = find_option(argc, argv, "depth-prepass")) {
+		config.depth_prepass = parse_bool("depth-prepass", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "hdr")) {
+
+		if (*value == "off") {
+			config.hdr_format = HdrFormat::Off;
+		}
+		else if (*value == "b10g11r11") {
+			config.hdr_format = HdrFormat::B10G11R11;
+		}
+		else if (*value == "rgba16f") {
+			config.hdr_format = HdrFormat::R16G16B16A16;
+		}
+		else {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Unknown HDR format: " + *value + " (expected off, b10g11r11 or rgba16f) \033[0m \n");
+		}
+	}
+
+	if (auto value = find_option(argc, argv, "particles")) {
+		config.particle_count = parse_uint("particles", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark")) {
+		config.benchmark_frames = parse_uint("benchmark", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-recreations")) {
+		config.benchmark_recreations = parse_uint("benchmark-recreations", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-variants")) {
+		config.benchmark_variants = parse_uint("benchmark-variants", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-overdraw")) {
+		config.benchmark_overdraw = parse_uint("benchmark-overdraw", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-draws")) {
+		config.benchmark_draws = parse_uint("benchmark-draws", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-draws-per-frame")) {
+		config.benchmark_draws_per_frame = parse_uint("benchmark-draws-per-frame", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-msaa")) {
+		config.benchmark_msaa = parse_uint("benchmark-msaa", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-depth-prepass")) {
+		config.benchmark_depth_prepass = parse_uint("benchmark-depth-prepass", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-hdr")) {
+		config.benchmark_hdr = parse_uint("benchmark-hdr", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "textures")) {
+		config.textures = *value;
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-textures")) {
+		config.benchmark_textures = parse_uint("benchmark-textures", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-capture")) {
+		config.benchmark_capture = parse_uint("benchmark-capture", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "capture")) {
+		config.capture = *value;
+	}
+
+	if (auto value = find_option(argc, argv, "capture-frame-rate")) {
+		config.capture_frame_rate = parse_uint("capture-frame-rate", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-compute")) {
+		config.benchmark_compute = parse_uint("benchmark-compute", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-primitives")) {
+		config.benchmark_primitives = parse_uint("benchmark-primitives", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-compute-max-elements")) {
+		config.benchmark_compute_max_elements = parse_uint("benchmark-compute-max-elements", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-file")) {
+		config.benchmark_file = *value;
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-file-iterations")) {
+		config.benchmark_file_iterations = parse_uint("benchmark-file-iterations", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "startup-trace")) {
+		config.startup_trace = *value;
+	}
+
+	if (auto value = find_option(argc, argv, "render-thread")) {
+		config.render_thread = parse_bool("render-thread", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "benchmark-render-thread")) {
+		config.benchmark_render_thread = parse_uint("benchmark-render-thread", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "hot-reload")) {
+		config.hot_reload = parse_bool("hot-reload", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "memory-report")) {
+		config.memory_report = parse_uint("memory-report", *value);
+	}
+
+	if (auto value = find_option(argc, argv, "pass-queries")) {
+		config.pass_queries = parse_uint("pass-queries", *value);
+	}
+
+	LOG_MESSAGE("Render path: " + to_string(config.render_path), Color::Bright_White, Color::Black, 0);
+
+	return config;
+}
+
+
+std::string to_string(RenderPath render_path) {
+
+	switch (render_path) {
+		default:
+		case RenderPath::RenderPass: return "Render pass";
+		case RenderPath::DynamicRendering: return "Dynamic rendering";
+	}
+}
+
+
+std::string to_string(HdrFormat hdr_format) {
+
+	switch (hdr_format) {
+		default:
+		case HdrFormat::Off: return "off";
+		case HdrFormat::B10G11R11: return "b10g11r11";
+		case HdrFormat::R16G16B16A16: return "rgba16f";
+	}
+}
+
+
+} // namespace vk_config
\ No newline at end of file
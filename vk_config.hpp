@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+namespace vk_config {
+
+
+// How the frame is rendered:
+// - RenderPass uses VkRenderPass and one VkFramebuffer per swapchain image
+// - DynamicRendering uses vkCmdBeginRendering (core in Vulkan 1.3),
+//   no render pass and no framebuffer objects are created at all
+enum class RenderPath {
+	RenderPass,
+	DynamicRendering
+};
+
+
+// Offscreen color target the scene is rendered to, tone mapped into the swapchain image
+// by a compute pass (see vk_tonemap):
+// - Off renders straight into the swapchain image
+// - B10G11R11: 32 bits per pixel, unsigned floats without alpha, half the bandwidth of R16G16B16A16
+// - R16G16B16A16: 64 bits per pixel, half floats with alpha
+enum class HdrFormat {
+	Off,
+	B10G11R11,
+	R16G16B16A16
+};
+
+
+// Startup options of the application.
+// Every option can be set from the command line (--name=value)
+// or from an environment variable (LV_NAME=value). Command line wins.
+struct Config {
+
+	RenderPath render_path = RenderPath::RenderPass;
+
+	// Use this GPU instead of the best scored one: part of its name or its UUID
+	std::string device;
+
+	// Shading model compiled into the fragment shader variant
+	// (specialization constant of shader.frag): 0 gradient, 1 noise
+	uint32_t shading_model = 0;
+
+	// Samples per pixel of the color target (1, 2, 4, 8...), clamped to what the GPU supports.
+	// Above 1 the scene is rendered to a multisampled image resolved into the swapchain image.
+	uint32_t msaa_samples = 1;
+
+	// Render the depth of the scene first, then shade it with an EQUAL depth test:
+	// every pixel runs the fragment shader once, whatever the overdraw
+	bool depth_prepass = false;
+
+	// HDR color target, tone mapped into the swapchain image.
+	// Needs swapchain images usable as storage images, otherwise it is turned off.
+	HdrFormat hdr_format = HdrFormat::Off;
+
+	// Particles simulated, sorted and drawn on the GPU every frame over the scene (see vk_particles),
+	// 0 for none. Also drawn by the frame benchmark (benchmark_frames).
+	uint32_t particle_count = 0;
+
+	// If > 0 run the benchmark instead of the normal main loop:
+	// render this many frames and recreate the swapchain
+	// benchmark_recreations times for every render path.
+	uint32_t benchmark_frames = 0;
+	uint32_t benchmark_recreations = 50;
+
+	// If > 0 run the shader variant benchmark instead of the normal main loop:
+	// render this many frames with each specialized and uber shader variant,
+	// drawing the triangle benchmark_overdraw times per frame.
+	uint32_t benchmark_variants = 0;
+	uint32_t benchmark_overdraw = 64;
+
+	// If > 0 run the per-draw data benchmark instead of the normal main loop:
+	// render this many frames of benchmark_draws_per_frame small triangles,
+	// with the per-draw data in push constants, then in a dynamic uniform buffer.
+	uint32_t benchmark_draws = 0;
+	uint32_t benchmark_draws_per_frame = 10000;
+
+	// If > 0 run the MSAA benchmark instead of the normal main loop:
+	// render this many frames at 1x, 2x, 4x and 8x, drawing the triangle benchmark_overdraw times per frame.
+	uint32_t benchmark_msaa = 0;
+
+	// If > 0 run the depth pre-pass benchmark instead of the normal main loop:
+	// render this many frames of benchmark_overdraw stacked triangles without, then with the depth pre-pass.
+	uint32_t benchmark_depth_prepass = 0;
+
+	// If > 0 run the HDR benchmark instead of the normal main loop: render this many frames
+	// of benchmark_overdraw stacked triangles straight to the swapchain, then with each HDR format.
+	uint32_t benchmark_hdr = 0;
+
+	// KTX2 file, or directory of .ktx2 files, loaded at startup: the load time
+	// and the memory of each texture are logged
+	std::string textures;
+
+	// If > 0 run the texture benchmark instead of the normal main loop: upload this many
+	// RGBA8 textures of each size from 256x256 to 4096x4096, without then with their mip chain.
+	uint32_t benchmark_textures = 0;
+
+	// If > 0 run the capture benchmark instead of the normal main loop: render this many frames
+	// at 1920x1080 without then with the readback of every frame to host memory
+	uint32_t benchmark_capture = 0;
+
+	// If set, write every frame to this file: YUV4MPEG2 for a .y4m file, raw YUV 4:2:0 otherwise.
+	// capture_frame_rate only goes into the Y4M header.
+	std::string capture;
+	uint32_t capture_frame_rate = 60;
+
+	// If set, write the startup phases (until the first frame) to this file
+	// in the Chrome trace event format (chrome://tracing, ui.perfetto.dev)
+	std::string startup_trace;
+
+	// Render and submit the frames of the main loop on a render thread, while the main thread only
+	// processes the window events and forwards them to it (vk_input). Else both alternate on the main thread.
+	bool render_thread = true;
+
+	// If > 0 run the render thread benchmark instead of the normal main loop: render this many frames
+	// with the events and the frames on the main thread, then on two threads, without then with
+	// a slow event handler, and compare the frame time variance
+	uint32_t benchmark_render_thread = 0;
+
+	// Recompile shaders/*.vert|frag|comp when they change
+	// and swap the rebuilt pipelines in at the next frame
+	bool hot_reload = false;
+
+	// Log the memory budget and usage of every heap every memory_report frames,
+	// 0 only logs them at exit
+	uint32_t memory_report = 0;
+
+	// If > 0, count the vertices, primitives and fragments of every pass of the frames with
+	// pipeline statistics and occlusion queries, and log their averages every pass_queries frames
+	// and at exit
+	uint32_t pass_queries = 0;
+
+	// If > 0 only run the headless compute benchmark (no window) and exit:
+	// run the saxpy kernel this many times on 10^3, 10^4... up to benchmark_compute_max_elements floats
+	uint32_t benchmark_compute = 0;
+	uint32_t benchmark_compute_max_elements = 100000000;
+
+	// If > 0 only run the parallel primitives benchmark (no window) and exit:
+	// run each scan, reduction, compaction and radix sort this many times on 10^3, 10^4...
+	// up to benchmark_compute_max_elements uints, next to the CPU (std::inclusive_scan, std::sort...)
+	uint32_t benchmark_primitives = 0;
+
+	// If set, only compare read_file() and map_file() on this file and exit
+	std::string benchmark_file;
+	uint32_t benchmark_file_iterations = 20;
+};
+
+
+// Read the startup options from the command line and the environment
+Config parse_config(int argc, char* argv[]);
+
+
+// Readable name of a render path, used in logs and benchmark reports
+std::string to_string(RenderPath render_path);
+
+
+// Readable name of an HDR format, as given to --hdr
+std::string to_string(HdrFormat hdr_format);
+
+
+} // namespace vk_config
\ No newline at end of file
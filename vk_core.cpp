@@ -15,7 +15,7 @@ using namespace my_util; // my_util.hpp
 
 namespace vk_core {
 
-void create_vk_instance(VkInstance& instance) {
+void create_vk_instance(VkInstance& instance, bool headless) {
 
 	LOG_MESSAGE("Creating Vulkan Instance...", Color::Yellow, Color::Black, 0);
 
@@ -68,7 +68,7 @@ void create_vk_instance(VkInstance& instance) {
 	// In particular, VK_KHR_surface and VK_KHR_win32_surface are required.
 	LOG_MESSAGE("Getting extensions...", Color::Bright_White, Color::Black, 4);
 
-	std::vector<const char*> extensions = check_glfw_required_extensions();
+	std::vector<const char*> extensions = headless ? check_headless_required_extensions() : check_glfw_required_extensions();
 	uint32_t extensions_count = 0;
 	vkEnumerateInstanceExtensionProperties(nullptr, &extensions_count, nullptr);
 
@@ -124,7 +124,9 @@ void create_vk_surface(VkSurfaceKHR& surface, VkInstance instance, GLFWwindow* w
 }
 
 
-void select_physical_device(VkPhysicalDevice& physical_device, VkInstance instance, VkSurfaceKHR surface) {
+void select_physical_device(VkPhysicalDevice& physical_device, vk_device::DeviceProbe& device_probe,
+	                        VkInstance instance, VkSurfaceKHR surface,
+	                        const std::string& device_override, const std::string& probe_cache_file) {
 
 	LOG_MESSAGE("Selecting Physical Device...", Color::Yellow, Color::Black, 0);
 
@@ -140,12 +142,49 @@ void select_physical_device(VkPhysicalDevice& physical_device, VkInstance instan
 	std::vector<VkPhysicalDevice> devices(devices_count);
 	vkEnumeratePhysicalDevices(instance, &devices_count, devices.data());
 
+	vk_device::ProbeCache probe_cache(probe_cache_file);
+
+	std::vector<vk_device::DeviceProbe> probes;
 	for (const auto& dev : devices) {
+		probes.push_back(probe_cache.get_probe(dev));
+	}
+
+	probe_cache.save();
+	LOG_MESSAGE("Device probes cached: " + std::to_string(probe_cache.hit_count()) +
+		        ", queried: " + std::to_string(probe_cache.miss_count()), Color::Bright_White, Color::Black, 4);
 
-		print_physical_devices(dev);
+	print_physical_devices(probes);
+
+	// Best score first, ties keep the enumeration order of the driver
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < probes.size(); i++) {
+		if (vk_device::match_device(probes[i], device_override)) {
+			candidates.push_back(i);
+		}
+	}
+
+	if (candidates.empty()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("No GPU matches the device override: " + device_override + " \033[0m \n");
+	}
 
-		if (check_device_suitable(dev, surface)) {
-			physical_device = dev;
+	std::stable_sort(candidates.begin(), candidates.end(), [&](size_t a, size_t b) {
+		return vk_device::score_device(probes[b]) < vk_device::score_device(probes[a]);
+	});
+
+	// The surface dependent checks (presentation, swapchain formats) can not be cached:
+	// only run them on the candidates, best first, until one fits.
+	// Without a surface (headless compute) a compute queue and synchronization2 are enough.
+	for (size_t i : candidates) {
+
+		bool suitable = (surface == VK_NULL_HANDLE) ?
+			probes[i].dynamic_rendering && find_compute_queue_family(devices[i]).has_value() :
+			probes[i].graphics_queue && probes[i].swapchain_extension && check_device_suitable(devices[i], surface);
+
+		if (suitable) {
+
+			physical_device = devices[i];
+			device_probe = probes[i];
 			break;
 		}
 	}
@@ -155,11 +194,14 @@ void select_physical_device(VkPhysicalDevice& physical_device, VkInstance instan
 		throw std::runtime_error("No suitable GPU found! \033[0m \n");
 	}
 
+	LOG_MESSAGE("Selected: " + device_probe.name + " (" + device_probe.uuid + ")", Color::Bright_White, Color::Black, 4);
+
 	LOG_MESSAGE("Physical Device selected. \n", Color::Yellow, Color::Black, 0);
 }
 
 
 void create_logical_device(VkDevice& device, VkPhysicalDevice physical_device,
+	                       const vk_device::DeviceProbe& device_probe,
 	                       VkInstance instance, VkSurfaceKHR surface,
 	                       VkQueue& queue_graphics, VkQueue& queue_present) {
 
@@ -188,20 +230,71 @@ void create_logical_device(VkDevice& device, VkPhysicalDevice physical_device,
 		queue_info.push_back(queue);
 	}
 
-	// Specify device features, previously queried with vkGetPhysicalDeviceFeatures()
-	// For now we don't need anything special, so we simply define it.
+	// Specify device features, previously queried by the probe
 	VkPhysicalDeviceFeatures device_features{};
 
+	// Fragment shader invocations of the depth pre-pass benchmark, and per pass statistics (vk_query)
+	if (device_probe.pipeline_statistics) {
+		device_features.pipelineStatisticsQuery = VK_TRUE;
+		LOG_MESSAGE("Enabled pipeline statistics queries.", Color::Bright_White, Color::Black, 4);
+	}
+
+	// The tone mapping shader writes the swapchain image whatever its channel order
+	if (device_probe.storage_write_without_format) {
+		device_features.shaderStorageImageWriteWithoutFormat = VK_TRUE;
+		LOG_MESSAGE("Enabled storage image writes without format.", Color::Bright_White, Color::Black, 4);
+	}
+
+	// Anisotropic filtering of the texture samplers (vk_texture::SamplerCache)
+	if (device_probe.sampler_anisotropy) {
+		device_features.samplerAnisotropy = VK_TRUE;
+		LOG_MESSAGE("Enabled sampler anisotropy.", Color::Bright_White, Color::Black, 4);
+	}
+
+	// Exact sample counts in the occlusion queries of the passes (vk_query)
+	if (device_probe.occlusion_query_precise) {
+		device_features.occlusionQueryPrecise = VK_TRUE;
+		LOG_MESSAGE("Enabled precise occlusion queries.", Color::Bright_White, Color::Black, 4);
+	}
+
+	// BC1-BC7 textures uploaded as they are stored (vk_ktx), decoded on the CPU otherwise
+	if (device_probe.texture_compression_bc) {
+		device_features.textureCompressionBC = VK_TRUE;
+		LOG_MESSAGE("Enabled BC texture compression.", Color::Bright_White, Color::Black, 4);
+	}
+
+	// Vulkan 1.3 features used by the dynamic rendering path:
+	// vkCmdBeginRendering() and vkCmdPipelineBarrier2() for the layout transitions
+	// that the render pass would otherwise do for us.
+	// The struct is only chained on a 1.3 device that has both, the others keep the render pass path.
+	VkPhysicalDeviceVulkan13Features vulkan13_features{};
+	vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+	bool vulkan13_supported = device_probe.dynamic_rendering;
+	if (vulkan13_supported) {
+		vulkan13_features.dynamicRendering = VK_TRUE;
+		vulkan13_features.synchronization2 = VK_TRUE;
+		LOG_MESSAGE("Enabled dynamic rendering and synchronization2.", Color::Bright_White, Color::Black, 4);
+	}
+
 	// Create logical device
 	VkDeviceCreateInfo device_info{};
 	device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	device_info.pNext = vulkan13_supported ? &vulkan13_features : nullptr;
 	device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_info.size());
 	device_info.pQueueCreateInfos = queue_info.data();
 	device_info.pEnabledFeatures = &device_features;
 
-	// Setup required extensions
-	device_info.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-	device_info.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+	// Setup required extensions, plus the optional ones the device supports
+	std::vector<const char*> device_extensions = DEVICE_EXTENSIONS;
+
+	if (device_probe.memory_budget_extension) {
+		device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		LOG_MESSAGE("Enabled VK_EXT_memory_budget.", Color::Bright_White, Color::Black, 4);
+	}
+
+	device_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+	device_info.ppEnabledExtensionNames = device_extensions.data();
 
 	// Setup validation layers
 	if (ENABLE_VALIDATION_LAYERS) {
@@ -226,18 +319,84 @@ void create_logical_device(VkDevice& device, VkPhysicalDevice physical_device,
 }
 
 
+void create_compute_device(VkDevice& device, VkPhysicalDevice physical_device,
+	                       const vk_device::DeviceProbe& device_probe,
+	                       uint32_t& queue_family, VkQueue& queue_compute) {
+
+	LOG_MESSAGE("Creating Vulkan Compute Device...", Color::Yellow, Color::Black, 0);
+
+	queue_family = find_compute_queue_family(physical_device).value();
+	LOG_MESSAGE("Compute queue family: " + std::to_string(queue_family), Color::Bright_White, Color::Black, 4);
+
+	float queue_priority = 1.0f;
+
+	VkDeviceQueueCreateInfo queue_info{};
+	queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queue_info.queueFamilyIndex = queue_family;
+	queue_info.queueCount = 1;
+	queue_info.pQueuePriorities = &queue_priority;
+
+	VkPhysicalDeviceFeatures device_features{};
+
+	// vkCmdPipelineBarrier2() between the commands of a batch
+	VkPhysicalDeviceVulkan13Features vulkan13_features{};
+	vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	vulkan13_features.synchronization2 = VK_TRUE;
+
+	// Create logical device: no swapchain, so no required extension
+	VkDeviceCreateInfo device_info{};
+	device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	device_info.pNext = &vulkan13_features;
+	device_info.queueCreateInfoCount = 1;
+	device_info.pQueueCreateInfos = &queue_info;
+	device_info.pEnabledFeatures = &device_features;
+
+	std::vector<const char*> device_extensions;
+
+	if (device_probe.memory_budget_extension) {
+		device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		LOG_MESSAGE("Enabled VK_EXT_memory_budget.", Color::Bright_White, Color::Black, 4);
+	}
+
+	device_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
+	device_info.ppEnabledExtensionNames = device_extensions.data();
+
+	// Setup validation layers
+	if (ENABLE_VALIDATION_LAYERS) {
+		device_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
+		device_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
+	}
+	else {
+		device_info.enabledLayerCount = 0;
+	}
+
+	if (vkCreateDevice(physical_device, &device_info, nullptr, &device) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Compute Device! \033[0m \n");
+	}
+
+	vkGetDeviceQueue(device, queue_family, 0, &queue_compute);
+
+	LOG_MESSAGE("Vulkan Compute Device created. \n", Color::Yellow, Color::Black, 0);
+}
+
+
 void create_swapchain(VkSwapchainKHR& swapchain, std::vector<VkImage>& swapchain_images,
-					  VkFormat swapchain_image_format, VkExtent2D swapchain_extent,
-	                  VkSurfaceKHR surface, GLFWwindow* window,
-	                  VkPhysicalDevice physical_device, VkDevice device) {
+					  VkFormat& swapchain_image_format, VkExtent2D& swapchain_extent,
+	                  VkSurfaceKHR surface, VkExtent2D framebuffer_extent,
+	                  VkPhysicalDevice physical_device, VkDevice device,
+	                  bool storage_images, bool readback_images,
+	                  VkSwapchainKHR old_swapchain) {
 
 	LOG_MESSAGE("Creating Vulkan Swapchain...", Color::Yellow, Color::Black, 0);
 
 	SwapchainSupportDetails swapchain_support = query_swapchain_support(surface, physical_device);
 
-	VkSurfaceFormatKHR surface_format = choose_swapchain_surface_format(swapchain_support.formats);
+	VkSurfaceFormatKHR surface_format = storage_images ?
+		choose_storage_surface_format(swapchain_support.formats, physical_device).value() :
+		choose_swapchain_surface_format(swapchain_support.formats);
 	VkPresentModeKHR present_mode = choose_swapchain_present_mode(swapchain_support.present_modes);
-	VkExtent2D extent = choose_swapchain_extent(window, swapchain_support.capabilities);
+	VkExtent2D extent = choose_swapchain_extent(framebuffer_extent, swapchain_support.capabilities);
 
 	// Also set how many images we want to the swapchain. Not required.
 	// Set to at least one more image than the minimum to avoid waiting on the driver
@@ -261,6 +420,12 @@ void create_swapchain(VkSwapchainKHR& swapchain, std::vector<VkImage>& swapchain
 	swapchain_info.imageExtent = extent;
 	swapchain_info.imageArrayLayers = 1; // amount of layers of each image (basically always 1)
 	swapchain_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // images are used as color attachment because we render them directly
+	if (storage_images) {
+		swapchain_info.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT; // or written by the tone mapping compute shader
+	}
+	if (readback_images) {
+		swapchain_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // and copied to host memory by the captures
+	}
 
 	// Specify that the swapchain images will be used across multiple queue families.
 	// We will be drawing the images in the swapchain from the graphics queue and
@@ -292,7 +457,7 @@ void create_swapchain(VkSwapchainKHR& swapchain, std::vector<VkImage>& swapchain
 
 	swapchain_info.presentMode = present_mode;
 	swapchain_info.clipped = VK_TRUE; // enables clipping
-	swapchain_info.oldSwapchain = VK_NULL_HANDLE; // For now, we assume we will only create 1 swapchain
+	swapchain_info.oldSwapchain = old_swapchain; // the surface can only have one active swapchain
 
 
 	if (vkCreateSwapchainKHR(device, &swapchain_info, nullptr, &swapchain) != VK_SUCCESS) {
@@ -359,6 +524,48 @@ VkSurfaceFormatKHR choose_swapchain_surface_format(const std::vector<VkSurfaceFo
 }
 
 
+std::optional<VkSurfaceFormatKHR> choose_storage_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats,
+	                                                            VkPhysicalDevice physical_device) {
+
+	for (VkFormat format : { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }) {
+
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+
+		if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+			continue;
+		}
+
+		for (const auto& form : available_formats) {
+			if (form.format == format && form.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+				return form;
+			}
+		}
+	}
+
+	return std::nullopt;
+}
+
+
+bool check_storage_swapchain_support(VkSurfaceKHR surface, VkPhysicalDevice physical_device,
+	                                 const vk_device::DeviceProbe& device_probe) {
+
+	SwapchainSupportDetails swapchain_support = query_swapchain_support(surface, physical_device);
+
+	return device_probe.storage_write_without_format &&
+		   (swapchain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) &&
+		   choose_storage_surface_format(swapchain_support.formats, physical_device).has_value();
+}
+
+
+bool check_readback_swapchain_support(VkSurfaceKHR surface, VkPhysicalDevice physical_device) {
+
+	SwapchainSupportDetails swapchain_support = query_swapchain_support(surface, physical_device);
+
+	return (swapchain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+}
+
+
 VkPresentModeKHR choose_swapchain_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes) {
 
 	for (const auto& pmode : available_present_modes) {
@@ -380,7 +587,7 @@ VkPresentModeKHR choose_swapchain_present_mode(const std::vector<VkPresentModeKH
 }
 
 
-VkExtent2D choose_swapchain_extent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities) {
+VkExtent2D choose_swapchain_extent(VkExtent2D framebuffer_extent, const VkSurfaceCapabilitiesKHR& capabilities) {
 
 	// The swap extent is the resolution of the swapchain images and
 	// it's almost always exactly equal to the resolution of the window
@@ -391,11 +598,7 @@ VkExtent2D choose_swapchain_extent(GLFWwindow* window, const VkSurfaceCapabiliti
 		return capabilities.currentExtent;
 	}
 	else {
-		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
-
-		VkExtent2D extent = { static_cast<uint32_t>(width),
-		                      static_cast<uint32_t>(height) };
+		VkExtent2D extent = framebuffer_extent;
 
 		// Bound the values of width and height between the min and max extents
 		// supported by the swapchain
@@ -498,6 +701,18 @@ std::vector<const char*> check_glfw_required_extensions() {
 }
 
 
+std::vector<const char*> check_headless_required_extensions() {
+
+	std::vector<const char*> extensions;
+
+	if (ENABLE_VALIDATION_LAYERS) {
+		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); // Debug messenger extension
+	}
+
+	return extensions;
+}
+
+
 bool check_device_extension_support(VkPhysicalDevice physical_device) {
 
 	uint32_t extensions_count;
@@ -539,6 +754,29 @@ bool check_device_suitable(VkPhysicalDevice physical_device, VkSurfaceKHR surfac
 }
 
 
+bool check_dynamic_rendering_support(VkPhysicalDevice physical_device) {
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	// The Vulkan 1.3 feature struct can only be queried on a 1.3 device
+	if (device_properties.apiVersion < VK_API_VERSION_1_3) {
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{};
+	vulkan13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+	VkPhysicalDeviceFeatures2 device_features{};
+	device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	device_features.pNext = &vulkan13_features;
+
+	vkGetPhysicalDeviceFeatures2(physical_device, &device_features);
+
+	return vulkan13_features.dynamicRendering && vulkan13_features.synchronization2;
+}
+
+
 QueueFamilyIndices check_queue_families(VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
 
 	LOG_MESSAGE("Querying Queue Families...", Color::Bright_White, Color::Black, 4);
@@ -588,65 +826,60 @@ QueueFamilyIndices check_queue_families(VkPhysicalDevice physical_device, VkSurf
 }
 
 
-void print_physical_devices(VkPhysicalDevice dev) {
-
-	LOG_MESSAGE("Available Physical Devices: ", Color::Bright_White, Color::Black, 4);
-	LOG_MESSAGE("Name \t\t\t | Type \t | Vulkan API \t | Driver \t | Memory", Color::White, Color::Black, 6);
-
-	VkPhysicalDeviceProperties device_properties;
-	vkGetPhysicalDeviceProperties(dev, &device_properties);
-	VkPhysicalDeviceMemoryProperties device_memory;
-	vkGetPhysicalDeviceMemoryProperties(dev, &device_memory);
-
-	std::string dev_log = device_properties.deviceName;
-
-	std::string type = " | Unknown";
-	switch (device_properties.deviceType) {
+std::optional<uint32_t> find_compute_queue_family(VkPhysicalDevice physical_device) {
 
-		default:
-
-		case VK_PHYSICAL_DEVICE_TYPE_OTHER:
-			type = "Unknown";
-			break;
+	uint32_t queue_families_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
 
-		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
-			type = "Integrated";
-			break;
+	std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, queue_families.data());
 
-		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
-			type = "Discrete";
-			break;
+	// The first family is usually graphics + compute, the one with the most hardware behind it
+	// and timestamps; a dedicated compute family only pays off next to graphics work
+	std::optional<uint32_t> compute_family;
+	for (uint32_t i = 0; i < queue_families_count; i++) {
 
-		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
-			type = "Virtual";
-			break;
+		if ((queue_families[i].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0) {
+			continue;
+		}
 
-		case VK_PHYSICAL_DEVICE_TYPE_CPU:
-			type = "CPU";
-			break;
+		if (!compute_family.has_value() ||
+			(queue_families[i].timestampValidBits > 0 && queue_families[*compute_family].timestampValidBits == 0)) {
+			compute_family = i;
+		}
 	}
 
-	float memory_gib = 0.0f;
-	for (uint32_t i = 0; i < device_memory.memoryHeapCount; i++) {
+	return compute_family;
+}
 
-		memory_gib = ((static_cast<float>(device_memory.memoryHeaps[i].size)) / 1024.0f / 1024.0f / 1024.0f);
-	}
 
-	dev_log += " \t | "
-		+ type
-		+ " \t | "
-		+ std::to_string(VK_VERSION_MAJOR(device_properties.apiVersion)) + "."
-		+ std::to_string(VK_VERSION_MINOR(device_properties.apiVersion)) + "."
-		+ std::to_string(VK_VERSION_PATCH(device_properties.apiVersion))
-		+ " \t | "
-		+ std::to_string(VK_VERSION_MAJOR(device_properties.driverVersion)) + "."
-		+ std::to_string(VK_VERSION_MINOR(device_properties.driverVersion)) + "."
-		+ std::to_string(VK_VERSION_PATCH(device_properties.driverVersion))
-		+ " \t | "
-		+ std::to_string(memory_gib)
-		+ " GiB";
+void print_physical_devices(const std::vector<vk_device::DeviceProbe>& probes) {
 
-	LOG_MESSAGE(dev_log, Color::White, Color::Black, 6);
+	LOG_MESSAGE("Available Physical Devices: ", Color::Bright_White, Color::Black, 4);
+	LOG_MESSAGE("Name \t\t\t | Type \t | Vulkan API \t | Driver \t | Memory \t | Score", Color::White, Color::Black, 6);
+
+	for (const auto& probe : probes) {
+
+		float memory_gib = static_cast<float>(probe.device_local_memory) / 1024.0f / 1024.0f / 1024.0f;
+
+		std::string dev_log = probe.name
+			+ " \t | "
+			+ vk_device::to_string(probe.type)
+			+ " \t | "
+			+ std::to_string(VK_VERSION_MAJOR(probe.api_version)) + "."
+			+ std::to_string(VK_VERSION_MINOR(probe.api_version)) + "."
+			+ std::to_string(VK_VERSION_PATCH(probe.api_version))
+			+ " \t | "
+			+ std::to_string(VK_VERSION_MAJOR(probe.driver_version)) + "."
+			+ std::to_string(VK_VERSION_MINOR(probe.driver_version)) + "."
+			+ std::to_string(VK_VERSION_PATCH(probe.driver_version))
+			+ " \t | "
+			+ std::to_string(memory_gib)
+			+ " GiB \t | "
+			+ vk_device::score_device(probe).to_string();
+
+		LOG_MESSAGE(dev_log, Color::White, Color::Black, 6);
+	}
 }
 
 } // namespace vk_core
\ No newline at end of file
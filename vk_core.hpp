@@ -1,11 +1,13 @@
 #pragma once
 
 #include "vk_includes.hpp"
+#include "vk_device.hpp"
 
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h> // include Windows specific headers
 
 #include <optional>     // has_value()
+#include <string>
 
 
 namespace vk_core {
@@ -33,30 +35,56 @@ struct SwapchainSupportDetails {
 
 
 // Initialize the Vulkan library
-void create_vk_instance(VkInstance& instance);
+// A headless instance (compute only, no window) does not enable the surface extensions of GLFW.
+void create_vk_instance(VkInstance& instance, bool headless = false);
 
 
 // Initialize the Vulkan-Windows surface
 void create_vk_surface(VkSurfaceKHR& surface, VkInstance instance, GLFWwindow* window);
 
 
-// Select the Physical device (GPU)
-void select_physical_device(VkPhysicalDevice& physical_device, VkInstance instance, VkSurfaceKHR surface);
+// Select the Physical device (GPU) with the best vk_device::DeviceScore
+// that can present to the surface, or that has a compute queue and synchronization2 if surface is VK_NULL_HANDLE (headless).
+// device_override (name part or UUID) restricts the choice.
+// Device capabilities are cached in probe_cache_file between runs.
+void select_physical_device(
+	VkPhysicalDevice& physical_device, vk_device::DeviceProbe& device_probe,
+	VkInstance instance, VkSurfaceKHR surface,
+	const std::string& device_override, const std::string& probe_cache_file);
 
 
 // Initialize Logical Device
+// Optional extensions found by the probe (e.g. VK_EXT_memory_budget) are enabled too.
 void create_logical_device(
 	VkDevice& device, VkPhysicalDevice physical_device,
+	const vk_device::DeviceProbe& device_probe,
 	VkInstance instance, VkSurfaceKHR surface,
 	VkQueue& queue_graphics, VkQueue& queue_present);
 
 
+// Initialize a Logical Device for headless compute: a single queue of find_compute_queue_family(),
+// synchronization2, no swapchain extension. Optional extensions found by the probe are enabled too.
+void create_compute_device(
+	VkDevice& device, VkPhysicalDevice physical_device,
+	const vk_device::DeviceProbe& device_probe,
+	uint32_t& queue_family, VkQueue& queue_compute);
+
+
 // Initialize Swapchain
+// When recreating it, old_swapchain is retired: its images that are not acquired are released,
+// it must still be destroyed once the frames that use it have completed.
+// With storage_images the images can also be written by compute shaders (tone mapping),
+// in the format of choose_storage_surface_format(): check_storage_swapchain_support() first.
+// With readback_images they can also be copied from (vk_readback): check_readback_swapchain_support() first.
+// framebuffer_extent is the size of the window in pixels (glfwGetFramebufferSize(), read on the GLFW thread):
+// the swapchain may be created on the render thread, which must not call GLFW.
 void create_swapchain(
 	VkSwapchainKHR& swapchain, std::vector<VkImage>& swapchain_images,
-	VkFormat swapchain_image_format, VkExtent2D swapchain_extent,
-	VkSurfaceKHR surface, GLFWwindow* window,
-	VkPhysicalDevice physical_device, VkDevice device);
+	VkFormat& swapchain_image_format, VkExtent2D& swapchain_extent,
+	VkSurfaceKHR surface, VkExtent2D framebuffer_extent,
+	VkPhysicalDevice physical_device, VkDevice device,
+	bool storage_images, bool readback_images,
+	VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
 
 
 // Query for specific swapchain features/details
@@ -67,12 +95,31 @@ SwapchainSupportDetails query_swapchain_support(VkSurfaceKHR surface, VkPhysical
 VkSurfaceFormatKHR choose_swapchain_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
 
 
+// Surface format for swapchain images written by compute shaders: the sRGB formats
+// usually can not be storage images, so an 8 bit UNORM format with the sRGB color space
+// is chosen instead and the shader encodes sRGB itself. Empty if none supports it.
+std::optional<VkSurfaceFormatKHR> choose_storage_surface_format(
+	const std::vector<VkSurfaceFormatKHR>& available_formats, VkPhysicalDevice physical_device);
+
+
+// Check if compute shaders can write the swapchain images: storage usage for the surface,
+// a storage surface format, and storage image writes without a format qualifier
+// (the shader does not know the channel order of the swapchain format)
+bool check_storage_swapchain_support(
+	VkSurfaceKHR surface, VkPhysicalDevice physical_device,
+	const vk_device::DeviceProbe& device_probe);
+
+
+// Check if the swapchain images can be copied from (transfer source usage for the surface)
+bool check_readback_swapchain_support(VkSurfaceKHR surface, VkPhysicalDevice physical_device);
+
+
 // Set the conditions for how to show/swap images to the screen
 VkPresentModeKHR choose_swapchain_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes);
 
 
 // Set the resolution of the images in the swapchain
-VkExtent2D choose_swapchain_extent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities);
+VkExtent2D choose_swapchain_extent(VkExtent2D framebuffer_extent, const VkSurfaceCapabilitiesKHR& capabilities);
 
 
 // Initialize Image Views
@@ -91,6 +138,10 @@ VkResult check_validation_layers_support();
 std::vector<const char*> check_glfw_required_extensions();
 
 
+// Instance extensions of a headless instance (only the debug messenger with validation)
+std::vector<const char*> check_headless_required_extensions();
+
+
 // Check if the required extensions match with
 // all the available extensions supported by the device
 bool check_device_extension_support(VkPhysicalDevice physical_device);
@@ -101,12 +152,21 @@ bool check_device_extension_support(VkPhysicalDevice physical_device);
 bool check_device_suitable(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
 
 
+// Check if the physical device supports the Vulkan 1.3
+// dynamic rendering and synchronization2 features
+bool check_dynamic_rendering_support(VkPhysicalDevice physical_device);
+
+
 // Check for queue families supported by the physical device
 QueueFamilyIndices check_queue_families(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
 
 
-// Print physical devices features in detail
-void print_physical_devices(VkPhysicalDevice dev);
+// Queue family for compute work, preferably one with timestamps. Empty if there is none.
+std::optional<uint32_t> find_compute_queue_family(VkPhysicalDevice physical_device);
+
+
+// Print the physical devices with their score
+void print_physical_devices(const std::vector<vk_device::DeviceProbe>& probes);
 
 
 } // namespace vk_core
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include "vk_device.hpp"
+#include "vk_core.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>		// strcmp()
+#include <algorithm>	// transform()
+#include <cctype>		// tolower()
+#include <tuple>		// tie()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_device {
+
+
+// First line of the cache file, a cache written by another version is ignored
+static const std::string PROBE_CACHE_HEADER = "# learning-vulkan device probe cache v4";
+
+// Device-local memory differences smaller than this do not decide the ranking
+static const uint64_t MEMORY_STEP = 256ull * 1024 * 1024;
+
+
+bool DeviceScore::operator<(const DeviceScore& other) const {
+
+	return std::tie(type_rank, memory_steps, queue_score, feature_score) <
+		   std::tie(other.type_rank, other.memory_steps, other.queue_score, other.feature_score);
+}
+
+
+std::string DeviceScore::to_string() const {
+
+	return std::to_string(type_rank) + "/" + std::to_string(memory_steps) + "/" +
+		   std::to_string(queue_score) + "/" + std::to_string(feature_score);
+}
+
+
+// Properties and UUID in one call: the cache key and what is shown in the device list
+static void query_properties(VkPhysicalDevice physical_device, DeviceProbe& probe) {
+
+	VkPhysicalDeviceIDProperties id_properties{};
+	id_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 device_properties{};
+	device_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	device_properties.pNext = &id_properties;
+
+	vkGetPhysicalDeviceProperties2(physical_device, &device_properties);
+
+	std::ostringstream uuid;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+		uuid << std::hex << std::setw(2) << std::setfill('0') << static_cast<uint32_t>(id_properties.deviceUUID[i]);
+	}
+
+	const VkPhysicalDeviceProperties& properties = device_properties.properties;
+
+	probe.uuid = uuid.str();
+	probe.driver_version = properties.driverVersion;
+	probe.api_version = properties.apiVersion;
+	probe.vendor_id = properties.vendorID;
+	probe.device_id = properties.deviceID;
+	probe.type = properties.deviceType;
+	probe.name = properties.deviceName;
+	probe.timestamps = properties.limits.timestampComputeAndGraphics;
+	probe.max_sampler_anisotropy = properties.limits.maxSamplerAnisotropy;
+	probe.timestamp_period = properties.limits.timestampPeriod;
+}
+
+
+DeviceProbe probe_device(VkPhysicalDevice physical_device) {
+
+	DeviceProbe probe;
+	query_properties(physical_device, probe);
+
+	// Memory: all the heaps the GPU owns, not just the last one
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+		if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			probe.device_local_memory += memory_properties.memoryHeaps[i].size;
+		}
+	}
+
+	// Queue topology
+	uint32_t queue_families_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, queue_families.data());
+
+	probe.queue_family_count = queue_families_count;
+	for (const auto& qfam : queue_families) {
+
+		bool graphics = qfam.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = qfam.queueFlags & VK_QUEUE_COMPUTE_BIT;
+		bool transfer = qfam.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+		probe.graphics_queue = probe.graphics_queue || graphics;
+		probe.dedicated_compute_queue = probe.dedicated_compute_queue || (compute && !graphics);
+		probe.dedicated_transfer_queue = probe.dedicated_transfer_queue || (transfer && !compute && !graphics);
+	}
+
+	// Extensions
+	uint32_t extensions_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extensions_count, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(extensions_count);
+	vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extensions_count, extensions.data());
+
+	for (const auto& ext : extensions) {
+		probe.swapchain_extension = probe.swapchain_extension || strcmp(ext.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+		probe.memory_budget_extension = probe.memory_budget_extension || strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+	}
+
+	// Features
+	probe.dynamic_rendering = vk_core::check_dynamic_rendering_support(physical_device);
+
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physical_device, &features);
+	probe.pipeline_statistics = features.pipelineStatisticsQuery;
+	probe.storage_write_without_format = features.shaderStorageImageWriteWithoutFormat;
+	probe.sampler_anisotropy = features.samplerAnisotropy;
+	probe.occlusion_query_precise = features.occlusionQueryPrecise;
+	probe.texture_compression_bc = features.textureCompressionBC;
+
+	return probe;
+}
+
+
+DeviceScore score_device(const DeviceProbe& probe) {
+
+	DeviceScore score;
+
+	switch (probe.type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score.type_rank = 4; break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score.type_rank = 3; break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score.type_rank = 2; break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: score.type_rank = 1; break;
+		default: score.type_rank = 0; break;
+	}
+
+	score.memory_steps = probe.device_local_memory / MEMORY_STEP;
+
+	score.queue_score = (probe.dedicated_compute_queue ? 1 : 0) +
+		                (probe.dedicated_transfer_queue ? 1 : 0);
+
+	score.feature_score = (probe.dynamic_rendering ? 1 : 0) +
+		                  (probe.memory_budget_extension ? 1 : 0) +
+		                  (probe.timestamps ? 1 : 0);
+
+	return score;
+}
+
+
+static std::string to_lower(std::string text) {
+
+	std::transform(text.begin(), text.end(), text.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	return text;
+}
+
+
+bool match_device(const DeviceProbe& probe, const std::string& device_override) {
+
+	if (device_override.empty()) {
+		return true;
+	}
+
+	std::string wanted = to_lower(device_override);
+
+	return to_lower(probe.uuid) == wanted ||
+		   to_lower(probe.name).find(wanted) != std::string::npos;
+}
+
+
+std::string to_string(VkPhysicalDeviceType type) {
+
+	switch (type) {
+		default:
+		case VK_PHYSICAL_DEVICE_TYPE_OTHER: return "Unknown";
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "Integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "Discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "Virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return "CPU";
+	}
+}
+
+
+ProbeCache::ProbeCache(const std::string& file_path)
+	: file_path(file_path) {
+
+	std::ifstream file(file_path);
+	std::string line;
+
+	if (!file.is_open() || !std::getline(file, line) || line != PROBE_CACHE_HEADER) {
+		return;
+	}
+
+	// One device per line, tab separated, the name last
+	while (std::getline(file, line)) {
+
+		std::istringstream fields(line);
+		DeviceProbe probe;
+		uint32_t type = 0;
+
+		fields >> probe.uuid >> probe.driver_version >> probe.api_version
+			>> probe.vendor_id >> probe.device_id >> type
+			>> probe.device_local_memory >> probe.queue_family_count
+			>> probe.graphics_queue >> probe.dedicated_compute_queue >> probe.dedicated_transfer_queue
+			>> probe.swapchain_extension >> probe.memory_budget_extension
+			>> probe.dynamic_rendering >> probe.timestamps >> probe.pipeline_statistics
+			>> probe.storage_write_without_format >> probe.sampler_anisotropy
+			>> probe.occlusion_query_precise >> probe.texture_compression_bc
+			>> probe.max_sampler_anisotropy >> probe.timestamp_period;
+
+		fields.ignore(1); // tab before the name
+		std::getline(fields, probe.name);
+
+		if (fields.fail() || probe.uuid.empty()) {
+			continue; // damaged line, the device will just be probed again
+		}
+
+		probe.type = static_cast<VkPhysicalDeviceType>(type);
+		probes.push_back(probe);
+	}
+}
+
+
+DeviceProbe ProbeCache::get_probe(VkPhysicalDevice physical_device) {
+
+	DeviceProbe current;
+	query_properties(physical_device, current);
+
+	for (auto& cached : probes) {
+
+		if (cached.uuid != current.uuid) {
+			continue;
+		}
+
+		if (cached.driver_version == current.driver_version && cached.api_version == current.api_version) {
+			hits++;
+			return cached;
+		}
+
+		// Driver update: the capabilities may have changed
+		misses++;
+		cached = probe_device(physical_device);
+		modified = true;
+		return cached;
+	}
+
+	misses++;
+	probes.push_back(probe_device(physical_device));
+	modified = true;
+
+	return probes.back();
+}
+
+
+void ProbeCache::save() const {
+
+	if (!modified) {
+		return;
+	}
+
+	std::ofstream file(file_path, std::ios::trunc);
+
+	if (!file.is_open()) {
+		LOG_MESSAGE("Failed to write the device probe cache: " + file_path, Color::Red, Color::Black, 4);
+		return;
+	}
+
+	file << PROBE_CACHE_HEADER << "\n";
+	file << std::setprecision(9); // the float limits read back exactly
+
+	for (const auto& probe : probes) {
+
+		file << probe.uuid << "\t" << probe.driver_version << "\t" << probe.api_version
+			<< "\t" << probe.vendor_id << "\t" << probe.device_id << "\t" << static_cast<uint32_t>(probe.type)
+			<< "\t" << probe.device_local_memory << "\t" << probe.queue_family_count
+			<< "\t" << probe.graphics_queue << "\t" << probe.dedicated_compute_queue << "\t" << probe.dedicated_transfer_queue
+			<< "\t" << probe.swapchain_extension << "\t" << probe.memory_budget_extension
+			<< "\t" << probe.dynamic_rendering << "\t" << probe.timestamps << "\t" << probe.pipeline_statistics
+			<< "\t" << probe.storage_write_without_format << "\t" << probe.sampler_anisotropy
+			<< "\t" << probe.occlusion_query_precise << "\t" << probe.texture_compression_bc
+			<< "\t" << probe.max_sampler_anisotropy << "\t" << probe.timestamp_period
+			<< "\t" << probe.name << "\n";
+	}
+}
+
+
+} // namespace vk_device
\ No newline at end of file
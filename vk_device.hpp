@@ -0,0 +1,109 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace vk_device {
+
+
+// What the device selection, and the modules that adapt to the device, need to know about a GPU.
+// Nothing here depends on the window surface: it only changes with the device
+// and its driver, so it is cached between runs (ProbeCache).
+struct DeviceProbe {
+
+	std::string uuid;            // VkPhysicalDeviceIDProperties::deviceUUID, in hex
+	uint32_t driver_version = 0;
+	uint32_t api_version = 0;
+	uint32_t vendor_id = 0;
+	uint32_t device_id = 0;
+	VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+	std::string name;
+
+	uint64_t device_local_memory = 0; // bytes, sum of all the DEVICE_LOCAL heaps
+
+	uint32_t queue_family_count = 0;
+	bool graphics_queue = false;
+	bool dedicated_compute_queue = false;  // compute without graphics: async compute
+	bool dedicated_transfer_queue = false; // transfer only: copy engine
+
+	bool swapchain_extension = false;     // required
+	bool memory_budget_extension = false; // VK_EXT_memory_budget
+	bool dynamic_rendering = false;       // Vulkan 1.3 dynamicRendering + synchronization2
+	bool timestamps = false;              // timestampComputeAndGraphics
+	bool pipeline_statistics = false;     // pipelineStatisticsQuery
+	bool storage_write_without_format = false; // shaderStorageImageWriteWithoutFormat
+	bool sampler_anisotropy = false;      // samplerAnisotropy
+	bool occlusion_query_precise = false; // occlusionQueryPrecise
+	bool texture_compression_bc = false;  // textureCompressionBC
+
+	float max_sampler_anisotropy = 1.0f;
+	float timestamp_period = 1.0f;        // nanoseconds per timestamp tick
+};
+
+
+// Devices are ranked by comparing these fields in order:
+// type (discrete > integrated > virtual > CPU), device-local memory
+// (in 256 MiB steps, so that close sizes tie), queue topology, optional features.
+struct DeviceScore {
+
+	uint32_t type_rank = 0;
+	uint64_t memory_steps = 0;
+	uint32_t queue_score = 0;
+	uint32_t feature_score = 0;
+
+	bool operator<(const DeviceScore& other) const;
+
+	// e.g. "4/32/2/3"
+	std::string to_string() const;
+};
+
+
+// Query everything of DeviceProbe from the driver
+DeviceProbe probe_device(VkPhysicalDevice physical_device);
+
+
+DeviceScore score_device(const DeviceProbe& probe);
+
+
+// True if the override is empty, a case insensitive part of the name, or the UUID
+bool match_device(const DeviceProbe& probe, const std::string& device_override);
+
+
+// Readable name of a device type
+std::string to_string(VkPhysicalDeviceType type);
+
+
+/*
+Probes saved by previous runs, one per device UUID.
+A cached probe is used only if the driver and API versions still match,
+then the device costs a single vkGetPhysicalDeviceProperties2() call
+instead of the memory, queue family, extension and feature queries.
+*/
+class ProbeCache {
+
+public:
+
+	explicit ProbeCache(const std::string& file_path);
+
+	DeviceProbe get_probe(VkPhysicalDevice physical_device);
+
+	// Write the file if a probe was added or refreshed
+	void save() const;
+
+	uint32_t hit_count() const { return hits; }
+	uint32_t miss_count() const { return misses; }
+
+private:
+
+	std::string file_path;
+	std::vector<DeviceProbe> probes;
+	bool modified = false;
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+};
+
+
+} // namespace vk_device
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "vk_draw.hpp"
+
+#include <cstring>	// memcpy()
+
+
+namespace vk_draw {
+
+
+void push_per_draw(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout,
+	               VkShaderStageFlags stages, const PerDraw& per_draw) {
+
+	vkCmdPushConstants(command_buffer, pipeline_layout, stages, 0, sizeof(PerDraw), &per_draw);
+}
+
+
+void write_per_draw(void* mapped_buffer, VkDeviceSize stride, const std::vector<PerDraw>& draws) {
+
+	char* destination = static_cast<char*>(mapped_buffer);
+
+	for (const auto& per_draw : draws) {
+		std::memcpy(destination, &per_draw, sizeof(PerDraw));
+		destination += stride;
+	}
+}
+
+
+
+std::vector<PerDraw> overdraw_layers(uint32_t layer_count, const PerDraw& base) {
+
+	const float SCALE = 3.0f;
+
+	std::vector<PerDraw> layers(layer_count, base);
+
+	for (uint32_t i = 0; i < layer_count; i++) {
+
+		// Depth in (0, 1), decreasing: the first layer is the farthest
+		float depth = 1.0f - static_cast<float>(i + 1) / static_cast<float>(layer_count + 1);
+
+		layers[i].transform = glm::mat4(
+			SCALE, 0.0f, 0.0f, 0.0f,
+			0.0f, SCALE, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, depth, 1.0f); // column major: translation in the last column
+		layers[i].object_index = i;
+	}
+
+	return layers;
+}
+
+
+} // namespace vk_draw
\ No newline at end of file
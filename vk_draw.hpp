@@ -0,0 +1,46 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+namespace vk_draw {
+
+
+// Per-draw data, same layout as the PerDraw push constant block of the shaders (std430).
+// Pushed with every draw: small per-draw data never needs a descriptor update
+// or a uniform buffer write.
+struct PerDraw {
+
+	glm::mat4 transform = glm::mat4(1.0f);
+	uint32_t object_index = 0;
+	uint32_t material_id = 0;   // shading model read by the uber shader variant
+	uint32_t noise_octaves = 0; // read by the uber shader variant
+};
+
+// 128 bytes is the minimum maxPushConstantsSize every device supports
+static_assert(sizeof(PerDraw) <= 128, "PerDraw does not fit in the guaranteed push constant size");
+
+
+// Push the data of the next draw to the stages of the layout's push constant range
+void push_per_draw(
+	VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout,
+	VkShaderStageFlags stages, const PerDraw& per_draw);
+
+
+// Copy the data of every draw into a mapped (dynamic) uniform buffer,
+// one entry every stride bytes. The slow path push constants replace.
+void write_per_draw(void* mapped_buffer, VkDeviceSize stride, const std::vector<PerDraw>& draws);
+
+
+
+// Overdraw stress scene: layer_count copies of base, scaled up to cover most of the screen
+// and stacked from the farthest to the nearest. With a LESS depth test every layer passes,
+// so each pixel is shaded layer_count times unless a depth pre-pass is used.
+std::vector<PerDraw> overdraw_layers(uint32_t layer_count, const PerDraw& base);
+
+
+} // namespace vk_draw
\ No newline at end of file
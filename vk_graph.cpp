@@ -0,0 +1,645 @@
+#include "vk_graph.hpp"
+#include "vk_buffer.hpp"
+#include "vk_attachment.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <sstream>
+#include <iomanip>
+#include <algorithm>	// sort(), max()
+#include <tuple>		// tie()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_graph {
+
+
+using vk_barrier::is_read;
+
+
+// Usage flags a transient image needs for an access
+static VkImageUsageFlags image_usage(VkAccessFlags2 access) {
+
+	VkImageUsageFlags usage = 0;
+
+	if (access & (VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT)) {
+		usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	}
+	if (access & (VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT)) {
+		usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	}
+	if (access & VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) {
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	}
+	if (access & (VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)) {
+		usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+	}
+	if (access & VK_ACCESS_2_TRANSFER_READ_BIT) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+	if (access & VK_ACCESS_2_TRANSFER_WRITE_BIT) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+
+	return usage;
+}
+
+
+// Transient attachments are created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+static VkImageCreateInfo image_create_info(const ImageDesc& desc, VkImageUsageFlags usage) {
+
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.format = desc.format;
+	image_info.extent = { desc.extent.width, desc.extent.height, 1 };
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = 1;
+	image_info.samples = desc.samples;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.usage = vk_attachment::transient_usage(usage);
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	return image_info;
+}
+
+
+static double to_mib(VkDeviceSize bytes) {
+
+	return static_cast<double>(bytes) / 1024.0 / 1024.0;
+}
+
+
+RenderGraph::RenderGraph(VkPhysicalDevice physical_device, VkDevice device, vk_handle::DeletionQueue* deletion_queue)
+	: physical_device(physical_device), device(device), deletion_queue(deletion_queue) {
+}
+
+
+void RenderGraph::reset() {
+
+	resources.clear();
+	passes.clear();
+	final_barriers = Barriers{};
+}
+
+
+ResourceId RenderGraph::import_image(const std::string& name, VkImage image, VkImageView image_view,
+	                                 VkImageAspectFlags aspect, const Access& initial, const Access& final) {
+
+	Resource resource;
+	resource.name = name;
+	resource.is_image = true;
+	resource.imported = true;
+	resource.image = image;
+	resource.image_view = image_view;
+	resource.aspect = aspect;
+	resource.initial = initial;
+	resource.final = final;
+
+	resources.push_back(resource);
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+
+ResourceId RenderGraph::import_buffer(const std::string& name, VkBuffer buffer,
+	                                  const Access& initial, const Access& final) {
+
+	Resource resource;
+	resource.name = name;
+	resource.is_image = false;
+	resource.imported = true;
+	resource.buffer = buffer;
+	resource.initial = initial;
+	resource.final = final;
+
+	resources.push_back(resource);
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+
+ResourceId RenderGraph::create_image(const std::string& name, const ImageDesc& desc) {
+
+	Resource resource;
+	resource.name = name;
+	resource.is_image = true;
+	resource.imported = false;
+	resource.aspect = desc.aspect;
+	resource.desc = desc;
+
+	resources.push_back(resource);
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+
+void RenderGraph::add_pass(const std::string& name, const std::vector<Use>& uses, PassCallback record) {
+
+	Pass pass;
+	pass.name = name;
+	pass.record = record;
+
+	// One use per resource: a pass that reads and writes the same image gets a single barrier
+	for (const Use& use : uses) {
+
+		if (use.resource >= resources.size()) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Render graph pass " + name + " uses an unknown resource! \033[0m \n");
+		}
+
+		auto merged = std::find_if(pass.uses.begin(), pass.uses.end(),
+			                       [&](const Use& other) { return other.resource == use.resource; });
+
+		if (merged == pass.uses.end()) {
+			pass.uses.push_back(use);
+		}
+		else if (merged->access.layout != use.access.layout && resources[use.resource].is_image) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Render graph pass " + name + " uses " + resources[use.resource].name +
+				                     " in two layouts! \033[0m \n");
+		}
+		else {
+			merged->access.stage |= use.access.stage;
+			merged->access.access |= use.access.access;
+		}
+
+		if (!resources[use.resource].imported) {
+			resources[use.resource].usage |= image_usage(use.access.access);
+		}
+	}
+
+	passes.push_back(pass);
+}
+
+
+void RenderGraph::compile() {
+
+	vk_profiler::ScopedTimer timer(compile_stats);
+
+	cull_passes();
+
+	std::vector<int64_t> previous_alias;
+	allocate_transient_images(previous_alias);
+
+	compute_barriers(previous_alias);
+
+	graph_stats.pass_count = static_cast<uint32_t>(passes.size());
+	graph_stats.culled_pass_count = 0;
+	graph_stats.barrier_batch_count = 0;
+	graph_stats.image_barrier_count = 0;
+	graph_stats.buffer_barrier_count = 0;
+
+	for (const Pass& pass : passes) {
+		graph_stats.culled_pass_count += pass.culled ? 1 : 0;
+	}
+
+	auto count_barriers = [this](const Barriers& barriers) {
+		if (!barriers.image_barriers.empty() || !barriers.buffer_barriers.empty()) {
+			graph_stats.barrier_batch_count++;
+		}
+		graph_stats.image_barrier_count += static_cast<uint32_t>(barriers.image_barriers.size());
+		graph_stats.buffer_barrier_count += static_cast<uint32_t>(barriers.buffer_barriers.size());
+	};
+
+	for (const Pass& pass : passes) {
+		count_barriers(pass.barriers);
+	}
+	count_barriers(final_barriers);
+}
+
+
+void RenderGraph::cull_passes() {
+
+	// Walk back from the outputs: a pass is live if it writes a resource a later live pass
+	// (or the outside of the graph) needs, and then everything it reads is needed too
+	std::vector<bool> needed(resources.size(), false);
+	for (size_t r = 0; r < resources.size(); r++) {
+		needed[r] = resources[r].imported;
+	}
+
+	for (size_t p = passes.size(); p-- > 0; ) {
+
+		Pass& pass = passes[p];
+
+		bool live = false;
+		for (const Use& use : pass.uses) {
+			live = live || (is_write(use.access.access) && needed[use.resource]);
+		}
+
+		pass.culled = !live;
+		pass.barriers = Barriers{};
+
+		if (live) {
+			for (const Use& use : pass.uses) {
+				if (is_read(use.access.access)) {
+					needed[use.resource] = true;
+				}
+			}
+		}
+	}
+}
+
+
+void RenderGraph::allocate_transient_images(std::vector<int64_t>& previous_alias) {
+
+	previous_alias.assign(resources.size(), -1);
+
+	// Lifetime of each transient image: first and last live pass that uses it
+	const uint32_t UNUSED = UINT32_MAX;
+	std::vector<uint32_t> first_pass(resources.size(), UNUSED);
+	std::vector<uint32_t> last_pass(resources.size(), 0);
+
+	for (uint32_t p = 0; p < passes.size(); p++) {
+
+		if (passes[p].culled) {
+			continue;
+		}
+
+		for (const Use& use : passes[p].uses) {
+			if (!resources[use.resource].imported) {
+				first_pass[use.resource] = std::min(first_pass[use.resource], p);
+				last_pass[use.resource] = std::max(last_pass[use.resource], p);
+			}
+		}
+	}
+
+	// Memory requirements without creating the images (Vulkan 1.3)
+	std::vector<ResourceId> transients;
+	std::vector<VkMemoryRequirements> requirements(resources.size());
+
+	for (ResourceId r = 0; r < resources.size(); r++) {
+
+		if (resources[r].imported || first_pass[r] == UNUSED) {
+			continue;
+		}
+
+		VkImageCreateInfo image_info = image_create_info(resources[r].desc, resources[r].usage);
+
+		VkDeviceImageMemoryRequirements image_requirements{};
+		image_requirements.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+		image_requirements.pCreateInfo = &image_info;
+
+		VkMemoryRequirements2 memory_requirements{};
+		memory_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+
+		vkGetDeviceImageMemoryRequirements(device, &image_requirements, &memory_requirements);
+
+		requirements[r] = memory_requirements.memoryRequirements;
+		transients.push_back(r);
+		resources[r].last_pass = last_pass[r];
+	}
+
+	// Lazily allocated memory is only offered to transient attachments: they get blocks of their own
+	auto is_lazy = [this](uint32_t type_bits) {
+		return (vk_attachment::memory_properties(type_bits, physical_device) & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+	};
+
+	// Largest first, each image goes to the first block with compatible memory types
+	// whose images are all dead before it starts or born after it ends
+	struct MemoryBlock {
+		VkMemoryRequirements requirements;
+		std::vector<ResourceId> users;
+	};
+
+	std::vector<ResourceId> by_size = transients;
+	std::stable_sort(by_size.begin(), by_size.end(), [&](ResourceId a, ResourceId b) {
+		return requirements[a].size > requirements[b].size;
+	});
+
+	std::vector<MemoryBlock> blocks;
+	std::vector<uint32_t> memory_block(resources.size(), 0);
+
+	for (ResourceId r : by_size) {
+
+		uint32_t chosen = static_cast<uint32_t>(blocks.size());
+
+		for (uint32_t b = 0; b < blocks.size() && chosen == blocks.size(); b++) {
+
+			if ((blocks[b].requirements.memoryTypeBits & requirements[r].memoryTypeBits) == 0 ||
+				is_lazy(blocks[b].requirements.memoryTypeBits) != is_lazy(requirements[r].memoryTypeBits)) {
+				continue;
+			}
+
+			bool overlaps = false;
+			for (ResourceId user : blocks[b].users) {
+				overlaps = overlaps || (first_pass[r] <= last_pass[user] && first_pass[user] <= last_pass[r]);
+			}
+
+			if (!overlaps) {
+				chosen = b;
+			}
+		}
+
+		if (chosen == blocks.size()) {
+			blocks.push_back({ requirements[r], {} });
+		}
+
+		MemoryBlock& block = blocks[chosen];
+		block.requirements.size = std::max(block.requirements.size, requirements[r].size);
+		block.requirements.alignment = std::max(block.requirements.alignment, requirements[r].alignment);
+		block.requirements.memoryTypeBits &= requirements[r].memoryTypeBits;
+		block.users.push_back(r);
+
+		memory_block[r] = chosen;
+	}
+
+	// The users of a block do not overlap: in order of first use, each one inherits
+	// the memory (and the pending accesses) of the previous one
+	for (MemoryBlock& block : blocks) {
+
+		std::sort(block.users.begin(), block.users.end(),
+			      [&](ResourceId a, ResourceId b) { return first_pass[a] < first_pass[b]; });
+
+		for (size_t i = 1; i < block.users.size(); i++) {
+			previous_alias[block.users[i]] = block.users[i - 1];
+		}
+	}
+
+	// Keep the images of the previous frames if the graph declares the same ones
+	bool same_images = transient_images.size() == transients.size();
+	for (size_t i = 0; same_images && i < transients.size(); i++) {
+
+		const Resource& resource = resources[transients[i]];
+		const TransientImage& cached = transient_images[i];
+
+		same_images =
+			cached.desc.format == resource.desc.format &&
+			cached.desc.extent.width == resource.desc.extent.width &&
+			cached.desc.extent.height == resource.desc.extent.height &&
+			cached.desc.samples == resource.desc.samples &&
+			cached.desc.aspect == resource.desc.aspect &&
+			cached.usage == resource.usage &&
+			cached.memory_block == memory_block[transients[i]];
+	}
+
+	if (!same_images) {
+
+		// The frame in flight may still use them
+		transient_images.clear();
+		transient_memory.clear();
+
+		for (const MemoryBlock& block : blocks) {
+
+			VkMemoryPropertyFlags properties = vk_attachment::memory_properties(block.requirements.memoryTypeBits, physical_device);
+
+			VkDeviceMemory memory = vk_buffer::allocate_memory(block.requirements, properties, physical_device, device);
+			transient_memory.emplace_back(memory, device, deletion_queue);
+		}
+
+		for (ResourceId r : transients) {
+
+			const Resource& resource = resources[r];
+
+			VkImageCreateInfo image_info = image_create_info(resource.desc, resource.usage);
+
+			VkImage image;
+			if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+				std::cout << "\033[31;40m";
+				throw std::runtime_error("Failed to create render graph image " + resource.name + "! \033[0m \n");
+			}
+
+			TransientImage transient{ resource.desc, resource.usage, memory_block[r],
+				                      vk_handle::Handle<VkImage>(image, device, deletion_queue), {} };
+
+			vkBindImageMemory(device, image, transient_memory[memory_block[r]], 0);
+
+			VkImageViewCreateInfo view_info{};
+			view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_info.image = image;
+			view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			view_info.format = resource.desc.format;
+			view_info.subresourceRange.aspectMask = resource.desc.aspect;
+			view_info.subresourceRange.baseMipLevel = 0;
+			view_info.subresourceRange.levelCount = 1;
+			view_info.subresourceRange.baseArrayLayer = 0;
+			view_info.subresourceRange.layerCount = 1;
+
+			VkImageView image_view;
+			if (vkCreateImageView(device, &view_info, nullptr, &image_view) != VK_SUCCESS) {
+				std::cout << "\033[31;40m";
+				throw std::runtime_error("Failed to create render graph image view " + resource.name + "! \033[0m \n");
+			}
+			transient.image_view = vk_handle::Handle<VkImageView>(image_view, device, deletion_queue);
+
+			transient_images.push_back(std::move(transient));
+		}
+
+		LOG_MESSAGE("Render graph: allocated " + std::to_string(transients.size()) + " transient image(s) in " +
+			        std::to_string(blocks.size()) + " memory block(s).", Color::Bright_White, Color::Black, 0);
+	}
+
+	graph_stats.transient_image_count = static_cast<uint32_t>(transients.size());
+	graph_stats.transient_bytes = 0;
+	graph_stats.unaliased_bytes = 0;
+	graph_stats.lazy_bytes = 0;
+
+	for (const MemoryBlock& block : blocks) {
+		graph_stats.transient_bytes += block.requirements.size;
+		graph_stats.lazy_bytes += is_lazy(block.requirements.memoryTypeBits) ? block.requirements.size : 0;
+	}
+
+	for (size_t i = 0; i < transients.size(); i++) {
+		resources[transients[i]].image = transient_images[i].image;
+		resources[transients[i]].image_view = transient_images[i].image_view;
+		graph_stats.unaliased_bytes += requirements[transients[i]].size;
+	}
+}
+
+
+void RenderGraph::compute_barriers(const std::vector<int64_t>& previous_alias) {
+
+	// Each resource is tracked as a whole: its barriers cover all of its levels and layers
+	vk_barrier::StateTracker tracker;
+	std::vector<bool> started(resources.size(), false);
+	final_barriers = Barriers{};
+
+	auto start = [&](ResourceId r) {
+
+		const Resource& resource = resources[r];
+		started[r] = true;
+
+		if (!resource.is_image) {
+			tracker.add_buffer(resource.buffer, VK_WHOLE_SIZE, resource.initial);
+			return;
+		}
+
+		Access initial = resource.initial;
+		if (!resource.imported) {
+			// Aliased memory: wait for the last uses of the previous image, the contents are discarded
+			initial = Access{};
+			if (previous_alias[r] >= 0 && tracker.tracks_image(resources[previous_alias[r]].image)) {
+				initial = tracker.remove_image(resources[previous_alias[r]].image);
+				initial.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			}
+		}
+		tracker.add_image(resource.image, resource.aspect, 1, 1, initial);
+	};
+
+	auto use = [&](ResourceId r, const Access& access) {
+
+		if (!started[r]) {
+			start(r);
+		}
+
+		if (resources[r].is_image) {
+			tracker.use_image(resources[r].image, access);
+		}
+		else {
+			tracker.use_buffer(resources[r].buffer, access);
+		}
+	};
+
+	auto take = [&](Barriers& barriers) {
+
+		tracker.take(barriers.image_barriers, barriers.buffer_barriers);
+
+		for (VkImageMemoryBarrier2& barrier : barriers.image_barriers) {
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		}
+	};
+
+	for (ResourceId r = 0; r < resources.size(); r++) {
+		if (resources[r].imported) {
+			start(r);
+		}
+	}
+
+	for (Pass& pass : passes) {
+
+		if (pass.culled) {
+			continue;
+		}
+
+		for (const Use& pass_use : pass.uses) {
+			use(pass_use.resource, pass_use.access);
+		}
+		take(pass.barriers);
+	}
+
+	// Leave the imported resources as the outside of the graph expects them
+	for (ResourceId r = 0; r < resources.size(); r++) {
+
+		const Resource& resource = resources[r];
+
+		bool keep_state = resource.is_image ? resource.final.layout == VK_IMAGE_LAYOUT_UNDEFINED
+			                                : resource.final.stage == VK_PIPELINE_STAGE_2_NONE;
+
+		if (resource.imported && !keep_state) {
+			use(r, resource.final);
+		}
+	}
+	take(final_barriers);
+
+	graph_stats.redundant_barrier_count = tracker.stats().redundant_count;
+	graph_stats.merged_barrier_count = tracker.stats().merged_count;
+}
+
+
+void RenderGraph::execute(VkCommandBuffer command_buffer) const {
+
+	for (uint32_t p = 0; p < passes.size(); p++) {
+
+		const Pass& pass = passes[p];
+
+		if (pass.culled) {
+			continue;
+		}
+
+		record_barriers(command_buffer, pass.barriers);
+
+		executing_pass = p;
+		pass.record(command_buffer, *this);
+	}
+
+	record_barriers(command_buffer, final_barriers);
+}
+
+
+void RenderGraph::record_barriers(VkCommandBuffer command_buffer, const Barriers& barriers) {
+
+	if (barriers.image_barriers.empty() && barriers.buffer_barriers.empty()) {
+		return;
+	}
+
+	VkDependencyInfo dependency_info{};
+	dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.image_barriers.size());
+	dependency_info.pImageMemoryBarriers = barriers.image_barriers.data();
+	dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(barriers.buffer_barriers.size());
+	dependency_info.pBufferMemoryBarriers = barriers.buffer_barriers.data();
+
+	vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+
+VkImage RenderGraph::image(ResourceId resource) const {
+
+	return resources.at(resource).image;
+}
+
+
+VkImageView RenderGraph::image_view(ResourceId resource) const {
+
+	return resources.at(resource).image_view;
+}
+
+
+VkBuffer RenderGraph::buffer(ResourceId resource) const {
+
+	return resources.at(resource).buffer;
+}
+
+
+VkAttachmentStoreOp RenderGraph::store_op(ResourceId resource) const {
+
+	const Resource& used = resources.at(resource);
+
+	if (used.imported || used.last_pass > executing_pass) {
+		return VK_ATTACHMENT_STORE_OP_STORE;
+	}
+
+	return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+}
+
+
+void RenderGraph::report() const {
+
+	LOG_MESSAGE("Render graph: " + std::to_string(graph_stats.pass_count - graph_stats.culled_pass_count) + " pass(es), " +
+		        std::to_string(graph_stats.culled_pass_count) + " culled", Color::Yellow, Color::Black, 0);
+
+	for (const Pass& pass : passes) {
+		LOG_MESSAGE(pass.name + (pass.culled ? " (culled)" : "") + " | barriers: " +
+			        std::to_string(pass.barriers.image_barriers.size() + pass.barriers.buffer_barriers.size()),
+			        pass.culled ? Color::Bright_Black : Color::Bright_White, Color::Black, 4);
+	}
+
+	std::ostringstream memory_log;
+	memory_log << std::fixed << std::setprecision(2)
+		<< "Transient images: " << graph_stats.transient_image_count
+		<< ", memory: " << to_mib(graph_stats.transient_bytes) << " MiB"
+		<< " (" << to_mib(graph_stats.unaliased_bytes) << " MiB without aliasing, "
+		<< to_mib(graph_stats.lazy_bytes) << " MiB lazily allocated)";
+
+	LOG_MESSAGE("Barriers per frame: " + std::to_string(graph_stats.image_barrier_count) + " image, " +
+		        std::to_string(graph_stats.buffer_barrier_count) + " buffer, in " +
+		        std::to_string(graph_stats.barrier_batch_count) + " batch(es), " +
+		        std::to_string(graph_stats.redundant_barrier_count) + " redundant dropped, " +
+		        std::to_string(graph_stats.merged_barrier_count) + " merged", Color::Bright_Green, Color::Black, 4);
+	LOG_MESSAGE(memory_log.str(), Color::Bright_Green, Color::Black, 4);
+
+	compile_stats.report("render graph | compile");
+}
+
+
+void RenderGraph::record_counters(vk_profiler::TraceRecorder& trace) const {
+
+	trace.add_counter("render graph", {
+		{ "barriers", static_cast<double>(graph_stats.image_barrier_count + graph_stats.buffer_barrier_count) },
+		{ "transient MiB", to_mib(graph_stats.transient_bytes) } });
+}
+
+
+} // namespace vk_graph
\ No newline at end of file
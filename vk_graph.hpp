@@ -0,0 +1,216 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_handle.hpp"
+#include "vk_profiler.hpp"
+#include "vk_barrier.hpp"
+
+#include <string>
+#include <vector>
+#include <functional>
+
+
+namespace vk_graph {
+
+
+// How a pass uses a resource (see vk_barrier)
+using vk_barrier::Access;
+
+using vk_barrier::SWAPCHAIN_ACQUIRED;
+using vk_barrier::PRESENT;
+using vk_barrier::COLOR_ATTACHMENT_WRITE;
+using vk_barrier::DEPTH_ATTACHMENT_WRITE;
+using vk_barrier::DEPTH_ATTACHMENT_READ;
+using vk_barrier::FRAGMENT_SAMPLED_READ;
+using vk_barrier::COMPUTE_SAMPLED_READ;
+using vk_barrier::COMPUTE_STORAGE_READ;
+using vk_barrier::COMPUTE_STORAGE_WRITE;
+using vk_barrier::TRANSFER_READ;
+using vk_barrier::TRANSFER_WRITE;
+
+using vk_barrier::is_write;
+
+
+using ResourceId = uint32_t;
+
+
+// A transient image, only used inside the graph.
+// Its usage flags are derived from the accesses of the passes.
+struct ImageDesc {
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+
+// A resource used by a pass
+struct Use {
+
+	ResourceId resource;
+	Access access;
+};
+
+
+class RenderGraph;
+
+// Records the commands of a pass, the barriers it needs are already recorded
+using PassCallback = std::function<void(VkCommandBuffer command_buffer, const RenderGraph& graph)>;
+
+
+// What the last compiled graph costs per frame
+struct GraphStats {
+
+	uint32_t pass_count = 0;
+	uint32_t culled_pass_count = 0;
+
+	uint32_t barrier_batch_count = 0; // vkCmdPipelineBarrier2() calls
+	uint32_t image_barrier_count = 0;
+	uint32_t buffer_barrier_count = 0;
+	uint32_t redundant_barrier_count = 0; // declared uses that needed no barrier
+	uint32_t merged_barrier_count = 0;    // barriers merged into another of the same batch
+
+	uint32_t transient_image_count = 0;
+	VkDeviceSize transient_bytes = 0; // memory of the transient images, with aliasing
+	VkDeviceSize unaliased_bytes = 0; // what they would take without aliasing
+	VkDeviceSize lazy_bytes = 0;      // part of transient_bytes in lazily allocated memory
+};
+
+
+/*
+Frame graph: each frame the passes are declared with the resources they read and write,
+then compile() works out everything that is implicit in a hand-written frame:
+- passes that contribute nothing to an output (an imported resource) are culled,
+- the barriers and layout transitions between passes are computed from the declared
+  accesses by a vk_barrier::StateTracker, and the ones needed before a pass are recorded
+  in a single vkCmdPipelineBarrier2(),
+- transient images whose lifetimes (first to last pass that uses them) do not overlap
+  share the same memory. Their contents are undefined at the start of every frame.
+  The ones only used as attachments are created with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+  in lazily allocated memory when the device has it (see vk_attachment).
+Transient images are kept between frames as long as the graph declares the same ones,
+and released through the deletion queue otherwise.
+Only one frame may be in flight: a frame can alias memory the previous one still uses.
+*/
+class RenderGraph {
+
+public:
+
+	RenderGraph(VkPhysicalDevice physical_device, VkDevice device, vk_handle::DeletionQueue* deletion_queue);
+
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	// Forget the passes and resources of the previous frame (the transient images are kept)
+	void reset();
+
+	// An image owned outside the graph, in the initial state when the graph starts
+	// and left in the final state. Imported resources are the outputs of the graph.
+	ResourceId import_image(
+		const std::string& name, VkImage image, VkImageView image_view,
+		VkImageAspectFlags aspect, const Access& initial, const Access& final);
+
+	ResourceId import_buffer(
+		const std::string& name, VkBuffer buffer,
+		const Access& initial, const Access& final);
+
+	ResourceId create_image(const std::string& name, const ImageDesc& desc);
+
+	// Passes run in the order they are added
+	void add_pass(const std::string& name, const std::vector<Use>& uses, PassCallback record);
+
+	// Cull, compute the barriers and allocate the transient images
+	void compile();
+
+	// Record the live passes and their barriers
+	void execute(VkCommandBuffer command_buffer) const;
+
+	VkImage image(ResourceId resource) const;
+	VkImageView image_view(ResourceId resource) const;
+	VkBuffer buffer(ResourceId resource) const;
+
+	// Store op for an attachment of the pass being recorded: DONT_CARE if it is a transient
+	// image that no later pass uses, so its tile is never written back to memory.
+	// Only valid inside a pass callback.
+	VkAttachmentStoreOp store_op(ResourceId resource) const;
+
+	const GraphStats& stats() const { return graph_stats; }
+
+	// Log the passes, barriers and transient memory of the last compiled graph
+	void report() const;
+
+	// Barriers and transient memory as counter tracks of a trace
+	void record_counters(vk_profiler::TraceRecorder& trace) const;
+
+private:
+
+	struct Resource {
+		std::string name;
+		bool is_image;
+		bool imported;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView image_view = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		Access initial;
+		Access final;
+
+		ImageDesc desc;               // transient images
+		VkImageUsageFlags usage = 0;  // transient images, from the accesses
+		uint32_t last_pass = 0;       // transient images, last live pass that uses it
+	};
+
+	struct Barriers {
+		std::vector<VkImageMemoryBarrier2> image_barriers;
+		std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+	};
+
+	struct Pass {
+		std::string name;
+		std::vector<Use> uses;
+		PassCallback record;
+
+		bool culled = false;
+		Barriers barriers; // recorded before the pass
+	};
+
+	// Transient images of the last allocation, in declaration order
+	struct TransientImage {
+		ImageDesc desc;
+		VkImageUsageFlags usage;
+		uint32_t memory_block;
+		vk_handle::Handle<VkImage> image;
+		vk_handle::Handle<VkImageView> image_view;
+	};
+
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	vk_handle::DeletionQueue* deletion_queue;
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	Barriers final_barriers; // into the final state of the imported resources
+
+	std::vector<TransientImage> transient_images;
+	std::vector<vk_handle::Handle<VkDeviceMemory>> transient_memory;
+
+	GraphStats graph_stats;
+	mutable uint32_t executing_pass = 0; // pass whose callback is running, for store_op()
+	vk_profiler::TimingStats compile_stats;
+
+	void cull_passes();
+
+	// Place the transient images of the live passes in memory blocks, (re)creating them if needed.
+	// previous_alias gets, for each resource, the image that used its memory before it (or -1).
+	void allocate_transient_images(std::vector<int64_t>& previous_alias);
+
+	void compute_barriers(const std::vector<int64_t>& previous_alias);
+
+	static void record_barriers(VkCommandBuffer command_buffer, const Barriers& barriers);
+};
+
+
+} // namespace vk_graph
\ No newline at end of file
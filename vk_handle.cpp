@@ -0,0 +1,159 @@
+#include "vk_handle.hpp"
+#include "vk_buffer.hpp"
+
+
+namespace vk_handle {
+
+
+DeletionQueue::~DeletionQueue() {
+
+	flush();
+}
+
+
+void DeletionQueue::push(std::function<void()> destroy) {
+
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	pending.push_back({ current_frame, std::move(destroy) });
+}
+
+
+void DeletionQueue::end_frame() {
+
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	current_frame++;
+}
+
+
+uint64_t DeletionQueue::frame_index() const {
+
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return current_frame;
+}
+
+
+void DeletionQueue::collect(uint64_t completed_frames) {
+
+	std::vector<std::function<void()>> retired;
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+
+		while (!pending.empty() && pending.front().frame < completed_frames) {
+			retired.push_back(std::move(pending.front().destroy));
+			pending.pop_front();
+		}
+	}
+
+	// Destroy outside the lock, in release order
+	for (auto& destroy : retired) {
+		destroy();
+	}
+}
+
+
+void DeletionQueue::flush() {
+
+	std::deque<PendingDeletion> retired;
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		retired.swap(pending);
+	}
+
+	for (auto& deletion : retired) {
+		deletion.destroy();
+	}
+}
+
+
+size_t DeletionQueue::size() const {
+
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return pending.size();
+}
+
+
+void destroy_handle(VkDevice device, VkSwapchainKHR swapchain) {
+
+	vkDestroySwapchainKHR(device, swapchain, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkImage image) {
+
+	vkDestroyImage(device, image, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkImageView image_view) {
+
+	vkDestroyImageView(device, image_view, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkFramebuffer framebuffer) {
+
+	vkDestroyFramebuffer(device, framebuffer, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkRenderPass render_pass) {
+
+	vkDestroyRenderPass(device, render_pass, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkPipeline pipeline) {
+
+	vkDestroyPipeline(device, pipeline, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkPipelineCache pipeline_cache) {
+
+	vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkCommandPool command_pool) {
+
+	vkDestroyCommandPool(device, command_pool, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkSemaphore semaphore) {
+
+	vkDestroySemaphore(device, semaphore, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkFence fence) {
+
+	vkDestroyFence(device, fence, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkQueryPool query_pool) {
+
+	vkDestroyQueryPool(device, query_pool, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkDescriptorPool descriptor_pool) {
+
+	vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkBuffer buffer) {
+
+	vkDestroyBuffer(device, buffer, nullptr);
+}
+
+
+void destroy_handle(VkDevice device, VkDeviceMemory memory) {
+
+	vk_buffer::free_memory(memory, device);
+}
+
+
+} // namespace vk_handle
\ No newline at end of file
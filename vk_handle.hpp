@@ -0,0 +1,206 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+
+namespace vk_handle {
+
+
+/*
+Destroys Vulkan objects once the GPU is done with every frame that may still use them.
+Objects released while frame N is recorded (or before it is submitted) are tagged N
+and destroyed by collect() once frame N has completed, so nothing waits for the device
+to be idle when an object is replaced in the middle of the run.
+Thread safe, objects are destroyed on the thread that calls collect() or flush().
+*/
+class DeletionQueue {
+
+public:
+
+	DeletionQueue() = default;
+	~DeletionQueue();
+
+	DeletionQueue(const DeletionQueue&) = delete;
+	DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+	// Destroy the object later, when the current frame has completed
+	void push(std::function<void()> destroy);
+
+	// A frame has been submitted: objects released from now on may be used by the next one
+	void end_frame();
+
+	// Frames submitted so far, the index of the frame being recorded
+	uint64_t frame_index() const;
+
+	// The first completed_frames frames have completed (their fence was waited on):
+	// destroy the objects they were the last to use
+	void collect(uint64_t completed_frames);
+
+	// Destroy everything now. Every submitted frame must have completed,
+	// and the device must still exist.
+	void flush();
+
+	size_t size() const;
+
+private:
+
+	struct PendingDeletion {
+		uint64_t frame; // last frame that may use the object
+		std::function<void()> destroy;
+	};
+
+	mutable std::mutex queue_mutex;
+	std::deque<PendingDeletion> pending; // ordered by frame, then by release
+	uint64_t current_frame = 0;
+};
+
+
+// Destroy a handle with the matching vkDestroy*() / vkFree*() function.
+// Overloaded by type: non-dispatchable handles are distinct pointer types on 64 bit targets only,
+// on 32 bit targets they are all uint64_t (so is Handle<T>). The project only has x64 configurations.
+static_assert(sizeof(void*) == 8, "vk_handle needs the distinct non-dispatchable handle types of a 64 bit target");
+
+void destroy_handle(VkDevice device, VkSwapchainKHR swapchain);
+void destroy_handle(VkDevice device, VkImage image);
+void destroy_handle(VkDevice device, VkImageView image_view);
+void destroy_handle(VkDevice device, VkFramebuffer framebuffer);
+void destroy_handle(VkDevice device, VkRenderPass render_pass);
+void destroy_handle(VkDevice device, VkPipeline pipeline);
+void destroy_handle(VkDevice device, VkPipelineCache pipeline_cache);
+void destroy_handle(VkDevice device, VkCommandPool command_pool);
+void destroy_handle(VkDevice device, VkSemaphore semaphore);
+void destroy_handle(VkDevice device, VkFence fence);
+void destroy_handle(VkDevice device, VkQueryPool query_pool);
+void destroy_handle(VkDevice device, VkDescriptorPool descriptor_pool);
+void destroy_handle(VkDevice device, VkBuffer buffer);
+void destroy_handle(VkDevice device, VkDeviceMemory memory); // vk_buffer::free_memory()
+
+
+/*
+Move-only owner of a Vulkan object created from a device.
+With a deletion queue the object is destroyed once the frames that may use it
+have completed, otherwise as soon as the owner lets it go.
+Converts implicitly to the raw handle, so it can be given to any Vulkan function.
+*/
+template <typename T>
+class Handle {
+
+public:
+
+	Handle() = default;
+
+	Handle(T handle, VkDevice device, DeletionQueue* deletion_queue)
+		: handle(handle), device(device), deletion_queue(deletion_queue) {
+	}
+
+	~Handle() {
+
+		reset();
+	}
+
+	Handle(const Handle&) = delete;
+	Handle& operator=(const Handle&) = delete;
+
+	Handle(Handle&& other) noexcept
+		: handle(other.handle), device(other.device), deletion_queue(other.deletion_queue) {
+
+		other.handle = VK_NULL_HANDLE;
+	}
+
+	Handle& operator=(Handle&& other) noexcept {
+
+		if (this != &other) {
+			reset();
+			handle = other.handle;
+			device = other.device;
+			deletion_queue = other.deletion_queue;
+			other.handle = VK_NULL_HANDLE;
+		}
+
+		return *this;
+	}
+
+	// Release the current object and own new_handle, with the same device and deletion queue
+	void replace(T new_handle) {
+
+		reset();
+		handle = new_handle;
+	}
+
+	// Release the object: queued for deletion, or destroyed right away without a queue
+	void reset() {
+
+		if (handle == VK_NULL_HANDLE) {
+			return;
+		}
+
+		if (deletion_queue != nullptr) {
+			VkDevice owner = device;
+			T released = handle;
+			deletion_queue->push([owner, released] { destroy_handle(owner, released); });
+		}
+		else {
+			destroy_handle(device, handle);
+		}
+
+		handle = VK_NULL_HANDLE;
+	}
+
+	// Give up ownership without destroying the object
+	T release() {
+
+		T released = handle;
+		handle = VK_NULL_HANDLE;
+		return released;
+	}
+
+	T get() const { return handle; }
+	operator T() const { return handle; }
+
+	// For the Vulkan functions that take an array of handles (vkWaitForFences...)
+	const T* ptr() const { return &handle; }
+
+private:
+
+	T handle = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	DeletionQueue* deletion_queue = nullptr;
+};
+
+
+// Take ownership of every handle of a vector (e.g. from vk_core::create_image_views())
+template <typename T>
+std::vector<Handle<T>> to_handles(const std::vector<T>& handles, VkDevice device, DeletionQueue* deletion_queue) {
+
+	std::vector<Handle<T>> owned;
+	owned.reserve(handles.size());
+
+	for (T handle : handles) {
+		owned.emplace_back(handle, device, deletion_queue);
+	}
+
+	return owned;
+}
+
+
+// Raw handles of a vector of owners, still owned by them
+template <typename T>
+std::vector<T> to_raw(const std::vector<Handle<T>>& handles) {
+
+	std::vector<T> raw;
+	raw.reserve(handles.size());
+
+	for (const Handle<T>& handle : handles) {
+		raw.push_back(handle.get());
+	}
+
+	return raw;
+}
+
+
+} // namespace vk_handle
\ No newline at end of file
@@ -0,0 +1,347 @@
+#include "vk_hot_reload.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <cstdlib>		// system()
+#include <chrono>
+#include <filesystem>
+#include <map>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_hot_reload {
+
+
+// Time to wait after a change before compiling,
+// editors often write a file several times when saving it
+static const std::chrono::milliseconds DEBOUNCE_TIME(100);
+
+// Polling interval of the watcher (also how fast stop() returns)
+static const std::chrono::milliseconds POLL_INTERVAL(250);
+
+
+ShaderHotReload::ShaderHotReload(VkDevice device, const std::string& shader_directory)
+	: device(device), shader_directory(shader_directory) {
+}
+
+
+ShaderHotReload::~ShaderHotReload() {
+
+	stop();
+}
+
+
+void ShaderHotReload::add_pipeline(vk_handle::Handle<VkPipeline>& pipeline, VkPipelineLayout& pipeline_layout,
+	                               const std::vector<std::string>& spirv_files, PipelineBuilder builder) {
+
+	if (running) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Pipelines must be added before starting shader hot reload! \033[0m \n");
+	}
+
+	watched_pipelines.push_back({ &pipeline, &pipeline_layout, spirv_files, builder });
+}
+
+
+void ShaderHotReload::start() {
+
+	if (running) {
+		return;
+	}
+
+	LOG_MESSAGE("Starting shader hot reload on " + shader_directory + "...", Color::Yellow, Color::Black, 0);
+
+	running = true;
+	watcher_thread = std::thread(&ShaderHotReload::watch_loop, this);
+	compiler_thread = std::thread(&ShaderHotReload::compile_loop, this);
+
+	LOG_MESSAGE("Shader hot reload started. \n", Color::Yellow, Color::Black, 0);
+}
+
+
+void ShaderHotReload::stop() {
+
+	if (!running) {
+		return;
+	}
+
+	running = false;
+	changes_cv.notify_all();
+
+	watcher_thread.join();
+	compiler_thread.join();
+
+	// Pipelines rebuilt but never swapped in are not used by any frame
+	std::lock_guard<std::mutex> lock(rebuilt_mutex);
+	for (const auto& rebuilt : rebuilt_pipelines) {
+		vkDestroyPipeline(device, rebuilt.pipeline, nullptr);
+	}
+	rebuilt_pipelines.clear();
+
+	LOG_MESSAGE("Shader hot reload stopped.", Color::Bright_Blue, Color::Black, 0);
+}
+
+
+uint32_t ShaderHotReload::apply_pending() {
+
+	std::vector<RebuiltPipeline> pending;
+	{
+		// Never block the render loop on the compiler thread
+		std::unique_lock<std::mutex> lock(rebuilt_mutex, std::try_to_lock);
+		if (!lock.owns_lock() || rebuilt_pipelines.empty()) {
+			return 0;
+		}
+		pending.swap(rebuilt_pipelines);
+	}
+
+	for (const auto& rebuilt : pending) {
+
+		WatchedPipeline& watched = watched_pipelines[rebuilt.index];
+
+		watched.pipeline->replace(rebuilt.pipeline);
+		*watched.pipeline_layout = rebuilt.pipeline_layout;
+	}
+
+	LOG_MESSAGE("Hot reloaded " + std::to_string(pending.size()) + " pipeline(s).", Color::Bright_Green, Color::Black, 0);
+
+	return static_cast<uint32_t>(pending.size());
+}
+
+
+std::string ShaderHotReload::spirv_file_name(const std::string& glsl_file_name) {
+
+	std::filesystem::path path(glsl_file_name);
+	std::string stem = path.stem().string();
+	std::string stage = path.extension().string().substr(1); // without the dot
+
+	if (stem == "shader") {
+		return stage + ".spv";
+	}
+
+	return stem + "_" + stage + ".spv";
+}
+
+
+void ShaderHotReload::notify_change(const std::string& file_name) {
+
+	{
+		std::lock_guard<std::mutex> lock(changes_mutex);
+		changed_files.insert(file_name);
+	}
+	changes_cv.notify_one();
+}
+
+
+void ShaderHotReload::watch_loop() {
+
+#ifdef __linux__
+
+	int inotify_fd = inotify_init1(IN_NONBLOCK);
+	if (inotify_fd < 0 ||
+		inotify_add_watch(inotify_fd, shader_directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+
+		LOG_MESSAGE("Failed to watch " + shader_directory + ", shader hot reload disabled.", Color::Red, Color::Black, 0);
+		if (inotify_fd >= 0) {
+			close(inotify_fd);
+		}
+		return;
+	}
+
+	// Events are variable sized, the buffer must be aligned for inotify_event
+	alignas(inotify_event) char events_buffer[4096];
+
+	while (running) {
+
+		pollfd poll_fd{ inotify_fd, POLLIN, 0 };
+		if (poll(&poll_fd, 1, static_cast<int>(POLL_INTERVAL.count())) <= 0) {
+			continue;
+		}
+
+		ssize_t length = read(inotify_fd, events_buffer, sizeof(events_buffer));
+
+		for (ssize_t offset = 0; offset < length; ) {
+
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(events_buffer + offset);
+
+			if (event->len > 0 && is_shader_source(event->name)) {
+				notify_change(event->name);
+			}
+
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+
+	close(inotify_fd);
+
+#else
+
+	// No inotify: poll the modification time of the sources
+	std::map<std::string, std::filesystem::file_time_type> write_times;
+
+	auto scan = [&](bool notify) {
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(shader_directory, error)) {
+
+			std::string file_name = entry.path().filename().string();
+			if (!entry.is_regular_file(error) || !is_shader_source(file_name)) {
+				continue;
+			}
+
+			auto write_time = entry.last_write_time(error);
+			auto it = write_times.find(file_name);
+
+			if (it == write_times.end() || it->second != write_time) {
+				write_times[file_name] = write_time;
+				if (notify) {
+					notify_change(file_name);
+				}
+			}
+		}
+	};
+
+	scan(false);
+
+	while (running) {
+		std::this_thread::sleep_for(POLL_INTERVAL);
+		scan(true);
+	}
+
+#endif
+}
+
+
+void ShaderHotReload::compile_loop() {
+
+	while (running) {
+
+		std::set<std::string> glsl_files;
+		{
+			std::unique_lock<std::mutex> lock(changes_mutex);
+			changes_cv.wait(lock, [this] { return !running || !changed_files.empty(); });
+
+			if (!running) {
+				return;
+			}
+		}
+
+		// Let the burst of writes of a single save settle, then take all of them
+		std::this_thread::sleep_for(DEBOUNCE_TIME);
+		{
+			std::lock_guard<std::mutex> lock(changes_mutex);
+			glsl_files.swap(changed_files);
+		}
+
+		std::set<std::string> spirv_files;
+		for (const auto& file : glsl_files) {
+			if (compile_shader(file)) {
+				spirv_files.insert(spirv_file_name(file));
+			}
+		}
+
+		if (!spirv_files.empty()) {
+			rebuild_pipelines(spirv_files);
+		}
+	}
+}
+
+
+bool ShaderHotReload::compile_shader(const std::string& glsl_file_name) {
+
+	// LV_GLSLC overrides the compiler, otherwise use the one of the Vulkan SDK
+	std::string glslc = "glslc";
+	if (auto path = get_env("LV_GLSLC")) {
+		glslc = *path;
+	}
+	else if (auto sdk = get_env("VULKAN_SDK")) {
+	#ifdef _WIN32
+		glslc = *sdk + "/Bin/glslc.exe";
+	#else
+		glslc = *sdk + "/bin/glslc";
+	#endif
+	}
+
+	std::string source = shader_directory + "/" + glsl_file_name;
+	std::string output = shader_directory + "/" + spirv_file_name(glsl_file_name);
+
+	// The target environment of the subgroup shaders in compile_shaders.bat: the device is at least Vulkan 1.1
+	std::string command = "\"" + glslc + "\" --target-env=vulkan1.1 \"" + source + "\" -o \"" + output + "\"";
+#ifdef _WIN32
+	// cmd.exe strips the outer quotes of a command that starts with a quote
+	command = "\"" + command + "\"";
+#endif
+
+	LOG_MESSAGE("Compiling " + source + "...", Color::Bright_White, Color::Black, 0);
+
+	if (std::system(command.c_str()) != 0) {
+		// Keep the previous SPIR-V and pipelines, the next save will retry
+		LOG_MESSAGE("Failed to compile " + source + ", keeping the previous pipeline.", Color::Red, Color::Black, 4);
+		return false;
+	}
+
+	return true;
+}
+
+
+void ShaderHotReload::rebuild_pipelines(const std::set<std::string>& spirv_files) {
+
+	for (size_t i = 0; i < watched_pipelines.size(); i++) {
+
+		const WatchedPipeline& watched = watched_pipelines[i];
+
+		bool affected = false;
+		for (const auto& file : watched.spirv_files) {
+			affected = affected || spirv_files.count(file) > 0;
+		}
+
+		if (!affected) {
+			continue;
+		}
+
+		RebuiltPipeline rebuilt{ i, VK_NULL_HANDLE, VK_NULL_HANDLE };
+
+		try {
+			watched.builder(rebuilt.pipeline, rebuilt.pipeline_layout);
+		}
+		catch (const std::exception& ex) {
+			// e.g. a stage interface mismatch, the old pipeline stays in use
+			std::cerr << ex.what() << std::endl;
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(rebuilt_mutex);
+
+		// A newer build of the same pipeline replaces one that was never swapped in
+		for (auto it = rebuilt_pipelines.begin(); it != rebuilt_pipelines.end(); ) {
+			if (it->index == i) {
+				vkDestroyPipeline(device, it->pipeline, nullptr);
+				it = rebuilt_pipelines.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		rebuilt_pipelines.push_back(rebuilt);
+	}
+}
+
+
+bool is_shader_source(const std::string& file_name) {
+
+	std::string extension = std::filesystem::path(file_name).extension().string();
+
+	return extension == ".vert" || extension == ".frag" || extension == ".comp";
+}
+
+
+} // namespace vk_hot_reload
\ No newline at end of file
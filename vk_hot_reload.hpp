@@ -0,0 +1,107 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_handle.hpp"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+namespace vk_hot_reload {
+
+
+// Builds a new pipeline from the current SPIR-V files and returns its layout.
+// Called on the background thread, so it must not touch render loop state.
+// Layouts are owned by the vk_reflect::LayoutCache, only pipelines are destroyed here.
+using PipelineBuilder = std::function<void(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout)>;
+
+
+/*
+Watches the GLSL sources in a shader directory (*.vert, *.frag, *.comp).
+When one changes it is recompiled to SPIR-V with glslc on a background thread
+and every pipeline that uses it is rebuilt on the same thread.
+The render loop picks the new pipelines up at a frame boundary with apply_pending(),
+so it never waits for a compilation. The replaced pipelines are released through their
+handle, so they are destroyed once the frames that use them have completed.
+
+SPIR-V naming follows shaders/compile_shaders.bat:
+shader.vert -> vert.spv, any other name.vert -> name_vert.spv (name.comp -> name_comp.spv)
+*/
+class ShaderHotReload {
+
+public:
+
+	ShaderHotReload(VkDevice device, const std::string& shader_directory);
+	~ShaderHotReload();
+
+	ShaderHotReload(const ShaderHotReload&) = delete;
+	ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+	// Register a pipeline built from the given SPIR-V files (e.g. "vert.spv").
+	// The handles are replaced in place by apply_pending().
+	void add_pipeline(
+		vk_handle::Handle<VkPipeline>& pipeline, VkPipelineLayout& pipeline_layout,
+		const std::vector<std::string>& spirv_files, PipelineBuilder builder);
+
+	void start();
+	void stop();
+
+	// Swap in every pipeline rebuilt since the last call and release the old ones
+	// (the layout handle is updated too, in case the shader interface changed).
+	// Call it at a frame boundary, before recording the next frame.
+	// Returns the number of pipelines swapped.
+	uint32_t apply_pending();
+
+	// Name of the SPIR-V file compiled from a GLSL source
+	static std::string spirv_file_name(const std::string& glsl_file_name);
+
+private:
+
+	struct WatchedPipeline {
+		vk_handle::Handle<VkPipeline>* pipeline;
+		VkPipelineLayout* pipeline_layout;
+		std::vector<std::string> spirv_files;
+		PipelineBuilder builder;
+	};
+
+	struct RebuiltPipeline {
+		size_t index; // into watched_pipelines
+		VkPipeline pipeline;
+		VkPipelineLayout pipeline_layout;
+	};
+
+	VkDevice device;
+	std::string shader_directory;
+	std::vector<WatchedPipeline> watched_pipelines;
+
+	std::atomic<bool> running{ false };
+	std::thread watcher_thread;
+	std::thread compiler_thread;
+
+	std::mutex changes_mutex;
+	std::condition_variable changes_cv;
+	std::set<std::string> changed_files; // GLSL file names
+
+	std::mutex rebuilt_mutex;
+	std::vector<RebuiltPipeline> rebuilt_pipelines;
+
+	void watch_loop();
+	void compile_loop();
+
+	void notify_change(const std::string& file_name);
+	bool compile_shader(const std::string& glsl_file_name);
+	void rebuild_pipelines(const std::set<std::string>& spirv_files);
+};
+
+
+// True for the GLSL stage extensions that are watched
+bool is_shader_source(const std::string& file_name);
+
+
+} // namespace vk_hot_reload
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "vk_input.hpp"
+
+
+namespace vk_input {
+
+
+EventForwarder::EventForwarder(GLFWwindow* window, size_t capacity)
+	: window(window), queue(capacity) {
+
+	// The state before the first callback
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	framebuffer_size = (static_cast<uint64_t>(width) << 32) | static_cast<uint32_t>(height);
+	minimized = glfwGetWindowAttrib(window, GLFW_ICONIFIED) == GLFW_TRUE;
+	focused = glfwGetWindowAttrib(window, GLFW_FOCUSED) == GLFW_TRUE;
+	state_changed();
+
+	glfwSetWindowUserPointer(window, this);
+
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetCursorPosCallback(window, cursor_position_callback);
+	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetWindowIconifyCallback(window, iconify_callback);
+	glfwSetWindowFocusCallback(window, focus_callback);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+}
+
+
+EventForwarder::~EventForwarder() {
+
+	glfwSetKeyCallback(window, nullptr);
+	glfwSetMouseButtonCallback(window, nullptr);
+	glfwSetCursorPosCallback(window, nullptr);
+	glfwSetScrollCallback(window, nullptr);
+	glfwSetWindowIconifyCallback(window, nullptr);
+	glfwSetWindowFocusCallback(window, nullptr);
+	glfwSetFramebufferSizeCallback(window, nullptr);
+
+	glfwSetWindowUserPointer(window, nullptr);
+}
+
+
+void EventForwarder::post(WindowEvent event) {
+
+	event.posted = std::chrono::steady_clock::now();
+
+	if (queue.try_push(event)) {
+		posted_count++;
+	}
+	else {
+		dropped_count++;
+	}
+}
+
+
+bool EventForwarder::try_post_close() {
+
+	WindowEvent event;
+	event.type = WindowEvent::Type::Close;
+	event.posted = std::chrono::steady_clock::now();
+
+	if (!queue.try_push(event)) {
+		return false;
+	}
+
+	posted_count++;
+	return true;
+}
+
+
+void EventForwarder::state_changed() {
+
+	state_version.fetch_add(1, std::memory_order_release);
+}
+
+
+bool EventForwarder::take_window_state(WindowState& state) {
+
+	// A change made while the fields are read bumps the version again: taken again next time
+	uint64_t version = state_version.load(std::memory_order_acquire);
+	if (version == taken_version) {
+		return false;
+	}
+	taken_version = version;
+
+	uint64_t size = framebuffer_size.load(std::memory_order_relaxed);
+	state.width = static_cast<uint32_t>(size >> 32);
+	state.height = static_cast<uint32_t>(size);
+	state.minimized = minimized.load(std::memory_order_relaxed);
+	state.focused = focused.load(std::memory_order_relaxed);
+
+	return true;
+}
+
+
+EventForwarder* EventForwarder::from(GLFWwindow* window) {
+
+	return static_cast<EventForwarder*>(glfwGetWindowUserPointer(window));
+}
+
+
+void EventForwarder::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+
+	WindowEvent event;
+	event.type = WindowEvent::Type::Key;
+	event.key = key;
+	event.scancode = scancode;
+	event.action = action;
+	event.mods = mods;
+
+	from(window)->post(event);
+}
+
+
+void EventForwarder::mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+
+	WindowEvent event;
+	event.type = WindowEvent::Type::MouseButton;
+	event.key = button;
+	event.action = action;
+	event.mods = mods;
+
+	from(window)->post(event);
+}
+
+
+void EventForwarder::cursor_position_callback(GLFWwindow* window, double x, double y) {
+
+	WindowEvent event;
+	event.type = WindowEvent::Type::CursorPosition;
+	event.x = x;
+	event.y = y;
+
+	from(window)->post(event);
+}
+
+
+void EventForwarder::scroll_callback(GLFWwindow* window, double x, double y) {
+
+	WindowEvent event;
+	event.type = WindowEvent::Type::Scroll;
+	event.x = x;
+	event.y = y;
+
+	from(window)->post(event);
+}
+
+
+void EventForwarder::iconify_callback(GLFWwindow* window, int iconified) {
+
+	EventForwarder* forwarder = from(window);
+	forwarder->minimized.store(iconified == GLFW_TRUE, std::memory_order_relaxed);
+	forwarder->state_changed();
+}
+
+
+void EventForwarder::focus_callback(GLFWwindow* window, int focused) {
+
+	EventForwarder* forwarder = from(window);
+	forwarder->focused.store(focused == GLFW_TRUE, std::memory_order_relaxed);
+	forwarder->state_changed();
+}
+
+
+void EventForwarder::framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+
+	EventForwarder* forwarder = from(window);
+	forwarder->framebuffer_size.store((static_cast<uint64_t>(width) << 32) | static_cast<uint32_t>(height),
+		                              std::memory_order_relaxed);
+	forwarder->state_changed();
+}
+
+
+} // namespace vk_input
\ No newline at end of file
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+
+namespace vk_input {
+
+
+/*
+Lock-free single producer, single consumer ring of capacity (rounded up to a power of 2) values.
+try_push() is only called by the producer thread, try_pop() only by the consumer thread; neither
+ever blocks. Each side caches the index of the other one and only reloads it (one acquire) when
+the ring looks full or empty, and the indices written by each side are on their own cache line.
+*/
+template <typename T>
+class SpscQueue {
+
+public:
+
+	explicit SpscQueue(size_t capacity) {
+
+		size_t size = 1;
+		while (size < capacity) {
+			size *= 2;
+		}
+
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer: false if the ring is full
+	bool try_push(const T& value) {
+
+		size_t tail = tail_index.load(std::memory_order_relaxed);
+
+		if (tail - head_cache == slots.size()) {
+			head_cache = head_index.load(std::memory_order_acquire);
+			if (tail - head_cache == slots.size()) {
+				return false;
+			}
+		}
+
+		slots[tail & mask] = value;
+		tail_index.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: false if the ring is empty
+	bool try_pop(T& value) {
+
+		size_t head = head_index.load(std::memory_order_relaxed);
+
+		if (head == tail_cache) {
+			tail_cache = tail_index.load(std::memory_order_acquire);
+			if (head == tail_cache) {
+				return false;
+			}
+		}
+
+		value = slots[head & mask];
+		head_index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+
+	std::vector<T> slots;
+	size_t mask = 0;
+
+	alignas(64) std::atomic<size_t> head_index{ 0 }; // written by the consumer
+	size_t tail_cache = 0;                           // consumer only
+
+	alignas(64) std::atomic<size_t> tail_index{ 0 }; // written by the producer
+	size_t head_cache = 0;                           // producer only
+};
+
+
+// Input, from the GLFW callbacks
+struct WindowEvent {
+
+	enum class Type {
+		Key,            // key, scancode, action, mods
+		MouseButton,    // key (the button), action, mods
+		CursorPosition, // x, y
+		Scroll,         // x, y
+		Close           // try_post_close(): the consumer stops
+	};
+
+	Type type = Type::Close;
+	int key = 0;
+	int scancode = 0;
+	int action = 0;
+	int mods = 0;
+	double x = 0.0;
+	double y = 0.0;
+	std::chrono::steady_clock::time_point posted; // by the GLFW thread
+};
+
+
+// The latest state of a window: only the last value matters, the intermediate ones are not kept
+struct WindowState {
+	uint32_t width = 0;    // framebuffer size in pixels, 0 x 0 when minimized
+	uint32_t height = 0;
+	bool minimized = false;
+	bool focused = false;
+};
+
+
+/*
+Forwards the events of a window from the GLFW thread (the main thread, which alone may process the
+events) to another thread, the render thread, through a SpscQueue: installs the callbacks of the
+window on construction and removes them on destruction, both on the GLFW thread. The GLFW thread
+then only waits for events; the render thread drains events() and takes the window state before
+each frame. Input events that find the queue full are dropped and counted. The window state
+(framebuffer size, minimized, focused) does not go through the queue: each change overwrites
+a single slot of atomics, so it is never dropped, only coalesced.
+*/
+class EventForwarder {
+
+public:
+
+	explicit EventForwarder(GLFWwindow* window, size_t capacity = 1024);
+	~EventForwarder();
+
+	EventForwarder(const EventForwarder&) = delete;
+	EventForwarder& operator=(const EventForwarder&) = delete;
+
+	// Consumer side
+	SpscQueue<WindowEvent>& events() { return queue; }
+
+	// Consumer side: false if the window state has not changed since the last call
+	// (the first call always returns the state read on construction)
+	bool take_window_state(WindowState& state);
+
+	// GLFW thread: tell the consumer to stop. False if the queue is full: try again once the consumer
+	// has drained it (and not if the consumer has stopped).
+	bool try_post_close();
+
+	// GLFW thread
+	uint64_t posted_events() const { return posted_count; }
+	uint64_t dropped_events() const { return dropped_count; }
+
+private:
+
+	GLFWwindow* window;
+	SpscQueue<WindowEvent> queue;
+	uint64_t posted_count = 0;
+	uint64_t dropped_count = 0;
+
+	// Written by the GLFW thread, then state_version is incremented (release)
+	std::atomic<uint64_t> framebuffer_size{ 0 }; // width << 32 | height
+	std::atomic<bool> minimized{ false };
+	std::atomic<bool> focused{ false };
+	std::atomic<uint64_t> state_version{ 0 };
+	uint64_t taken_version = 0; // consumer only
+
+	void post(WindowEvent event);
+	void state_changed();
+
+	static EventForwarder* from(GLFWwindow* window);
+	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+	static void cursor_position_callback(GLFWwindow* window, double x, double y);
+	static void scroll_callback(GLFWwindow* window, double x, double y);
+	static void iconify_callback(GLFWwindow* window, int iconified);
+	static void focus_callback(GLFWwindow* window, int focused);
+	static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+};
+
+
+} // namespace vk_input
\ No newline at end of file
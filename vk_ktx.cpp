@@ -0,0 +1,504 @@
+#include "vk_ktx.hpp"
+#include "vk_buffer.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <cstring>		// memcpy(), memcmp()
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>	// max()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_ktx {
+
+
+// «KTX 20»\r\n\x1A\n
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Level offsets in the staging memory, a multiple of every texel block size
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+
+// Header after the identifier, then the index (KTX 2.0 specification, little endian)
+struct Ktx2Header {
+	uint32_t vk_format;
+	uint32_t type_size;
+	uint32_t pixel_width;
+	uint32_t pixel_height;
+	uint32_t pixel_depth;
+	uint32_t layer_count;
+	uint32_t face_count;
+	uint32_t level_count;
+	uint32_t supercompression_scheme;
+	uint32_t dfd_byte_offset;
+	uint32_t dfd_byte_length;
+	uint32_t kvd_byte_offset;
+	uint32_t kvd_byte_length;
+	uint64_t sgd_byte_offset;
+	uint64_t sgd_byte_length;
+};
+
+// Entry of the level index, right after the header
+struct Ktx2LevelIndex {
+	uint64_t byte_offset;
+	uint64_t byte_length;
+	uint64_t uncompressed_byte_length;
+};
+
+
+static VkExtent2D level_extent(VkExtent2D extent, uint32_t level) {
+
+	return { std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u) };
+}
+
+
+static void throw_invalid(const std::string& file_path, const std::string& reason) {
+
+	std::cout << "\033[31;40m";
+	throw std::runtime_error("Invalid KTX2 file " + file_path + ": " + reason + "! \033[0m \n");
+}
+
+
+Ktx2File open_ktx2(const std::string& file_path) {
+
+	Ktx2File ktx;
+	ktx.file = map_file(file_path);
+
+	const char* data = ktx.file.data();
+	const size_t size = ktx.file.size();
+
+	if (size < sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header) ||
+		std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		throw_invalid(file_path, "not a KTX2 file");
+	}
+
+	Ktx2Header header;
+	std::memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+
+	if (header.supercompression_scheme != 0) {
+		throw_invalid(file_path, "supercompressed (Basis Universal or zstd), transcode it to a BC format offline");
+	}
+	if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1) {
+		throw_invalid(file_path, "not a 2D texture");
+	}
+	if (header.layer_count > 1 || header.face_count != 1) {
+		throw_invalid(file_path, "arrays and cube maps are not supported");
+	}
+	if (header.vk_format == VK_FORMAT_UNDEFINED) {
+		throw_invalid(file_path, "no Vulkan format");
+	}
+
+	ktx.format = static_cast<VkFormat>(header.vk_format);
+	ktx.extent = { header.pixel_width, header.pixel_height };
+
+	uint32_t format_block_size = block_size(ktx.format);
+	if (format_block_size == 0) {
+		throw_invalid(file_path, "unsupported format " + std::to_string(ktx.format));
+	}
+	// Copies from the staging memory need offsets aligned to the texel size (e.g. R8G8B8, R32G32B32)
+	if (STAGING_ALIGNMENT % format_block_size != 0) {
+		throw_invalid(file_path, "format " + std::to_string(ktx.format) + " has " + std::to_string(format_block_size) +
+			          " byte texels, they must divide " + std::to_string(STAGING_ALIGNMENT) + " bytes");
+	}
+
+	// 0 levels asks the loader to generate the mips: only level 0 is stored
+	uint32_t level_count = std::max(header.level_count, 1u);
+	if (level_count > vk_texture::mip_level_count(ktx.extent)) {
+		throw_invalid(file_path, std::to_string(level_count) + " levels");
+	}
+
+	size_t index_offset = sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header);
+	if (size < index_offset + level_count * sizeof(Ktx2LevelIndex)) {
+		throw_invalid(file_path, "truncated level index");
+	}
+
+	ktx.levels.resize(level_count);
+
+	for (uint32_t level = 0; level < level_count; level++) {
+
+		Ktx2LevelIndex entry;
+		std::memcpy(&entry, data + index_offset + level * sizeof(Ktx2LevelIndex), sizeof(entry));
+
+		if (entry.byte_offset > size || entry.byte_length > size - entry.byte_offset) {
+			throw_invalid(file_path, "level " + std::to_string(level) + " past the end of the file");
+		}
+
+		VkDeviceSize expected_length = level_size(ktx.format, level_extent(ktx.extent, level));
+		if (entry.byte_length != expected_length) {
+			throw_invalid(file_path, "level " + std::to_string(level) + " is not " +
+				          std::to_string(expected_length) + " bytes");
+		}
+
+		ktx.levels[level] = { entry.byte_offset, entry.byte_length };
+	}
+
+	return ktx;
+}
+
+
+bool is_block_compressed(VkFormat format) {
+
+	return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+
+uint32_t block_extent(VkFormat format) {
+
+	return is_block_compressed(format) ? 4 : 1;
+}
+
+
+uint32_t block_size(VkFormat format) {
+
+	if (is_block_compressed(format)) {
+		switch (format) {
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+			case VK_FORMAT_BC4_SNORM_BLOCK:
+				return 8;
+			default:
+				return 16; // BC2, BC3, BC5, BC6H, BC7
+		}
+	}
+
+	switch (format) {
+		case VK_FORMAT_R8_UNORM:
+		case VK_FORMAT_R8_SNORM:
+		case VK_FORMAT_R8_UINT:
+		case VK_FORMAT_R8_SRGB:
+			return 1;
+		case VK_FORMAT_R8G8_UNORM:
+		case VK_FORMAT_R8G8_SNORM:
+		case VK_FORMAT_R8G8_UINT:
+		case VK_FORMAT_R8G8_SRGB:
+		case VK_FORMAT_R5G6B5_UNORM_PACK16:
+		case VK_FORMAT_R16_UNORM:
+		case VK_FORMAT_R16_SFLOAT:
+		case VK_FORMAT_R16_UINT:
+			return 2;
+		case VK_FORMAT_R8G8B8_UNORM:
+		case VK_FORMAT_R8G8B8_SRGB:
+		case VK_FORMAT_B8G8R8_UNORM:
+		case VK_FORMAT_B8G8R8_SRGB:
+			return 3;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SNORM:
+		case VK_FORMAT_R8G8B8A8_UINT:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+		case VK_FORMAT_R16G16_UNORM:
+		case VK_FORMAT_R16G16_SFLOAT:
+		case VK_FORMAT_R32_SFLOAT:
+		case VK_FORMAT_R32_UINT:
+			return 4;
+		case VK_FORMAT_R16G16B16_UNORM:
+		case VK_FORMAT_R16G16B16_SFLOAT:
+			return 6;
+		case VK_FORMAT_R16G16B16A16_UNORM:
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+		case VK_FORMAT_R32G32_SFLOAT:
+			return 8;
+		case VK_FORMAT_R32G32B32_SFLOAT:
+			return 12;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+
+VkDeviceSize level_size(VkFormat format, VkExtent2D extent) {
+
+	uint32_t texels = block_extent(format);
+
+	VkDeviceSize blocks_x = (extent.width + texels - 1) / texels;
+	VkDeviceSize blocks_y = (extent.height + texels - 1) / texels;
+
+	return blocks_x * blocks_y * block_size(format);
+}
+
+
+bool check_format_support(VkFormat format, VkPhysicalDevice physical_device, const vk_device::DeviceProbe& device_probe) {
+
+	if (is_block_compressed(format) && !device_probe.texture_compression_bc) {
+		return false;
+	}
+
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+
+	return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+
+bool has_cpu_decoder(VkFormat format) {
+
+	return (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC3_SRGB_BLOCK) ||
+		   format == VK_FORMAT_BC4_UNORM_BLOCK || format == VK_FORMAT_BC5_UNORM_BLOCK;
+}
+
+
+VkFormat decoded_format(VkFormat format) {
+
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			return VK_FORMAT_R8G8B8A8_SRGB;
+		default:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+
+/* ---------- CPU fallback: BC1 to BC5 blocks to RGBA8 ---------- */
+
+// 16 RGBA8 texels of a 4x4 block, row by row
+struct DecodedBlock {
+	uint8_t texels[16][4];
+};
+
+
+static void decode_color_block(const uint8_t* block, bool four_colors_only, bool opaque_black, DecodedBlock& decoded) {
+
+	uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+	uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+	uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+	// RGB565 expanded to 8 bits
+	int palette[4][4];
+	for (int c = 0; c < 2; c++) {
+		uint16_t color = (c == 0) ? c0 : c1;
+		int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		palette[c][0] = (r << 3) | (r >> 2);
+		palette[c][1] = (g << 2) | (g >> 4);
+		palette[c][2] = (b << 3) | (b >> 2);
+		palette[c][3] = 255;
+	}
+
+	for (int channel = 0; channel < 3; channel++) {
+		if (c0 > c1 || four_colors_only) {
+			palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+			palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+		}
+		else {
+			palette[2][channel] = (palette[0][channel] + palette[1][channel]) / 2;
+			palette[3][channel] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = (c0 > c1 || four_colors_only || opaque_black) ? 255 : 0;
+
+	for (int texel = 0; texel < 16; texel++) {
+		const int* color = palette[(indices >> (2 * texel)) & 3];
+		for (int channel = 0; channel < 4; channel++) {
+			decoded.texels[texel][channel] = static_cast<uint8_t>(color[channel]);
+		}
+	}
+}
+
+
+// BC4 block (BC3 alpha, BC5 red and green) into one channel of the texels
+static void decode_channel_block(const uint8_t* block, int channel, DecodedBlock& decoded) {
+
+	int values[8];
+	values[0] = block[0];
+	values[1] = block[1];
+
+	if (values[0] > values[1]) {
+		for (int i = 1; i < 7; i++) {
+			values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+		}
+	}
+	else {
+		for (int i = 1; i < 5; i++) {
+			values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+		}
+		values[6] = 0;
+		values[7] = 255;
+	}
+
+	// 16 indices of 3 bits
+	uint64_t indices = 0;
+	for (int i = 0; i < 6; i++) {
+		indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+	}
+
+	for (int texel = 0; texel < 16; texel++) {
+		decoded.texels[texel][channel] = static_cast<uint8_t>(values[(indices >> (3 * texel)) & 7]);
+	}
+}
+
+
+static void decode_block(VkFormat format, const uint8_t* block, DecodedBlock& decoded) {
+
+	switch (format) {
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			decode_color_block(block, false, true, decoded);
+			break;
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			decode_color_block(block, false, false, decoded);
+			break;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+			decode_color_block(block + 8, true, true, decoded);
+			for (int texel = 0; texel < 16; texel++) {
+				uint8_t alpha = (block[texel / 2] >> (4 * (texel % 2))) & 15;
+				decoded.texels[texel][3] = static_cast<uint8_t>(alpha * 17);
+			}
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			decode_color_block(block + 8, true, true, decoded);
+			decode_channel_block(block, 3, decoded);
+			break;
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			decode_channel_block(block, 0, decoded);
+			for (int texel = 0; texel < 16; texel++) {
+				decoded.texels[texel][1] = 0;
+				decoded.texels[texel][2] = 0;
+				decoded.texels[texel][3] = 255;
+			}
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			decode_channel_block(block, 0, decoded);
+			decode_channel_block(block + 8, 1, decoded);
+			for (int texel = 0; texel < 16; texel++) {
+				decoded.texels[texel][2] = 0;
+				decoded.texels[texel][3] = 255;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+
+// Decode a level into tightly packed RGBA8 texels, the blocks past the edges are clipped
+static void decode_level(VkFormat format, const uint8_t* blocks, VkExtent2D extent, uint8_t* output) {
+
+	uint32_t blocks_x = (extent.width + 3) / 4;
+	uint32_t blocks_y = (extent.height + 3) / 4;
+	uint32_t size = block_size(format);
+
+	DecodedBlock decoded{};
+
+	for (uint32_t by = 0; by < blocks_y; by++) {
+		for (uint32_t bx = 0; bx < blocks_x; bx++) {
+
+			decode_block(format, blocks + (static_cast<size_t>(by) * blocks_x + bx) * size, decoded);
+
+			for (uint32_t y = 0; y < 4 && by * 4 + y < extent.height; y++) {
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < extent.width; x++) {
+					size_t texel = static_cast<size_t>(by * 4 + y) * extent.width + bx * 4 + x;
+					std::memcpy(output + texel * 4, decoded.texels[y * 4 + x], 4);
+				}
+			}
+		}
+	}
+}
+
+/* ---------- ---------- */
+
+
+void LoadReport::report() const {
+
+	std::ostringstream log;
+	log << std::fixed << std::setprecision(2)
+		<< name << " | format " << file_format << (cpu_decoded ? " decoded on the CPU" : "")
+		<< ", " << levels << " levels, loaded in " << load_ms << " ms"
+		<< " | " << memory_bytes / 1024.0 / 1024.0 << " MiB (file " << file_bytes / 1024.0 / 1024.0 << " MiB)";
+
+	if (memory_bytes > 0) {
+		log << ", " << static_cast<double>(rgba8_bytes) / memory_bytes << "x smaller than RGBA8";
+	}
+
+	LOG_MESSAGE(log.str(), Color::Bright_Green, Color::Black, 4);
+}
+
+
+vk_texture::Texture load_ktx2(const std::string& file_path,
+	                          vk_texture::TextureUploader& uploader,
+	                          VkPhysicalDevice physical_device, const vk_device::DeviceProbe& device_probe,
+	                          LoadReport* report) {
+
+	auto start = std::chrono::steady_clock::now();
+
+	Ktx2File ktx = open_ktx2(file_path);
+
+	bool cpu_decode = !check_format_support(ktx.format, physical_device, device_probe);
+
+	if (cpu_decode && !has_cpu_decoder(ktx.format)) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("The device can not sample format " + std::to_string(ktx.format) + " of " + file_path +
+			                     ", and the CPU fallback only decodes BC1 to BC5 UNORM! \033[0m \n");
+	}
+
+	VkFormat texture_format = cpu_decode ? decoded_format(ktx.format) : ktx.format;
+
+	// Level offsets in the staging memory
+	std::vector<VkDeviceSize> level_offsets(ktx.levels.size());
+	VkDeviceSize staging_size = 0;
+	VkDeviceSize rgba8_size = 0;
+
+	for (uint32_t level = 0; level < ktx.levels.size(); level++) {
+
+		VkExtent2D extent = level_extent(ktx.extent, level);
+		VkDeviceSize rgba8_level_size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+		level_offsets[level] = staging_size;
+		staging_size += vk_buffer::align_size(cpu_decode ? rgba8_level_size : ktx.levels[level].length, STAGING_ALIGNMENT);
+		rgba8_size += rgba8_level_size;
+	}
+
+	// The only copy of the texels on the host: from the file pages to the staging memory
+	uint8_t* staging = static_cast<uint8_t*>(uploader.map_staging(staging_size));
+
+	for (uint32_t level = 0; level < ktx.levels.size(); level++) {
+
+		const uint8_t* level_data = reinterpret_cast<const uint8_t*>(ktx.file.data()) + ktx.levels[level].offset;
+
+		if (cpu_decode) {
+			decode_level(ktx.format, level_data, level_extent(ktx.extent, level), staging + level_offsets[level]);
+		}
+		else {
+			std::memcpy(staging + level_offsets[level], level_data, ktx.levels[level].length);
+		}
+	}
+
+	std::string name = std::filesystem::path(file_path).filename().string();
+	vk_texture::Texture texture = uploader.create_texture_from_staging(name, ktx.extent, texture_format, level_offsets);
+
+	if (report != nullptr) {
+		report->name = name;
+		report->file_format = ktx.format;
+		report->texture_format = texture_format;
+		report->cpu_decoded = cpu_decode;
+		report->levels = static_cast<uint32_t>(ktx.levels.size());
+		report->load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		report->file_bytes = ktx.file.size();
+		report->memory_bytes = texture.size;
+		report->rgba8_bytes = rgba8_size;
+	}
+
+	return texture;
+}
+
+
+} // namespace vk_ktx
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_texture.hpp"
+#include "vk_device.hpp"
+#include "my_util.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace vk_ktx {
+
+
+// A KTX2 file of a 2D texture, mapped: its levels are read from the mapping, never copied into host memory
+struct Ktx2File {
+
+	my_util::MappedFile file;
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+
+	struct Level {
+		uint64_t offset = 0; // in the file
+		uint64_t length = 0;
+	};
+
+	std::vector<Level> levels; // level 0 (the largest) first
+};
+
+
+// Map a KTX2 file and read its header and level index.
+// Only single layer, single face 2D textures without supercompression (no Basis, no zstd) are accepted.
+Ktx2File open_ktx2(const std::string& file_path);
+
+
+// True for the BC1 to BC7 formats
+bool is_block_compressed(VkFormat format);
+
+
+// Texels per side of a texel block: 4 for the BC formats, 1 for the others
+uint32_t block_extent(VkFormat format);
+
+
+// Bytes per texel block: 8 for BC1 and BC4, 16 for the other BC formats,
+// the texel size of the uncompressed formats. 0 for the formats the loader does not know.
+uint32_t block_size(VkFormat format);
+
+
+// Bytes of a level of extent (whole blocks)
+VkDeviceSize level_size(VkFormat format, VkExtent2D extent);
+
+
+// True if the device can sample format as it is (textureCompressionBC found by the probe,
+// enabled by vk_core::create_logical_device() then)
+bool check_format_support(VkFormat format, VkPhysicalDevice physical_device, const vk_device::DeviceProbe& device_probe);
+
+
+// True if the CPU fallback can decode format: BC1, BC2, BC3, and BC4 and BC5 UNORM
+bool has_cpu_decoder(VkFormat format);
+
+
+// RGBA8 format the CPU fallback decodes format to (sRGB for the sRGB formats)
+VkFormat decoded_format(VkFormat format);
+
+
+// How a texture was loaded
+struct LoadReport {
+
+	std::string name;
+	VkFormat file_format = VK_FORMAT_UNDEFINED;
+	VkFormat texture_format = VK_FORMAT_UNDEFINED; // decoded_format() with the CPU fallback
+	bool cpu_decoded = false;
+	uint32_t levels = 0;
+
+	double load_ms = 0.0;         // mapping, parsing and filling the staging memory (CPU)
+	VkDeviceSize file_bytes = 0;
+	VkDeviceSize memory_bytes = 0; // of the image
+	VkDeviceSize rgba8_bytes = 0;  // of the same levels in RGBA8
+
+	// Log one line: format, levels, load time, memory and its ratio to RGBA8
+	void report() const;
+};
+
+
+/*
+Load a KTX2 texture and record its upload in uploader (nothing runs until its submit()).
+Block compressed levels the device can sample are copied from the file mapping straight into
+the staging memory, with no decoding: the image keeps the compressed format, 4 to 8 times smaller
+than RGBA8 and as much cheaper to sample. Without device support for the format, BC1 to BC5
+are decoded to RGBA8 on the CPU into the staging memory instead; other formats throw.
+Uncompressed formats are copied as they are.
+*/
+vk_texture::Texture load_ktx2(
+	const std::string& file_path,
+	vk_texture::TextureUploader& uploader,
+	VkPhysicalDevice physical_device, const vk_device::DeviceProbe& device_probe,
+	LoadReport* report = nullptr);
+
+
+} // namespace vk_ktx
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "vk_memory.hpp"
+#include "vk_buffer.hpp"
+#include "my_util.hpp"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>	// max()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_memory {
+
+
+static double to_mib(VkDeviceSize bytes) {
+
+	return static_cast<double>(bytes) / 1024.0 / 1024.0;
+}
+
+
+MemoryTelemetry::MemoryTelemetry(VkPhysicalDevice physical_device, bool budget_extension, double pressure_threshold)
+	: physical_device(physical_device), budget_extension(budget_extension), pressure_threshold(pressure_threshold) {
+
+	sample();
+}
+
+
+void MemoryTelemetry::sample() {
+
+	vk_profiler::ScopedTimer timer(sample_stats);
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+	budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memory_properties{};
+	memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memory_properties.pNext = budget_extension ? &budget_properties : nullptr;
+
+	vkGetPhysicalDeviceMemoryProperties2(physical_device, &memory_properties);
+
+	vk_buffer::AllocationStats allocation_stats = vk_buffer::get_allocation_stats();
+
+	uint32_t heap_count = memory_properties.memoryProperties.memoryHeapCount;
+	heap_samples.resize(heap_count);
+	heap_pressure.resize(heap_count, false);
+
+	for (uint32_t i = 0; i < heap_count; i++) {
+
+		HeapSample& heap = heap_samples[i];
+		heap.size = memory_properties.memoryProperties.memoryHeaps[i].size;
+		heap.flags = memory_properties.memoryProperties.memoryHeaps[i].flags;
+		heap.allocated = allocation_stats.heap_bytes[i];
+
+		if (budget_extension) {
+			heap.budget = budget_properties.heapBudget[i];
+			heap.usage = budget_properties.heapUsage[i];
+		}
+		else {
+			heap.budget = heap.size;
+			heap.usage = heap.allocated;
+		}
+
+		heap.peak_usage = std::max(heap.peak_usage, heap.usage);
+
+		// Only report crossings, not every frame spent above the threshold
+		bool pressure = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.budget > 0 &&
+			            static_cast<double>(heap.usage) > pressure_threshold * static_cast<double>(heap.budget);
+
+		if (pressure && !heap_pressure[i]) {
+
+			std::ostringstream pressure_log;
+			pressure_log << std::fixed << std::setprecision(1)
+				<< "Memory pressure on heap " << i << ": " << to_mib(heap.usage)
+				<< " MiB used of a " << to_mib(heap.budget) << " MiB budget";
+
+			LOG_MESSAGE(pressure_log.str(), Color::Red, Color::Black, 0);
+		}
+		heap_pressure[i] = pressure;
+	}
+}
+
+
+bool MemoryTelemetry::under_pressure() const {
+
+	return std::find(heap_pressure.begin(), heap_pressure.end(), true) != heap_pressure.end();
+}
+
+
+void MemoryTelemetry::report() const {
+
+	LOG_MESSAGE(std::string("Memory telemetry") + (budget_extension ? " (VK_EXT_memory_budget):" : " (no VK_EXT_memory_budget, usage = allocated):"),
+		        Color::Yellow, Color::Black, 0);
+	LOG_MESSAGE("Heap \t | Size MiB \t | Budget MiB \t | Usage MiB \t | Allocated MiB \t | Peak MiB", Color::White, Color::Black, 4);
+
+	for (size_t i = 0; i < heap_samples.size(); i++) {
+
+		const HeapSample& heap = heap_samples[i];
+
+		std::ostringstream heap_log;
+		heap_log << std::fixed << std::setprecision(1)
+			<< i << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device)" : " (host)")
+			<< " \t | " << to_mib(heap.size)
+			<< " \t | " << to_mib(heap.budget)
+			<< " \t | " << to_mib(heap.usage)
+			<< " \t | " << to_mib(heap.allocated)
+			<< " \t\t | " << to_mib(heap.peak_usage);
+
+		LOG_MESSAGE(heap_log.str(), heap_pressure[i] ? Color::Red : Color::Bright_Green, Color::Black, 4);
+	}
+
+	sample_stats.report("memory telemetry | sample");
+}
+
+
+void MemoryTelemetry::record_counters(vk_profiler::TraceRecorder& trace) const {
+
+	for (size_t i = 0; i < heap_samples.size(); i++) {
+
+		trace.add_counter("heap " + std::to_string(i) + " MiB", {
+			{ "usage", to_mib(heap_samples[i].usage) },
+			{ "allocated", to_mib(heap_samples[i].allocated) },
+			{ "budget", to_mib(heap_samples[i].budget) } });
+	}
+}
+
+
+} // namespace vk_memory
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_profiler.hpp"
+
+#include <vector>
+
+
+namespace vk_memory {
+
+
+struct HeapSample {
+
+	VkDeviceSize size = 0;
+	VkMemoryHeapFlags flags = 0;
+
+	VkDeviceSize budget = 0;    // how much the process can use before the driver starts paging
+	VkDeviceSize usage = 0;     // used by the process, driver internal memory included
+	VkDeviceSize allocated = 0; // allocated by the application (vk_buffer)
+	VkDeviceSize peak_usage = 0;
+};
+
+
+/*
+Per-heap memory budget and usage, sampled every frame.
+With VK_EXT_memory_budget the budget and the usage come from the driver:
+the budget shrinks when other processes need video memory, so pressure is
+detected before the driver starts moving allocations to system memory.
+Without it the budget is the heap size and the usage is what the application allocated.
+The difference between usage and allocated is memory the driver allocated
+for us (swapchain images, pipelines, command buffers...).
+*/
+class MemoryTelemetry {
+
+public:
+
+	// A DEVICE_LOCAL heap is under pressure above pressure_threshold (0..1) of its budget
+	MemoryTelemetry(VkPhysicalDevice physical_device, bool budget_extension, double pressure_threshold);
+
+	// Call once per frame. Logs when a heap goes under pressure.
+	void sample();
+
+	const std::vector<HeapSample>& heaps() const { return heap_samples; }
+
+	bool under_pressure() const;
+
+	// Log budget, usage, allocated and peak usage of every heap
+	void report() const;
+
+	// Usage and budget of every heap as counter tracks of a trace
+	void record_counters(vk_profiler::TraceRecorder& trace) const;
+
+private:
+
+	VkPhysicalDevice physical_device;
+	bool budget_extension;
+	double pressure_threshold;
+
+	std::vector<HeapSample> heap_samples;
+	std::vector<bool> heap_pressure;
+
+	vk_profiler::TimingStats sample_stats; // cost of sample()
+};
+
+
+} // namespace vk_memory
\ No newline at end of file
@@ -0,0 +1,302 @@
+#include "vk_particles.hpp"
+#include "my_util.hpp"
+
+#include <glm/ext/matrix_clip_space.hpp> // perspectiveRH_ZO()
+#include <glm/ext/matrix_transform.hpp>  // lookAt()
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <filesystem>
+#include <numeric>		// iota()
+#include <algorithm>	// min()
+#include <cmath>		// sin(), cos()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_particles {
+
+
+// Half size of a particle, in world units
+static const float PARTICLE_SIZE = 0.02f;
+
+// Push constants of particles_simulate.comp
+struct SimulateConstants {
+	uint32_t count;
+	float delta_time;
+};
+
+// Push constants of particles_emit.comp
+struct EmitConstants {
+	uint32_t count;
+	uint32_t emit_count;
+	uint32_t seed;
+	float average_lifetime;
+};
+
+// Push constants of particles_depth_keys.comp
+struct DepthKeysConstants {
+	glm::mat4 view_projection;
+	uint32_t count;
+};
+
+
+bool check_particle_support(VkPhysicalDevice physical_device) {
+
+	for (const std::string& file : { SIMULATE_SHADER_FILE, EMIT_SHADER_FILE, DEPTH_KEYS_SHADER_FILE,
+		                             VERT_SHADER_FILE, FRAG_SHADER_FILE,
+		                             vk_primitives::SCAN_SHADER_FILE, vk_primitives::COMPACT_SHADER_FILE,
+		                             vk_primitives::RADIX_HISTOGRAM_SHADER_FILE, vk_primitives::RADIX_SCATTER_SHADER_FILE }) {
+
+		if (!std::filesystem::exists(file)) {
+			LOG_MESSAGE(file + " not found, run shaders/compile_shaders.bat first.", Color::Red, Color::Black, 4);
+			return false;
+		}
+	}
+
+	if (!vk_primitives::check_subgroup_support(physical_device)) {
+		LOG_MESSAGE("The device lacks the subgroup operations of the particle sort.", Color::Red, Color::Black, 4);
+		return false;
+	}
+
+	return true;
+}
+
+
+ParticleSystem::ParticleSystem(VkPhysicalDevice physical_device, VkDevice device,
+	                           uint32_t queue_family, VkQueue queue,
+	                           VkPipelineCache pipeline_cache, vk_reflect::LayoutCache& layout_cache,
+	                           uint32_t capacity)
+	: device(device), layout_cache(layout_cache), particle_capacity(capacity) {
+
+	LOG_MESSAGE("Creating particle system...", Color::Yellow, Color::Black, 0);
+
+	if (capacity == 0) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("A particle system needs room for at least one particle! \033[0m \n");
+	}
+
+	context = std::make_unique<vk_compute::ComputeContext>(physical_device, device, queue_family, queue,
+		                                                   pipeline_cache, layout_cache);
+	primitives = std::make_unique<vk_primitives::Primitives>(*context);
+
+	simulate_kernel = context->create_kernel(SIMULATE_SHADER_FILE);
+	emit_kernel = context->create_kernel(EMIT_SHADER_FILE);
+	depth_keys_kernel = context->create_kernel(DEPTH_KEYS_SHADER_FILE);
+
+	VkDeviceSize slot_bytes = static_cast<VkDeviceSize>(capacity) * sizeof(uint32_t);
+
+	particles = context->create_buffer(static_cast<VkDeviceSize>(capacity) * sizeof(Particle));
+	dead_flags = context->create_buffer(slot_bytes);
+	slot_indices = context->create_buffer(slot_bytes);
+	free_slots = context->create_buffer(slot_bytes);
+	free_count = context->create_buffer(sizeof(uint32_t));
+	depth_keys = context->create_buffer(slot_bytes);
+	draw_order = context->create_buffer(slot_bytes);
+	draw_arguments = context->create_buffer(sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+
+	// The only upload: the values compacted into the free list never change
+	std::vector<uint32_t> indices(capacity);
+	std::iota(indices.begin(), indices.end(), 0u);
+	context->upload(slot_indices, indices.data(), slot_bytes);
+
+	// Every particle starts dead (no life left)
+	context->fill(particles, 0);
+
+	// A step in the batch of the context: the scratch buffers of the primitives are grown
+	// to their final size here, they can not be grown while recording into a frame
+	record_step(0.0f, 0, glm::mat4(1.0f));
+	context->submit();
+
+	// One set for the particle pipeline, allocated on the first draw
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount = 2;
+
+	VkDescriptorPoolCreateInfo descriptor_pool_info{};
+	descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptor_pool_info.maxSets = 1;
+	descriptor_pool_info.poolSizeCount = 1;
+	descriptor_pool_info.pPoolSizes = &pool_size;
+
+	VkDescriptorPool new_descriptor_pool;
+	if (vkCreateDescriptorPool(device, &descriptor_pool_info, nullptr, &new_descriptor_pool) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Descriptor pool! \033[0m \n");
+	}
+	descriptor_pool = vk_handle::Handle<VkDescriptorPool>(new_descriptor_pool, device, nullptr);
+
+	LOG_MESSAGE("Particles: " + std::to_string(capacity) + ", " +
+		        std::to_string((particles.size + 5 * slot_bytes) / 1024 / 1024) + " MiB of buffers",
+		        Color::Bright_White, Color::Black, 4);
+	LOG_MESSAGE("Particle system created. \n", Color::Yellow, Color::Black, 0);
+}
+
+
+void ParticleSystem::record_update(VkCommandBuffer command_buffer, VkExtent2D extent) {
+
+	auto now = std::chrono::steady_clock::now();
+
+	float delta_time = 0.0f;
+	if (updated) {
+		delta_time = std::min(std::chrono::duration<float>(now - last_update).count(), MAX_TIME_STEP);
+	}
+	last_update = now;
+	updated = true;
+	time += delta_time;
+
+	// Emitted at the rate that replaces the particles dying in the steady state
+	float emission_rate = 0.9f * static_cast<float>(particle_capacity) / AVERAGE_LIFETIME;
+	float emission = emission_rate * delta_time + emission_remainder;
+	uint32_t emit_count = std::min(static_cast<uint32_t>(emission), particle_capacity);
+	emission_remainder = emission - static_cast<float>(emit_count);
+
+	context->begin_external(command_buffer);
+	record_step(delta_time, emit_count, camera(extent).view_projection);
+	context->end_external(VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT,
+		                  VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_HOST_READ_BIT);
+
+	frame_index++;
+}
+
+
+void ParticleSystem::record_step(float delta_time, uint32_t emit_count, const glm::mat4& view_projection) {
+
+	SimulateConstants simulate_constants{ particle_capacity, delta_time };
+	context->dispatch(simulate_kernel, { &particles, &dead_flags },
+		              &simulate_constants, sizeof(simulate_constants),
+		              context->group_count(particle_capacity, simulate_kernel));
+
+	primitives->compact(slot_indices, dead_flags, free_slots, free_count, particle_capacity);
+
+	// At least one invocation: it writes the draw arguments
+	EmitConstants emit_constants{ particle_capacity, emit_count, frame_index, AVERAGE_LIFETIME };
+	context->dispatch(emit_kernel, { &particles, &free_slots, &free_count, &draw_arguments },
+		              &emit_constants, sizeof(emit_constants),
+		              context->group_count(emit_count, emit_kernel));
+
+	DepthKeysConstants depth_keys_constants{ view_projection, particle_capacity };
+	context->dispatch(depth_keys_kernel, { &particles, &depth_keys, &draw_order },
+		              &depth_keys_constants, sizeof(depth_keys_constants),
+		              context->group_count(particle_capacity, depth_keys_kernel));
+
+	primitives->sort_pairs(depth_keys, draw_order, particle_capacity, 32);
+}
+
+
+void ParticleSystem::record_draw(VkCommandBuffer command_buffer,
+	                             VkPipeline pipeline, VkPipelineLayout pipeline_layout,
+	                             VkExtent2D extent) {
+
+	// The pipeline is recreated with the render path objects, possibly with another set layout
+	std::vector<VkDescriptorSetLayout> set_layouts = layout_cache.descriptor_set_layouts(pipeline_layout);
+	if (set_layouts.empty()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(VERT_SHADER_FILE + " declares no particle buffers! \033[0m \n");
+	}
+
+	// The previous frame has completed: its command buffer no longer uses the set
+	if (set_layouts[0] != descriptor_set_layout) {
+
+		vkResetDescriptorPool(device, descriptor_pool, 0);
+
+		VkDescriptorSetAllocateInfo descriptor_set_info{};
+		descriptor_set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descriptor_set_info.descriptorPool = descriptor_pool;
+		descriptor_set_info.descriptorSetCount = 1;
+		descriptor_set_info.pSetLayouts = &set_layouts[0];
+
+		if (vkAllocateDescriptorSets(device, &descriptor_set_info, &descriptor_set) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to allocate Vulkan Descriptor set! \033[0m \n");
+		}
+		descriptor_set_layout = set_layouts[0];
+
+		// The buffers are persistent: written once per set
+		VkDescriptorBufferInfo buffer_infos[2] = {};
+		buffer_infos[0].buffer = particles.buffer;
+		buffer_infos[0].range = VK_WHOLE_SIZE;
+		buffer_infos[1].buffer = draw_order.buffer;
+		buffer_infos[1].range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet descriptor_writes[2] = {};
+		for (uint32_t i = 0; i < 2; i++) {
+			descriptor_writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptor_writes[i].dstSet = descriptor_set;
+			descriptor_writes[i].dstBinding = i;
+			descriptor_writes[i].descriptorCount = 1;
+			descriptor_writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_writes[i].pBufferInfo = &buffer_infos[i];
+		}
+
+		vkUpdateDescriptorSets(device, 2, descriptor_writes, 0, nullptr);
+	}
+
+	Camera frame_camera = camera(extent);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkViewport viewport{};
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.extent = extent;
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout,
+		                    0, 1, &descriptor_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+		               0, sizeof(Camera), &frame_camera);
+
+	// One instance per alive particle: the count never comes back to the CPU
+	vkCmdDrawIndirect(command_buffer, draw_arguments.buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+}
+
+
+uint32_t ParticleSystem::alive_count() {
+
+	VkDrawIndirectCommand arguments{};
+	context->download(draw_arguments, &arguments, sizeof(arguments));
+
+	return arguments.instanceCount;
+}
+
+
+void ParticleSystem::watch(vk_hot_reload::ShaderHotReload& hot_reload) {
+
+	context->watch_kernel(hot_reload, simulate_kernel);
+	context->watch_kernel(hot_reload, emit_kernel);
+	context->watch_kernel(hot_reload, depth_keys_kernel);
+
+	primitives->watch(hot_reload);
+}
+
+
+ParticleSystem::Camera ParticleSystem::camera(VkExtent2D extent) const {
+
+	const float ORBIT_SPEED = 0.2f; // radians per second
+	const float ORBIT_RADIUS = 8.0f;
+
+	float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max(extent.height, 1u));
+
+	glm::vec3 eye(ORBIT_RADIUS * std::sin(time * ORBIT_SPEED), 3.0f, ORBIT_RADIUS * std::cos(time * ORBIT_SPEED));
+	glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// Vulkan clip space: depth in [0, 1] and y pointing down
+	glm::mat4 projection = glm::perspectiveRH_ZO(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+	projection[1][1] *= -1.0f;
+
+	Camera frame_camera;
+	frame_camera.view_projection = projection * view;
+	frame_camera.billboard_size = glm::vec2(projection[0][0], projection[1][1]) * PARTICLE_SIZE;
+
+	return frame_camera;
+}
+
+
+} // namespace vk_particles
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_compute.hpp"
+#include "vk_primitives.hpp"
+#include "vk_reflect.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <memory>
+#include <chrono>
+
+
+namespace vk_particles {
+
+
+// SPIR-V of the shaders/particles_*.comp kernels
+const std::string SIMULATE_SHADER_FILE = "shaders/particles_simulate_comp.spv";
+const std::string EMIT_SHADER_FILE = "shaders/particles_emit_comp.spv";
+const std::string DEPTH_KEYS_SHADER_FILE = "shaders/particles_depth_keys_comp.spv";
+
+// SPIR-V of the particle billboards, drawn with a DepthMode::Translucent pipeline
+const std::string VERT_SHADER_FILE = "shaders/particles_vert.spv";
+const std::string FRAG_SHADER_FILE = "shaders/particles_frag.spv";
+
+
+// True if every particle shader is compiled and the device has the subgroup operations
+// of the sort (see vk_primitives::check_subgroup_support())
+bool check_particle_support(VkPhysicalDevice physical_device);
+
+
+// A particle in the buffers (std430, same layout as in the shaders)
+struct Particle {
+
+	glm::vec3 position;
+	float life;         // seconds left, dead at 0
+	glm::vec3 velocity;
+	float lifetime;     // life when emitted
+};
+
+
+/*
+A fountain of up to capacity particles, simulated on the GPU in the command buffer
+of each frame, without any per-particle work on the CPU:
+- integration: gravity, drag and bounces on the ground, each particle loses its life
+  and dies when it runs out; the dead slots are flagged,
+- emission: the dead slots are compacted into a free list (vk_primitives), from which
+  the emit kernel takes the slots of the particles emitted this frame. It also writes the
+  number of alive particles into the arguments of the indirect draw,
+- sorting: the alive particles are sorted by view depth, back to front, with the radix sort
+  of vk_primitives (dead ones get the largest key: they end past the alive ones).
+The draw reads the particles in sorted order in the vertex shader, one billboard per instance.
+The particle buffers are persistent: nothing is reallocated or uploaded per frame.
+Only one frame may be in flight (the descriptor sets of a frame are recycled by the next one).
+*/
+class ParticleSystem {
+
+public:
+
+	// The compute context records on queue (of queue_family), which must be the queue of the frames
+	ParticleSystem(
+		VkPhysicalDevice physical_device, VkDevice device,
+		uint32_t queue_family, VkQueue queue,
+		VkPipelineCache pipeline_cache, vk_reflect::LayoutCache& layout_cache,
+		uint32_t capacity);
+
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// Advance the simulation by the time elapsed since the last update (at most MAX_TIME_STEP),
+	// emit and sort. Recorded outside of any rendering, and followed by the barrier of the draw.
+	void record_update(VkCommandBuffer command_buffer, VkExtent2D extent);
+
+	// Draw the particles of the last update with pipeline, inside the rendering of the scene
+	void record_draw(
+		VkCommandBuffer command_buffer,
+		VkPipeline pipeline, VkPipelineLayout pipeline_layout,
+		VkExtent2D extent);
+
+	// Rebuild the kernels (and those of the primitives) when the shader hot reload
+	// recompiles their shaders. The particle system must outlive hot_reload.
+	void watch(vk_hot_reload::ShaderHotReload& hot_reload);
+
+	// Particles alive after the last update, read back from the indirect draw arguments:
+	// the frame of the update must have completed
+	uint32_t alive_count();
+
+	uint32_t capacity() const { return particle_capacity; }
+
+	// Longest simulated step, so that a stall does not throw the particles through the ground
+	static constexpr float MAX_TIME_STEP = 1.0f / 30.0f;
+
+	// Average time a particle lives, the emission rate keeps the buffers about 90% full
+	static constexpr float AVERAGE_LIFETIME = 3.0f;
+
+private:
+
+	VkDevice device;
+	vk_reflect::LayoutCache& layout_cache;
+	uint32_t particle_capacity;
+
+	std::unique_ptr<vk_compute::ComputeContext> context;
+	std::unique_ptr<vk_primitives::Primitives> primitives;
+
+	vk_compute::Kernel simulate_kernel;
+	vk_compute::Kernel emit_kernel;
+	vk_compute::Kernel depth_keys_kernel;
+
+	vk_compute::Buffer particles;      // Particle per slot
+	vk_compute::Buffer dead_flags;     // 1 for the dead slots
+	vk_compute::Buffer slot_indices;   // 0, 1, 2... compacted into the free list
+	vk_compute::Buffer free_slots;     // dead slots, in order
+	vk_compute::Buffer free_count;
+	vk_compute::Buffer depth_keys;     // sort keys, farthest first
+	vk_compute::Buffer draw_order;     // slots sorted by depth_keys, read by the vertex shader
+	vk_compute::Buffer draw_arguments; // VkDrawIndirectCommand
+
+	// Set 0 of the particle pipeline, for the layout it was allocated with
+	vk_handle::Handle<VkDescriptorPool> descriptor_pool;
+	VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+
+	std::chrono::steady_clock::time_point last_update;
+	bool updated = false;
+	float time = 0.0f;               // simulated seconds, moves the camera
+	float emission_remainder = 0.0f; // fraction of a particle left to emit
+	uint32_t frame_index = 0;        // seeds the random numbers of the emission
+
+	// Camera orbiting the fountain, same layout as the push constants of particles.vert
+	struct Camera {
+		glm::mat4 view_projection;
+		glm::vec2 billboard_size; // half size of a particle in clip space, multiplied by the depth
+	};
+
+	Camera camera(VkExtent2D extent) const;
+
+	// Record the passes of a step into the current recording of the context
+	void record_step(float delta_time, uint32_t emit_count, const glm::mat4& view_projection);
+};
+
+
+} // namespace vk_particles
\ No newline at end of file
@@ -4,6 +4,9 @@
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <cstring>	 // memcmp()
+#include <filesystem>
 #include <stdexcept> // std::runtime_error()
 
 
@@ -14,49 +17,67 @@ namespace vk_pipeline {
 
 
 void create_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
-	                 VkRenderPass render_pass, VkDevice device) {
+	                 VkRenderPass render_pass, VkFormat color_format,
+	                 VkFormat depth_format, VkSampleCountFlagBits samples,
+	                 DepthMode depth_mode,
+	                 vk_config::RenderPath render_path,
+	                 const vk_variant::ShaderVariant& variant,
+	                 VkPipelineCache pipeline_cache,
+	                 vk_reflect::LayoutCache& layout_cache, VkDevice device) {
 
 	LOG_MESSAGE("Creating Vulkan Pipeline...", Color::Yellow, Color::Black, 0);
+	if (!variant.vert_specialization.empty() || !variant.frag_specialization.empty()) {
+		LOG_MESSAGE("Shader variant: " + variant.to_string(), Color::Bright_White, Color::Black, 4);
+	}
 
 	// Creating Shader modules
 	LOG_MESSAGE("Creating Shader modules...", Color::Bright_White, Color::Black, 4);
 
-	auto vert_shader = read_file("shaders/vert.spv");
-	auto frag_shader = read_file("shaders/frag.spv");
+	// Map both files concurrently
+	auto vert_shader_file = map_file_async(variant.vert_file);
+	auto frag_shader_file = map_file_async(variant.frag_file);
+	MappedFile vert_shader = vert_shader_file.get();
+	MappedFile frag_shader = frag_shader_file.get();
 
-	VkShaderModule vert_shader_module = create_shader_module(vert_shader, device);
-	VkShaderModule frag_shader_module = create_shader_module(frag_shader, device);
+	// The interface of each stage (descriptors, push constants, vertex inputs)
+	// is read from the SPIR-V itself instead of being written by hand
+	vk_reflect::ShaderReflection vert_reflection = vk_reflect::reflect_shader(vert_shader.words(), vert_shader.size() / sizeof(uint32_t));
+	vk_reflect::ShaderReflection frag_reflection = vk_reflect::reflect_shader(frag_shader.words(), frag_shader.size() / sizeof(uint32_t));
 
-	if (vert_shader_module == VK_NULL_HANDLE ) {
-		LOG_MESSAGE("Shader file: shader.vert", Color::Red, Color::Black, 0);
-	}
-	if (frag_shader_module == VK_NULL_HANDLE) {
-		LOG_MESSAGE("Shader file: shader.frag", Color::Red, Color::Black, 0);
-	}
+	variant.vert_specialization.validate(vert_reflection, variant.vert_file);
+	variant.frag_specialization.validate(frag_reflection, variant.frag_file);
 
+	// The modules are created last, right before the pipeline: nothing can throw while they are alive
 	VkPipelineShaderStageCreateInfo vert_shader_info{};
 	vert_shader_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vert_shader_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vert_shader_info.module = vert_shader_module;
-	vert_shader_info.pName = "main";
+	vert_shader_info.pName = vert_reflection.entry_point.c_str();
+	vert_shader_info.pSpecializationInfo = variant.vert_specialization.info(); // constants compiled into this variant
 
 	VkPipelineShaderStageCreateInfo frag_shader_info{};
 	frag_shader_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	frag_shader_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	frag_shader_info.module = frag_shader_module;
-	frag_shader_info.pName = "main";
+	frag_shader_info.pName = frag_reflection.entry_point.c_str();
+	frag_shader_info.pSpecializationInfo = variant.frag_specialization.info();
 
 	VkPipelineShaderStageCreateInfo shader_stages[] = {
 		vert_shader_info, frag_shader_info };
 
-	LOG_MESSAGE("Shader modules attached to the pipeline.", Color::Bright_White, Color::Black, 4);
+	// The depth pre-pass has no fragment shader: only the depth of the fragments is written
+	bool depth_only = depth_mode == DepthMode::DepthOnly;
+	bool translucent = depth_mode == DepthMode::Translucent || depth_mode == DepthMode::TranslucentAfterPrepass;
 
 
 	// Setting up Pipeline features
+	// Vertex attributes declared by the vertex shader, interleaved in binding 0
+	vk_reflect::VertexInputLayout vertex_input_layout = vk_reflect::build_vertex_input_layout(vert_reflection);
+
 	VkPipelineVertexInputStateCreateInfo vertex_input_info{};
 	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_info.vertexBindingDescriptionCount = 0;
-	vertex_input_info.vertexAttributeDescriptionCount = 0;
+	vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_input_layout.bindings.size());
+	vertex_input_info.pVertexBindingDescriptions = vertex_input_layout.bindings.data();
+	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input_layout.attributes.size());
+	vertex_input_info.pVertexAttributeDescriptions = vertex_input_layout.attributes.data();
 
 	VkPipelineInputAssemblyStateCreateInfo input_assembly{};
 	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -74,14 +95,14 @@ void create_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
 	rasterizer_info.rasterizerDiscardEnable = VK_FALSE;
 	rasterizer_info.polygonMode = VK_POLYGON_MODE_FILL; // fragments fill the area of polygons
 	rasterizer_info.lineWidth = 1.0f;
-	rasterizer_info.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer_info.cullMode = translucent ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT; // billboards are seen from both sides
 	rasterizer_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
 	rasterizer_info.depthBiasEnable = VK_FALSE;
 
 	VkPipelineMultisampleStateCreateInfo multisampling_info{};
 	multisampling_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampling_info.sampleShadingEnable = VK_FALSE;
-	multisampling_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling_info.rasterizationSamples = samples;
 
 	VkPipelineColorBlendAttachmentState color_blend_attachment{};
 	color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
@@ -90,17 +111,36 @@ void create_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
 		                                    VK_COLOR_COMPONENT_A_BIT;
 	color_blend_attachment.blendEnable = VK_FALSE;
 
+	// Straight alpha over what is already drawn: correct when drawn from back to front
+	if (translucent) {
+		color_blend_attachment.blendEnable = VK_TRUE;
+		color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+		color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+
 	VkPipelineColorBlendStateCreateInfo color_blending_info{};
 	color_blending_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	color_blending_info.logicOpEnable = VK_FALSE;
 	color_blending_info.logicOp = VK_LOGIC_OP_COPY;
-	color_blending_info.attachmentCount = 1;
+	color_blending_info.attachmentCount = depth_only ? 0 : 1;
 	color_blending_info.pAttachments = &color_blend_attachment;
 	color_blending_info.blendConstants[0] = 0.0f;
 	color_blending_info.blendConstants[1] = 0.0f;
 	color_blending_info.blendConstants[2] = 0.0f;
 	color_blending_info.blendConstants[3] = 0.0f;
 
+	VkPipelineDepthStencilStateCreateInfo depth_stencil_info{};
+	depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_stencil_info.depthTestEnable = VK_TRUE;
+	depth_stencil_info.depthWriteEnable = (depth_mode == DepthMode::EqualTest || translucent) ? VK_FALSE : VK_TRUE;
+	depth_stencil_info.depthCompareOp = depth_mode == DepthMode::EqualTest ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+	depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+	depth_stencil_info.stencilTestEnable = VK_FALSE;
+
 	std::vector<VkDynamicState> dynamic_states = {
 		VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
@@ -110,57 +150,175 @@ void create_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
 	dynamic_state_info.pDynamicStates = dynamic_states.data();
 
 
-	// Creating Pipeline layout
-	LOG_MESSAGE("Creating Vulkan Pipeline layout...", Color::Bright_White, Color::Black, 4);
+	// Getting the Pipeline layout generated from the shaders,
+	// shared with every other pipeline with the same interface
+	LOG_MESSAGE("Getting Vulkan Pipeline layout...", Color::Bright_White, Color::Black, 4);
 
-	VkPipelineLayoutCreateInfo pipeline_layout_info{};
-	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_info.setLayoutCount = 0;
-	pipeline_layout_info.pushConstantRangeCount = 0;
+	pipeline_layout = layout_cache.get_pipeline_layout({ &vert_reflection, &frag_reflection }).pipeline_layout;
 
-	if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-		std::cout << "\033[31;40m";
-		throw std::runtime_error("Failed to create Vulkan Pipeline! \033[0m \n");
-	}
-	LOG_MESSAGE("Vulkan Pipeline layout created.", Color::Bright_White, Color::Black, 4);
+	LOG_MESSAGE("Pipeline layouts in cache: " + std::to_string(layout_cache.pipeline_layout_count()), Color::Bright_White, Color::Black, 4);
 
 
 	// Creating Pipeline
 
 	VkGraphicsPipelineCreateInfo pipeline_info{};
 	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeline_info.stageCount = 2;
+	pipeline_info.stageCount = depth_only ? 1 : 2;
 	pipeline_info.pStages = shader_stages;
 	pipeline_info.pVertexInputState = &vertex_input_info;
 	pipeline_info.pInputAssemblyState = &input_assembly;
 	pipeline_info.pViewportState = &viewport_state_info;
 	pipeline_info.pRasterizationState = &rasterizer_info;
 	pipeline_info.pMultisampleState = &multisampling_info;
+	pipeline_info.pDepthStencilState = &depth_stencil_info;
 	pipeline_info.pColorBlendState = &color_blending_info;
 	pipeline_info.pDynamicState = &dynamic_state_info;
 	pipeline_info.layout = pipeline_layout;
-	pipeline_info.renderPass = render_pass;
-	pipeline_info.subpass = 0;
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
+	// With dynamic rendering there is no render pass:
+	// the attachment formats are given directly to the pipeline
+	VkPipelineRenderingCreateInfo rendering_info{};
+	rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	rendering_info.colorAttachmentCount = depth_only ? 0 : 1;
+	rendering_info.pColorAttachmentFormats = &color_format;
+	rendering_info.depthAttachmentFormat = depth_format;
+	if (vk_attachment::depth_aspect(depth_format) & VK_IMAGE_ASPECT_STENCIL_BIT) {
+		rendering_info.stencilAttachmentFormat = depth_format;
+	}
+
+	if (render_path == vk_config::RenderPath::DynamicRendering) {
+		pipeline_info.pNext = &rendering_info;
+		pipeline_info.renderPass = VK_NULL_HANDLE;
+	}
+	else {
+		pipeline_info.renderPass = render_pass;
+		pipeline_info.subpass = (depth_mode == DepthMode::EqualTest || depth_mode == DepthMode::TranslucentAfterPrepass) ? 1 : 0;
+	}
+
+	VkShaderModule vert_shader_module = create_shader_module(vert_shader, device);
+	VkShaderModule frag_shader_module;
+	try {
+		frag_shader_module = create_shader_module(frag_shader, device);
+	}
+	catch (...) {
+		vkDestroyShaderModule(device, vert_shader_module, nullptr);
+		throw;
+	}
+
+	shader_stages[0].module = vert_shader_module;
+	shader_stages[1].module = frag_shader_module;
+
+	LOG_MESSAGE("Shader modules attached to the pipeline.", Color::Bright_White, Color::Black, 4);
+
+	VkResult result = vkCreateGraphicsPipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+
+	vkDestroyShaderModule(device, frag_shader_module, nullptr);
+	vkDestroyShaderModule(device, vert_shader_module, nullptr);
+
+	if (result != VK_SUCCESS) {
 		std::cout << "\033[31;40m";
 		throw std::runtime_error("Failed to create Vulkan Pipeline! \033[0m \n");
 	}
 	LOG_MESSAGE("Vulkan Pipeline created. \n", Color::Yellow, Color::Black, 0);
+}
 
-	vkDestroyShaderModule(device, frag_shader_module, nullptr);
-	vkDestroyShaderModule(device, vert_shader_module, nullptr);
+
+void create_compute_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
+	                         vk_reflect::ShaderReflection& reflection,
+	                         const std::string& shader_file,
+	                         const vk_variant::Specialization& specialization,
+	                         VkPipelineCache pipeline_cache,
+	                         vk_reflect::LayoutCache& layout_cache, VkDevice device) {
+
+	LOG_MESSAGE("Creating Vulkan Compute Pipeline: " + shader_file + "...", Color::Yellow, Color::Black, 0);
+
+	MappedFile shader = map_file(shader_file);
+
+	reflection = vk_reflect::reflect_shader(shader.words(), shader.size() / sizeof(uint32_t));
+
+	if (reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(shader_file + " is not a compute shader! \033[0m \n");
+	}
+
+	specialization.validate(reflection, shader_file);
+
+	// Before the module is created: nothing can throw while it is alive
+	pipeline_layout = layout_cache.get_pipeline_layout({ &reflection }).pipeline_layout;
+
+	VkShaderModule shader_module = create_shader_module(shader, device);
+
+	VkPipelineShaderStageCreateInfo shader_info{};
+	shader_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shader_info.module = shader_module;
+	shader_info.pName = reflection.entry_point.c_str();
+	shader_info.pSpecializationInfo = specialization.info();
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage = shader_info;
+	pipeline_info.layout = pipeline_layout;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+	VkResult result = vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+
+	vkDestroyShaderModule(device, shader_module, nullptr);
+
+	if (result != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Compute Pipeline! \033[0m \n");
+	}
+
+	LOG_MESSAGE("Workgroup size: " + std::to_string(reflection.local_size[0]) + "x" +
+		        std::to_string(reflection.local_size[1]) + "x" + std::to_string(reflection.local_size[2]),
+		        Color::Bright_White, Color::Black, 4);
+	LOG_MESSAGE("Vulkan Compute Pipeline created. \n", Color::Yellow, Color::Black, 0);
+}
+
+
+void rebuild_compute_pipeline(VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
+	                          const std::string& shader_file,
+	                          const vk_variant::Specialization& specialization,
+	                          VkPipelineLayout expected_pipeline_layout, const uint32_t expected_local_size[3],
+	                          VkPipelineCache pipeline_cache,
+	                          vk_reflect::LayoutCache& layout_cache, VkDevice device) {
+
+	vk_reflect::ShaderReflection reflection;
+
+	create_compute_pipeline(pipeline, pipeline_layout, reflection, shader_file, specialization,
+		                    pipeline_cache, layout_cache, device);
+
+	// The layout cache returns the same layout for the same interface
+	bool same_interface = pipeline_layout == expected_pipeline_layout;
+	for (int i = 0; i < 3; i++) {
+		same_interface = same_interface && reflection.local_size[i] == expected_local_size[i];
+	}
+
+	if (!same_interface) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(shader_file + ": the bindings, push constants or workgroup size changed, "
+			                     "restart to use it! \033[0m \n");
+	}
 }
 
 
-void create_renderpass(VkRenderPass& render_pass, VkDevice device, VkFormat swapchain_image_format) {
+void create_renderpass(VkRenderPass& render_pass, VkDevice device,
+	                   VkFormat color_format, VkFormat depth_format,
+	                   VkSampleCountFlagBits samples, bool depth_prepass,
+	                   bool offscreen_target) {
 
 	LOG_MESSAGE("Creating Vulkan Render pass...", Color::Yellow, Color::Black, 0);
+	LOG_MESSAGE("Samples per pixel: " + std::to_string(samples), Color::Bright_White, Color::Black, 4);
+	LOG_MESSAGE(std::string("Depth pre-pass: ") + (depth_prepass ? "on" : "off"), Color::Bright_White, Color::Black, 4);
 
-	// Single color buffer attachment as one of the images from the swapchain
+	// Single color buffer attachment as one of the images from the swapchain, or the HDR target
 	VkAttachmentDescription color_attachment{};
-	color_attachment.format = swapchain_image_format; // format of color attachment should match with format of swapchain images
+	color_attachment.format = color_format; // format of color attachment should match with format of swapchain images
 	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
 	// This refers to color and depth data
@@ -175,6 +333,11 @@ void create_renderpass(VkRenderPass& render_pass, VkDevice device, VkFormat swap
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // we don't care what previous layout the image was in
 	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // the image must be ready for presentation using the swapchain after rendering
 
+	// The HDR target is not presented: the render graph transitions it for the tone mapping pass
+	if (offscreen_target) {
+		color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
 
 	VkAttachmentReference color_attachment_ref{};
 	color_attachment_ref.attachment = 0;
@@ -185,13 +348,127 @@ void create_renderpass(VkRenderPass& render_pass, VkDevice device, VkFormat swap
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &color_attachment_ref;
 
+	std::vector<VkAttachmentDescription> attachments = { color_attachment };
+
+	// With MSAA the subpass renders to a multisampled attachment instead, resolved into the
+	// swapchain image at the end of the subpass: the samples stay in tile memory, they are
+	// never stored (the attachment is transient, see vk_attachment)
+	VkAttachmentReference resolve_attachment_ref{};
+	if (samples != VK_SAMPLE_COUNT_1_BIT) {
+
+		VkAttachmentDescription multisampled_attachment = color_attachment;
+		multisampled_attachment.samples = samples;
+		multisampled_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		multisampled_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentDescription resolve_attachment = color_attachment;
+		resolve_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // every pixel is written by the resolve
+
+		attachments = { multisampled_attachment, resolve_attachment };
+
+		resolve_attachment_ref.attachment = 1;
+		resolve_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		subpass.pResolveAttachments = &resolve_attachment_ref;
+	}
+
+	// The depth buffer is the last attachment. It is only needed during the render pass:
+	// cleared when it starts and never stored (transient as well)
+	VkAttachmentDescription depth_attachment{};
+	depth_attachment.format = depth_format;
+	depth_attachment.samples = samples;
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	attachments.push_back(depth_attachment);
+
+	VkAttachmentReference depth_attachment_ref{};
+	depth_attachment_ref.attachment = static_cast<uint32_t>(attachments.size() - 1);
+	depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+	// The layout transitions at the start of the render pass must wait for the swapchain image:
+	// the acquire semaphore is waited on at the color attachment output stage.
+	// The depth buffer is shared by the frames: its clear waits for the depth tests of the previous one.
+	// So are the MSAA and HDR color targets: their clear waits for the color writes of the previous one.
+	// This is the barrier the render graph computes for the dynamic rendering path.
+	VkSubpassDependency dependency{};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// The HDR target is shared by the frames too: it is only cleared once the previous one is tone mapped
+	if (offscreen_target) {
+		dependency.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	std::vector<VkSubpassDescription> subpasses = { subpass };
+	std::vector<VkSubpassDependency> dependencies = { dependency };
+
+	// With the pre-pass, subpass 0 only writes the depth buffer
+	// and subpass 1 shades the pixels whose depth is EQUAL to it
+	VkAttachmentReference read_only_depth_ref = depth_attachment_ref;
+	if (depth_prepass) {
+
+		VkSubpassDescription depth_subpass{};
+		depth_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		depth_subpass.pDepthStencilAttachment = &depth_attachment_ref;
+
+		read_only_depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		subpass.pDepthStencilAttachment = &read_only_depth_ref;
+		attachments.back().finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		subpasses = { depth_subpass, subpass };
+
+		// The color attachments are first used in subpass 1
+		VkSubpassDependency color_dependency = dependency;
+		color_dependency.dstSubpass = 1;
+
+		VkSubpassDependency depth_dependency{};
+		depth_dependency.srcSubpass = 0;
+		depth_dependency.dstSubpass = 1;
+		depth_dependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		depth_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depth_dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		depth_dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		depth_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT; // same pixel only: stays in the tile
+
+		dependencies = { dependency, color_dependency, depth_dependency };
+	}
+
+	// Replaces the implicit dependency at the end of the render pass, whose BOTTOM_OF_PIPE destination
+	// chains with nothing: a barrier recorded after the render pass (the copy of a capture without tone
+	// mapping, vk_readback::ReadbackService::record_copy()) from the color attachment output stage then
+	// waits for the store and for the final layout transition
+	if (!offscreen_target) {
+
+		VkSubpassDependency end_dependency{};
+		end_dependency.srcSubpass = static_cast<uint32_t>(subpasses.size() - 1);
+		end_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		end_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		end_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		end_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		end_dependency.dstAccessMask = 0;
+
+		dependencies.push_back(end_dependency);
+	}
+
 
 	VkRenderPassCreateInfo render_pass_info{};
 	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	render_pass_info.attachmentCount = 1;
-	render_pass_info.pAttachments = &color_attachment;
-	render_pass_info.subpassCount = 1;
-	render_pass_info.pSubpasses = &subpass;
+	render_pass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+	render_pass_info.pAttachments = attachments.data();
+	render_pass_info.subpassCount = static_cast<uint32_t>(subpasses.size());
+	render_pass_info.pSubpasses = subpasses.data();
+	render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	render_pass_info.pDependencies = dependencies.data();
 
 	if (vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass) != VK_SUCCESS) {
 		std::cout << "\033[31;40m";
@@ -202,12 +479,14 @@ void create_renderpass(VkRenderPass& render_pass, VkDevice device, VkFormat swap
 }
 
 
-VkShaderModule create_shader_module(const std::vector<char>& shader_code, VkDevice device) {
+VkShaderModule create_shader_module(const MappedFile& shader_code, VkDevice device) {
 
+	// SPIR-V is a stream of 32-bit words: pCode must be 4-byte aligned,
+	// which the page aligned mapping guarantees (words() also checks the size)
 	VkShaderModuleCreateInfo shader_info{};
 	shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	shader_info.codeSize = shader_code.size();
-	shader_info.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
+	shader_info.pCode = shader_code.words();
 
 	VkShaderModule shader_module;
 	if (vkCreateShaderModule(device, &shader_info, nullptr, &shader_module) != VK_SUCCESS) {
@@ -219,8 +498,81 @@ VkShaderModule create_shader_module(const std::vector<char>& shader_code, VkDevi
 }
 
 
+void create_pipeline_cache(VkPipelineCache& pipeline_cache, const std::string& file_path,
+	                       VkPhysicalDevice physical_device, VkDevice device) {
+
+	LOG_MESSAGE("Creating Vulkan Pipeline cache...", Color::Yellow, Color::Black, 0);
+
+	VkPipelineCacheCreateInfo pipeline_cache_info{};
+	pipeline_cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	// The data of a previous run is only valid for the same device and driver
+	MappedFile cache_file;
+	if (std::filesystem::exists(file_path)) {
+		cache_file = map_file(file_path);
+	}
+	else {
+		LOG_MESSAGE("No pipeline cache found, starting empty.", Color::Bright_White, Color::Black, 4);
+	}
+
+	if (check_pipeline_cache_compatible(cache_file, physical_device)) {
+		pipeline_cache_info.initialDataSize = cache_file.size();
+		pipeline_cache_info.pInitialData = cache_file.data();
+		LOG_MESSAGE("Loaded pipeline cache: " + std::to_string(cache_file.size()) + " bytes", Color::Bright_White, Color::Black, 4);
+	}
+	else if (!cache_file.empty()) {
+		LOG_MESSAGE("Pipeline cache is from another device or driver, starting empty.", Color::Bright_White, Color::Black, 4);
+	}
+
+	if (vkCreatePipelineCache(device, &pipeline_cache_info, nullptr, &pipeline_cache) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Pipeline cache! \033[0m \n");
+	}
+
+	LOG_MESSAGE("Vulkan Pipeline cache created. \n", Color::Yellow, Color::Black, 0);
+}
+
+
+bool check_pipeline_cache_compatible(const MappedFile& cache_file, VkPhysicalDevice physical_device) {
+
+	// Only the header is read: the driver defines the size of the rest, not necessarily a multiple of 4
+	VkPipelineCacheHeaderVersionOne header;
+	if (cache_file.size() < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, cache_file.data(), sizeof(header));
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	return header.headerSize >= sizeof(header) &&
+		   header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		   header.vendorID == device_properties.vendorID &&
+		   header.deviceID == device_properties.deviceID &&
+		   std::memcmp(header.pipelineCacheUUID, device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+
+void save_pipeline_cache(VkPipelineCache pipeline_cache, const std::string& file_path, VkDevice device) {
+
+	size_t data_size = 0;
+	vkGetPipelineCacheData(device, pipeline_cache, &data_size, nullptr);
+
+	std::vector<char> data(data_size);
+	if (data_size == 0 || vkGetPipelineCacheData(device, pipeline_cache, &data_size, data.data()) != VK_SUCCESS) {
+		return;
+	}
+
+	std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+	file.write(data.data(), static_cast<std::streamsize>(data_size));
+
+	LOG_MESSAGE("Saved pipeline cache: " + std::to_string(data_size) + " bytes", Color::Bright_White, Color::Black, 0);
+}
+
+
 void create_framebuffers(std::vector<VkFramebuffer>& swapchain_framebuffers,
 	                     std::vector<VkImageView> swapchain_image_views,
+	                     const std::vector<vk_attachment::Attachment>& attachments, uint32_t swapchain_attachment,
 	                     VkExtent2D swapchain_extent,
 	                     VkDevice device, VkRenderPass render_pass) {
 
@@ -229,15 +581,34 @@ void create_framebuffers(std::vector<VkFramebuffer>& swapchain_framebuffers,
 	swapchain_framebuffers.resize(swapchain_image_views.size());
 	LOG_MESSAGE("Swapchain Framebuffer size: " + std::to_string(swapchain_framebuffers.size()), Color::Bright_White, Color::Black, 4);
 
+	bool swapchain_target = swapchain_attachment != NO_SWAPCHAIN_ATTACHMENT;
+
+	if (swapchain_target && swapchain_attachment > attachments.size()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Invalid swapchain attachment index for the Framebuffers! \033[0m \n");
+	}
+
+	// Only the swapchain image differs between the framebuffers
+	// (they are all the same with an offscreen target)
+	std::vector<VkImageView> framebuffer_attachments;
+	for (const auto& attachment : attachments) {
+		framebuffer_attachments.push_back(attachment.image_view);
+	}
+	if (swapchain_target) {
+		framebuffer_attachments.insert(framebuffer_attachments.begin() + swapchain_attachment, VK_NULL_HANDLE);
+	}
+
 	for (size_t i=0; i < swapchain_image_views.size(); i++) {
 
-		VkImageView attachments[] = { swapchain_image_views[i] };
+		if (swapchain_target) {
+			framebuffer_attachments[swapchain_attachment] = swapchain_image_views[i];
+		}
 
 		VkFramebufferCreateInfo framebuffer_info{};
 		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		framebuffer_info.renderPass = render_pass;
-		framebuffer_info.attachmentCount = 1;
-		framebuffer_info.pAttachments = attachments;
+		framebuffer_info.attachmentCount = static_cast<uint32_t>(framebuffer_attachments.size());
+		framebuffer_info.pAttachments = framebuffer_attachments.data();
 		framebuffer_info.width = swapchain_extent.width;
 		framebuffer_info.height = swapchain_extent.height;
 		framebuffer_info.layers = 1;
@@ -295,12 +666,76 @@ void create_command_buffer(VkCommandBuffer& command_buffer, VkCommandPool comman
 }
 
 
-void record_command_buffer(VkCommandBuffer command_buffer, uint32_t swapchain_image_index,
-	                       VkPipeline pipeline, VkRenderPass render_pass,
-	                       std::vector<VkFramebuffer> swapchain_framebuffers,
-	                       VkExtent2D swapchain_extent) {
+// Tone map the HDR color into the swapchain image: a compute pass of the render graph,
+// which records the layout transitions of both images around it
+static void add_tone_map_pass(vk_graph::RenderGraph& render_graph,
+	                          vk_graph::ResourceId hdr_color, vk_graph::ResourceId swapchain,
+	                          const HdrTarget& hdr_target,
+	                          VkFormat swapchain_image_format, VkExtent2D swapchain_extent,
+	                          vk_query::QueryManager* pass_queries) {
+
+	render_graph.add_pass("tone map",
+		{ { hdr_color, vk_graph::COMPUTE_SAMPLED_READ }, { swapchain, vk_graph::COMPUTE_STORAGE_WRITE } },
+		[=](VkCommandBuffer pass_command_buffer, const vk_graph::RenderGraph& graph) {
+
+			vk_query::PassScope query_scope(pass_queries, pass_command_buffer, "tone map");
+			hdr_target.tone_map->record(pass_command_buffer,
+				                        graph.image_view(hdr_color), graph.image_view(swapchain),
+				                        swapchain_image_format, swapchain_extent);
+		});
+}
+
+
+// Copy the swapchain image into a slot of the readback service: a transfer pass of the render graph,
+// added after the passes that write the image, so that the graph records the barriers from their
+// writes and the final transition to PRESENT_SRC_KHR after the copy. The slot buffer is an output
+// of the graph: the pass is never culled. Nothing is added when the service has no free slot.
+static void add_capture_pass(vk_graph::RenderGraph& render_graph, vk_graph::ResourceId swapchain,
+	                         vk_readback::ReadbackService* readback,
+	                         VkFormat swapchain_image_format, VkExtent2D swapchain_extent) {
+
+	VkBuffer slot_buffer = readback->reserve_slot(swapchain_image_format, swapchain_extent);
+	if (slot_buffer == VK_NULL_HANDLE) {
+		return;
+	}
+
+	vk_graph::ResourceId slot = render_graph.import_buffer(
+		"capture slot", slot_buffer, vk_graph::Access{}, vk_readback::SLOT_HOST_READ);
+
+	render_graph.add_pass("capture",
+		{ { swapchain, vk_graph::TRANSFER_READ }, { slot, vk_graph::TRANSFER_WRITE } },
+		[=](VkCommandBuffer pass_command_buffer, const vk_graph::RenderGraph& graph) {
+
+			readback->record_reserved_copy(pass_command_buffer, graph.image(swapchain));
+		});
+}
+
 
+// Draw the particles of the settings, if any, over the scene
+static void record_particles(VkCommandBuffer command_buffer, VkExtent2D extent, const DrawSettings& draw_settings) {
+
+	if (draw_settings.particles != nullptr) {
+		draw_settings.particles->record_draw(command_buffer, draw_settings.particle_pipeline,
+			                                 draw_settings.particle_pipeline_layout, extent);
+	}
+}
+
+
+void record_command_buffer(VkCommandBuffer command_buffer, uint32_t swapchain_image_index,
+	                       VkPipeline pipeline, VkPipeline depth_prepass_pipeline,
+	                       VkRenderPass render_pass, VkFramebuffer framebuffer,
+	                       VkImage swapchain_image, VkImageView swapchain_image_view,
+	                       VkFormat swapchain_image_format, VkFormat depth_format,
+	                       VkExtent2D swapchain_extent, VkSampleCountFlagBits samples,
+	                       const HdrTarget& hdr_target,
+	                       vk_config::RenderPath render_path,
+	                       const DrawSettings& draw_settings,
+	                       vk_graph::RenderGraph& render_graph) {
+
+#ifdef _DEBUG
 	LOG_MESSAGE("Registering Command buffer(s)...", Color::Yellow, Color::Black, 0);
+	LOG_MESSAGE("Current swapchain image index: " + std::to_string(swapchain_image_index), Color::Bright_White, Color::Black, 4);
+#endif
 
 	VkCommandBufferBeginInfo command_buffer_info{};
 	command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -310,55 +745,308 @@ void record_command_buffer(VkCommandBuffer command_buffer, uint32_t swapchain_im
 		throw std::runtime_error("Failed to begin recording Command Buffer! \033[0m \n");
 	}
 
-	VkRenderPassBeginInfo render_pass_info{};
-	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	render_pass_info.renderPass = render_pass;
+	// Query pools must be reset outside of a render pass.
+	// The queries cover the whole rendering: pre-pass, draws, resolve and barriers.
+	if (draw_settings.timestamp_query_pool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(command_buffer, draw_settings.timestamp_query_pool, 0, 2);
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, draw_settings.timestamp_query_pool, 0);
+	}
+	if (draw_settings.statistics_query_pool != VK_NULL_HANDLE) {
+		if (draw_settings.pass_queries != nullptr) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Pass queries cannot be recorded inside the statistics query of the rendering! \033[0m \n");
+		}
+		vkCmdResetQueryPool(command_buffer, draw_settings.statistics_query_pool, 0, 1);
+		vkCmdBeginQuery(command_buffer, draw_settings.statistics_query_pool, 0, 0);
+	}
+	if (draw_settings.pass_queries != nullptr) {
+		draw_settings.pass_queries->begin_frame(command_buffer);
+	}
 
-	LOG_MESSAGE("Current swapchain image index: " + std::to_string(swapchain_image_index), Color::Bright_White, Color::Black, 4);
-	render_pass_info.framebuffer = swapchain_framebuffers[swapchain_image_index];
+	// The color that clears the screen after rendering, and the farthest depth
+	VkClearValue clear_color = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
+	VkClearValue clear_depth{};
+	clear_depth.depthStencil = { 1.0f, 0 };
 
-	render_pass_info.renderArea.offset = { 0, 0 };
-	render_pass_info.renderArea.extent = swapchain_extent;
+	bool depth_prepass = depth_prepass_pipeline != VK_NULL_HANDLE;
 
-	// The color that clears the screen after rendering
-	VkClearValue clear_color = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	render_pass_info.clearValueCount = 1;
-	render_pass_info.pClearValues = &clear_color;
+	// Simulated outside of the rendering: the particle system records the barrier
+	// between its compute passes and the draw
+	if (draw_settings.particles != nullptr) {
+		vk_query::PassScope query_scope(draw_settings.pass_queries, command_buffer, "particle update");
+		draw_settings.particles->record_update(command_buffer, swapchain_extent);
+	}
+
+	// The scene is rendered to the HDR target, if any, in its format
+	bool tone_mapped = hdr_target.tone_map != nullptr;
+	VkFormat color_format = tone_mapped ? hdr_target.format : swapchain_image_format;
+
+	if (render_path == vk_config::RenderPath::DynamicRendering) {
+
+		// Without a render pass the image layouts are not transitioned for us:
+		// the graph records UNDEFINED -> COLOR_ATTACHMENT_OPTIMAL before drawing
+		// and COLOR_ATTACHMENT_OPTIMAL -> PRESENT_SRC_KHR after, like the render pass finalLayout
+		render_graph.reset();
+
+		vk_graph::ResourceId swapchain = render_graph.import_image(
+			"swapchain", swapchain_image, swapchain_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+			vk_graph::SWAPCHAIN_ACQUIRED, vk_graph::PRESENT);
+
+		// The HDR target is sampled by the tone mapping pass: not a transient attachment
+		vk_graph::ResourceId target = swapchain;
+		if (tone_mapped) {
+
+			vk_graph::ImageDesc hdr_desc;
+			hdr_desc.format = hdr_target.format;
+			hdr_desc.extent = swapchain_extent;
+
+			target = render_graph.create_image("hdr color", hdr_desc);
+		}
+
+		std::vector<vk_graph::Use> uses = { { target, vk_graph::COLOR_ATTACHMENT_WRITE } };
+
+		// With MSAA the scene is rendered to a transient multisampled image and
+		// resolved into the target (a color attachment write) when rendering ends
+		bool multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+		vk_graph::ResourceId multisampled_target = 0;
+
+		if (multisampled) {
 
-	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+			vk_graph::ImageDesc multisampled_desc;
+			multisampled_desc.format = color_format;
+			multisampled_desc.extent = swapchain_extent;
+			multisampled_desc.samples = samples;
+
+			multisampled_target = render_graph.create_image("msaa color", multisampled_desc);
+			uses.push_back({ multisampled_target, vk_graph::COLOR_ATTACHMENT_WRITE });
+		}
+
+		vk_graph::ImageDesc depth_desc;
+		depth_desc.format = depth_format;
+		depth_desc.extent = swapchain_extent;
+		depth_desc.samples = samples;
+		depth_desc.aspect = vk_attachment::depth_aspect(depth_format);
+
+		vk_graph::ResourceId depth = render_graph.create_image("depth", depth_desc);
+		bool stencil = (depth_desc.aspect & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+
+		// The pre-pass writes the depth in its own rendering scope: the graph puts
+		// the barrier between the depth writes and the EQUAL tests of the scene pass
+		if (depth_prepass) {
+
+			render_graph.add_pass("depth prepass", { { depth, vk_graph::DEPTH_ATTACHMENT_WRITE } },
+				[&](VkCommandBuffer pass_command_buffer, const vk_graph::RenderGraph& graph) {
+
+					VkRenderingAttachmentInfo depth_attachment{};
+					depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+					depth_attachment.imageView = graph.image_view(depth);
+					depth_attachment.imageLayout = vk_graph::DEPTH_ATTACHMENT_WRITE.layout;
+					depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+					depth_attachment.storeOp = graph.store_op(depth); // read by the scene pass
+					depth_attachment.clearValue = clear_depth;
+
+					VkRenderingInfo rendering_info{};
+					rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+					rendering_info.renderArea.offset = { 0, 0 };
+					rendering_info.renderArea.extent = swapchain_extent;
+					rendering_info.layerCount = 1;
+					rendering_info.pDepthAttachment = &depth_attachment;
+					rendering_info.pStencilAttachment = stencil ? &depth_attachment : nullptr;
+
+					vk_query::PassScope query_scope(draw_settings.pass_queries, pass_command_buffer, "depth prepass");
+					vkCmdBeginRendering(pass_command_buffer, &rendering_info);
+					record_draws(pass_command_buffer, depth_prepass_pipeline, swapchain_extent, draw_settings);
+					vkCmdEndRendering(pass_command_buffer);
+				});
+		}
+
+		const vk_graph::Access& depth_access = depth_prepass ? vk_graph::DEPTH_ATTACHMENT_READ : vk_graph::DEPTH_ATTACHMENT_WRITE;
+		uses.push_back({ depth, depth_access });
+
+		render_graph.add_pass("scene", uses,
+			[&](VkCommandBuffer pass_command_buffer, const vk_graph::RenderGraph& graph) {
+
+				VkRenderingAttachmentInfo color_attachment{};
+				color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				color_attachment.imageView = graph.image_view(target);
+				color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+				color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+				color_attachment.clearValue = clear_color;
+
+				if (multisampled) {
+					color_attachment.imageView = graph.image_view(multisampled_target);
+					color_attachment.storeOp = graph.store_op(multisampled_target); // only the resolved image is kept
+					color_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+					color_attachment.resolveImageView = graph.image_view(target);
+					color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+				}
+
+				VkRenderingAttachmentInfo depth_attachment{};
+				depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				depth_attachment.imageView = graph.image_view(depth);
+				depth_attachment.imageLayout = depth_access.layout;
+				depth_attachment.loadOp = depth_prepass ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+				depth_attachment.storeOp = graph.store_op(depth); // not needed after the scene
+				depth_attachment.clearValue = clear_depth;
+
+				VkRenderingInfo rendering_info{};
+				rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+				rendering_info.renderArea.offset = { 0, 0 };
+				rendering_info.renderArea.extent = swapchain_extent;
+				rendering_info.layerCount = 1;
+				rendering_info.colorAttachmentCount = 1;
+				rendering_info.pColorAttachments = &color_attachment;
+				rendering_info.pDepthAttachment = &depth_attachment;
+				rendering_info.pStencilAttachment = stencil ? &depth_attachment : nullptr;
+
+				vk_query::PassScope query_scope(draw_settings.pass_queries, pass_command_buffer, "scene");
+				vkCmdBeginRendering(pass_command_buffer, &rendering_info);
+				record_draws(pass_command_buffer, pipeline, swapchain_extent, draw_settings);
+				record_particles(pass_command_buffer, swapchain_extent, draw_settings);
+				vkCmdEndRendering(pass_command_buffer);
+			});
+
+		if (tone_mapped) {
+			add_tone_map_pass(render_graph, target, swapchain, hdr_target, swapchain_image_format, swapchain_extent,
+			                  draw_settings.pass_queries);
+		}
+
+		if (draw_settings.readback != nullptr) {
+			add_capture_pass(render_graph, swapchain, draw_settings.readback, swapchain_image_format, swapchain_extent);
+		}
+
+		render_graph.compile();
+		render_graph.execute(command_buffer);
+	}
+	else {
+
+		// One clear value per attachment: color (or multisampled color), [resolve,] depth
+		std::vector<VkClearValue> clear_values = { clear_color };
+		if (samples != VK_SAMPLE_COUNT_1_BIT) {
+			clear_values.push_back(clear_color); // not cleared, the resolve writes it
+		}
+		clear_values.push_back(clear_depth);
+
+		VkRenderPassBeginInfo render_pass_info{};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = render_pass;
+		render_pass_info.framebuffer = framebuffer;
+
+		render_pass_info.renderArea.offset = { 0, 0 };
+		render_pass_info.renderArea.extent = swapchain_extent;
+
+		render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+		render_pass_info.pClearValues = clear_values.data();
+
+		// Queries begun outside of a render pass cover all of its subpasses
+		{
+			vk_query::PassScope query_scope(draw_settings.pass_queries, command_buffer, "scene");
+			vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+			if (depth_prepass) {
+				record_draws(command_buffer, depth_prepass_pipeline, swapchain_extent, draw_settings);
+				vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+			}
+
+			record_draws(command_buffer, pipeline, swapchain_extent, draw_settings);
+			record_particles(command_buffer, swapchain_extent, draw_settings);
+			vkCmdEndRenderPass(command_buffer);
+		}
+
+		// The render pass leaves the HDR target as a color attachment and never touches
+		// the swapchain image: the graph only has the tone mapping pass and its barriers
+		if (tone_mapped) {
+
+			render_graph.reset();
+
+			vk_graph::ResourceId hdr_color = render_graph.import_image(
+				"hdr color", hdr_target.image, hdr_target.image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+				vk_graph::COLOR_ATTACHMENT_WRITE, vk_graph::COMPUTE_SAMPLED_READ);
+
+			vk_graph::ResourceId swapchain = render_graph.import_image(
+				"swapchain", swapchain_image, swapchain_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+				vk_graph::SWAPCHAIN_ACQUIRED, vk_graph::PRESENT);
+
+			add_tone_map_pass(render_graph, hdr_color, swapchain, hdr_target, swapchain_image_format, swapchain_extent,
+				              draw_settings.pass_queries);
+
+			if (draw_settings.readback != nullptr) {
+				add_capture_pass(render_graph, swapchain, draw_settings.readback, swapchain_image_format, swapchain_extent);
+			}
+
+			render_graph.compile();
+			render_graph.execute(command_buffer);
+		}
+	}
+
+	if (draw_settings.statistics_query_pool != VK_NULL_HANDLE) {
+		vkCmdEndQuery(command_buffer, draw_settings.statistics_query_pool, 0);
+	}
+	if (draw_settings.timestamp_query_pool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, draw_settings.timestamp_query_pool, 1);
+	}
+	if (draw_settings.pass_queries != nullptr) {
+		draw_settings.pass_queries->end_frame(command_buffer);
+	}
+
+	// The render pass left the swapchain image in PRESENT_SRC_KHR, out of any graph: the service records
+	// the copy and its barriers, chained with the end dependency of the render pass. After the queries:
+	// they measure the rendering, not the capture (the graph passes above are inside them).
+	if (draw_settings.readback != nullptr && render_path != vk_config::RenderPath::DynamicRendering && !tone_mapped) {
+		draw_settings.readback->record_copy(command_buffer, swapchain_image, swapchain_image_format, swapchain_extent);
+	}
+
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to record Command Buffer! \033[0m \n");
+	}
+
+#ifdef _DEBUG
+	LOG_MESSAGE("Command buffer(s) registered. \n", Color::Yellow, Color::Black, 0);
+#endif
+}
+
+
+void record_draws(VkCommandBuffer command_buffer, VkPipeline pipeline,
+	              VkExtent2D extent, const DrawSettings& draw_settings) {
 
 	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = (float)swapchain_extent.width;
-	viewport.height = (float)swapchain_extent.height;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0, 0 };
-	scissor.extent = swapchain_extent;
+	scissor.extent = extent;
 	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
 
-	// Draw command of the triangle
-	// 3 is the number of vertices in the vertex buffer, that we are not actually using now,
-	// but we specify it anyway
-	// 1, 0, 0 are just default values
-	vkCmdDraw(command_buffer, 3, 1, 0, 0);
-
-	vkCmdEndRenderPass(command_buffer);
+	for (size_t i = 0; i < draw_settings.draws.size(); i++) {
 
+		if (draw_settings.per_draw_descriptor_set != VK_NULL_HANDLE) {
+			uint32_t dynamic_offset = static_cast<uint32_t>(i * draw_settings.per_draw_stride);
+			vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_settings.pipeline_layout,
+				                    0, 1, &draw_settings.per_draw_descriptor_set, 1, &dynamic_offset);
+		}
+		else if (draw_settings.push_constant_stages != 0) {
+			vk_draw::push_per_draw(command_buffer, draw_settings.pipeline_layout,
+				                   draw_settings.push_constant_stages, draw_settings.draws[i]);
+		}
 
-	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-		std::cout << "\033[31;40m";
-		throw std::runtime_error("Failed to record Command Buffer! \033[0m \n");
+		// Draw command of the triangle
+		// 3 is the number of vertices in the vertex buffer, that we are not actually using now,
+		// but we specify it anyway
+		// 1, 0, 0 are just default values
+		vkCmdDraw(command_buffer, 3, 1, 0, 0);
 	}
-
-	LOG_MESSAGE("Command buffer(s) registered. \n", Color::Yellow, Color::Black, 0);
 }
 
 
@@ -374,6 +1062,7 @@ void create_sync_objects(VkSemaphore& semaphore_image_available,
 
 	VkFenceCreateInfo fence_info{};
 	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // the first frame must not wait for a previous one
 
 	if (vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore_image_available) != VK_SUCCESS ||
 		vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore_render_finished) != VK_SUCCESS ||
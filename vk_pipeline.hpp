@@ -1,29 +1,125 @@
 #pragma once
 
 #include "vk_includes.hpp"
+#include "vk_config.hpp"
+#include "vk_reflect.hpp"
+#include "vk_variant.hpp"
+#include "vk_draw.hpp"
+#include "vk_graph.hpp"
+#include "vk_attachment.hpp"
+#include "vk_tonemap.hpp"
+#include "vk_particles.hpp"
+#include "vk_query.hpp"
+#include "vk_readback.hpp"
+#include "my_util.hpp"
+
+#include <string>
 
 
 namespace vk_pipeline {
 
 
+// What a graphics pipeline does with the depth buffer
+enum class DepthMode {
+	TestAndWrite, // LESS test and depth writes: the scene without a pre-pass
+	DepthOnly,    // depth pre-pass: LESS test and depth writes, no fragment shader and no color attachment
+	EqualTest,    // color pass after a pre-pass: EQUAL test, no depth writes, every pixel is shaded once
+
+	// Alpha blended draws after the opaque ones (e.g. particles sorted back to front):
+	// LESS test without depth writes, no face culling
+	Translucent,
+	TranslucentAfterPrepass // the same, in the color pass of a render pass with a pre-pass
+};
+
+
 // Initialize the Graphics Pipeline
+// With RenderPath::DynamicRendering render_pass is ignored and
+// the color format (of the swapchain or of the HDR target) is given to the pipeline instead.
+// The pipeline layout is generated from the shaders and owned by layout_cache.
+// The shaders and their specialization constants are given by the variant.
+// samples must match the color attachment the pipeline renders to.
+// With a render pass, EqualTest and TranslucentAfterPrepass pipelines are for subpass 1 (after the pre-pass),
+// the others for subpass 0.
+// A DepthOnly pipeline has the layout of the whole variant, so it takes the same push constants.
 void create_pipeline(
 	VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
-	VkRenderPass render_pass, VkDevice device);
+	VkRenderPass render_pass, VkFormat color_format,
+	VkFormat depth_format, VkSampleCountFlagBits samples,
+	DepthMode depth_mode,
+	vk_config::RenderPath render_path,
+	const vk_variant::ShaderVariant& variant,
+	VkPipelineCache pipeline_cache,
+	vk_reflect::LayoutCache& layout_cache, VkDevice device);
+
+
+// Initialize a Compute Pipeline from a single shader
+// The pipeline layout is generated from the shader and owned by layout_cache,
+// reflection gets the rest of its interface (e.g. the workgroup size).
+void create_compute_pipeline(
+	VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
+	vk_reflect::ShaderReflection& reflection,
+	const std::string& shader_file,
+	const vk_variant::Specialization& specialization,
+	VkPipelineCache pipeline_cache,
+	vk_reflect::LayoutCache& layout_cache, VkDevice device);
+
+
+// Rebuild a compute pipeline for the shader hot reload. Its users keep their descriptor sets
+// and dispatch sizes, so it throws (the old pipeline stays in use) if the new shader
+// changed the pipeline layout or the workgroup size.
+void rebuild_compute_pipeline(
+	VkPipeline& pipeline, VkPipelineLayout& pipeline_layout,
+	const std::string& shader_file,
+	const vk_variant::Specialization& specialization,
+	VkPipelineLayout expected_pipeline_layout, const uint32_t expected_local_size[3],
+	VkPipelineCache pipeline_cache,
+	vk_reflect::LayoutCache& layout_cache, VkDevice device);
 
 
 // Initialize the Renderpass
-void create_renderpass(VkRenderPass& render_pass, VkDevice device, VkFormat swapchain_image_format);
+// Attachments: the color target (0) and the depth buffer (1). With more than one sample
+// the subpass renders to a multisampled attachment (0) and resolves it into the color target (1)
+// when it ends, the depth buffer is then 2.
+// The color target is the swapchain image, left ready to present, or with offscreen_target
+// an image of color_format left in COLOR_ATTACHMENT_OPTIMAL for the tone mapping pass.
+// With the depth pre-pass, subpass 0 only writes the depth and subpass 1 renders the color.
+void create_renderpass(
+	VkRenderPass& render_pass, VkDevice device,
+	VkFormat color_format, VkFormat depth_format,
+	VkSampleCountFlagBits samples, bool depth_prepass,
+	bool offscreen_target);
 
 
 // Create a shader module for each of the vertex and fragment shader
-VkShaderModule create_shader_module(const std::vector<char>& shader_code, VkDevice device);
+VkShaderModule create_shader_module(const my_util::MappedFile& shader_code, VkDevice device);
+
+
+// Initialize the Pipeline cache with the data saved by a previous run, if compatible
+void create_pipeline_cache(
+	VkPipelineCache& pipeline_cache, const std::string& file_path,
+	VkPhysicalDevice physical_device, VkDevice device);
+
+
+// Check that saved pipeline cache data was created by this device and driver
+bool check_pipeline_cache_compatible(const my_util::MappedFile& cache_file, VkPhysicalDevice physical_device);
+
+
+// Write the Pipeline cache data to disk for the next run
+void save_pipeline_cache(VkPipelineCache pipeline_cache, const std::string& file_path, VkDevice device);
+
+
+// Framebuffers of a render pass that renders to an offscreen target instead of the swapchain image
+const uint32_t NO_SWAPCHAIN_ATTACHMENT = UINT32_MAX;
 
 
 // Initialize Swapchain Framebuffers
+// attachments are the other attachments of the render pass (from vk_attachment::create_attachment()),
+// in order, shared by every framebuffer. The swapchain image view is inserted at swapchain_attachment,
+// unless it is NO_SWAPCHAIN_ATTACHMENT.
 void create_framebuffers(
 	std::vector<VkFramebuffer>& swapchain_framebuffers,
 	std::vector<VkImageView> swapchain_image_views,
+	const std::vector<vk_attachment::Attachment>& attachments, uint32_t swapchain_attachment,
 	VkExtent2D swapchain_extent,
 	VkDevice device, VkRenderPass render_pass);
 
@@ -41,12 +137,81 @@ void create_command_buffer(
 	VkDevice device);
 
 
-// Write commands
+// What record_command_buffer() draws with the pipeline
+struct DrawSettings {
+
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	VkShaderStageFlags push_constant_stages = 0;       // stages the per-draw data is pushed to, 0 for none
+
+	// One triangle per entry, its data is pushed right before the draw
+	std::vector<vk_draw::PerDraw> draws = { vk_draw::PerDraw{} };
+
+	// Slow path, for comparison: if set, the per-draw data is not pushed but read from a
+	// dynamic uniform buffer (set 0) already filled by vk_draw::write_per_draw()
+	VkDescriptorSet per_draw_descriptor_set = VK_NULL_HANDLE;
+	VkDeviceSize per_draw_stride = 0;
+
+	// If set, the particles are simulated and sorted before the rendering (their compute passes are in
+	// the queries below) and drawn after the draws above, with a DepthMode::Translucent(AfterPrepass) pipeline
+	vk_particles::ParticleSystem* particles = nullptr;
+	VkPipeline particle_pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout particle_pipeline_layout = VK_NULL_HANDLE;
+
+	VkQueryPool timestamp_query_pool = VK_NULL_HANDLE;  // if set, timestamps before and after the rendering in queries 0 and 1
+	VkQueryPool statistics_query_pool = VK_NULL_HANDLE; // if set, pipeline statistics of the rendering in query 0
+
+	// If set, each pass is counted in its own queries (a frame of the manager per command buffer).
+	// Not with statistics_query_pool: two pipeline statistics queries cannot be active at once.
+	vk_query::QueryManager* pass_queries = nullptr;
+
+	// If set, the final swapchain image is copied into a slot of the service at the end of the frame
+	// (the swapchain must have been created with readback_images)
+	vk_readback::ReadbackService* readback = nullptr;
+};
+
+
+// Offscreen HDR color target, tone mapped into the swapchain image after the scene
+struct HdrTarget {
+
+	vk_tonemap::ToneMapPass* tone_map = nullptr; // null: the scene is rendered straight into the swapchain image
+	VkFormat format = VK_FORMAT_UNDEFINED;
+
+	// Render pass path: the framebuffer attachment (the dynamic rendering path creates it in the render graph)
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView image_view = VK_NULL_HANDLE;
+};
+
+
+// Write commands that render to the swapchain image of swapchain_image_index
+// With RenderPath::DynamicRendering the render pass and framebuffer are ignored:
+// the frame is declared to render_graph, which records the layout transitions,
+// and the swapchain image view is rendered to directly.
+// With more than one sample the scene is rendered to a transient multisampled image
+// of the graph (or of the framebuffer) resolved into the swapchain image.
+// If depth_prepass_pipeline is set (DepthMode::DepthOnly), the draws are first recorded with it
+// and then with pipeline, which must be a DepthMode::EqualTest pipeline.
+// With an HDR target the scene is rendered to it instead, then a compute pass tone maps it
+// into the swapchain image: the render graph records the barriers around it on both paths.
+// Particles are updated before the rendering, with their own barriers, and drawn after the scene.
+// With pass queries, the particle update, the pre-pass, the scene and the tone mapping are each
+// in a query scope (the render pass path counts its subpasses together, as "scene").
 void record_command_buffer(
 	VkCommandBuffer command_buffer, uint32_t swapchain_image_index,
-	VkPipeline pipeline, VkRenderPass render_pass,
-	std::vector<VkFramebuffer> swapchain_framebuffers,
-	VkExtent2D swapchain_extent);
+	VkPipeline pipeline, VkPipeline depth_prepass_pipeline,
+	VkRenderPass render_pass, VkFramebuffer framebuffer,
+	VkImage swapchain_image, VkImageView swapchain_image_view,
+	VkFormat swapchain_image_format, VkFormat depth_format,
+	VkExtent2D swapchain_extent, VkSampleCountFlagBits samples,
+	const HdrTarget& hdr_target,
+	vk_config::RenderPath render_path,
+	const DrawSettings& draw_settings,
+	vk_graph::RenderGraph& render_graph);
+
+
+// Record the draws of the settings, inside a render pass or a dynamic rendering scope
+void record_draws(
+	VkCommandBuffer command_buffer, VkPipeline pipeline,
+	VkExtent2D extent, const DrawSettings& draw_settings);
 
 
 // Initialize semaphores and fences
@@ -0,0 +1,258 @@
+#include "vk_primitives.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <algorithm>	// min(), swap()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_primitives {
+
+
+// Push constants of reduce.comp and compact.comp
+struct CountConstants {
+	uint32_t count;
+};
+
+// Push constants of scan.comp
+struct ScanConstants {
+	uint32_t count;
+	uint32_t inclusive;
+	uint32_t add_tile_offsets;
+};
+
+// Push constants of radix_histogram.comp and radix_scatter.comp
+struct RadixConstants {
+	uint32_t count;
+	uint32_t shift;
+	uint32_t tile_count;
+};
+
+
+static uint32_t tile_count(uint32_t count, uint32_t tile_size) {
+
+	return static_cast<uint32_t>((static_cast<uint64_t>(count) + tile_size - 1) / tile_size);
+}
+
+
+bool check_subgroup_support(VkPhysicalDevice physical_device) {
+
+	VkPhysicalDeviceSubgroupProperties subgroup_properties{};
+	subgroup_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 device_properties{};
+	device_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	device_properties.pNext = &subgroup_properties;
+
+	vkGetPhysicalDeviceProperties2(physical_device, &device_properties);
+
+	VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT |
+		                              VK_SUBGROUP_FEATURE_BALLOT_BIT;
+
+	return (subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+		   (subgroup_properties.supportedOperations & required) == required &&
+		   subgroup_properties.subgroupSize >= 4;
+}
+
+
+Primitives::Primitives(vk_compute::ComputeContext& context)
+	: context(context), scan_levels(MAX_SCAN_LEVELS) {
+
+	reduce_kernel = context.create_kernel(REDUCE_SHADER_FILE);
+	scan_kernel = context.create_kernel(SCAN_SHADER_FILE);
+	compact_kernel = context.create_kernel(COMPACT_SHADER_FILE);
+
+	for (uint32_t key_words = 1; key_words <= 2; key_words++) {
+
+		vk_variant::Specialization specialization;
+		specialization.set(0, key_words); // KEY_WORDS
+
+		radix_histogram_kernels[key_words - 1] = context.create_kernel(RADIX_HISTOGRAM_SHADER_FILE, specialization);
+		radix_scatter_kernels[key_words - 1] = context.create_kernel(RADIX_SCATTER_SHADER_FILE, specialization);
+	}
+}
+
+
+void Primitives::inclusive_scan(const vk_compute::Buffer& input, vk_compute::Buffer& output, uint32_t count) {
+
+	scan(input, output, count, true, 0);
+}
+
+
+void Primitives::exclusive_scan(const vk_compute::Buffer& input, vk_compute::Buffer& output, uint32_t count) {
+
+	scan(input, output, count, false, 0);
+}
+
+
+void Primitives::scan(const vk_compute::Buffer& input, vk_compute::Buffer& output, uint32_t count,
+	                  bool inclusive, size_t level) {
+
+	if (count == 0) {
+		return;
+	}
+
+	uint32_t tiles = tile_count(count, SCAN_TILE_SIZE);
+
+	ScanConstants constants{ count, inclusive ? 1u : 0u, 0u };
+
+	// A single tile needs no tile offsets (the binding is not read)
+	if (tiles == 1) {
+		dispatch_tiles(scan_kernel, { &input, &output, &output }, &constants, sizeof(constants), 1);
+		return;
+	}
+
+	if (level + 1 >= MAX_SCAN_LEVELS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Too many elements to scan! \033[0m \n");
+	}
+
+	vk_compute::Buffer& tile_sums = scratch(scan_levels[level], static_cast<VkDeviceSize>(tiles) * sizeof(uint32_t));
+
+	CountConstants reduce_constants{ count };
+	dispatch_tiles(reduce_kernel, { &input, &tile_sums }, &reduce_constants, sizeof(reduce_constants), tiles);
+
+	// The tile sums become the offset of each tile
+	scan(tile_sums, tile_sums, tiles, false, level + 1);
+
+	constants.add_tile_offsets = 1;
+	dispatch_tiles(scan_kernel, { &input, &output, &tile_sums }, &constants, sizeof(constants), tiles);
+}
+
+
+void Primitives::reduce(const vk_compute::Buffer& input, vk_compute::Buffer& result, uint32_t count) {
+
+	if (count == 0) {
+		context.fill(result, 0, sizeof(uint32_t));
+		return;
+	}
+
+	const vk_compute::Buffer* level_input = &input;
+	uint32_t level_count = count;
+
+	for (size_t level = 0; ; level++) {
+
+		uint32_t tiles = tile_count(level_count, SCAN_TILE_SIZE);
+
+		// The last level writes its single tile sum to the result
+		vk_compute::Buffer& level_output = (tiles == 1) ?
+			result : scratch(scan_levels[level], static_cast<VkDeviceSize>(tiles) * sizeof(uint32_t));
+
+		CountConstants constants{ level_count };
+		dispatch_tiles(reduce_kernel, { level_input, &level_output }, &constants, sizeof(constants), tiles);
+
+		if (tiles == 1) {
+			return;
+		}
+
+		level_input = &level_output;
+		level_count = tiles;
+	}
+}
+
+
+void Primitives::compact(const vk_compute::Buffer& values, const vk_compute::Buffer& flags,
+	                     vk_compute::Buffer& output, vk_compute::Buffer& output_count, uint32_t count) {
+
+	if (count == 0) {
+		context.fill(output_count, 0, sizeof(uint32_t));
+		return;
+	}
+
+	vk_compute::Buffer& offsets = scratch(compact_offsets, static_cast<VkDeviceSize>(count) * sizeof(uint32_t));
+
+	exclusive_scan(flags, offsets, count);
+
+	CountConstants constants{ count };
+	context.dispatch(compact_kernel, { &values, &flags, &offsets, &output, &output_count },
+		             &constants, sizeof(constants), context.group_count(count, compact_kernel));
+}
+
+
+void Primitives::sort_pairs(vk_compute::Buffer& keys, vk_compute::Buffer& values, uint32_t count, uint32_t key_bits) {
+
+	if (key_bits != 32 && key_bits != 64) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Radix sort keys are 32 or 64 bit, not " + std::to_string(key_bits) + "! \033[0m \n");
+	}
+
+	if (count <= 1) {
+		return;
+	}
+
+	uint32_t key_words = key_bits / 32;
+	uint32_t tiles = tile_count(count, RADIX_TILE_SIZE);
+
+	const vk_compute::Kernel& histogram_kernel = radix_histogram_kernels[key_words - 1];
+	const vk_compute::Kernel& scatter_kernel = radix_scatter_kernels[key_words - 1];
+
+	vk_compute::Buffer* source_keys = &keys;
+	vk_compute::Buffer* source_values = &values;
+	vk_compute::Buffer* destination_keys = &scratch(sort_keys, static_cast<VkDeviceSize>(count) * key_words * sizeof(uint32_t));
+	vk_compute::Buffer* destination_values = &scratch(sort_values, static_cast<VkDeviceSize>(count) * sizeof(uint32_t));
+
+	uint32_t histogram_count = tiles * (1u << RADIX_BITS);
+	vk_compute::Buffer& histograms = scratch(radix_histograms, static_cast<VkDeviceSize>(histogram_count) * sizeof(uint32_t));
+
+	// An even number of passes: the last one writes back to keys and values
+	for (uint32_t shift = 0; shift < key_bits; shift += RADIX_BITS) {
+
+		RadixConstants constants{ count, shift, tiles };
+
+		dispatch_tiles(histogram_kernel, { source_keys, &histograms }, &constants, sizeof(constants), tiles);
+
+		exclusive_scan(histograms, histograms, histogram_count);
+
+		dispatch_tiles(scatter_kernel, { source_keys, source_values, &histograms, destination_keys, destination_values },
+			           &constants, sizeof(constants), tiles);
+
+		std::swap(source_keys, destination_keys);
+		std::swap(source_values, destination_values);
+	}
+}
+
+
+void Primitives::watch(vk_hot_reload::ShaderHotReload& hot_reload) {
+
+	context.watch_kernel(hot_reload, reduce_kernel);
+	context.watch_kernel(hot_reload, scan_kernel);
+	context.watch_kernel(hot_reload, compact_kernel);
+
+	for (int i = 0; i < 2; i++) {
+		context.watch_kernel(hot_reload, radix_histogram_kernels[i]);
+		context.watch_kernel(hot_reload, radix_scatter_kernels[i]);
+	}
+}
+
+
+void Primitives::dispatch_tiles(const vk_compute::Kernel& kernel, const std::vector<const vk_compute::Buffer*>& buffers,
+	                            const void* push_constants, uint32_t push_constants_size, uint32_t tile_count) {
+
+	// The kernels skip the tiles past tile_count in the last row
+	uint32_t group_count_x = std::min(tile_count, context.properties().limits.maxComputeWorkGroupCount[0]);
+	uint32_t group_count_y = (tile_count + group_count_x - 1) / group_count_x;
+
+	context.dispatch(kernel, buffers, push_constants, push_constants_size, group_count_x, group_count_y);
+}
+
+
+vk_compute::Buffer& Primitives::scratch(vk_compute::Buffer& buffer, VkDeviceSize size) {
+
+	if (buffer.size >= size) {
+		return buffer;
+	}
+
+	// The recorded commands may use the buffer that is replaced
+	if (context.recorded_commands() > 0) {
+		context.submit();
+	}
+
+	buffer = context.create_buffer(size);
+	return buffer;
+}
+
+
+} // namespace vk_primitives
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_compute.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace vk_primitives {
+
+
+// SPIR-V of the shaders/*.comp kernels
+const std::string REDUCE_SHADER_FILE = "shaders/reduce_comp.spv";
+const std::string SCAN_SHADER_FILE = "shaders/scan_comp.spv";
+const std::string COMPACT_SHADER_FILE = "shaders/compact_comp.spv";
+const std::string RADIX_HISTOGRAM_SHADER_FILE = "shaders/radix_histogram_comp.spv";
+const std::string RADIX_SCATTER_SHADER_FILE = "shaders/radix_scatter_comp.spv";
+
+
+// True if compute shaders have the subgroup operations the kernels use (basic, arithmetic, ballot)
+// and subgroups of at least 4 invocations (at most 64 per workgroup of 256)
+bool check_subgroup_support(VkPhysicalDevice physical_device);
+
+
+/*
+Parallel primitives over uint storage buffers, recorded in the batch of a ComputeContext:
+nothing runs until its submit(), and each call may be followed by others in the same batch.
+- Scans are tiled (1024 elements per workgroup): each tile is reduced, the tile sums are
+  scanned the same way (recursively), then each tile is scanned with subgroup operations
+  and offset by the sum of the tiles before it.
+- The reduction sums tiles level by level until one value is left.
+- Compaction scans the 0/1 flags into the output positions of the kept values.
+- The radix sort sorts key-value pairs by 4 bits per pass (8 passes for 32 bit keys,
+  16 for 64 bit keys), with a histogram per tile scanned with the scan above.
+  It is stable, and the sorted pairs end in the buffers they came from.
+Scratch buffers are kept between calls and grown as needed;
+growing one submits the commands recorded so far, as they may still use it.
+*/
+class Primitives {
+
+public:
+
+	explicit Primitives(vk_compute::ComputeContext& context);
+
+	Primitives(const Primitives&) = delete;
+	Primitives& operator=(const Primitives&) = delete;
+
+	// output[i] = input[0] + ... + input[i], input and output may be the same buffer
+	void inclusive_scan(const vk_compute::Buffer& input, vk_compute::Buffer& output, uint32_t count);
+
+	// output[i] = input[0] + ... + input[i - 1], output[0] = 0
+	void exclusive_scan(const vk_compute::Buffer& input, vk_compute::Buffer& output, uint32_t count);
+
+	// result[0] = sum of the count first elements of input (modulo 2^32)
+	void reduce(const vk_compute::Buffer& input, vk_compute::Buffer& result, uint32_t count);
+
+	// Copy values[i] for which flags[i] is 1 (flags are 0 or 1) to the start of output, in order,
+	// and their number to output_count[0]
+	void compact(
+		const vk_compute::Buffer& values, const vk_compute::Buffer& flags,
+		vk_compute::Buffer& output, vk_compute::Buffer& output_count, uint32_t count);
+
+	// Sort count pairs by key, in place. key_bits is 32 (uint keys) or 64 (uint64 keys,
+	// low word first as in memory on the host); values are uint (e.g. indices).
+	void sort_pairs(vk_compute::Buffer& keys, vk_compute::Buffer& values, uint32_t count, uint32_t key_bits);
+
+	// Rebuild the kernels when the shader hot reload recompiles their shaders
+	void watch(vk_hot_reload::ShaderHotReload& hot_reload);
+
+	static const uint32_t SCAN_TILE_SIZE = 1024;
+	static const uint32_t RADIX_TILE_SIZE = 256;
+	static const uint32_t RADIX_BITS = 4;
+
+private:
+
+	// Enough for 2^32 elements: 2^22, 2^12, 4 then 1 tile sums
+	static const size_t MAX_SCAN_LEVELS = 4;
+
+	vk_compute::ComputeContext& context;
+
+	vk_compute::Kernel reduce_kernel;
+	vk_compute::Kernel scan_kernel;
+	vk_compute::Kernel compact_kernel;
+	vk_compute::Kernel radix_histogram_kernels[2]; // by key words - 1
+	vk_compute::Kernel radix_scatter_kernels[2];
+
+	std::vector<vk_compute::Buffer> scan_levels; // tile sums of each level, MAX_SCAN_LEVELS
+	vk_compute::Buffer compact_offsets;
+	vk_compute::Buffer sort_keys;                // the other half of the ping-pong
+	vk_compute::Buffer sort_values;
+	vk_compute::Buffer radix_histograms;
+
+	void scan(const vk_compute::Buffer& input, vk_compute::Buffer& output, uint32_t count, bool inclusive, size_t level);
+
+	// Dispatch one workgroup per tile, along y too past maxComputeWorkGroupCount[0]
+	void dispatch_tiles(
+		const vk_compute::Kernel& kernel, const std::vector<const vk_compute::Buffer*>& buffers,
+		const void* push_constants, uint32_t push_constants_size, uint32_t tile_count);
+
+	// buffer, grown to at least size bytes
+	vk_compute::Buffer& scratch(vk_compute::Buffer& buffer, VkDeviceSize size);
+};
+
+
+} // namespace vk_primitives
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include "vk_profiler.hpp"
+#include "my_util.hpp"
+
+#include <algorithm>	// sort(), min_element(), max_element(), min(), max()
+#include <numeric>		// accumulate()
+#include <cmath>		// sqrt()
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_profiler {
+
+
+void TimingStats::add_sample(double milliseconds) {
+
+	samples.push_back(milliseconds);
+}
+
+
+void TimingStats::clear() {
+
+	samples.clear();
+}
+
+
+size_t TimingStats::count() const {
+
+	return samples.size();
+}
+
+
+double TimingStats::average() const {
+
+	if (samples.empty()) {
+		return 0.0;
+	}
+
+	return std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+}
+
+
+double TimingStats::minimum() const {
+
+	return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end());
+}
+
+
+double TimingStats::maximum() const {
+
+	return samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+}
+
+
+double TimingStats::standard_deviation() const {
+
+	if (samples.size() < 2) {
+		return 0.0;
+	}
+
+	double avg = average();
+	double sum = 0.0;
+	for (double s : samples) {
+		sum += (s - avg) * (s - avg);
+	}
+
+	return std::sqrt(sum / static_cast<double>(samples.size() - 1));
+}
+
+
+double TimingStats::percentile(double fraction) const {
+
+	if (samples.empty()) {
+		return 0.0;
+	}
+
+	std::vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+
+void TimingStats::report(const std::string& name) const {
+
+	std::ostringstream stats_log;
+	stats_log << std::fixed << std::setprecision(3)
+		<< name
+		<< " \t | n " << count()
+		<< " | avg " << average() << " ms"
+		<< " | min " << minimum() << " ms"
+		<< " | max " << maximum() << " ms"
+		<< " | stddev " << standard_deviation() << " ms"
+		<< " | p99 " << percentile(0.99) << " ms";
+
+	LOG_MESSAGE(stats_log.str(), Color::Bright_Green, Color::Black, 4);
+}
+
+
+ScopedTimer::ScopedTimer(TimingStats& stats)
+	: stats(stats), start(std::chrono::steady_clock::now()) {
+}
+
+
+ScopedTimer::~ScopedTimer() {
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	stats.add_sample(elapsed.count());
+}
+
+
+TraceRecorder::TraceRecorder()
+	: origin(std::chrono::steady_clock::now()) {
+
+	threads.push_back(std::this_thread::get_id());
+}
+
+
+void TraceRecorder::add_event(const std::string& name,
+	                          std::chrono::steady_clock::time_point start,
+	                          std::chrono::steady_clock::time_point end) {
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+
+	events.push_back({ name, thread_index_locked(), to_microseconds(start), to_microseconds(end) - to_microseconds(start), {} });
+}
+
+
+void TraceRecorder::add_marker(const std::string& name) {
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+
+	events.push_back({ name, thread_index_locked(), to_microseconds(std::chrono::steady_clock::now()), -1.0, {} });
+}
+
+
+void TraceRecorder::add_counter(const std::string& name, const std::vector<std::pair<std::string, double>>& values) {
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+
+	events.push_back({ name, thread_index_locked(), to_microseconds(std::chrono::steady_clock::now()), -1.0, values });
+}
+
+
+double TraceRecorder::elapsed() const {
+
+	return to_microseconds(std::chrono::steady_clock::now()) / 1000.0;
+}
+
+
+void TraceRecorder::report() const {
+
+	std::vector<Event> sorted;
+	{
+		std::lock_guard<std::mutex> lock(events_mutex);
+		sorted = events;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Event& a, const Event& b) { return a.start < b.start; });
+
+	for (const auto& event : sorted) {
+
+		std::ostringstream event_log;
+		event_log << std::fixed << std::setprecision(3)
+			<< "[thread " << event.thread_index << "] "
+			<< "@ " << event.start / 1000.0 << " ms \t" << event.name;
+
+		if (event.duration >= 0.0) {
+			event_log << " \t| " << event.duration / 1000.0 << " ms";
+		}
+		for (const auto& [series, value] : event.counter_values) {
+			event_log << " \t| " << series << " " << value;
+		}
+
+		LOG_MESSAGE(event_log.str(), Color::Bright_Green, Color::Black, 4 + 4 * event.thread_index);
+	}
+}
+
+
+// Names are ours, only quotes and backslashes need escaping
+static std::string json_escape(const std::string& text) {
+
+	std::string escaped;
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+
+void TraceRecorder::write_chrome_trace(const std::string& file_path) const {
+
+	std::ofstream file(file_path, std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to open file: " + file_path + " \033[0m \n");
+	}
+
+	std::lock_guard<std::mutex> lock(events_mutex);
+
+	file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+
+	for (size_t i = 0; i < events.size(); i++) {
+
+		const Event& event = events[i];
+
+		file << "{\"name\":\"" << json_escape(event.name) << "\",\"cat\":\"startup\""
+			<< ",\"pid\":1,\"tid\":" << event.thread_index
+			<< ",\"ts\":" << event.start;
+
+		if (event.duration >= 0.0) {
+			// Complete event
+			file << ",\"ph\":\"X\",\"dur\":" << event.duration << "}";
+		}
+		else if (!event.counter_values.empty()) {
+			// Counter event, one series per value
+			file << ",\"ph\":\"C\",\"args\":{";
+			for (size_t v = 0; v < event.counter_values.size(); v++) {
+				file << (v > 0 ? "," : "") << "\"" << json_escape(event.counter_values[v].first) << "\":" << event.counter_values[v].second;
+			}
+			file << "}}";
+		}
+		else {
+			// Instant event, drawn across all threads
+			file << ",\"ph\":\"i\",\"s\":\"g\"}";
+		}
+
+		file << (i + 1 < events.size() ? ",\n" : "\n");
+	}
+
+	file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+	LOG_MESSAGE("Trace written to " + file_path, Color::Bright_Green, Color::Black, 4);
+}
+
+
+uint32_t TraceRecorder::thread_index_locked() {
+
+	std::thread::id id = std::this_thread::get_id();
+
+	auto it = std::find(threads.begin(), threads.end(), id);
+	if (it != threads.end()) {
+		return static_cast<uint32_t>(it - threads.begin());
+	}
+
+	threads.push_back(id);
+	return static_cast<uint32_t>(threads.size() - 1);
+}
+
+
+double TraceRecorder::to_microseconds(std::chrono::steady_clock::time_point time) const {
+
+	return std::chrono::duration<double, std::micro>(time - origin).count();
+}
+
+
+ScopedTrace::ScopedTrace(TraceRecorder& trace, const std::string& name)
+	: trace(trace), name(name), start(std::chrono::steady_clock::now()) {
+}
+
+
+ScopedTrace::~ScopedTrace() {
+
+	trace.add_event(name, start, std::chrono::steady_clock::now());
+}
+
+
+void FrameCounters::add(const std::string& name, double value) {
+
+	for (Counter& counter : counters) {
+		if (counter.name == name) {
+			counter.current += value;
+			return;
+		}
+	}
+
+	// Zero in the frames before its first use
+	Counter counter;
+	counter.name = name;
+	counter.current = value;
+	counter.minimum = frames > 0 ? 0.0 : value;
+	counters.push_back(counter);
+}
+
+
+void FrameCounters::end_frame() {
+
+	for (Counter& counter : counters) {
+		counter.total += counter.current;
+		counter.minimum = frames > 0 ? std::min(counter.minimum, counter.current) : counter.current;
+		counter.maximum = std::max(counter.maximum, counter.current);
+		counter.current = 0.0;
+	}
+
+	frames++;
+}
+
+
+void FrameCounters::report(const std::string& name) const {
+
+	if (frames == 0) {
+		return;
+	}
+
+	for (const Counter& counter : counters) {
+
+		std::ostringstream counter_log;
+		counter_log << std::fixed << std::setprecision(1)
+			<< name << " | " << counter.name
+			<< " \t | frames " << frames
+			<< " | avg " << counter.total / static_cast<double>(frames)
+			<< " | min " << counter.minimum
+			<< " | max " << counter.maximum;
+
+		LOG_MESSAGE(counter_log.str(), Color::Bright_Green, Color::Black, 4);
+	}
+}
+
+
+void FrameCounters::record_counters(TraceRecorder& trace, const std::string& name) const {
+
+	if (frames == 0) {
+		return;
+	}
+
+	std::vector<std::pair<std::string, double>> values;
+	for (const Counter& counter : counters) {
+		values.push_back({ counter.name, counter.total / static_cast<double>(frames) });
+	}
+
+	trace.add_counter(name, values);
+}
+
+
+} // namespace vk_profiler
\ No newline at end of file
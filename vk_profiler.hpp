@@ -0,0 +1,165 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>	// pair
+
+
+namespace vk_profiler {
+
+
+// Collects CPU timings (in milliseconds) of an operation
+// that is executed many times (frames, swapchain recreations...)
+class TimingStats {
+
+public:
+
+	void add_sample(double milliseconds);
+
+	void clear();
+
+	size_t count() const;
+	double average() const;
+	double minimum() const;
+	double maximum() const;
+	double standard_deviation() const;
+
+	// Value below which the given fraction (0..1) of the samples falls
+	double percentile(double fraction) const;
+
+	// Log count, average, min, max, standard deviation and 99th percentile
+	void report(const std::string& name) const;
+
+private:
+
+	std::vector<double> samples;
+};
+
+
+// Adds the time elapsed between its construction and destruction
+// to a TimingStats
+class ScopedTimer {
+
+public:
+
+	explicit ScopedTimer(TimingStats& stats);
+	~ScopedTimer();
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+
+	TimingStats& stats;
+	std::chrono::steady_clock::time_point start;
+};
+
+
+/*
+Timeline of named phases (startup, loading...) recorded from any thread.
+Times are relative to the construction of the recorder.
+write_chrome_trace() exports the Chrome trace event format,
+which chrome://tracing and https://ui.perfetto.dev can open:
+phases running in parallel appear side by side, one row per thread.
+*/
+class TraceRecorder {
+
+public:
+
+	TraceRecorder();
+
+	void add_event(const std::string& name,
+		           std::chrono::steady_clock::time_point start,
+		           std::chrono::steady_clock::time_point end);
+
+	// Instant event, e.g. "first frame presented"
+	void add_marker(const std::string& name);
+
+	// Values of a counter track at this time, e.g. { {"usage", 512}, {"budget", 7800} }
+	void add_counter(const std::string& name, const std::vector<std::pair<std::string, double>>& values);
+
+	// Milliseconds since the construction of the recorder
+	double elapsed() const;
+
+	// Log every event in start order, indented by thread
+	void report() const;
+
+	void write_chrome_trace(const std::string& file_path) const;
+
+private:
+
+	struct Event {
+		std::string name;
+		uint32_t thread_index;
+		double start;    // microseconds since origin
+		double duration; // microseconds, < 0 for markers and counters
+		std::vector<std::pair<std::string, double>> counter_values;
+	};
+
+	std::chrono::steady_clock::time_point origin;
+
+	mutable std::mutex events_mutex;
+	std::vector<Event> events;
+	std::vector<std::thread::id> threads; // thread_index -> id, the first one is the recording thread
+
+	uint32_t thread_index_locked();
+	double to_microseconds(std::chrono::steady_clock::time_point time) const;
+};
+
+
+// Adds an event lasting from its construction to its destruction to a TraceRecorder
+class ScopedTrace {
+
+public:
+
+	ScopedTrace(TraceRecorder& trace, const std::string& name);
+	~ScopedTrace();
+
+	ScopedTrace(const ScopedTrace&) = delete;
+	ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+private:
+
+	TraceRecorder& trace;
+	std::string name;
+	std::chrono::steady_clock::time_point start;
+};
+
+
+// Counts that add up over a frame (barriers, draw calls...): add() during the frame,
+// end_frame() once it is recorded. Keeps the total, minimum and maximum per frame of each counter.
+class FrameCounters {
+
+public:
+
+	void add(const std::string& name, double value);
+
+	void end_frame();
+
+	size_t frame_count() const { return frames; }
+
+	// Log the average, min and max per frame of every counter
+	void report(const std::string& name) const;
+
+	// Averages per frame as a counter track of a trace
+	void record_counters(TraceRecorder& trace, const std::string& name) const;
+
+private:
+
+	struct Counter {
+		std::string name;
+		double current = 0.0; // of the frame being recorded
+		double total = 0.0;
+		double minimum = 0.0;
+		double maximum = 0.0;
+	};
+
+	std::vector<Counter> counters; // in the order of their first add()
+	size_t frames = 0;
+};
+
+
+} // namespace vk_profiler
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "vk_query.hpp"
+#include "vk_buffer.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <cstring>		// memset()
+#include <sstream>
+#include <iomanip>
+#include <algorithm>	// sort()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_query {
+
+
+// Written in the order of their bits: one uint64_t each, then the availability
+static const VkQueryPipelineStatisticFlags STATISTICS =
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// uint64_t per query in the result buffer, with the availability
+static const uint32_t STATISTICS_WORDS = 7;
+static const uint32_t OCCLUSION_WORDS = 2;
+
+
+void PassCounts::add(const PassCounts& other) {
+
+	input_vertices += other.input_vertices;
+	vertex_invocations += other.vertex_invocations;
+	clipping_invocations += other.clipping_invocations;
+	clipping_primitives += other.clipping_primitives;
+	fragment_invocations += other.fragment_invocations;
+	compute_invocations += other.compute_invocations;
+	samples_passed += other.samples_passed;
+}
+
+
+static vk_handle::Handle<VkQueryPool> create_query_pool(VkDevice device, VkQueryType type,
+	                                                    VkQueryPipelineStatisticFlags statistics, uint32_t count,
+	                                                    vk_handle::DeletionQueue* deletion_queue) {
+
+	VkQueryPoolCreateInfo query_pool_info{};
+	query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_info.queryType = type;
+	query_pool_info.queryCount = count;
+	query_pool_info.pipelineStatistics = statistics;
+
+	VkQueryPool new_query_pool;
+	if (vkCreateQueryPool(device, &query_pool_info, nullptr, &new_query_pool) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Query pool! \033[0m \n");
+	}
+
+	return vk_handle::Handle<VkQueryPool>(new_query_pool, device, deletion_queue);
+}
+
+
+QueryManager::QueryManager(VkPhysicalDevice physical_device, VkDevice device,
+	                       const vk_device::DeviceProbe& device_probe, vk_handle::DeletionQueue* deletion_queue,
+	                       uint32_t ring_size, uint32_t max_passes)
+	: device(device), ring_size(ring_size), max_passes(max_passes), slots(ring_size) {
+
+	precise_occlusion = device_probe.occlusion_query_precise;
+
+	uint32_t query_count = ring_size * max_passes;
+
+	if (device_probe.pipeline_statistics) {
+		statistics_pool = create_query_pool(device, VK_QUERY_TYPE_PIPELINE_STATISTICS, STATISTICS, query_count, deletion_queue);
+	}
+	else {
+		LOG_MESSAGE("Pipeline statistics queries not supported, only the occlusion of the passes is counted.", Color::Red, Color::Black, 4);
+	}
+	occlusion_pool = create_query_pool(device, VK_QUERY_TYPE_OCCLUSION, 0, query_count, deletion_queue);
+
+	VkDeviceSize result_size = static_cast<VkDeviceSize>(query_count) * (STATISTICS_WORDS + OCCLUSION_WORDS) * sizeof(uint64_t);
+
+	VkBuffer new_buffer;
+	VkDeviceMemory new_memory;
+	vk_buffer::create_buffer(new_buffer, new_memory, result_size,
+		                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                     physical_device, device);
+
+	result_memory = vk_handle::Handle<VkDeviceMemory>(new_memory, device, deletion_queue);
+	result_buffer = vk_handle::Handle<VkBuffer>(new_buffer, device, deletion_queue);
+
+	void* mapped = nullptr;
+	if (vkMapMemory(device, new_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to map Vulkan query result Buffer memory! \033[0m \n");
+	}
+	results = static_cast<uint64_t*>(mapped);
+	memset(results, 0, static_cast<size_t>(result_size));
+}
+
+
+uint64_t* QueryManager::statistics_results(uint32_t slot, uint32_t pass) const {
+
+	return results + static_cast<size_t>(slot) * max_passes * (STATISTICS_WORDS + OCCLUSION_WORDS) +
+		   static_cast<size_t>(pass) * STATISTICS_WORDS;
+}
+
+
+uint64_t* QueryManager::occlusion_results(uint32_t slot, uint32_t pass) const {
+
+	return results + static_cast<size_t>(slot) * max_passes * (STATISTICS_WORDS + OCCLUSION_WORDS) +
+		   static_cast<size_t>(max_passes) * STATISTICS_WORDS + static_cast<size_t>(pass) * OCCLUSION_WORDS;
+}
+
+
+void QueryManager::begin_frame(VkCommandBuffer command_buffer) {
+
+	if (recording) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("begin_frame() called twice without end_frame() on the query manager! \033[0m \n");
+	}
+
+	current_slot = static_cast<uint32_t>(frame_count % ring_size);
+	Slot& slot = slots[current_slot];
+
+	if (slot.pending) {
+		collect();
+		if (slot.pending) {
+			// Still running ring_size frames later: its results are about to be overwritten
+			dropped_frames++;
+			slot.pending = false;
+		}
+	}
+
+	slot.frame = frame_count++;
+	slot.pass_names.clear();
+
+	// The availability words of the slot tell collect() when the copy of this frame has run
+	memset(statistics_results(current_slot, 0), 0, static_cast<size_t>(max_passes) * (STATISTICS_WORDS + OCCLUSION_WORDS) * sizeof(uint64_t));
+
+	uint32_t first_query = current_slot * max_passes;
+	if (has_statistics()) {
+		vkCmdResetQueryPool(command_buffer, statistics_pool, first_query, max_passes);
+	}
+	vkCmdResetQueryPool(command_buffer, occlusion_pool, first_query, max_passes);
+
+	recording = true;
+}
+
+
+void QueryManager::begin_pass(VkCommandBuffer command_buffer, const std::string& name) {
+
+	if (!recording || pass_open) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Query scope of pass " + name + " outside of a frame or inside another scope! \033[0m \n");
+	}
+
+	Slot& slot = slots[current_slot];
+	pass_open = true;
+	pass_counted = slot.pass_names.size() < max_passes;
+
+	if (!pass_counted) {
+		uncounted_passes++;
+		return;
+	}
+
+	uint32_t query = current_slot * max_passes + static_cast<uint32_t>(slot.pass_names.size());
+	slot.pass_names.push_back(name);
+
+	if (has_statistics()) {
+		vkCmdBeginQuery(command_buffer, statistics_pool, query, 0);
+	}
+	vkCmdBeginQuery(command_buffer, occlusion_pool, query, precise_occlusion ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+}
+
+
+void QueryManager::end_pass(VkCommandBuffer command_buffer) {
+
+	if (!pass_open) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("end_pass() without begin_pass() on the query manager! \033[0m \n");
+	}
+	pass_open = false;
+
+	if (!pass_counted) {
+		return;
+	}
+
+	uint32_t query = current_slot * max_passes + static_cast<uint32_t>(slots[current_slot].pass_names.size()) - 1;
+
+	if (has_statistics()) {
+		vkCmdEndQuery(command_buffer, statistics_pool, query);
+	}
+	vkCmdEndQuery(command_buffer, occlusion_pool, query);
+}
+
+
+void QueryManager::end_frame(VkCommandBuffer command_buffer) {
+
+	if (!recording || pass_open) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("end_frame() outside of a frame or inside a pass scope on the query manager! \033[0m \n");
+	}
+	recording = false;
+
+	Slot& slot = slots[current_slot];
+	uint32_t pass_count = static_cast<uint32_t>(slot.pass_names.size());
+
+	if (pass_count == 0) {
+		return;
+	}
+
+	uint32_t first_query = current_slot * max_passes;
+	VkDeviceSize slot_offset = static_cast<VkDeviceSize>(first_query) * (STATISTICS_WORDS + OCCLUSION_WORDS) * sizeof(uint64_t);
+
+	// The queries ended earlier in the same command buffer: WAIT makes the copy wait for them
+	VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+
+	if (has_statistics()) {
+		vkCmdCopyQueryPoolResults(command_buffer, statistics_pool, first_query, pass_count,
+			                      result_buffer, slot_offset,
+			                      STATISTICS_WORDS * sizeof(uint64_t), flags);
+	}
+	vkCmdCopyQueryPoolResults(command_buffer, occlusion_pool, first_query, pass_count,
+		                      result_buffer, slot_offset + static_cast<VkDeviceSize>(max_passes) * STATISTICS_WORDS * sizeof(uint64_t),
+		                      OCCLUSION_WORDS * sizeof(uint64_t), flags);
+
+	// Visible to the host once the frame has completed
+	VkMemoryBarrier2 to_host{};
+	to_host.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	to_host.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+	to_host.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	to_host.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+	to_host.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+	VkDependencyInfo dependency_info{};
+	dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency_info.memoryBarrierCount = 1;
+	dependency_info.pMemoryBarriers = &to_host;
+
+	vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+
+	slot.pending = true;
+}
+
+
+bool QueryManager::read_slot(uint32_t slot, FrameResult& frame) const {
+
+	frame.frame = slots[slot].frame;
+	frame.passes.clear();
+
+	for (uint32_t pass = 0; pass < slots[slot].pass_names.size(); pass++) {
+
+		const uint64_t* statistics = statistics_results(slot, pass);
+		const uint64_t* occlusion = occlusion_results(slot, pass);
+
+		if ((has_statistics() && statistics[STATISTICS_WORDS - 1] == 0) || occlusion[OCCLUSION_WORDS - 1] == 0) {
+			return false;
+		}
+
+		PassCounts counts;
+		if (has_statistics()) {
+			counts.input_vertices = statistics[0];
+			counts.vertex_invocations = statistics[1];
+			counts.clipping_invocations = statistics[2];
+			counts.clipping_primitives = statistics[3];
+			counts.fragment_invocations = statistics[4];
+			counts.compute_invocations = statistics[5];
+		}
+		counts.samples_passed = occlusion[0];
+
+		frame.passes.push_back({ slots[slot].pass_names[pass], counts });
+	}
+
+	return true;
+}
+
+
+void QueryManager::collect() {
+
+	// Oldest first: the frames complete in submission order
+	std::vector<uint32_t> pending;
+	for (uint32_t s = 0; s < ring_size; s++) {
+		if (slots[s].pending) {
+			pending.push_back(s);
+		}
+	}
+	std::sort(pending.begin(), pending.end(), [this](uint32_t a, uint32_t b) { return slots[a].frame < slots[b].frame; });
+
+	for (uint32_t s : pending) {
+
+		FrameResult frame;
+		if (!read_slot(s, frame)) {
+			break;
+		}
+
+		slots[s].pending = false;
+		collected_frames++;
+
+		for (const auto& pass : frame.passes) {
+
+			size_t t = 0;
+			while (t < totals.size() && totals[t].first != pass.first) {
+				t++;
+			}
+			if (t == totals.size()) {
+				totals.push_back({ pass.first, PassCounts{} });
+				total_frames.push_back(0);
+			}
+
+			totals[t].second.add(pass.second);
+			total_frames[t]++;
+		}
+
+		latest_frame = std::move(frame);
+	}
+}
+
+
+void QueryManager::report() const {
+
+	uint64_t pending_frames = 0;
+	for (const Slot& slot : slots) {
+		pending_frames += slot.pending ? 1 : 0;
+	}
+
+	LOG_MESSAGE("Pass queries: " + std::to_string(collected_frames) + " frame(s) collected, " +
+		        std::to_string(pending_frames) + " pending, " + std::to_string(dropped_frames) + " dropped" +
+		        (uncounted_passes > 0 ? ", " + std::to_string(uncounted_passes) + " pass(es) past the limit" : "") +
+		        (has_statistics() ? "" : " (occlusion only)"), Color::Yellow, Color::Black, 0);
+
+	for (size_t t = 0; t < totals.size(); t++) {
+
+		const PassCounts& total = totals[t].second;
+		double frames = static_cast<double>(total_frames[t]);
+
+		// Many fragments per vertex: fill bound. Few: geometry bound.
+		double fragments_per_vertex = total.vertex_invocations > 0 ?
+			static_cast<double>(total.fragment_invocations) / static_cast<double>(total.vertex_invocations) : 0.0;
+
+		std::ostringstream pass_log;
+		pass_log << std::fixed << std::setprecision(0)
+			<< totals[t].first
+			<< " \t | vertices " << total.vertex_invocations / frames
+			<< " | primitives " << total.clipping_invocations / frames << " in, " << total.clipping_primitives / frames << " out"
+			<< " | fragments " << total.fragment_invocations / frames
+			<< " | samples passed " << total.samples_passed / frames;
+
+		if (total.compute_invocations > 0) {
+			pass_log << " | compute " << total.compute_invocations / frames;
+		}
+		pass_log << std::setprecision(2) << " | fragments/vertex " << fragments_per_vertex;
+
+		LOG_MESSAGE(pass_log.str(), Color::Bright_Green, Color::Black, 4);
+	}
+}
+
+
+void QueryManager::record_counters(vk_profiler::TraceRecorder& trace) const {
+
+	for (size_t t = 0; t < totals.size(); t++) {
+
+		const PassCounts& total = totals[t].second;
+		double frames = static_cast<double>(total_frames[t]);
+
+		trace.add_counter("queries | " + totals[t].first, {
+			{ "vertices", total.vertex_invocations / frames },
+			{ "fragments", total.fragment_invocations / frames },
+			{ "samples passed", total.samples_passed / frames } });
+	}
+}
+
+
+double timestamp_interval_ms(uint64_t begin, uint64_t end, uint32_t valid_bits, float timestamp_period) {
+
+	uint64_t mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	// Modulo 2^valid_bits, so an end past a wrap of the counter still gives the interval
+	uint64_t ticks = (end - begin) & mask;
+
+	// timestampPeriod is in nanoseconds per tick
+	return ticks * static_cast<double>(timestamp_period) / 1e6;
+}
+
+
+PassScope::PassScope(QueryManager* manager, VkCommandBuffer command_buffer, const std::string& name)
+	: manager(manager), command_buffer(command_buffer) {
+
+	if (manager != nullptr) {
+		manager->begin_pass(command_buffer, name);
+	}
+}
+
+
+PassScope::~PassScope() {
+
+	if (manager != nullptr) {
+		manager->end_pass(command_buffer);
+	}
+}
+
+
+} // namespace vk_query
\ No newline at end of file
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_handle.hpp"
+#include "vk_device.hpp"
+#include "vk_profiler.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>	// pair
+
+
+namespace vk_query {
+
+
+// What the GPU did in a pass. The pipeline statistics are 0 without pipelineStatisticsQuery.
+struct PassCounts {
+
+	uint64_t input_vertices = 0;       // vertices read by the input assembly
+	uint64_t vertex_invocations = 0;
+	uint64_t clipping_invocations = 0; // primitives that reached the clipping stage
+	uint64_t clipping_primitives = 0;  // primitives out of the clipping stage (culled ones removed, clipped ones split)
+	uint64_t fragment_invocations = 0;
+	uint64_t compute_invocations = 0;
+	uint64_t samples_passed = 0;       // occlusion: samples that passed the depth and stencil tests
+
+	void add(const PassCounts& other);
+};
+
+
+// Counts of the passes of a frame, in recording order
+struct FrameResult {
+
+	uint64_t frame = 0; // begin_frame() calls before it
+	std::vector<std::pair<std::string, PassCounts>> passes;
+};
+
+
+/*
+Per pass pipeline statistics and occlusion queries, for production captures: the vertex and
+fragment counts of each pass tell a geometry bound frame (many vertices per fragment) from a fill
+bound one (many fragments per vertex, or many samples per fragment with overdraw).
+Each frame takes the next slot of a ring of ring_size frames: a range of max_passes queries in
+each pool, and of the host visible result buffer. end_frame() records the copy of the results into
+the buffer (vkCmdCopyQueryPoolResults, with the availability of each query), so that nothing waits:
+collect() reads the frames the GPU has finished from the mapped buffer, later, and the results of a
+frame are dropped only if ring_size frames are recorded before it completes.
+Queries begun outside a render pass instance must end outside of it: a scope covers whole render
+passes (with their subpasses) or whole dynamic rendering scopes, or compute passes.
+Scopes cannot nest, and no other pipeline statistics or occlusion query may be active around them.
+*/
+class QueryManager {
+
+public:
+
+	// The statistics and the precise occlusion are used when the probe found them
+	// (vk_core::create_logical_device() enables them then)
+	QueryManager(
+		VkPhysicalDevice physical_device, VkDevice device,
+		const vk_device::DeviceProbe& device_probe, vk_handle::DeletionQueue* deletion_queue,
+		uint32_t ring_size = 4, uint32_t max_passes = 16);
+
+	QueryManager(const QueryManager&) = delete;
+	QueryManager& operator=(const QueryManager&) = delete;
+
+	// False without pipelineStatisticsQuery: only the occlusion queries are counted
+	bool has_statistics() const { return statistics_pool.get() != VK_NULL_HANDLE; }
+
+	// Take the next slot of the ring and reset its queries, outside a render pass
+	void begin_frame(VkCommandBuffer command_buffer);
+
+	// Begin the queries of a pass, outside a render pass instance. Passes past max_passes are not counted.
+	void begin_pass(VkCommandBuffer command_buffer, const std::string& name);
+	void end_pass(VkCommandBuffer command_buffer);
+
+	// Copy the results of the passes into the slot of the frame, after its last pass
+	void end_frame(VkCommandBuffer command_buffer);
+
+	// Read the results of the frames the GPU has finished, without waiting for the others
+	void collect();
+
+	// Last frame collected (no passes before the first one)
+	const FrameResult& latest() const { return latest_frame; }
+
+	// Log the average counts per frame of every pass, with the fragments per vertex
+	// and the frames dropped or still pending
+	void report() const;
+
+	// Averages per frame of the vertices and fragments of every pass as counter tracks of a trace
+	void record_counters(vk_profiler::TraceRecorder& trace) const;
+
+private:
+
+	VkDevice device;
+	uint32_t ring_size;
+	uint32_t max_passes;
+	bool precise_occlusion; // exact sample counts (occlusionQueryPrecise), else only zero or not
+
+	vk_handle::Handle<VkQueryPool> statistics_pool; // null without pipeline statistics
+	vk_handle::Handle<VkQueryPool> occlusion_pool;
+
+	// Results of every slot, with their availability: statistics then occlusion
+	vk_handle::Handle<VkDeviceMemory> result_memory;
+	vk_handle::Handle<VkBuffer> result_buffer;
+	uint64_t* results = nullptr; // mapped
+
+	struct Slot {
+		uint64_t frame = 0;
+		std::vector<std::string> pass_names;
+		bool pending = false; // copied by a submitted frame, not collected yet
+	};
+
+	std::vector<Slot> slots;
+	uint32_t current_slot = 0;
+	bool recording = false;
+	bool pass_open = false;
+	bool pass_counted = false; // the open pass got queries (fewer than max_passes before it)
+	uint64_t frame_count = 0;
+
+	FrameResult latest_frame;
+	uint64_t collected_frames = 0;
+	uint64_t dropped_frames = 0;
+	uint64_t uncounted_passes = 0; // past max_passes
+
+	// Sum of the counts of every collected frame, per pass name in order of first use
+	std::vector<std::pair<std::string, PassCounts>> totals;
+	std::vector<uint64_t> total_frames; // frames in which the pass of totals was recorded
+
+	uint64_t* statistics_results(uint32_t slot, uint32_t pass) const;
+	uint64_t* occlusion_results(uint32_t slot, uint32_t pass) const;
+
+	// Read a slot whose results are all available
+	bool read_slot(uint32_t slot, FrameResult& frame) const;
+};
+
+
+// Milliseconds from the begin to the end timestamp, written on a queue family with valid_bits
+// timestampValidBits (> 0): the bits above them are undefined and the counter wraps at 2^valid_bits.
+// timestamp_period is VkPhysicalDeviceLimits::timestampPeriod.
+double timestamp_interval_ms(uint64_t begin, uint64_t end, uint32_t valid_bits, float timestamp_period);
+
+
+// Begins the queries of a pass on construction and ends them on destruction.
+// Nothing with a null manager.
+class PassScope {
+
+public:
+
+	PassScope(QueryManager* manager, VkCommandBuffer command_buffer, const std::string& name);
+	~PassScope();
+
+	PassScope(const PassScope&) = delete;
+	PassScope& operator=(const PassScope&) = delete;
+
+private:
+
+	QueryManager* manager;
+	VkCommandBuffer command_buffer;
+};
+
+
+} // namespace vk_query
\ No newline at end of file
@@ -0,0 +1,309 @@
+#include "vk_readback.hpp"
+#include "vk_buffer.hpp"
+#include "vk_tonemap.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <sstream>
+#include <iomanip>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_readback {
+
+
+// The swapchain image after a render pass: its dependency to VK_SUBPASS_EXTERNAL
+// ends at the color attachment output stage, after the final layout transition
+static const vk_barrier::Access RENDER_PASS_PRESENT = {
+	VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+
+
+ReadbackService::ReadbackService(VkPhysicalDevice physical_device, VkDevice device,
+	                             vk_handle::DeletionQueue* deletion_queue,
+	                             Consumer consumer, uint32_t ring_size)
+	: physical_device(physical_device), device(device), deletion_queue(deletion_queue),
+	  consumer(std::move(consumer)), slots(ring_size) {
+
+	// The consumer reads every byte: uncached memory would make it crawl.
+	// Cached memory may not be coherent, the consumer thread invalidates it.
+	memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	if (!vk_buffer::has_memory_type(UINT32_MAX, memory_properties, physical_device)) {
+		memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		LOG_MESSAGE("No host cached memory, frames are read back from uncached memory.", Color::Red, Color::Black, 4);
+	}
+
+	consumer_thread = std::thread(&ReadbackService::consume_frames, this);
+}
+
+
+ReadbackService::~ReadbackService() {
+
+	{
+		std::lock_guard<std::mutex> lock(slots_mutex);
+		stopping = true;
+	}
+	queue_condition.notify_all();
+
+	consumer_thread.join();
+}
+
+
+void ReadbackService::allocate_slot(Slot& slot, VkDeviceSize size) {
+
+	// The previous buffer was last used by a frame that has completed
+	slot.buffer.reset();
+	slot.memory.reset();
+
+	VkBuffer new_buffer;
+	VkDeviceMemory new_memory;
+	vk_buffer::create_buffer(new_buffer, new_memory, size,
+		                     VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_properties,
+		                     physical_device, device);
+
+	slot.memory = vk_handle::Handle<VkDeviceMemory>(new_memory, device, deletion_queue);
+	slot.buffer = vk_handle::Handle<VkBuffer>(new_buffer, device, deletion_queue);
+	slot.size = size;
+
+	if (vkMapMemory(device, new_memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to map Vulkan readback Buffer memory! \033[0m \n");
+	}
+}
+
+
+ReadbackService::Slot* ReadbackService::take_slot(VkFormat format, VkExtent2D extent) {
+
+	uint32_t row_pitch = extent.width * vk_tonemap::texel_size(format);
+	VkDeviceSize size = static_cast<VkDeviceSize>(row_pitch) * extent.height;
+
+	Slot* slot = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(slots_mutex);
+
+		for (Slot& candidate : slots) {
+			if (candidate.state == SlotState::Free) {
+				slot = &candidate;
+				break;
+			}
+		}
+
+		if (slot == nullptr) {
+			skipped_frames++;
+			return nullptr;
+		}
+
+		if (frame_count == 0) {
+			first_record = std::chrono::steady_clock::now();
+		}
+	}
+
+	// Free slots are only touched by this thread
+	if (slot->size < size) {
+		allocate_slot(*slot, size);
+	}
+
+	slot->frame.index = frame_count++;
+	slot->frame.extent = extent;
+	slot->frame.format = format;
+	slot->frame.row_pitch = row_pitch;
+	slot->frame.pixels = static_cast<const uint8_t*>(slot->mapped);
+	slot->frame.recorded = std::chrono::steady_clock::now();
+
+	return slot;
+}
+
+
+void ReadbackService::record_image_copy(VkCommandBuffer command_buffer, VkImage image, Slot& slot) {
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { slot.frame.extent.width, slot.frame.extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+}
+
+
+void ReadbackService::slot_recorded(Slot& slot) {
+
+	{
+		std::lock_guard<std::mutex> lock(slots_mutex);
+		slot.state = SlotState::Recorded;
+	}
+	recorded_slots.push_back(static_cast<uint32_t>(&slot - slots.data()));
+}
+
+
+bool ReadbackService::record_copy(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkExtent2D extent) {
+
+	Slot* slot = take_slot(format, extent);
+	if (slot == nullptr) {
+		return false;
+	}
+
+	barrier_tracker.add_image(image, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, RENDER_PASS_PRESENT);
+	barrier_tracker.add_buffer(slot->buffer, slot->size, vk_barrier::Access{});
+
+	barrier_tracker.use_image(image, vk_barrier::TRANSFER_READ);
+	barrier_tracker.use_buffer(slot->buffer, vk_barrier::TRANSFER_WRITE);
+	barrier_tracker.flush(command_buffer);
+
+	record_image_copy(command_buffer, image, *slot);
+
+	// Back to presentation (synchronized by the render finished semaphore),
+	// and the copy visible to the host: one batch
+	barrier_tracker.use_image(image, vk_barrier::PRESENT);
+	barrier_tracker.use_buffer(slot->buffer, SLOT_HOST_READ);
+	barrier_tracker.flush(command_buffer);
+
+	barrier_tracker.remove_image(image);
+	barrier_tracker.remove_buffer(slot->buffer);
+
+	slot_recorded(*slot);
+	return true;
+}
+
+
+VkBuffer ReadbackService::reserve_slot(VkFormat format, VkExtent2D extent) {
+
+	if (reserved_slot != nullptr) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("A readback slot is already reserved! \033[0m \n");
+	}
+
+	reserved_slot = take_slot(format, extent);
+	return reserved_slot != nullptr ? reserved_slot->buffer.get() : VK_NULL_HANDLE;
+}
+
+
+void ReadbackService::record_reserved_copy(VkCommandBuffer command_buffer, VkImage image) {
+
+	if (reserved_slot == nullptr) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("No readback slot is reserved! \033[0m \n");
+	}
+
+	record_image_copy(command_buffer, image, *reserved_slot);
+
+	slot_recorded(*reserved_slot);
+	reserved_slot = nullptr;
+}
+
+
+void ReadbackService::frames_completed() {
+
+	if (recorded_slots.empty()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(slots_mutex);
+
+		for (uint32_t s : recorded_slots) {
+			slots[s].state = SlotState::Queued;
+			queue.push_back(s);
+		}
+	}
+	recorded_slots.clear();
+
+	queue_condition.notify_one();
+}
+
+
+void ReadbackService::drain() {
+
+	std::unique_lock<std::mutex> lock(slots_mutex);
+
+	drained_condition.wait(lock, [this] {
+		for (const Slot& slot : slots) {
+			if (slot.state == SlotState::Queued || slot.state == SlotState::Consuming) {
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+
+void ReadbackService::consume_frames() {
+
+	while (true) {
+
+		uint32_t s;
+		{
+			std::unique_lock<std::mutex> lock(slots_mutex);
+			queue_condition.wait(lock, [this] { return stopping || !queue.empty(); });
+
+			// Stop once the queued frames are consumed
+			if (queue.empty()) {
+				return;
+			}
+
+			s = queue.front();
+			queue.pop_front();
+			slots[s].state = SlotState::Consuming;
+		}
+
+		Slot& slot = slots[s];
+
+		// The copy is complete: make it visible to the host caches
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = slot.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(device, 1, &range);
+
+		auto start = std::chrono::steady_clock::now();
+		consumer(slot.frame);
+		auto end = std::chrono::steady_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(slots_mutex);
+
+			consumed_frames++;
+			consumed_bytes += static_cast<uint64_t>(slot.frame.row_pitch) * slot.frame.extent.height;
+			last_consumed = end;
+			consumer_stats.add_sample(std::chrono::duration<double, std::milli>(end - start).count());
+			latency_stats.add_sample(std::chrono::duration<double, std::milli>(end - slot.frame.recorded).count());
+
+			slot.state = SlotState::Free;
+		}
+		drained_condition.notify_all();
+	}
+}
+
+
+void ReadbackService::report(const std::string& name) const {
+
+	std::lock_guard<std::mutex> lock(slots_mutex);
+
+	double seconds = std::chrono::duration<double>(last_consumed - first_record).count();
+
+	std::ostringstream readback_log;
+	readback_log << std::fixed << std::setprecision(2)
+		<< name << " | " << frame_count << " frame(s) captured, " << skipped_frames << " skipped (no free slot), "
+		<< consumed_frames << " consumed, " << consumed_bytes / 1024.0 / 1024.0 << " MiB";
+	if (seconds > 0.0) {
+		readback_log << " (" << consumed_bytes / 1024.0 / 1024.0 / seconds << " MiB/s)";
+	}
+
+	LOG_MESSAGE(readback_log.str(), Color::Bright_Green, Color::Black, 4);
+
+	if (consumed_frames > 0) {
+		latency_stats.report(name + " | latency");
+		consumer_stats.report(name + " | consumer");
+	}
+}
+
+
+} // namespace vk_readback
\ No newline at end of file
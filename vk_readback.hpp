@@ -0,0 +1,154 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_handle.hpp"
+#include "vk_barrier.hpp"
+#include "vk_profiler.hpp"
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+namespace vk_readback {
+
+
+// A frame copied to host memory, only valid during the call of the consumer
+struct Frame {
+
+	uint64_t index = 0; // copies recorded before it
+	VkExtent2D extent = { 0, 0 };
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t row_pitch = 0; // bytes, rows are tightly packed
+	const uint8_t* pixels = nullptr;
+	std::chrono::steady_clock::time_point recorded; // when its copy was recorded
+};
+
+// Called on the consumer thread of the service, one frame at a time, in frame order
+using Consumer = std::function<void(const Frame& frame)>;
+
+// The final state of a slot buffer after its copy: read by the consumer thread once the frame has completed
+const vk_barrier::Access SLOT_HOST_READ = { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+
+
+/*
+Pipelined readback of the final image of the frames, for screenshots, raw frame dumps and video
+streaming, without ever waiting for the GPU on the render thread:
+- record_copy() (or reserve_slot() then record_reserved_copy() in a render graph pass) records,
+  at the end of the command buffer of a frame, the copy of the image into a free slot of a ring of
+  host visible buffers (host cached when the device has it: the consumer reads every byte),
+- once the fence of that frame has signaled, frames_completed() hands the slot to the consumer thread,
+- the consumer thread runs the consumer on it and frees the slot.
+If the consumer falls behind and no slot is free, the frame is skipped (and counted), the render
+thread never waits for it. A consumer slower than the frame rate drops frames but never slows
+the rendering down: ring_size bounds the latency and the host memory.
+*/
+class ReadbackService {
+
+public:
+
+	ReadbackService(
+		VkPhysicalDevice physical_device, VkDevice device,
+		vk_handle::DeletionQueue* deletion_queue,
+		Consumer consumer, uint32_t ring_size = 3);
+
+	// Consumes the frames already handed to the consumer thread, then stops it.
+	// Copies recorded after the last frames_completed() are dropped.
+	~ReadbackService();
+
+	ReadbackService(const ReadbackService&) = delete;
+	ReadbackService& operator=(const ReadbackService&) = delete;
+
+	// Record the copy of image into a free slot, with its barriers, after the render pass that wrote it.
+	// image was left in PRESENT_SRC_KHR by a render pass whose dependency to VK_SUBPASS_EXTERNAL has the
+	// color attachment output stage as destination (so that the barrier chains with its final layout
+	// transition), and is left so. Returns false, recording nothing, if every slot is still owned
+	// by the consumer thread.
+	bool record_copy(VkCommandBuffer command_buffer, VkImage image, VkFormat format, VkExtent2D extent);
+
+	// Take a free slot for a frame of extent and format, copied by the next record_reserved_copy():
+	// its buffer, to import into a render graph whose capture pass uses it as a TRANSFER_WRITE and
+	// leaves it in SLOT_HOST_READ. VK_NULL_HANDLE if every slot is still owned by the consumer thread
+	// (the frame is skipped).
+	VkBuffer reserve_slot(VkFormat format, VkExtent2D extent);
+
+	// Record the copy of image, in TRANSFER_SRC_OPTIMAL, into the reserved slot, without any barrier:
+	// the capture pass of the graph reads image as a TRANSFER_READ and writes the slot buffer
+	void record_reserved_copy(VkCommandBuffer command_buffer, VkImage image);
+
+	// The copies recorded so far have completed (the fence of their frame has signaled):
+	// hand them to the consumer thread
+	void frames_completed();
+
+	// Wait until the consumer thread has consumed every frame handed to it
+	void drain();
+
+	// Log the frames captured, skipped and consumed, the throughput, the latency from
+	// the recording of the copy to the end of the consumer, and the time spent in the consumer
+	void report(const std::string& name) const;
+
+private:
+
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	vk_handle::DeletionQueue* deletion_queue;
+	Consumer consumer;
+	VkMemoryPropertyFlags memory_properties;
+
+	enum class SlotState {
+		Free,      // owned by the render thread
+		Recorded,  // copy recorded, its frame may still run
+		Queued,    // copy completed, waiting for the consumer thread
+		Consuming  // in the consumer
+	};
+
+	struct Slot {
+		vk_handle::Handle<VkDeviceMemory> memory;
+		vk_handle::Handle<VkBuffer> buffer;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+		SlotState state = SlotState::Free;
+		Frame frame;
+	};
+
+	std::vector<Slot> slots;
+	std::vector<uint32_t> recorded_slots; // in recording order, until frames_completed()
+	Slot* reserved_slot = nullptr;        // by reserve_slot(), until record_reserved_copy()
+	uint64_t frame_count = 0;
+	vk_barrier::StateTracker barrier_tracker; // render thread only
+
+	std::thread consumer_thread;
+	mutable std::mutex slots_mutex; // states, queue and stats
+	std::condition_variable queue_condition;
+	std::condition_variable drained_condition;
+	std::deque<uint32_t> queue;
+	bool stopping = false;
+
+	uint64_t skipped_frames = 0;
+	uint64_t consumed_frames = 0;
+	uint64_t consumed_bytes = 0;
+	std::chrono::steady_clock::time_point first_record;
+	std::chrono::steady_clock::time_point last_consumed;
+	vk_profiler::TimingStats latency_stats;
+	vk_profiler::TimingStats consumer_stats;
+
+	// (Re)create the buffer of a free slot for size bytes
+	void allocate_slot(Slot& slot, VkDeviceSize size);
+
+	// A free slot, with a buffer large enough and its frame filled in. Null if none is free.
+	Slot* take_slot(VkFormat format, VkExtent2D extent);
+
+	void record_image_copy(VkCommandBuffer command_buffer, VkImage image, Slot& slot);
+
+	// The copy of the slot is recorded: it waits for its frame to complete
+	void slot_recorded(Slot& slot);
+
+	void consume_frames();
+};
+
+
+} // namespace vk_readback
\ No newline at end of file
@@ -0,0 +1,858 @@
+#include "vk_reflect.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <algorithm>	// sort(), min(), max()
+#include <optional>
+#include <unordered_map>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_reflect {
+
+
+// SPIR-V constants used by the parser (from the SPIR-V specification, spirv.h)
+namespace spv {
+
+	const uint32_t MAGIC_NUMBER = 0x07230203;
+	const uint32_t HEADER_WORDS = 5;
+
+	enum Op : uint32_t {
+		OpName = 5,
+		OpEntryPoint = 15,
+		OpExecutionMode = 16,
+		OpTypeBool = 20,
+		OpTypeInt = 21,
+		OpTypeFloat = 22,
+		OpTypeVector = 23,
+		OpTypeMatrix = 24,
+		OpTypeImage = 25,
+		OpTypeSampler = 26,
+		OpTypeSampledImage = 27,
+		OpTypeArray = 28,
+		OpTypeRuntimeArray = 29,
+		OpTypeStruct = 30,
+		OpTypePointer = 32,
+		OpConstant = 43,
+		OpSpecConstantTrue = 48,
+		OpSpecConstantFalse = 49,
+		OpSpecConstant = 50,
+		OpVariable = 59,
+		OpDecorate = 71,
+		OpMemberDecorate = 72
+	};
+
+	enum Decoration : uint32_t {
+		SpecId = 1,
+		Block = 2,
+		BufferBlock = 3,
+		ArrayStride = 6,
+		MatrixStride = 7,
+		BuiltIn = 11,
+		Location = 30,
+		Binding = 33,
+		DescriptorSet = 34,
+		Offset = 35
+	};
+
+	enum StorageClass : uint32_t {
+		UniformConstant = 0,
+		Input = 1,
+		Uniform = 2,
+		PushConstant = 9,
+		StorageBuffer = 12
+	};
+
+	enum ExecutionModel : uint32_t {
+		Vertex = 0,
+		TessellationControl = 1,
+		TessellationEvaluation = 2,
+		Geometry = 3,
+		Fragment = 4,
+		GLCompute = 5
+	};
+
+	enum Dim : uint32_t {
+		DimBuffer = 5,
+		DimSubpassData = 6
+	};
+
+	const uint32_t ExecutionModeLocalSize = 17;
+
+} // namespace spv
+
+
+struct Decorations {
+
+	std::optional<uint32_t> set;
+	std::optional<uint32_t> binding;
+	std::optional<uint32_t> location;
+	std::optional<uint32_t> spec_id;
+	std::optional<uint32_t> array_stride;
+	bool builtin = false;
+	bool block = false;
+	bool buffer_block = false;
+};
+
+struct MemberDecorations {
+
+	uint32_t offset = 0;
+	uint32_t matrix_stride = 0;
+	bool builtin = false;
+};
+
+struct Type {
+
+	uint32_t op = 0;
+	uint32_t width = 0;          // int, float
+	bool is_signed = false;      // int
+	uint32_t element_type = 0;   // vector component, matrix column, array element, pointee, sampled image
+	uint32_t count = 0;          // vector components, matrix columns
+	uint32_t length_id = 0;      // array length constant
+	uint32_t storage_class = 0;  // pointer
+	uint32_t dim = 0;            // image
+	uint32_t sampled = 0;        // image: 1 sampled, 2 storage
+	std::vector<uint32_t> members;
+};
+
+struct Variable {
+
+	uint32_t id;
+	uint32_t type_id; // pointer type
+	uint32_t storage_class;
+};
+
+
+// Everything collected in a single pass over the instructions
+struct Module {
+
+	std::unordered_map<uint32_t, std::string> names;
+	std::unordered_map<uint32_t, Decorations> decorations;
+	std::unordered_map<uint32_t, std::vector<MemberDecorations>> member_decorations;
+	std::unordered_map<uint32_t, Type> types;
+	std::unordered_map<uint32_t, uint32_t> constants; // low word
+	std::vector<Variable> variables;
+	std::vector<std::pair<uint32_t, uint32_t>> spec_constants; // result id, type id (+ default in constants)
+
+	uint32_t execution_model = spv::Vertex;
+	uint32_t entry_point_id = 0;
+	std::string entry_point;
+	uint32_t local_size[3] = { 1, 1, 1 };
+
+
+	const Type& type(uint32_t id) const {
+
+		auto it = types.find(id);
+		if (it == types.end()) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("SPIR-V reflection: unknown type id " + std::to_string(id) + " \033[0m \n");
+		}
+		return it->second;
+	}
+
+	std::string name(uint32_t id) const {
+
+		auto it = names.find(id);
+		return it != names.end() ? it->second : std::string();
+	}
+
+	Decorations decoration(uint32_t id) const {
+
+		auto it = decorations.find(id);
+		return it != decorations.end() ? it->second : Decorations{};
+	}
+
+	MemberDecorations& member(uint32_t struct_id, uint32_t member_index) {
+
+		auto& members = member_decorations[struct_id];
+		if (members.size() <= member_index) {
+			members.resize(member_index + 1);
+		}
+		return members[member_index];
+	}
+};
+
+
+// SPIR-V strings are nul terminated and padded to a whole word
+static std::string read_string(const uint32_t* words, size_t word_count) {
+
+	const char* chars = reinterpret_cast<const char*>(words);
+	size_t max_length = word_count * sizeof(uint32_t);
+
+	size_t length = 0;
+	while (length < max_length && chars[length] != '\0') {
+		length++;
+	}
+
+	return std::string(chars, length);
+}
+
+
+static Module parse_module(const uint32_t* words, size_t word_count) {
+
+	if (word_count < spv::HEADER_WORDS || words[0] != spv::MAGIC_NUMBER) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("SPIR-V reflection: not a SPIR-V module! \033[0m \n");
+	}
+
+	Module module;
+
+	for (size_t i = spv::HEADER_WORDS; i < word_count; ) {
+
+		uint32_t opcode = words[i] & 0xFFFF;
+		uint32_t length = words[i] >> 16;
+
+		if (length == 0 || i + length > word_count) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("SPIR-V reflection: truncated instruction! \033[0m \n");
+		}
+
+		const uint32_t* op = &words[i];
+
+		switch (opcode) {
+
+			case spv::OpName:
+				module.names[op[1]] = read_string(&op[2], length - 2);
+				break;
+
+			case spv::OpEntryPoint:
+				// Only the first entry point is reflected (glslc emits one)
+				if (module.entry_point.empty()) {
+					module.execution_model = op[1];
+					module.entry_point_id = op[2];
+					module.entry_point = read_string(&op[3], length - 3);
+				}
+				break;
+
+			case spv::OpExecutionMode:
+				if (op[1] == module.entry_point_id && op[2] == spv::ExecutionModeLocalSize && length >= 6) {
+					module.local_size[0] = op[3];
+					module.local_size[1] = op[4];
+					module.local_size[2] = op[5];
+				}
+				break;
+
+			case spv::OpDecorate: {
+				Decorations& decoration = module.decorations[op[1]];
+				uint32_t value = length > 3 ? op[3] : 0;
+
+				switch (op[2]) {
+					case spv::SpecId: decoration.spec_id = value; break;
+					case spv::Block: decoration.block = true; break;
+					case spv::BufferBlock: decoration.buffer_block = true; break;
+					case spv::ArrayStride: decoration.array_stride = value; break;
+					case spv::BuiltIn: decoration.builtin = true; break;
+					case spv::Location: decoration.location = value; break;
+					case spv::Binding: decoration.binding = value; break;
+					case spv::DescriptorSet: decoration.set = value; break;
+					default: break;
+				}
+				break;
+			}
+
+			case spv::OpMemberDecorate: {
+				MemberDecorations& member = module.member(op[1], op[2]);
+				uint32_t value = length > 4 ? op[4] : 0;
+
+				switch (op[3]) {
+					case spv::Offset: member.offset = value; break;
+					case spv::MatrixStride: member.matrix_stride = value; break;
+					case spv::BuiltIn: member.builtin = true; break;
+					default: break;
+				}
+				break;
+			}
+
+			case spv::OpTypeBool:
+			case spv::OpTypeSampler:
+				module.types[op[1]].op = opcode;
+				break;
+
+			case spv::OpTypeInt: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.width = op[2];
+				type.is_signed = op[3] != 0;
+				break;
+			}
+
+			case spv::OpTypeFloat: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.width = op[2];
+				break;
+			}
+
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.element_type = op[2];
+				type.count = op[3];
+				break;
+			}
+
+			case spv::OpTypeImage: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.dim = op[3];
+				type.sampled = op[7];
+				break;
+			}
+
+			case spv::OpTypeSampledImage:
+			case spv::OpTypeRuntimeArray: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.element_type = op[2];
+				break;
+			}
+
+			case spv::OpTypeArray: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.element_type = op[2];
+				type.length_id = op[3];
+				break;
+			}
+
+			case spv::OpTypeStruct: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.members.assign(&op[2], &op[length]);
+				break;
+			}
+
+			case spv::OpTypePointer: {
+				Type& type = module.types[op[1]];
+				type.op = opcode;
+				type.storage_class = op[2];
+				type.element_type = op[3];
+				break;
+			}
+
+			case spv::OpConstant:
+			case spv::OpSpecConstant:
+				module.constants[op[2]] = length > 3 ? op[3] : 0;
+				if (opcode == spv::OpSpecConstant) {
+					module.spec_constants.emplace_back(op[2], op[1]);
+				}
+				break;
+
+			case spv::OpSpecConstantTrue:
+			case spv::OpSpecConstantFalse:
+				module.constants[op[2]] = opcode == spv::OpSpecConstantTrue ? 1 : 0;
+				module.spec_constants.emplace_back(op[2], op[1]);
+				break;
+
+			case spv::OpVariable:
+				module.variables.push_back({ op[2], op[1], op[3] });
+				break;
+
+			default:
+				break;
+		}
+
+		i += length;
+	}
+
+	return module;
+}
+
+
+static VkShaderStageFlagBits to_shader_stage(uint32_t execution_model) {
+
+	switch (execution_model) {
+		case spv::Vertex: return VK_SHADER_STAGE_VERTEX_BIT;
+		case spv::Fragment: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case spv::GLCompute: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default:
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("SPIR-V reflection: unsupported shader stage " + std::to_string(execution_model) + " \033[0m \n");
+	}
+}
+
+
+// Size in bytes of a type in an explicitly laid out block (push constants)
+static uint32_t type_size(const Module& module, uint32_t type_id, uint32_t matrix_stride) {
+
+	const Type& type = module.type(type_id);
+
+	switch (type.op) {
+
+		case spv::OpTypeBool:
+			return 4;
+
+		case spv::OpTypeInt:
+		case spv::OpTypeFloat:
+			return type.width / 8;
+
+		case spv::OpTypeVector:
+			return type.count * type_size(module, type.element_type, 0);
+
+		case spv::OpTypeMatrix:
+			return type.count * (matrix_stride > 0 ? matrix_stride : type_size(module, type.element_type, 0));
+
+		case spv::OpTypeArray: {
+			uint32_t length = module.constants.count(type.length_id) ? module.constants.at(type.length_id) : 1;
+			auto stride = module.decoration(type_id).array_stride;
+			return length * (stride ? *stride : type_size(module, type.element_type, matrix_stride));
+		}
+
+		case spv::OpTypeStruct: {
+			uint32_t size = 0;
+			auto members = module.member_decorations.find(type_id);
+
+			for (uint32_t m = 0; m < type.members.size(); m++) {
+
+				MemberDecorations member{};
+				if (members != module.member_decorations.end() && m < members->second.size()) {
+					member = members->second[m];
+				}
+				size = std::max(size, member.offset + type_size(module, type.members[m], member.matrix_stride));
+			}
+			return size;
+		}
+
+		default:
+			return 0;
+	}
+}
+
+
+static VkFormat to_vertex_format(const Module& module, const Type& type) {
+
+	const Type& component = type.op == spv::OpTypeVector ? module.type(type.element_type) : type;
+	uint32_t count = type.op == spv::OpTypeVector ? type.count : 1;
+
+	if (component.width != 32 || count < 1 || count > 4) {
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	static const VkFormat float_formats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+	static const VkFormat sint_formats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+	static const VkFormat uint_formats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+	if (component.op == spv::OpTypeFloat) {
+		return float_formats[count - 1];
+	}
+	if (component.op == spv::OpTypeInt) {
+		return component.is_signed ? sint_formats[count - 1] : uint_formats[count - 1];
+	}
+
+	return VK_FORMAT_UNDEFINED;
+}
+
+
+// Descriptor type of a resource variable, arrays are unwrapped into count
+static bool to_descriptor(const Module& module, const Variable& variable, VkDescriptorType& descriptor_type, uint32_t& count) {
+
+	uint32_t type_id = module.type(variable.type_id).element_type;
+	count = 1;
+
+	const Type* type = &module.type(type_id);
+	if (type->op == spv::OpTypeArray) {
+		count = module.constants.count(type->length_id) ? module.constants.at(type->length_id) : 1;
+		type_id = type->element_type;
+		type = &module.type(type_id);
+	}
+	else if (type->op == spv::OpTypeRuntimeArray) {
+		type_id = type->element_type;
+		type = &module.type(type_id);
+	}
+
+	switch (variable.storage_class) {
+
+		case spv::UniformConstant:
+			if (type->op == spv::OpTypeSampler) {
+				descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+			}
+			else if (type->op == spv::OpTypeSampledImage) {
+				const Type& image = module.type(type->element_type);
+				descriptor_type = image.dim == spv::DimBuffer ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+					                                          : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			}
+			else if (type->op == spv::OpTypeImage) {
+				if (type->dim == spv::DimSubpassData) {
+					descriptor_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				}
+				else if (type->dim == spv::DimBuffer) {
+					descriptor_type = type->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+						                                 : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+				}
+				else {
+					descriptor_type = type->sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+						                                 : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				}
+			}
+			else {
+				return false;
+			}
+			return true;
+
+		case spv::Uniform:
+			// Old style storage buffers are Uniform + BufferBlock
+			descriptor_type = module.decoration(type_id).buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+				                                                      : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			return true;
+
+		case spv::StorageBuffer:
+			descriptor_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+// Buffers whose variable name ends with it are bound with a dynamic offset
+static const std::string DYNAMIC_SUFFIX = "_dynamic";
+
+
+ShaderReflection reflect_shader(const uint32_t* words, size_t word_count) {
+
+	Module module = parse_module(words, word_count);
+
+	ShaderReflection reflection;
+	reflection.stage = to_shader_stage(module.execution_model);
+	reflection.entry_point = module.entry_point;
+	std::copy(std::begin(module.local_size), std::end(module.local_size), reflection.local_size);
+
+	for (const auto& variable : module.variables) {
+
+		Decorations decoration = module.decoration(variable.id);
+
+		// Descriptors
+		if (decoration.binding.has_value()) {
+
+			DescriptorBinding binding;
+			binding.set = decoration.set.value_or(0);
+			binding.binding = *decoration.binding;
+			binding.stages = reflection.stage;
+			binding.name = module.name(variable.id);
+
+			if (to_descriptor(module, variable, binding.type, binding.count)) {
+
+				// SPIR-V can not tell a dynamic buffer from a static one: use the variable name
+				bool dynamic = binding.name.size() > DYNAMIC_SUFFIX.size() &&
+					           binding.name.compare(binding.name.size() - DYNAMIC_SUFFIX.size(), DYNAMIC_SUFFIX.size(), DYNAMIC_SUFFIX) == 0;
+
+				if (dynamic && binding.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+					binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+				}
+				else if (dynamic && binding.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+					binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+				}
+
+				reflection.descriptor_bindings.push_back(binding);
+			}
+			continue;
+		}
+
+		// Push constants: the range covers the members the stage declares
+		if (variable.storage_class == spv::PushConstant) {
+
+			uint32_t block_id = module.type(variable.type_id).element_type;
+			const Type& block = module.type(block_id);
+
+			uint32_t begin = UINT32_MAX;
+			auto members = module.member_decorations.find(block_id);
+			for (uint32_t m = 0; m < block.members.size(); m++) {
+				uint32_t offset = members != module.member_decorations.end() && m < members->second.size()
+					            ? members->second[m].offset : 0;
+				begin = std::min(begin, offset);
+			}
+
+			uint32_t end = type_size(module, block_id, 0);
+			if (begin == UINT32_MAX || end <= begin) {
+				continue;
+			}
+
+			VkPushConstantRange range{};
+			range.stageFlags = reflection.stage;
+			range.offset = begin;
+			range.size = end - begin;
+			reflection.push_constant_ranges.push_back(range);
+			continue;
+		}
+
+		// Vertex attributes, built-ins (gl_VertexIndex...) are not vertex inputs
+		if (variable.storage_class == spv::Input && reflection.stage == VK_SHADER_STAGE_VERTEX_BIT &&
+			!decoration.builtin && decoration.location.has_value()) {
+
+			const Type& type = module.type(module.type(variable.type_id).element_type);
+
+			VertexInput input;
+			input.location = *decoration.location;
+			input.format = to_vertex_format(module, type);
+			input.size = type_size(module, module.type(variable.type_id).element_type, 0);
+			input.name = module.name(variable.id);
+
+			if (input.format == VK_FORMAT_UNDEFINED) {
+				std::cout << "\033[31;40m";
+				throw std::runtime_error("SPIR-V reflection: unsupported vertex input type for " + input.name + " \033[0m \n");
+			}
+
+			reflection.vertex_inputs.push_back(input);
+		}
+	}
+
+	for (const auto& [id, type_id] : module.spec_constants) {
+
+		Decorations decoration = module.decoration(id);
+		if (!decoration.spec_id.has_value()) {
+			continue;
+		}
+
+		SpecializationConstant constant;
+		constant.constant_id = *decoration.spec_id;
+		constant.size = type_size(module, type_id, 0);
+		constant.default_value = module.constants[id];
+		constant.name = module.name(id);
+
+		reflection.specialization_constants.push_back(constant);
+	}
+
+	std::sort(reflection.vertex_inputs.begin(), reflection.vertex_inputs.end(),
+		[](const VertexInput& a, const VertexInput& b) { return a.location < b.location; });
+
+	std::sort(reflection.descriptor_bindings.begin(), reflection.descriptor_bindings.end(),
+		[](const DescriptorBinding& a, const DescriptorBinding& b) {
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+
+	std::sort(reflection.specialization_constants.begin(), reflection.specialization_constants.end(),
+		[](const SpecializationConstant& a, const SpecializationConstant& b) { return a.constant_id < b.constant_id; });
+
+	return reflection;
+}
+
+
+VertexInputLayout build_vertex_input_layout(const ShaderReflection& vertex_shader) {
+
+	VertexInputLayout layout;
+
+	uint32_t offset = 0;
+	for (const auto& input : vertex_shader.vertex_inputs) {
+
+		VkVertexInputAttributeDescription attribute{};
+		attribute.location = input.location;
+		attribute.binding = 0;
+		attribute.format = input.format;
+		attribute.offset = offset;
+
+		layout.attributes.push_back(attribute);
+		offset += input.size;
+	}
+
+	if (!layout.attributes.empty()) {
+
+		VkVertexInputBindingDescription binding{};
+		binding.binding = 0;
+		binding.stride = offset;
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		layout.bindings.push_back(binding);
+	}
+
+	return layout;
+}
+
+
+LayoutCache::LayoutCache(VkDevice device)
+	: device(device) {
+}
+
+
+LayoutCache::~LayoutCache() {
+
+	for (auto& [key, info] : pipeline_layouts) {
+		vkDestroyPipelineLayout(device, info.pipeline_layout, nullptr);
+	}
+	for (auto& [key, set_layout] : set_layouts) {
+		vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+	}
+}
+
+
+PipelineLayoutInfo LayoutCache::get_pipeline_layout(const std::vector<const ShaderReflection*>& stages) {
+
+	// Merge the bindings of all stages: the same set/binding must have the same type and count
+	std::map<std::pair<uint32_t, uint32_t>, DescriptorBinding> merged_bindings;
+	std::vector<VkPushConstantRange> push_constant_ranges;
+
+	for (const ShaderReflection* stage : stages) {
+
+		for (const auto& binding : stage->descriptor_bindings) {
+
+			auto [it, inserted] = merged_bindings.emplace(std::make_pair(binding.set, binding.binding), binding);
+
+			if (!inserted) {
+				if (it->second.type != binding.type || it->second.count != binding.count) {
+					std::cout << "\033[31;40m";
+					throw std::runtime_error("Shader stages disagree on descriptor set " + std::to_string(binding.set) +
+						                     " binding " + std::to_string(binding.binding) + " \033[0m \n");
+				}
+				it->second.stages |= binding.stages;
+			}
+		}
+
+		// Stages using the same push constant range share it
+		for (const auto& range : stage->push_constant_ranges) {
+
+			auto same_range = std::find_if(push_constant_ranges.begin(), push_constant_ranges.end(),
+				[&](const VkPushConstantRange& r) { return r.offset == range.offset && r.size == range.size; });
+
+			if (same_range != push_constant_ranges.end()) {
+				same_range->stageFlags |= range.stageFlags;
+			}
+			else {
+				push_constant_ranges.push_back(range);
+			}
+		}
+	}
+
+	// Split by set, sets must be contiguous so missing ones get an empty layout
+	uint32_t set_count = merged_bindings.empty() ? 0 : merged_bindings.rbegin()->first.first + 1;
+	std::vector<std::vector<DescriptorBinding>> sets(set_count);
+	for (const auto& [key, binding] : merged_bindings) {
+		sets[binding.set].push_back(binding);
+	}
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	PipelineLayoutInfo info;
+	for (const auto& set : sets) {
+		info.set_layouts.push_back(get_descriptor_set_layout_locked(set));
+	}
+	info.push_constant_ranges = push_constant_ranges;
+
+	std::vector<uint64_t> key;
+	for (VkDescriptorSetLayout set_layout : info.set_layouts) {
+		key.push_back(reinterpret_cast<uint64_t>(set_layout));
+	}
+	for (const auto& range : push_constant_ranges) {
+		key.insert(key.end(), { range.stageFlags, range.offset, range.size });
+	}
+
+	auto cached = pipeline_layouts.find(key);
+	if (cached != pipeline_layouts.end()) {
+		return cached->second;
+	}
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(info.set_layouts.size());
+	pipeline_layout_info.pSetLayouts = info.set_layouts.data();
+	pipeline_layout_info.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+	pipeline_layout_info.pPushConstantRanges = push_constant_ranges.data();
+
+	if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &info.pipeline_layout) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Pipeline layout! \033[0m \n");
+	}
+
+	pipeline_layouts[key] = info;
+
+	return info;
+}
+
+
+VkDescriptorSetLayout LayoutCache::get_descriptor_set_layout(const std::vector<DescriptorBinding>& bindings) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	return get_descriptor_set_layout_locked(bindings);
+}
+
+
+VkShaderStageFlags LayoutCache::push_constant_stages(VkPipelineLayout pipeline_layout) const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	VkShaderStageFlags stages = 0;
+	for (const auto& [key, info] : pipeline_layouts) {
+		if (info.pipeline_layout == pipeline_layout) {
+			for (const auto& range : info.push_constant_ranges) {
+				stages |= range.stageFlags;
+			}
+		}
+	}
+
+	return stages;
+}
+
+
+std::vector<VkDescriptorSetLayout> LayoutCache::descriptor_set_layouts(VkPipelineLayout pipeline_layout) const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	for (const auto& [key, info] : pipeline_layouts) {
+		if (info.pipeline_layout == pipeline_layout) {
+			return info.set_layouts;
+		}
+	}
+
+	return {};
+}
+
+
+VkDescriptorSetLayout LayoutCache::get_descriptor_set_layout_locked(const std::vector<DescriptorBinding>& bindings) {
+
+	std::vector<uint64_t> key;
+	std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
+
+	for (const auto& binding : bindings) {
+
+		key.insert(key.end(), { binding.binding, static_cast<uint64_t>(binding.type), binding.count, binding.stages });
+
+		VkDescriptorSetLayoutBinding layout_binding{};
+		layout_binding.binding = binding.binding;
+		layout_binding.descriptorType = binding.type;
+		layout_binding.descriptorCount = binding.count;
+		layout_binding.stageFlags = binding.stages;
+		layout_bindings.push_back(layout_binding);
+	}
+
+	auto cached = set_layouts.find(key);
+	if (cached != set_layouts.end()) {
+		return cached->second;
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info{};
+	set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	set_layout_info.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+	set_layout_info.pBindings = layout_bindings.data();
+
+	VkDescriptorSetLayout set_layout;
+	if (vkCreateDescriptorSetLayout(device, &set_layout_info, nullptr, &set_layout) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Descriptor set layout! \033[0m \n");
+	}
+
+	set_layouts[key] = set_layout;
+
+	return set_layout;
+}
+
+
+size_t LayoutCache::descriptor_set_layout_count() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	return set_layouts.size();
+}
+
+
+size_t LayoutCache::pipeline_layout_count() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	return pipeline_layouts.size();
+}
+
+
+} // namespace vk_reflect
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "vk_includes.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+
+namespace vk_reflect {
+
+
+struct DescriptorBinding {
+
+	uint32_t set = 0;
+	uint32_t binding = 0;
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uint32_t count = 1;
+	VkShaderStageFlags stages = 0;
+	std::string name;
+};
+
+struct VertexInput {
+
+	uint32_t location = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t size = 0; // bytes
+	std::string name;
+};
+
+struct SpecializationConstant {
+
+	uint32_t constant_id = 0;
+	uint32_t size = 0; // bytes (booleans are 4 bytes, VkBool32)
+	uint32_t default_value = 0; // low word of the default value
+	std::string name;
+};
+
+// Everything a pipeline needs to know about one shader stage
+struct ShaderReflection {
+
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+	std::string entry_point = "main";
+
+	std::vector<DescriptorBinding> descriptor_bindings;
+	std::vector<VkPushConstantRange> push_constant_ranges; // at most one per stage
+	std::vector<VertexInput> vertex_inputs;                // vertex stage only, sorted by location
+	std::vector<SpecializationConstant> specialization_constants;
+
+	uint32_t local_size[3] = { 1, 1, 1 };                  // compute stage only
+};
+
+// Vertex input state for a single interleaved vertex buffer (binding 0)
+struct VertexInputLayout {
+
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+};
+
+struct PipelineLayoutInfo {
+
+	VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSetLayout> set_layouts; // indexed by set number
+	std::vector<VkPushConstantRange> push_constant_ranges;
+};
+
+
+// Parse the SPIR-V module (as loaded by my_util::map_file).
+// Uniform and storage buffers named "*_dynamic" in the shader
+// (e.g. "} per_draw_dynamic;") get the *_DYNAMIC descriptor type.
+ShaderReflection reflect_shader(const uint32_t* words, size_t word_count);
+
+
+// Vertex attributes packed in location order, in a single binding
+VertexInputLayout build_vertex_input_layout(const ShaderReflection& vertex_shader);
+
+
+/*
+Creates descriptor set layouts and pipeline layouts from the reflection of the
+shader stages of a pipeline, and caches them: pipelines with the same interface
+share the same VkPipelineLayout. Stages that declare the same set/binding with
+a different type are rejected, so a layout can never mismatch its shaders.
+The cache owns every layout it returns and destroys them with it.
+Thread safe (pipelines are also built by the shader hot reload thread).
+*/
+class LayoutCache {
+
+public:
+
+	explicit LayoutCache(VkDevice device);
+	~LayoutCache();
+
+	LayoutCache(const LayoutCache&) = delete;
+	LayoutCache& operator=(const LayoutCache&) = delete;
+
+	PipelineLayoutInfo get_pipeline_layout(const std::vector<const ShaderReflection*>& stages);
+
+	VkDescriptorSetLayout get_descriptor_set_layout(const std::vector<DescriptorBinding>& bindings);
+
+	// Stages of the push constant ranges of a layout created by this cache (0 if none)
+	VkShaderStageFlags push_constant_stages(VkPipelineLayout pipeline_layout) const;
+
+	// Descriptor set layouts of a layout created by this cache, indexed by set number
+	std::vector<VkDescriptorSetLayout> descriptor_set_layouts(VkPipelineLayout pipeline_layout) const;
+
+	size_t descriptor_set_layout_count() const;
+	size_t pipeline_layout_count() const;
+
+private:
+
+	VkDevice device;
+
+	mutable std::mutex cache_mutex;
+	std::map<std::vector<uint64_t>, VkDescriptorSetLayout> set_layouts;
+	std::map<std::vector<uint64_t>, PipelineLayoutInfo> pipeline_layouts;
+
+	VkDescriptorSetLayout get_descriptor_set_layout_locked(const std::vector<DescriptorBinding>& bindings);
+};
+
+
+} // namespace vk_reflect
\ No newline at end of file
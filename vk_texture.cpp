@@ -0,0 +1,512 @@
+#include "vk_texture.hpp"
+#include "vk_pipeline.hpp"
+#include "vk_buffer.hpp"
+#include "vk_barrier.hpp"
+#include "vk_query.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <cstring>		// memcpy()
+#include <tuple>		// tie()
+#include <algorithm>	// max(), min()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_texture {
+
+
+// The textures once they are uploaded: sampled by the fragment and compute shaders
+static const vk_barrier::Access SHADER_READ = {
+	VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+	VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+	VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+
+bool SamplerDesc::operator<(const SamplerDesc& other) const {
+
+	return std::tie(mag_filter, min_filter, mipmap_mode, address_mode_u, address_mode_v, address_mode_w,
+		            max_anisotropy, mip_lod_bias, min_lod, max_lod, border_color) <
+		   std::tie(other.mag_filter, other.min_filter, other.mipmap_mode,
+			        other.address_mode_u, other.address_mode_v, other.address_mode_w,
+			        other.max_anisotropy, other.mip_lod_bias, other.min_lod, other.max_lod, other.border_color);
+}
+
+
+SamplerCache::SamplerCache(const vk_device::DeviceProbe& device_probe, VkDevice device)
+	: device(device), anisotropy(device_probe.sampler_anisotropy),
+	  max_anisotropy(device_probe.max_sampler_anisotropy) {
+}
+
+
+SamplerCache::~SamplerCache() {
+
+	for (const auto& [desc, sampler] : samplers) {
+		vkDestroySampler(device, sampler, nullptr);
+	}
+}
+
+
+VkSampler SamplerCache::get(const SamplerDesc& desc) {
+
+	// Requests that only differ by an anisotropy the device can not honor share a sampler
+	SamplerDesc key = desc;
+	key.max_anisotropy = anisotropy ? std::min(std::max(desc.max_anisotropy, 1.0f), max_anisotropy) : 1.0f;
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	auto it = samplers.find(key);
+	if (it != samplers.end()) {
+		hits++;
+		return it->second;
+	}
+
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = key.mag_filter;
+	sampler_info.minFilter = key.min_filter;
+	sampler_info.mipmapMode = key.mipmap_mode;
+	sampler_info.addressModeU = key.address_mode_u;
+	sampler_info.addressModeV = key.address_mode_v;
+	sampler_info.addressModeW = key.address_mode_w;
+	sampler_info.mipLodBias = key.mip_lod_bias;
+	sampler_info.anisotropyEnable = (key.max_anisotropy > 1.0f) ? VK_TRUE : VK_FALSE;
+	sampler_info.maxAnisotropy = key.max_anisotropy;
+	sampler_info.compareEnable = VK_FALSE;
+	sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+	sampler_info.minLod = key.min_lod;
+	sampler_info.maxLod = key.max_lod;
+	sampler_info.borderColor = key.border_color;
+	sampler_info.unnormalizedCoordinates = VK_FALSE;
+
+	VkSampler sampler;
+	if (vkCreateSampler(device, &sampler_info, nullptr, &sampler) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Sampler! \033[0m \n");
+	}
+
+	misses++;
+	samplers.emplace(key, sampler);
+
+	return sampler;
+}
+
+
+size_t SamplerCache::size() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return samplers.size();
+}
+
+
+uint64_t SamplerCache::hit_count() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return hits;
+}
+
+
+uint64_t SamplerCache::miss_count() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return misses;
+}
+
+
+uint32_t mip_level_count(VkExtent2D extent) {
+
+	uint32_t size = std::max(extent.width, extent.height);
+
+	uint32_t levels = 1;
+	while (size > 1) {
+		size /= 2;
+		levels++;
+	}
+
+	return levels;
+}
+
+
+bool check_mip_generation_support(VkFormat format, VkPhysicalDevice physical_device) {
+
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+		                            VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	return (format_properties.optimalTilingFeatures & required) == required;
+}
+
+
+TextureUploader::TextureUploader(VkPhysicalDevice physical_device, const vk_device::DeviceProbe& device_probe,
+	                             VkDevice device, uint32_t queue_family, VkQueue queue,
+	                             vk_handle::DeletionQueue* deletion_queue)
+	: physical_device(physical_device), device(device), queue(queue), deletion_queue(deletion_queue),
+	  timestamp_period(device_probe.timestamp_period) {
+
+	VkCommandPoolCreateInfo command_pool_info{};
+	command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	command_pool_info.queueFamilyIndex = queue_family;
+
+	VkCommandPool new_command_pool;
+	if (vkCreateCommandPool(device, &command_pool_info, nullptr, &new_command_pool) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Command pool! \033[0m \n");
+	}
+	command_pool = vk_handle::Handle<VkCommandPool>(new_command_pool, device, nullptr);
+
+	vk_pipeline::create_command_buffer(command_buffer, command_pool, device);
+
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence new_fence;
+	if (vkCreateFence(device, &fence_info, nullptr, &new_fence) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Fence! \033[0m \n");
+	}
+	fence = vk_handle::Handle<VkFence>(new_fence, device, nullptr);
+
+	// Timestamps before and after the batch
+	uint32_t queue_families_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_families_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_families_count, queue_families.data());
+
+	timestamp_valid_bits = queue_families[queue_family].timestampValidBits;
+
+	if (timestamp_valid_bits > 0) {
+
+		VkQueryPoolCreateInfo query_pool_info{};
+		query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		query_pool_info.queryCount = 2;
+
+		VkQueryPool new_query_pool;
+		if (vkCreateQueryPool(device, &query_pool_info, nullptr, &new_query_pool) != VK_SUCCESS) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Failed to create Vulkan Query pool! \033[0m \n");
+		}
+		timestamp_query_pool = vk_handle::Handle<VkQueryPool>(new_query_pool, device, nullptr);
+	}
+}
+
+
+Texture TextureUploader::create_texture(const std::string& name, const void* pixels, VkDeviceSize pixels_size,
+	                                    VkExtent2D extent, VkFormat format, bool mipmaps) {
+
+	if (pixels_size != static_cast<VkDeviceSize>(extent.width) * extent.height * 4) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Texture " + name + " is not " + std::to_string(extent.width) + "x" +
+			                     std::to_string(extent.height) + " texels of 4 bytes! \033[0m \n");
+	}
+
+	bool generate_mips = mipmaps && check_mip_generation_support(format, physical_device);
+	uint32_t mip_levels = generate_mips ? mip_level_count(extent) : 1;
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (generate_mips) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	Texture texture = create_image(name, extent, format, mip_levels, usage);
+
+	std::memcpy(map_staging(pixels_size), pixels, pixels_size);
+
+	record_level_copies(texture, { 0 });
+
+	if (generate_mips) {
+		record_mip_chain(texture);
+	}
+	else {
+		record_shader_read(texture);
+	}
+
+	texture_count++;
+
+	return texture;
+}
+
+
+void* TextureUploader::map_staging(VkDeviceSize size) {
+
+	StagingBuffer& staging = create_staging_buffer(size);
+	staging_pending = true;
+
+	return staging.mapped;
+}
+
+
+Texture TextureUploader::create_texture_from_staging(const std::string& name, VkExtent2D extent, VkFormat format,
+	                                                 const std::vector<VkDeviceSize>& level_offsets) {
+
+	if (level_offsets.empty() || level_offsets.size() > mip_level_count(extent)) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Texture " + name + " has " + std::to_string(level_offsets.size()) +
+			                     " levels, not 1 to " + std::to_string(mip_level_count(extent)) + "! \033[0m \n");
+	}
+
+	Texture texture = create_image(name, extent, format, static_cast<uint32_t>(level_offsets.size()),
+		                           VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+	record_level_copies(texture, level_offsets);
+	record_shader_read(texture);
+
+	texture_count++;
+
+	return texture;
+}
+
+
+void TextureUploader::record_level_copies(const Texture& texture, const std::vector<VkDeviceSize>& level_offsets) {
+
+	if (!staging_pending) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("No staging memory mapped for texture " + texture.name + "! \033[0m \n");
+	}
+	staging_pending = false;
+
+	begin_recording();
+
+	// The copied levels are written once: their previous contents are discarded.
+	// The levels generated later are transitioned by the blit that writes them.
+	barrier_tracker.add_image(texture.image, VK_IMAGE_ASPECT_COLOR_BIT, texture.mip_levels, 1, vk_barrier::Access{});
+	barrier_tracker.use_image(texture.image, vk_barrier::TRANSFER_WRITE, 0, static_cast<uint32_t>(level_offsets.size()));
+	barrier_tracker.flush(command_buffer);
+
+	std::vector<VkBufferImageCopy> regions(level_offsets.size());
+
+	for (uint32_t level = 0; level < regions.size(); level++) {
+
+		VkBufferImageCopy& region = regions[level];
+		region.bufferOffset = level_offsets[level];
+		region.bufferRowLength = 0;   // tightly packed
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { std::max(texture.extent.width >> level, 1u), std::max(texture.extent.height >> level, 1u), 1 };
+	}
+
+	vkCmdCopyBufferToImage(command_buffer, staging_buffers.back().buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		                   static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+
+void TextureUploader::record_shader_read(const Texture& texture) {
+
+	barrier_tracker.use_image(texture.image, SHADER_READ);
+	barrier_tracker.flush(command_buffer);
+
+	barrier_tracker.remove_image(texture.image);
+}
+
+
+void TextureUploader::record_mip_chain(const Texture& texture) {
+
+	int32_t width = static_cast<int32_t>(texture.extent.width);
+	int32_t height = static_cast<int32_t>(texture.extent.height);
+
+	for (uint32_t level = 1; level < texture.mip_levels; level++) {
+
+		// The level above, just written (by the copy or the previous blit), becomes the source,
+		// and this one the destination: both barriers in one batch
+		barrier_tracker.use_image(texture.image, vk_barrier::TRANSFER_READ, level - 1, 1);
+		barrier_tracker.use_image(texture.image, vk_barrier::TRANSFER_WRITE, level, 1);
+		barrier_tracker.flush(command_buffer);
+
+		int32_t level_width = std::max(width / 2, 1);
+		int32_t level_height = std::max(height / 2, 1);
+
+		VkImageBlit blit{};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = level - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { width, height, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = level;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { level_width, level_height, 1 };
+
+		vkCmdBlitImage(command_buffer,
+			           texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			           texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			           1, &blit, VK_FILTER_LINEAR);
+
+		width = level_width;
+		height = level_height;
+	}
+
+	// Every level but the last was a blit source, the last one was written by the last blit:
+	// two barriers once the levels in the same state are merged
+	record_shader_read(texture);
+}
+
+
+double TextureUploader::submit() {
+
+	if (!recording) {
+		return 0.0;
+	}
+
+	if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_query_pool, 1);
+	}
+
+	recording = false;
+	texture_count = 0;
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to record Command buffer! \033[0m \n");
+	}
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	if (vkQueueSubmit(queue, 1, &submit_info, fence) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to submit texture upload Command buffer! \033[0m \n");
+	}
+
+	vkWaitForFences(device, 1, fence.ptr(), VK_TRUE, UINT64_MAX);
+	vkResetFences(device, 1, fence.ptr());
+	vkResetCommandBuffer(command_buffer, 0);
+
+	// The copies are done
+	staging_buffers.clear();
+
+	if (timestamp_query_pool.get() == VK_NULL_HANDLE) {
+		return 0.0;
+	}
+
+	uint64_t timestamps[2] = {};
+	vkGetQueryPoolResults(device, timestamp_query_pool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+		                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	return vk_query::timestamp_interval_ms(timestamps[0], timestamps[1], timestamp_valid_bits, timestamp_period);
+}
+
+
+void TextureUploader::begin_recording() {
+
+	if (recording) {
+		return;
+	}
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to begin recording Command buffer! \033[0m \n");
+	}
+
+	if (timestamp_query_pool.get() != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(command_buffer, timestamp_query_pool, 0, 2);
+		vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_query_pool, 0);
+	}
+
+	recording = true;
+}
+
+
+TextureUploader::StagingBuffer& TextureUploader::create_staging_buffer(VkDeviceSize size) {
+
+	VkBuffer new_buffer;
+	VkDeviceMemory new_memory;
+	vk_buffer::create_buffer(new_buffer, new_memory, size,
+		                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                     physical_device, device);
+
+	StagingBuffer staging;
+	staging.memory = vk_handle::Handle<VkDeviceMemory>(new_memory, device, nullptr);
+	staging.buffer = vk_handle::Handle<VkBuffer>(new_buffer, device, nullptr);
+	staging.size = size;
+
+	if (vkMapMemory(device, new_memory, 0, VK_WHOLE_SIZE, 0, &staging.mapped) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to map Vulkan staging Buffer memory! \033[0m \n");
+	}
+
+	staging_buffers.push_back(std::move(staging));
+	return staging_buffers.back();
+}
+
+
+Texture TextureUploader::create_image(const std::string& name, VkExtent2D extent, VkFormat format,
+	                                  uint32_t mip_levels, VkImageUsageFlags usage) {
+
+	Texture texture;
+	texture.name = name;
+	texture.format = format;
+	texture.extent = extent;
+	texture.mip_levels = mip_levels;
+
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.format = format;
+	image_info.extent = { extent.width, extent.height, 1 };
+	image_info.mipLevels = mip_levels;
+	image_info.arrayLayers = 1;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.usage = usage;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkImage image;
+	if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create texture image " + name + "! \033[0m \n");
+	}
+	texture.image = vk_handle::Handle<VkImage>(image, device, deletion_queue);
+
+	VkMemoryRequirements memory_requirements;
+	vkGetImageMemoryRequirements(device, image, &memory_requirements);
+
+	VkDeviceMemory memory = vk_buffer::allocate_memory(memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		                                               physical_device, device);
+	texture.memory = vk_handle::Handle<VkDeviceMemory>(memory, device, deletion_queue);
+	texture.size = memory_requirements.size;
+
+	vkBindImageMemory(device, image, memory, 0);
+
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = format;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_info.subresourceRange.baseMipLevel = 0;
+	view_info.subresourceRange.levelCount = mip_levels;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = 1;
+
+	VkImageView image_view;
+	if (vkCreateImageView(device, &view_info, nullptr, &image_view) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create texture image view " + name + "! \033[0m \n");
+	}
+	texture.image_view = vk_handle::Handle<VkImageView>(image_view, device, deletion_queue);
+
+	return texture;
+}
+
+
+} // namespace vk_texture
\ No newline at end of file
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_handle.hpp"
+#include "vk_device.hpp"
+#include "vk_barrier.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+
+namespace vk_texture {
+
+
+// Sampler state, the key of the sampler cache
+struct SamplerDesc {
+
+	VkFilter mag_filter = VK_FILTER_LINEAR;
+	VkFilter min_filter = VK_FILTER_LINEAR;
+	VkSamplerMipmapMode mipmap_mode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	VkSamplerAddressMode address_mode_u = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkSamplerAddressMode address_mode_v = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	VkSamplerAddressMode address_mode_w = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	float max_anisotropy = 1.0f; // 1 disables anisotropic filtering
+	float mip_lod_bias = 0.0f;
+	float min_lod = 0.0f;
+	float max_lod = VK_LOD_CLAMP_NONE;
+	VkBorderColor border_color = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+
+	bool operator<(const SamplerDesc& other) const;
+};
+
+
+/*
+Samplers by state: materials asking for the same filtering and addressing share one VkSampler,
+so the number of samplers stays small (maxSamplerAllocationCount can be as low as 4000).
+Anisotropy is clamped to maxSamplerAnisotropy, and disabled unless samplerAnisotropy was enabled.
+Owns its samplers, destroyed with the cache: the device must be done with them.
+Thread safe.
+*/
+class SamplerCache {
+
+public:
+
+	// Anisotropy is used when the probe found samplerAnisotropy
+	// (vk_core::create_logical_device() enables it then)
+	SamplerCache(const vk_device::DeviceProbe& device_probe, VkDevice device);
+	~SamplerCache();
+
+	SamplerCache(const SamplerCache&) = delete;
+	SamplerCache& operator=(const SamplerCache&) = delete;
+
+	// Sampler with the state of desc, created on the first request
+	VkSampler get(const SamplerDesc& desc);
+
+	// Distinct samplers created
+	size_t size() const;
+
+	// Requests served by an existing sampler, and by a new one
+	uint64_t hit_count() const;
+	uint64_t miss_count() const;
+
+private:
+
+	VkDevice device;
+	bool anisotropy = false;
+	float max_anisotropy = 1.0f;
+
+	mutable std::mutex cache_mutex;
+	std::map<SamplerDesc, VkSampler> samplers;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
+
+
+// Number of levels of a full mip chain down to 1x1: floor(log2(max(width, height))) + 1
+uint32_t mip_level_count(VkExtent2D extent);
+
+
+// True if the mip chain of format can be generated on the GPU:
+// optimal tiling images of it can be the source and the destination of linear blits
+bool check_mip_generation_support(VkFormat format, VkPhysicalDevice physical_device);
+
+
+// A sampled image and its view, in SHADER_READ_ONLY_OPTIMAL once its upload has been submitted
+struct Texture {
+
+	std::string name;
+
+	vk_handle::Handle<VkImage> image;
+	vk_handle::Handle<VkDeviceMemory> memory;
+	vk_handle::Handle<VkImageView> image_view;
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	uint32_t mip_levels = 1;
+	VkDeviceSize size = 0; // of the memory allocation
+};
+
+
+/*
+Creates textures from pixels in host memory, or from levels prepared by the caller directly
+in staging memory (map_staging()). Each texture gets a host visible staging buffer,
+copied into level 0 of the image by vkCmdCopyBufferToImage(), then the other levels are blitted
+one from the other (linear filter, half the size each time), each level waiting only for the
+blit that wrote the level above it. The whole chain ends in SHADER_READ_ONLY_OPTIMAL.
+Uploads are recorded in a batch: many textures share one submission, and nothing runs
+until submit(), which waits for it and frees the staging buffers.
+The queue must support graphics (blits), e.g. the graphics queue of the frames.
+Not thread safe.
+*/
+class TextureUploader {
+
+public:
+
+	// Textures are released through deletion_queue (may be null: destroyed right away)
+	TextureUploader(
+		VkPhysicalDevice physical_device, const vk_device::DeviceProbe& device_probe, VkDevice device,
+		uint32_t queue_family, VkQueue queue,
+		vk_handle::DeletionQueue* deletion_queue);
+
+	TextureUploader(const TextureUploader&) = delete;
+	TextureUploader& operator=(const TextureUploader&) = delete;
+
+	// Record the upload of a tightly packed level 0 (width * height texels of format, 4 bytes each
+	// for the RGBA8 formats) and, with mipmaps, the generation of the full mip chain.
+	// Without GPU mip generation for format the texture has a single level.
+	Texture create_texture(
+		const std::string& name, const void* pixels, VkDeviceSize pixels_size,
+		VkExtent2D extent, VkFormat format, bool mipmaps);
+
+	// Host visible staging memory of size bytes for the next create_texture_from_staging(),
+	// written by the caller: e.g. the levels of a file copied straight from its mapping
+	void* map_staging(VkDeviceSize size);
+
+	// Record the upload of prepared levels (e.g. block compressed mips) from the memory of the last
+	// map_staging(), without generating anything: level i is tightly packed at level_offsets[i],
+	// a multiple of the texel block size of format
+	Texture create_texture_from_staging(
+		const std::string& name, VkExtent2D extent, VkFormat format,
+		const std::vector<VkDeviceSize>& level_offsets);
+
+	// Submit the recorded uploads and wait for them.
+	// Returns the GPU time of the batch in milliseconds (timestamp queries), 0 without timestamps.
+	double submit();
+
+	// Textures recorded since the last submit()
+	uint32_t recorded_textures() const { return texture_count; }
+
+	// Barriers recorded by the uploads so far
+	const vk_barrier::BarrierStats& barrier_stats() const { return barrier_tracker.stats(); }
+
+private:
+
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	VkQueue queue;
+	vk_handle::DeletionQueue* deletion_queue;
+
+	float timestamp_period; // nanoseconds per tick
+
+	vk_handle::Handle<VkCommandPool> command_pool;
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE; // freed with the pool
+	vk_handle::Handle<VkFence> fence;
+	vk_handle::Handle<VkQueryPool> timestamp_query_pool; // null without timestamps
+	uint32_t timestamp_valid_bits = 0;                   // of the queue family
+
+	// Host visible buffers read by the recorded copies, freed after submit()
+	struct StagingBuffer {
+		vk_handle::Handle<VkDeviceMemory> memory;
+		vk_handle::Handle<VkBuffer> buffer;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr;
+	};
+
+	std::vector<StagingBuffer> staging_buffers;
+	bool staging_pending = false; // the last staging buffer is mapped, not copied from yet
+
+	bool recording = false;
+	uint32_t texture_count = 0;
+
+	// Layouts of the levels of the textures being recorded
+	vk_barrier::StateTracker barrier_tracker;
+
+	void begin_recording();
+	StagingBuffer& create_staging_buffer(VkDeviceSize size);
+
+	// Image, memory and view of every level, in UNDEFINED layout
+	Texture create_image(const std::string& name, VkExtent2D extent, VkFormat format,
+		                 uint32_t mip_levels, VkImageUsageFlags usage);
+
+	// Transition the copied levels to TRANSFER_DST_OPTIMAL and copy them from the last staging buffer
+	void record_level_copies(const Texture& texture, const std::vector<VkDeviceSize>& level_offsets);
+
+	// Every level to SHADER_READ_ONLY_OPTIMAL, and stop tracking the texture
+	void record_shader_read(const Texture& texture);
+
+	// Blit each level from the one above it, and leave every level in SHADER_READ_ONLY_OPTIMAL
+	void record_mip_chain(const Texture& texture);
+};
+
+
+} // namespace vk_texture
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "vk_tonemap.hpp"
+#include "vk_pipeline.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <array>
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_tonemap {
+
+
+// Push constants of tonemap.comp
+struct ToneMapConstants {
+	float exposure;
+	uint32_t srgb_encode;
+};
+
+
+VkFormat to_vk_format(vk_config::HdrFormat hdr_format) {
+
+	switch (hdr_format) {
+		default:
+		case vk_config::HdrFormat::Off: return VK_FORMAT_UNDEFINED;
+		case vk_config::HdrFormat::B10G11R11: return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+		case vk_config::HdrFormat::R16G16B16A16: return VK_FORMAT_R16G16B16A16_SFLOAT;
+	}
+}
+
+
+uint32_t texel_size(VkFormat format) {
+
+	switch (format) {
+		case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+		default: return 4; // B10G11R11 and the 8 bit swapchain formats
+	}
+}
+
+
+bool check_hdr_format_support(VkFormat format, VkPhysicalDevice physical_device) {
+
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+		                            VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+		                            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+	return (format_properties.optimalTilingFeatures & required) == required;
+}
+
+
+ToneMapPass::ToneMapPass(VkDevice device, VkPipelineCache pipeline_cache,
+	                     vk_reflect::LayoutCache& layout_cache,
+	                     vk_handle::DeletionQueue* deletion_queue)
+	: device(device) {
+
+	vk_reflect::ShaderReflection reflection;
+
+	VkPipeline new_pipeline;
+	vk_pipeline::create_compute_pipeline(new_pipeline, pipeline_layout, reflection,
+		                                 TONE_MAP_SHADER_FILE, vk_variant::Specialization{},
+		                                 pipeline_cache, layout_cache, device);
+	pipeline = vk_handle::Handle<VkPipeline>(new_pipeline, device, deletion_queue);
+
+	local_size[0] = reflection.local_size[0];
+	local_size[1] = reflection.local_size[1];
+
+	// A single set: the HDR color and the swapchain image
+	VkDescriptorPoolSize pool_sizes[2] = {};
+	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	pool_sizes[0].descriptorCount = 1;
+	pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	pool_sizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo descriptor_pool_info{};
+	descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptor_pool_info.maxSets = 1;
+	descriptor_pool_info.poolSizeCount = 2;
+	descriptor_pool_info.pPoolSizes = pool_sizes;
+
+	VkDescriptorPool new_descriptor_pool;
+	if (vkCreateDescriptorPool(device, &descriptor_pool_info, nullptr, &new_descriptor_pool) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to create Vulkan Descriptor pool! \033[0m \n");
+	}
+	descriptor_pool = vk_handle::Handle<VkDescriptorPool>(new_descriptor_pool, device, deletion_queue);
+
+	std::vector<VkDescriptorSetLayout> set_layouts = layout_cache.descriptor_set_layouts(pipeline_layout);
+	if (set_layouts.empty()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error(TONE_MAP_SHADER_FILE + " declares no images! \033[0m \n");
+	}
+
+	VkDescriptorSetAllocateInfo descriptor_set_info{};
+	descriptor_set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptor_set_info.descriptorPool = descriptor_pool;
+	descriptor_set_info.descriptorSetCount = 1;
+	descriptor_set_info.pSetLayouts = &set_layouts[0];
+
+	if (vkAllocateDescriptorSets(device, &descriptor_set_info, &descriptor_set) != VK_SUCCESS) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to allocate Vulkan Descriptor set! \033[0m \n");
+	}
+}
+
+
+void ToneMapPass::record(VkCommandBuffer command_buffer,
+	                     VkImageView hdr_image_view, VkImageView target_image_view,
+	                     VkFormat target_format, VkExtent2D extent) {
+
+	// The previous frame has completed: its command buffer no longer uses the set
+	VkDescriptorImageInfo hdr_image_info{};
+	hdr_image_info.imageView = hdr_image_view;
+	hdr_image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo target_image_info{};
+	target_image_info.imageView = target_image_view;
+	target_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet descriptor_writes[2] = {};
+	descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_writes[0].dstSet = descriptor_set;
+	descriptor_writes[0].dstBinding = 0;
+	descriptor_writes[0].descriptorCount = 1;
+	descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptor_writes[0].pImageInfo = &hdr_image_info;
+
+	descriptor_writes[1] = descriptor_writes[0];
+	descriptor_writes[1].dstBinding = 1;
+	descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptor_writes[1].pImageInfo = &target_image_info;
+
+	vkUpdateDescriptorSets(device, 2, descriptor_writes, 0, nullptr);
+
+	// _SRGB swapchain formats encode on store, UNORM ones (the usual storage formats) do not
+	ToneMapConstants constants{};
+	constants.exposure = exposure;
+	constants.srgb_encode = (target_format == VK_FORMAT_B8G8R8A8_SRGB || target_format == VK_FORMAT_R8G8B8A8_SRGB) ? 0 : 1;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout,
+		                    0, 1, &descriptor_set, 0, nullptr);
+	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+		               0, sizeof(constants), &constants);
+
+	// One invocation per pixel, the shader skips the ones past the edges
+	vkCmdDispatch(command_buffer,
+		          (extent.width + local_size[0] - 1) / local_size[0],
+		          (extent.height + local_size[1] - 1) / local_size[1], 1);
+}
+
+
+void ToneMapPass::watch(vk_hot_reload::ShaderHotReload& hot_reload,
+	                    VkPipelineCache pipeline_cache, vk_reflect::LayoutCache& layout_cache) {
+
+	// The builder runs on the hot reload thread: capture copies, not members
+	VkPipelineLayout expected_pipeline_layout = pipeline_layout;
+	std::array<uint32_t, 3> expected_local_size = { local_size[0], local_size[1], 1 };
+	vk_reflect::LayoutCache* current_layout_cache = &layout_cache; // thread safe
+	VkDevice current_device = device;
+
+	hot_reload.add_pipeline(pipeline, pipeline_layout, { "tonemap_comp.spv" },
+		[=](VkPipeline& new_pipeline, VkPipelineLayout& new_pipeline_layout) {
+
+			vk_pipeline::rebuild_compute_pipeline(new_pipeline, new_pipeline_layout,
+				                                  TONE_MAP_SHADER_FILE, vk_variant::Specialization{},
+				                                  expected_pipeline_layout, expected_local_size.data(),
+				                                  pipeline_cache, *current_layout_cache, current_device);
+		});
+}
+
+
+} // namespace vk_tonemap
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_config.hpp"
+#include "vk_reflect.hpp"
+#include "vk_handle.hpp"
+#include "vk_hot_reload.hpp"
+
+#include <string>
+
+
+namespace vk_tonemap {
+
+
+// SPIR-V of shaders/tonemap.comp
+const std::string TONE_MAP_SHADER_FILE = "shaders/tonemap_comp.spv";
+
+
+// Format of the HDR color target, VK_FORMAT_UNDEFINED for HdrFormat::Off
+VkFormat to_vk_format(vk_config::HdrFormat hdr_format);
+
+
+// Size of a pixel of the color formats used as render targets, in bytes
+uint32_t texel_size(VkFormat format);
+
+
+// True if the device can render to the format and sample it (optimal tiling),
+// with blending and the MSAA resolve
+bool check_hdr_format_support(VkFormat format, VkPhysicalDevice physical_device);
+
+
+/*
+Compute pass that tone maps the HDR color target into the swapchain image:
+one invocation per pixel reads the HDR color (sampled image, SHADER_READ_ONLY_OPTIMAL),
+applies the exposure and a filmic curve and writes the result (storage image, GENERAL).
+The swapchain image is written without a format qualifier, so the same pipeline works
+with BGRA and RGBA swapchains; UNORM ones are sRGB encoded by the shader.
+The descriptor set is rewritten every frame with the views of that frame:
+only one frame may be in flight.
+*/
+class ToneMapPass {
+
+public:
+
+	ToneMapPass(
+		VkDevice device, VkPipelineCache pipeline_cache,
+		vk_reflect::LayoutCache& layout_cache,
+		vk_handle::DeletionQueue* deletion_queue);
+
+	ToneMapPass(const ToneMapPass&) = delete;
+	ToneMapPass& operator=(const ToneMapPass&) = delete;
+
+	// Record the dispatch, the images must already be in their layouts
+	void record(
+		VkCommandBuffer command_buffer,
+		VkImageView hdr_image_view, VkImageView target_image_view,
+		VkFormat target_format, VkExtent2D extent);
+
+	// Rebuild the pipeline when the shader hot reload recompiles tonemap.comp,
+	// as long as its interface is unchanged. The pass must outlive hot_reload.
+	void watch(
+		vk_hot_reload::ShaderHotReload& hot_reload,
+		VkPipelineCache pipeline_cache, vk_reflect::LayoutCache& layout_cache);
+
+	// Multiplies the HDR color before the curve
+	float exposure = 1.0f;
+
+private:
+
+	VkDevice device;
+
+	vk_handle::Handle<VkPipeline> pipeline;
+	VkPipelineLayout pipeline_layout;       // owned by the layout cache
+	vk_handle::Handle<VkDescriptorPool> descriptor_pool;
+	VkDescriptorSet descriptor_set;         // freed with the pool
+
+	uint32_t local_size[2] = { 1, 1 };      // workgroup size of the shader
+};
+
+
+} // namespace vk_tonemap
\ No newline at end of file
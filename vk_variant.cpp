@@ -0,0 +1,202 @@
+#include "vk_variant.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <cstring>		// memcpy()
+#include <tuple>		// tie()
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_variant {
+
+
+Specialization& Specialization::set(uint32_t constant_id, uint32_t value) {
+
+	values[constant_id] = value;
+	return *this;
+}
+
+
+Specialization& Specialization::set(uint32_t constant_id, int32_t value) {
+
+	return set(constant_id, static_cast<uint32_t>(value));
+}
+
+
+Specialization& Specialization::set(uint32_t constant_id, float value) {
+
+	uint32_t bits = 0;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return set(constant_id, bits);
+}
+
+
+Specialization& Specialization::set(uint32_t constant_id, bool value) {
+
+	return set(constant_id, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+}
+
+
+bool Specialization::empty() const {
+
+	return values.empty();
+}
+
+
+void Specialization::validate(const vk_reflect::ShaderReflection& reflection, const std::string& shader_name) const {
+
+	for (const auto& [constant_id, value] : values) {
+
+		const vk_reflect::SpecializationConstant* declared = nullptr;
+		for (const auto& constant : reflection.specialization_constants) {
+			if (constant.constant_id == constant_id) {
+				declared = &constant;
+			}
+		}
+
+		if (declared == nullptr) {
+			LOG_MESSAGE(shader_name + " has no specialization constant " + std::to_string(constant_id) + ", value ignored.", Color::Red, Color::Black, 4);
+			continue;
+		}
+
+		if (declared->size != sizeof(uint32_t)) {
+			std::cout << "\033[31;40m";
+			throw std::runtime_error("Specialization constant " + declared->name + " of " + shader_name +
+				                     " is not 32 bit \033[0m \n");
+		}
+	}
+}
+
+
+const VkSpecializationInfo* Specialization::info() const {
+
+	if (values.empty()) {
+		return nullptr;
+	}
+
+	map_entries.clear();
+	data.clear();
+
+	for (const auto& [constant_id, value] : values) {
+
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constant_id;
+		entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+
+		map_entries.push_back(entry);
+		data.push_back(value);
+	}
+
+	specialization_info.mapEntryCount = static_cast<uint32_t>(map_entries.size());
+	specialization_info.pMapEntries = map_entries.data();
+	specialization_info.dataSize = data.size() * sizeof(uint32_t);
+	specialization_info.pData = data.data();
+
+	return &specialization_info;
+}
+
+
+std::string Specialization::to_string() const {
+
+	std::string text;
+	for (const auto& [constant_id, value] : values) {
+		text += (text.empty() ? "" : " ") + std::to_string(constant_id) + "=" + std::to_string(value);
+	}
+
+	return text;
+}
+
+
+std::string ShaderVariant::to_string() const {
+
+	return vert_file + " [" + vert_specialization.to_string() + "] " +
+		   frag_file + " [" + frag_specialization.to_string() + "]";
+}
+
+
+bool ShaderVariant::operator<(const ShaderVariant& other) const {
+
+	return std::tie(vert_file, frag_file, vert_specialization, frag_specialization) <
+		   std::tie(other.vert_file, other.frag_file, other.vert_specialization, other.frag_specialization);
+}
+
+
+VariantCache::VariantCache(VkDevice device, VariantBuilder builder, vk_handle::DeletionQueue* deletion_queue)
+	: device(device), builder(builder), deletion_queue(deletion_queue) {
+}
+
+
+VariantCache::~VariantCache() {
+
+	clear();
+}
+
+
+VkPipeline VariantCache::get_pipeline(const ShaderVariant& variant, VkPipelineLayout& pipeline_layout) {
+
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+
+		auto cached = variants.find(variant);
+		if (cached != variants.end()) {
+			hits++;
+			pipeline_layout = cached->second.pipeline_layout;
+			return cached->second.pipeline;
+		}
+		misses++;
+	}
+
+	LOG_MESSAGE("Building shader variant: " + variant.to_string(), Color::Bright_White, Color::Black, 0);
+
+	// Compile outside the lock, other variants stay available meanwhile
+	VkPipeline built_pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout built_pipeline_layout = VK_NULL_HANDLE;
+	builder(variant, built_pipeline, built_pipeline_layout);
+
+	CachedVariant built{ vk_handle::Handle<VkPipeline>(built_pipeline, device, deletion_queue), built_pipeline_layout };
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	// If another thread built the same variant first, this one is released unused
+	auto it = variants.emplace(variant, std::move(built)).first;
+
+	pipeline_layout = it->second.pipeline_layout;
+	return it->second.pipeline;
+}
+
+
+void VariantCache::clear() {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	// Each handle releases its pipeline
+	variants.clear();
+}
+
+
+size_t VariantCache::size() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return variants.size();
+}
+
+
+uint64_t VariantCache::hit_count() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return hits;
+}
+
+
+uint64_t VariantCache::miss_count() const {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	return misses;
+}
+
+
+} // namespace vk_variant
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_reflect.hpp"
+#include "vk_handle.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+
+
+namespace vk_variant {
+
+
+// Values of the specialization constants (layout(constant_id = N) const ...) of one shader stage.
+// Constants that are not set keep the default value written in the shader.
+// Only 32 bit constants (bool, int, uint, float) are supported.
+class Specialization {
+
+public:
+
+	Specialization& set(uint32_t constant_id, uint32_t value);
+	Specialization& set(uint32_t constant_id, int32_t value);
+	Specialization& set(uint32_t constant_id, float value);
+	Specialization& set(uint32_t constant_id, bool value); // as VkBool32
+
+	bool empty() const;
+
+	// Check the values against the constants declared by the shader:
+	// a value for an undeclared constant is ignored by Vulkan, so it is only reported.
+	void validate(const vk_reflect::ShaderReflection& reflection, const std::string& shader_name) const;
+
+	// Points into this object, valid until it is modified or destroyed.
+	// nullptr if no value is set.
+	const VkSpecializationInfo* info() const;
+
+	// e.g. "0=1 1=8"
+	std::string to_string() const;
+
+	bool operator<(const Specialization& other) const { return values < other.values; }
+
+private:
+
+	std::map<uint32_t, uint32_t> values; // constant_id -> raw 32 bit value
+
+	mutable std::vector<VkSpecializationMapEntry> map_entries;
+	mutable std::vector<uint32_t> data;
+	mutable VkSpecializationInfo specialization_info{};
+};
+
+
+// The shaders of a graphics pipeline and the values their constants are specialized with
+struct ShaderVariant {
+
+	std::string vert_file = "shaders/vert.spv";
+	std::string frag_file = "shaders/frag.spv";
+
+	Specialization vert_specialization;
+	Specialization frag_specialization;
+
+	std::string to_string() const;
+
+	bool operator<(const ShaderVariant& other) const;
+};
+
+
+// Constant ids of shader.frag
+enum FragConstant : uint32_t {
+	SHADING_MODEL = 0,
+	NOISE_OCTAVES = 1,
+	UBER_SHADER = 2
+};
+
+enum ShadingModel : uint32_t {
+	SHADING_GRADIENT = 0,
+	SHADING_NOISE = 1
+};
+
+
+// Builds the pipeline of a variant, the layout is owned by the vk_reflect::LayoutCache
+using VariantBuilder = std::function<void(const ShaderVariant& variant, VkPipeline& pipeline, VkPipelineLayout& pipeline_layout)>;
+
+
+/*
+Pipelines keyed by (shaders, specialization values).
+Each variant is compiled once, on first use, and reused afterwards:
+features such as the shading model become constants compiled into the
+variant instead of branches on uniform data evaluated for every fragment.
+The cache owns the pipelines and releases them with it (or with clear()),
+through the deletion queue if one is given: they are then destroyed once
+the frames that use them have completed.
+Thread safe.
+*/
+class VariantCache {
+
+public:
+
+	VariantCache(VkDevice device, VariantBuilder builder, vk_handle::DeletionQueue* deletion_queue);
+	~VariantCache();
+
+	VariantCache(const VariantCache&) = delete;
+	VariantCache& operator=(const VariantCache&) = delete;
+
+	// Pipeline of the variant, built if it is not in the cache yet
+	VkPipeline get_pipeline(const ShaderVariant& variant, VkPipelineLayout& pipeline_layout);
+
+	// Release every pipeline (e.g. when the render pass they were built for is destroyed).
+	// Without a deletion queue none of them must be in use by the GPU.
+	void clear();
+
+	size_t size() const;
+	uint64_t hit_count() const;
+	uint64_t miss_count() const;
+
+private:
+
+	struct CachedVariant {
+		vk_handle::Handle<VkPipeline> pipeline;
+		VkPipelineLayout pipeline_layout;
+	};
+
+	VkDevice device;
+	VariantBuilder builder;
+	vk_handle::DeletionQueue* deletion_queue;
+
+	mutable std::mutex cache_mutex;
+	std::map<ShaderVariant, CachedVariant> variants;
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+};
+
+
+} // namespace vk_variant
\ No newline at end of file
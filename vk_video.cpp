@@ -0,0 +1,406 @@
+#include "vk_video.hpp"
+#include "my_util.hpp"
+
+#include <iostream>
+#include <stdexcept>	// std::runtime_error()
+#include <sstream>
+#include <iomanip>
+#include <algorithm>	// min()
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_VIDEO_SSE2
+#include <emmintrin.h>
+#endif
+
+
+using namespace my_util; // my_util.hpp
+
+
+namespace vk_video {
+
+
+// BT.709 limited range, 8 bit fixed point (x256):
+//   Y = 16  + ( 47 R + 157 G +  16 B) / 256
+//   U = 128 + (-26 R -  86 G + 112 B) / 256
+//   V = 128 + (112 R - 102 G -  10 B) / 256
+// The chroma rows sum to 0 so that grays have no chroma, and every sum fits in 16 bits
+// (the luma one unsigned), which is what the SIMD path computes in
+static const int Y_R = 47, Y_G = 157, Y_B = 16;
+static const int U_R = -26, U_G = -86, U_B = 112;
+static const int V_R = 112, V_G = -102, V_B = -10;
+
+
+bool check_yuv_source_format(VkFormat format) {
+
+	switch (format) {
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return true;
+		default:
+			return false;
+	}
+}
+
+
+size_t yuv420_frame_size(VkExtent2D extent) {
+
+	size_t chroma_width = (extent.width + 1) / 2;
+	size_t chroma_height = (extent.height + 1) / 2;
+
+	return static_cast<size_t>(extent.width) * extent.height + 2 * chroma_width * chroma_height;
+}
+
+
+static inline uint8_t luma(int r, int g, int b) {
+
+	return static_cast<uint8_t>(16 + ((Y_R * r + Y_G * g + Y_B * b + 128) >> 8));
+}
+
+
+// Columns [first_column, width) of rows y and y + 1 (y again for the last row of an odd height)
+static void convert_columns_scalar(
+	const uint8_t* row0, const uint8_t* row1, uint32_t first_column, uint32_t width, bool rgb_order,
+	uint8_t* y_row0, uint8_t* y_row1, uint8_t* u_row, uint8_t* v_row) {
+
+	const int r_offset = rgb_order ? 0 : 2;
+	const int b_offset = rgb_order ? 2 : 0;
+
+	for (uint32_t x = first_column; x < width; x += 2) {
+
+		// x + 1 again for the last column of an odd width
+		const uint32_t x1 = std::min(x + 1, width - 1);
+
+		int r_sum = 0, g_sum = 0, b_sum = 0;
+
+		for (const uint8_t* pixel : { row0 + 4 * x, row0 + 4 * x1, row1 + 4 * x, row1 + 4 * x1 }) {
+			r_sum += pixel[r_offset];
+			g_sum += pixel[1];
+			b_sum += pixel[b_offset];
+		}
+
+		y_row0[x] = luma(row0[4 * x + r_offset], row0[4 * x + 1], row0[4 * x + b_offset]);
+		y_row1[x] = luma(row1[4 * x + r_offset], row1[4 * x + 1], row1[4 * x + b_offset]);
+		if (x1 != x) {
+			y_row0[x1] = luma(row0[4 * x1 + r_offset], row0[4 * x1 + 1], row0[4 * x1 + b_offset]);
+			y_row1[x1] = luma(row1[4 * x1 + r_offset], row1[4 * x1 + 1], row1[4 * x1 + b_offset]);
+		}
+
+		// Average of the block, rounded
+		int r = (r_sum + 2) >> 2;
+		int g = (g_sum + 2) >> 2;
+		int b = (b_sum + 2) >> 2;
+
+		u_row[x / 2] = static_cast<uint8_t>(128 + ((U_R * r + U_G * g + U_B * b + 128) >> 8));
+		v_row[x / 2] = static_cast<uint8_t>(128 + ((V_R * r + V_G * g + V_B * b + 128) >> 8));
+	}
+}
+
+
+#ifdef VK_VIDEO_SSE2
+
+// 8 pixels to one 16 bit lane per pixel for each channel
+static inline void load_channels(const uint8_t* pixels, bool rgb_order, __m128i& r, __m128i& g, __m128i& b) {
+
+	const __m128i byte_mask = _mm_set1_epi32(0xFF);
+
+	__m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+	__m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 16));
+
+	__m128i c0 = _mm_packs_epi32(_mm_and_si128(p0, byte_mask), _mm_and_si128(p1, byte_mask));
+	__m128i c1 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), byte_mask), _mm_and_si128(_mm_srli_epi32(p1, 8), byte_mask));
+	__m128i c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), byte_mask), _mm_and_si128(_mm_srli_epi32(p1, 16), byte_mask));
+
+	r = rgb_order ? c0 : c2;
+	g = c1;
+	b = rgb_order ? c2 : c0;
+}
+
+
+// Luma of 8 pixels, in 16 bit lanes: the products and their sum stay below 65536, exact as unsigned
+static inline __m128i luma8(__m128i r, __m128i g, __m128i b) {
+
+	__m128i sum = _mm_add_epi16(
+		_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(Y_R)), _mm_mullo_epi16(g, _mm_set1_epi16(Y_G))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(Y_B)), _mm_set1_epi16(128)));
+
+	return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+
+// Rounded average of the 2x2 blocks of 8 columns of two rows, already summed row by row: 4 x 32 bit
+static inline __m128i block_average4(__m128i row_sum) {
+
+	__m128i block_sum = _mm_madd_epi16(row_sum, _mm_set1_epi16(1)); // adjacent columns
+	return _mm_srai_epi32(_mm_add_epi32(block_sum, _mm_set1_epi32(2)), 2);
+}
+
+
+// Signed chroma of 8 averages, in 16 bit lanes (every sum fits)
+static inline __m128i chroma8(__m128i r, __m128i g, __m128i b, int cr, int cg, int cb) {
+
+	__m128i sum = _mm_add_epi16(
+		_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(static_cast<short>(cr))), _mm_mullo_epi16(g, _mm_set1_epi16(static_cast<short>(cg)))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(static_cast<short>(cb))), _mm_set1_epi16(128)));
+
+	return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+
+// 16 columns of rows y and y + 1: 32 luma and 8 chroma samples of each plane
+static inline void convert_16_columns(
+	const uint8_t* row0, const uint8_t* row1, bool rgb_order,
+	uint8_t* y_row0, uint8_t* y_row1, uint8_t* u_row, uint8_t* v_row) {
+
+	__m128i r_average[2], g_average[2], b_average[2];
+
+	for (int half = 0; half < 2; half++) {
+
+		__m128i r0, g0, b0, r1, g1, b1;
+		load_channels(row0 + 32 * half, rgb_order, r0, g0, b0);
+		load_channels(row1 + 32 * half, rgb_order, r1, g1, b1);
+
+		__m128i y0 = luma8(r0, g0, b0);
+		__m128i y1 = luma8(r1, g1, b1);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(y_row0 + 8 * half), _mm_packus_epi16(y0, y0));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(y_row1 + 8 * half), _mm_packus_epi16(y1, y1));
+
+		r_average[half] = block_average4(_mm_add_epi16(r0, r1));
+		g_average[half] = block_average4(_mm_add_epi16(g0, g1));
+		b_average[half] = block_average4(_mm_add_epi16(b0, b1));
+	}
+
+	__m128i r = _mm_packs_epi32(r_average[0], r_average[1]);
+	__m128i g = _mm_packs_epi32(g_average[0], g_average[1]);
+	__m128i b = _mm_packs_epi32(b_average[0], b_average[1]);
+
+	__m128i u = chroma8(r, g, b, U_R, U_G, U_B);
+	__m128i v = chroma8(r, g, b, V_R, V_G, V_B);
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(u_row), _mm_packus_epi16(u, u));
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(v_row), _mm_packus_epi16(v, v));
+}
+
+#endif
+
+
+// Every pair of rows, with the columns [0, simd_width) converted 16 at a time
+static void convert(
+	const uint8_t* pixels, uint32_t row_pitch, VkExtent2D extent, bool rgb_order,
+	uint8_t* yuv, bool simd) {
+
+	const uint32_t chroma_width = (extent.width + 1) / 2;
+	const uint32_t chroma_height = (extent.height + 1) / 2;
+
+	uint8_t* y_plane = yuv;
+	uint8_t* u_plane = y_plane + static_cast<size_t>(extent.width) * extent.height;
+	uint8_t* v_plane = u_plane + static_cast<size_t>(chroma_width) * chroma_height;
+
+	// The second row of the last pair of an odd height is written in a scratch row
+	std::vector<uint8_t> scratch_row;
+	if (extent.height % 2 != 0) {
+		scratch_row.resize(extent.width);
+	}
+
+	const uint32_t simd_width = simd ? extent.width & ~15u : 0;
+
+	for (uint32_t y = 0; y < extent.height; y += 2) {
+
+		const bool last_odd_row = y + 1 == extent.height;
+
+		const uint8_t* row0 = pixels + static_cast<size_t>(y) * row_pitch;
+		const uint8_t* row1 = last_odd_row ? row0 : row0 + row_pitch;
+		uint8_t* y_row0 = y_plane + static_cast<size_t>(y) * extent.width;
+		uint8_t* y_row1 = last_odd_row ? scratch_row.data() : y_row0 + extent.width;
+		uint8_t* u_row = u_plane + static_cast<size_t>(y / 2) * chroma_width;
+		uint8_t* v_row = v_plane + static_cast<size_t>(y / 2) * chroma_width;
+
+#ifdef VK_VIDEO_SSE2
+		for (uint32_t x = 0; x < simd_width; x += 16) {
+			convert_16_columns(row0 + 4 * x, row1 + 4 * x, rgb_order,
+				               y_row0 + x, y_row1 + x, u_row + x / 2, v_row + x / 2);
+		}
+#endif
+
+		convert_columns_scalar(row0, row1, simd_width, extent.width, rgb_order, y_row0, y_row1, u_row, v_row);
+	}
+}
+
+
+void convert_to_yuv420(const uint8_t* pixels, uint32_t row_pitch, VkExtent2D extent, bool rgb_order, uint8_t* yuv) {
+
+#ifdef VK_VIDEO_SSE2
+	convert(pixels, row_pitch, extent, rgb_order, yuv, true);
+#else
+	convert(pixels, row_pitch, extent, rgb_order, yuv, false);
+#endif
+}
+
+
+void convert_to_yuv420_scalar(const uint8_t* pixels, uint32_t row_pitch, VkExtent2D extent, bool rgb_order, uint8_t* yuv) {
+
+	convert(pixels, row_pitch, extent, rgb_order, yuv, false);
+}
+
+
+VideoSink::VideoSink(const std::string& file_path, VkExtent2D extent, uint32_t frame_rate)
+	: file_path(file_path), extent(extent) {
+
+	y4m = file_path.size() >= 4 && file_path.compare(file_path.size() - 4, 4, ".y4m") == 0;
+
+	file.open(file_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cout << "\033[31;40m";
+		throw std::runtime_error("Failed to open file: " + file_path + " \033[0m \n");
+	}
+
+	// 420jpeg: the chroma is centered between the pixels, as the 2x2 averages are
+	if (y4m) {
+		file << "YUV4MPEG2 W" << extent.width << " H" << extent.height << " F" << frame_rate
+			<< ":1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+	}
+
+	for (Buffer& buffer : buffers) {
+		buffer.yuv.resize(yuv420_frame_size(extent));
+	}
+
+	LOG_MESSAGE("Capturing " + std::to_string(extent.width) + "x" + std::to_string(extent.height) +
+		        (y4m ? " Y4M" : " raw YUV 4:2:0") + " frames to " + file_path, Color::Bright_White, Color::Black, 0);
+
+	writer_thread = std::thread(&VideoSink::write_frames, this);
+}
+
+
+VideoSink::~VideoSink() {
+
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		stopping = true;
+	}
+	filled_condition.notify_all();
+
+	writer_thread.join();
+}
+
+
+void VideoSink::write_frame(const vk_readback::Frame& frame) {
+
+	if (frame.extent.width != extent.width || frame.extent.height != extent.height || !check_yuv_source_format(frame.format)) {
+
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		dropped_frames++;
+		return;
+	}
+
+	Buffer& buffer = buffers[next_buffer];
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock(buffers_mutex);
+		written_condition.wait(lock, [&buffer] { return !buffer.filled; });
+
+		wait_stats.add_sample(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	// The writer thread is busy with the other buffer meanwhile
+	bool rgb_order = frame.format == VK_FORMAT_R8G8B8A8_UNORM || frame.format == VK_FORMAT_R8G8B8A8_SRGB;
+
+	auto start = std::chrono::steady_clock::now();
+	convert_to_yuv420(frame.pixels, frame.row_pitch, frame.extent, rgb_order, buffer.yuv.data());
+	auto end = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		convert_stats.add_sample(std::chrono::duration<double, std::milli>(end - start).count());
+		buffer.filled = true;
+	}
+	filled_condition.notify_one();
+
+	next_buffer = 1 - next_buffer;
+}
+
+
+void VideoSink::flush() {
+
+	std::unique_lock<std::mutex> lock(buffers_mutex);
+	written_condition.wait(lock, [this] { return !buffers[0].filled && !buffers[1].filled; });
+}
+
+
+void VideoSink::write_frames() {
+
+	uint32_t b = 0;
+
+	while (true) {
+
+		Buffer& buffer = buffers[b];
+		{
+			std::unique_lock<std::mutex> lock(buffers_mutex);
+			filled_condition.wait(lock, [this, &buffer] { return stopping || buffer.filled; });
+
+			// Stop once the converted frames are written
+			if (!buffer.filled) {
+				break;
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		if (y4m) {
+			file << "FRAME\n";
+		}
+		file.write(reinterpret_cast<const char*>(buffer.yuv.data()), static_cast<std::streamsize>(buffer.yuv.size()));
+		auto end = std::chrono::steady_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(buffers_mutex);
+
+			if (file.fail()) {
+				write_failed = true;
+			}
+			else {
+				written_frames++;
+				written_bytes += buffer.yuv.size();
+			}
+			write_stats.add_sample(std::chrono::duration<double, std::milli>(end - start).count());
+
+			buffer.filled = false;
+		}
+		written_condition.notify_all();
+
+		b = 1 - b;
+	}
+
+	file.close();
+}
+
+
+void VideoSink::report(const std::string& name) const {
+
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+
+	double write_seconds = write_stats.count() * write_stats.average() / 1000.0;
+
+	std::ostringstream sink_log;
+	sink_log << std::fixed << std::setprecision(2)
+		<< name << " | " << written_frames << " frame(s) written to " << file_path << ", "
+		<< dropped_frames << " dropped (other size or format), " << written_bytes / 1024.0 / 1024.0 << " MiB";
+	if (write_seconds > 0.0) {
+		sink_log << " (writes at " << written_bytes / 1024.0 / 1024.0 / write_seconds << " MiB/s)";
+	}
+
+	LOG_MESSAGE(sink_log.str(), Color::Bright_Green, Color::Black, 4);
+
+	if (write_failed) {
+		LOG_MESSAGE(name + " | writing " + file_path + " failed, the file is incomplete.", Color::Red, Color::Black, 4);
+	}
+
+	if (convert_stats.count() > 0) {
+		convert_stats.report(name + " | conversion");
+		write_stats.report(name + " | write");
+		wait_stats.report(name + " | wait for a buffer");
+	}
+}
+
+
+} // namespace vk_video
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "vk_includes.hpp"
+#include "vk_readback.hpp"
+#include "vk_profiler.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace vk_video {
+
+
+// 8 bits per channel formats a frame can be converted from (blue first or red first)
+bool check_yuv_source_format(VkFormat format);
+
+// Bytes of a YUV 4:2:0 frame: a full resolution luma plane, then two half resolution chroma planes
+size_t yuv420_frame_size(VkExtent2D extent);
+
+/*
+Convert BGRA8 (or RGBA8, rgb_order) pixels to planar YUV 4:2:0, BT.709 limited range, with the chroma of
+each 2x2 block averaged (centered siting): yuv receives yuv420_frame_size() bytes.
+8 bit fixed point, 16 pixels and 2 rows per iteration with SSE2 where it is available (every x64 build),
+the scalar loop elsewhere and for the last columns. Both give the same bytes.
+*/
+void convert_to_yuv420(
+	const uint8_t* pixels, uint32_t row_pitch, VkExtent2D extent, bool rgb_order,
+	uint8_t* yuv);
+
+// The scalar loop alone, for comparison
+void convert_to_yuv420_scalar(
+	const uint8_t* pixels, uint32_t row_pitch, VkExtent2D extent, bool rgb_order,
+	uint8_t* yuv);
+
+
+/*
+Streams frames read back from the GPU (vk_readback) to a file, for an encoder to pick up later:
+- a .y4m file (YUV4MPEG2: a text header, then a FRAME line before each frame), which ffmpeg
+  and most encoders read as is,
+- any other extension: raw YUV 4:2:0 planes back to back (the size and rate are given to the encoder).
+write_frame() converts the frame on the calling thread (the consumer thread of the readback service)
+into one of two buffers, while a writer thread writes the other one to the file: the conversion and
+the disk overlap, and the readback service skips frames only when both are slower than the GPU.
+*/
+class VideoSink {
+
+public:
+
+	// Every frame must have extent. frame_rate only goes into the Y4M header.
+	VideoSink(const std::string& file_path, VkExtent2D extent, uint32_t frame_rate);
+
+	// Writes the frames already converted, then closes the file
+	~VideoSink();
+
+	VideoSink(const VideoSink&) = delete;
+	VideoSink& operator=(const VideoSink&) = delete;
+
+	// Convert a frame, then hand it to the writer thread. Waits while both buffers are
+	// converted and not written yet. Frames of another extent or format are dropped (and counted).
+	void write_frame(const vk_readback::Frame& frame);
+
+	// Wait until the frames converted so far are written
+	void flush();
+
+	// Log the frames written and dropped, the file size and the throughput,
+	// the time of the conversion and of the writes, and the waits for a buffer
+	void report(const std::string& name) const;
+
+private:
+
+	std::string file_path;
+	VkExtent2D extent;
+	bool y4m;
+	std::ofstream file; // writer thread only, once opened
+
+	struct Buffer {
+		std::vector<uint8_t> yuv;
+		bool filled = false; // converted, not written yet
+	};
+
+	Buffer buffers[2];
+	uint32_t next_buffer = 0; // converted next, the writer writes them in the same order
+
+	std::thread writer_thread;
+	mutable std::mutex buffers_mutex; // filled, stopping and stats
+	std::condition_variable filled_condition;
+	std::condition_variable written_condition;
+	bool stopping = false;
+
+	uint64_t written_frames = 0;
+	uint64_t dropped_frames = 0;
+	uint64_t written_bytes = 0;
+	bool write_failed = false;
+	vk_profiler::TimingStats convert_stats;
+	vk_profiler::TimingStats write_stats;
+	vk_profiler::TimingStats wait_stats; // write_frame() waiting for a free buffer
+
+	void write_frames();
+};
+
+
+} // namespace vk_video
\ No newline at end of file